@@ -19,11 +19,17 @@
 
 /* Modifications copyright 2021 Matt Evans:
  * Removed SPI flash, making this self-contained using on-chip memory (BRAM).
- * FIXME: All the memory is RW, may be useful to separate text/rodata vs bss etc.
+ * Optionally (FLASH_XIP), the firmware's text/rodata run from the SPI flash
+ * again, through a cache (src/spiflash_xip.v), and the BRAM holds only
+ * data/bss/stack.
+ * The UART has FIFOs, a status/control register and an interrupt (IRQ 4).
  */
 
+`define ADDR_FLASH	32'h0100_0000
 `define ADDR_UART	32'h1000_0000
 `define ADDR_UART_REG	32'h1000_0004
+`define ADDR_UART_STAT	32'h1000_0008
+`define ADDR_XIP_REGS	32'h1000_0010
 `define ADDR_EXTERNAL	32'h2000_0000
 
 `ifndef PICORV32_REGS
@@ -58,7 +64,13 @@ module picosocme (
 	input  irq_7,
 
 	output ser_tx,
-	input  ser_rx
+	input  ser_rx,
+
+	output       flash_csn,
+	output       flash_clk,
+	output [3:0] flash_io_out,
+	output [3:0] flash_io_oe,
+	input  [3:0] flash_io_in
 );
 	parameter [0:0] BARREL_SHIFTER = 1;
 	parameter [0:0] ENABLE_MULDIV = 1;
@@ -72,13 +84,15 @@ module picosocme (
 	parameter [31:0] PROGADDR_IRQ = 32'h 0000_0000;
 
    parameter RAM_INIT_FILE = "";
+   /* 0 = no flash, 1 = XIP with quad reads, 2 = dual reads: */
+   parameter [1:0] FLASH_XIP = 0;
    parameter CLK_RATE = 50000000;
    parameter BAUD_RATE = 115200;
    localparam UART_DIV = (CLK_RATE/BAUD_RATE)-2; // ME: DIV period is n+2!
 
 	reg [31:0] irq;
 	wire irq_stall = 0;
-	wire irq_uart = 0;
+	wire irq_uart;
 
 	always @* begin
 		irq = 0;
@@ -112,12 +126,33 @@ module picosocme (
 	wire [31:0] simpleuart_reg_dat_do;
 	wire        simpleuart_reg_dat_wait;
 
+	wire        simpleuart_reg_stat_sel = mem_valid && (mem_addr == `ADDR_UART_STAT);
+	wire [31:0] simpleuart_reg_stat_do;
+
+	wire        flash_sel = mem_valid && (mem_addr[31:24] == (`ADDR_FLASH >> 24));
+	wire        flash_ready;
+	wire [31:0] flash_rdata;
+
+	/* XIP registers:  0 = {present, 29'h0, mode}, then cache hits, misses
+	 * and cycles waiting for a fill; writing any clears the counts.
+	 */
+	wire        xip_reg_sel = mem_valid && (mem_addr[31:4] == (`ADDR_XIP_REGS >> 4));
+	wire [31:0] xip_hits, xip_misses, xip_waits;
+	wire [31:0] xip_reg_do = (mem_addr[3:2] == 2'h0) ? {FLASH_XIP != 0, 29'h0, FLASH_XIP} :
+			(mem_addr[3:2] == 2'h1) ? xip_hits :
+			(mem_addr[3:2] == 2'h2) ? xip_misses : xip_waits;
+
 	assign mem_ready = (iomem_valid && iomem_ready) || ram_ready ||
-			simpleuart_reg_div_sel || (simpleuart_reg_dat_sel && !simpleuart_reg_dat_wait);
+			simpleuart_reg_div_sel || (simpleuart_reg_dat_sel && !simpleuart_reg_dat_wait) ||
+			simpleuart_reg_stat_sel ||
+			flash_ready || xip_reg_sel;
 
 	assign mem_rdata = (iomem_valid && iomem_ready) ? iomem_rdata : ram_ready ? ram_rdata :
+			flash_ready ? flash_rdata :
 			simpleuart_reg_div_sel ? simpleuart_reg_div_do :
-			simpleuart_reg_dat_sel ? simpleuart_reg_dat_do : 32'h 0000_0000;
+			simpleuart_reg_dat_sel ? simpleuart_reg_dat_do :
+			simpleuart_reg_stat_sel ? simpleuart_reg_stat_do :
+			xip_reg_sel ? xip_reg_do : 32'h 0000_0000;
 
 	picorv32 #(
 		.STACKADDR(STACKADDR),
@@ -160,9 +195,51 @@ module picosocme (
 		.reg_dat_re  (simpleuart_reg_dat_sel && !mem_wstrb),
 		.reg_dat_di  (mem_wdata),
 		.reg_dat_do  (simpleuart_reg_dat_do),
-		.reg_dat_wait(simpleuart_reg_dat_wait)
+		.reg_dat_wait(simpleuart_reg_dat_wait),
+
+		.reg_stat_we (simpleuart_reg_stat_sel && mem_wstrb[0]),
+		.reg_stat_di (mem_wdata),
+		.reg_stat_do (simpleuart_reg_stat_do),
+
+		.irq         (irq_uart    )
 	);
 
+	generate if (FLASH_XIP != 0) begin: xip
+		spiflash_xip #(
+			.QUAD(FLASH_XIP == 1)
+		) flash (
+			.clk         (clk         ),
+			.reset       (!resetn     ),
+
+			.valid       (flash_sel   ),
+			.write       (|mem_wstrb  ),
+			.addr        (mem_addr[23:0]),
+			.ready       (flash_ready ),
+			.rdata       (flash_rdata ),
+
+			.clear_stats (xip_reg_sel && |mem_wstrb),
+			.hits        (xip_hits    ),
+			.misses      (xip_misses  ),
+			.wait_cycles (xip_waits   ),
+
+			.flash_csn   (flash_csn   ),
+			.flash_clk   (flash_clk   ),
+			.flash_io_out(flash_io_out),
+			.flash_io_oe (flash_io_oe ),
+			.flash_io_in (flash_io_in )
+		);
+	end else begin
+		assign flash_ready = 0;
+		assign flash_rdata = 0;
+		assign xip_hits = 0;
+		assign xip_misses = 0;
+		assign xip_waits = 0;
+		assign flash_csn = 1;
+		assign flash_clk = 0;
+		assign flash_io_out = 0;
+		assign flash_io_oe = 0;
+	end endgenerate
+
 	always @(posedge clk)
 		ram_ready <= mem_valid && !mem_ready && mem_addr < 4*MEM_WORDS;
 
@@ -17,7 +17,26 @@
  *
  */
 
-module simpleuart #(parameter integer DEFAULT_DIV = 1) (
+/* Modifications copyright 2021 Matt Evans:
+ * TX and RX FIFOs, so that writes only wait when the TX FIFO is full and
+ * received characters aren't lost between polls, plus a status/control
+ * register and a level interrupt:
+ *
+ *   status (read):   0     RX data available
+ *                    1     TX FIFO full
+ *                    2     TX idle (FIFO empty, nothing being sent)
+ *                    3     RX overrun (sticky; a character was lost)
+ *                    4     RX interrupt enabled
+ *                    5     TX interrupt enabled
+ *                    15:8  RX FIFO level
+ *                    23:16 TX FIFO level
+ *   status (write):  3     1 clears RX overrun
+ *                    4     Interrupt while RX data is available
+ *                    5     Interrupt while the TX FIFO is at most half full
+ */
+
+module simpleuart #(parameter integer DEFAULT_DIV = 1,
+		    parameter integer FIFO_BITS = 4) (
 	input clk,
 	input resetn,
 
@@ -32,25 +51,69 @@ module simpleuart #(parameter integer DEFAULT_DIV = 1) (
 	input         reg_dat_re,
 	input  [31:0] reg_dat_di,
 	output [31:0] reg_dat_do,
-	output        reg_dat_wait
+	output        reg_dat_wait,
+
+	input         reg_stat_we,
+	input  [31:0] reg_stat_di,
+	output [31:0] reg_stat_do,
+
+	output        irq
 );
+	localparam FIFO_DEPTH = 1 << FIFO_BITS;
+
 	reg [31:0] cfg_divider;
 
 	reg [3:0] recv_state;
 	reg [31:0] recv_divcnt;
 	reg [7:0] recv_pattern;
-	reg [7:0] recv_buf_data;
-	reg recv_buf_valid;
 
 	reg [9:0] send_pattern;
 	reg [3:0] send_bitcnt;
 	reg [31:0] send_divcnt;
 	reg send_dummy;
 
+	/* The FIFO pointers have an extra bit, to tell full from empty: */
+	reg [7:0] recv_fifo [0:FIFO_DEPTH-1];
+	reg [FIFO_BITS:0] recv_wr;
+	reg [FIFO_BITS:0] recv_rd;
+	wire [FIFO_BITS:0] recv_level = recv_wr - recv_rd;
+	wire recv_empty = recv_wr == recv_rd;
+	reg recv_overrun;
+
+	reg [7:0] send_fifo [0:FIFO_DEPTH-1];
+	reg [FIFO_BITS:0] send_wr;
+	reg [FIFO_BITS:0] send_rd;
+	wire [FIFO_BITS:0] send_level = send_wr - send_rd;
+	wire send_empty = send_wr == send_rd;
+	wire send_full = send_level[FIFO_BITS];
+	wire send_idle = send_empty && !send_bitcnt && !send_dummy;
+
+	reg rx_irq_en;
+	reg tx_irq_en;
+
 	assign reg_div_do = cfg_divider;
 
-	assign reg_dat_wait = reg_dat_we && (send_bitcnt || send_dummy);
-	assign reg_dat_do = recv_buf_valid ? recv_buf_data : ~0;
+	assign reg_dat_wait = reg_dat_we && send_full;
+	assign reg_dat_do = recv_empty ? ~0 : recv_fifo[recv_rd[FIFO_BITS-1:0]];
+
+	assign reg_stat_do = {8'h0,
+			      {(7-FIFO_BITS){1'b0}}, send_level,
+			      {(7-FIFO_BITS){1'b0}}, recv_level,
+			      2'b00, tx_irq_en, rx_irq_en,
+			      recv_overrun, send_idle, send_full, !recv_empty};
+
+	assign irq = (rx_irq_en && !recv_empty) ||
+		     (tx_irq_en && send_level <= FIFO_DEPTH/2);
+
+	always @(posedge clk) begin
+		if (!resetn) begin
+			rx_irq_en <= 0;
+			tx_irq_en <= 0;
+		end else if (reg_stat_we) begin
+			rx_irq_en <= reg_stat_di[4];
+			tx_irq_en <= reg_stat_di[5];
+		end
+	end
 
 	always @(posedge clk) begin
 		if (!resetn) begin
@@ -68,12 +131,15 @@ module simpleuart #(parameter integer DEFAULT_DIV = 1) (
 			recv_state <= 0;
 			recv_divcnt <= 0;
 			recv_pattern <= 0;
-			recv_buf_data <= 0;
-			recv_buf_valid <= 0;
+			recv_wr <= 0;
+			recv_rd <= 0;
+			recv_overrun <= 0;
 		end else begin
 			recv_divcnt <= recv_divcnt + 1;
-			if (reg_dat_re)
-				recv_buf_valid <= 0;
+			if (reg_dat_re && !recv_empty)
+				recv_rd <= recv_rd + 1;
+			if (reg_stat_we && reg_stat_di[3])
+				recv_overrun <= 0;
 			case (recv_state)
 				0: begin
 					if (!ser_rx)
@@ -88,8 +154,12 @@ module simpleuart #(parameter integer DEFAULT_DIV = 1) (
 				end
 				10: begin
 					if (recv_divcnt > cfg_divider) begin
-						recv_buf_data <= recv_pattern;
-						recv_buf_valid <= 1;
+						if (recv_level == FIFO_DEPTH) begin
+							recv_overrun <= 1;
+						end else begin
+							recv_fifo[recv_wr[FIFO_BITS-1:0]] <= recv_pattern;
+							recv_wr <= recv_wr + 1;
+						end
 						recv_state <= 0;
 					end
 				end
@@ -115,15 +185,23 @@ module simpleuart #(parameter integer DEFAULT_DIV = 1) (
 			send_bitcnt <= 0;
 			send_divcnt <= 0;
 			send_dummy <= 1;
+			send_wr <= 0;
+			send_rd <= 0;
 		end else begin
+			if (reg_dat_we && !send_full) begin
+				send_fifo[send_wr[FIFO_BITS-1:0]] <= reg_dat_di[7:0];
+				send_wr <= send_wr + 1;
+			end
+
 			if (send_dummy && !send_bitcnt) begin
 				send_pattern <= ~0;
 				send_bitcnt <= 15;
 				send_divcnt <= 0;
 				send_dummy <= 0;
 			end else
-			if (reg_dat_we && !send_bitcnt) begin
-				send_pattern <= {1'b1, reg_dat_di[7:0], 1'b0};
+			if (!send_empty && !send_bitcnt) begin
+				send_pattern <= {1'b1, send_fifo[send_rd[FIFO_BITS-1:0]], 1'b0};
+				send_rd <= send_rd + 1;
 				send_bitcnt <= 10;
 				send_divcnt <= 0;
 			end else
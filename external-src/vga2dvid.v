@@ -68,6 +68,12 @@ input wire [7:0] in_blue,
 input wire in_blank,
 input wire in_hsync,
 input wire in_vsync,
+// ME: HDMI data islands/guard bands, replacing the encoded symbols (see
+// src/hdmi_island.v), aligned with the encoder output:
+input wire in_island,
+input wire [9:0] in_island_red,
+input wire [9:0] in_island_green,
+input wire [9:0] in_island_blue,
 output wire [9:0] outp_red,
 output wire [9:0] outp_green,
 output wire [9:0] outp_blue,
@@ -176,9 +182,9 @@ wire [7:0] blue_d;
     .encoded(encoded_blue));
 
   always @(posedge clk_pixel) begin
-    latched_red <= encoded_red;
-    latched_green <= encoded_green;
-    latched_blue <= encoded_blue;
+    latched_red <= in_island ? in_island_red : encoded_red;
+    latched_green <= in_island ? in_island_green : encoded_green;
+    latched_blue <= in_island ? in_island_blue : encoded_blue;
   end
 
   generate if (c_parallel == 1'b1) begin: G_parallel
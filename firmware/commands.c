@@ -29,7 +29,11 @@
 #include "uart.h"
 #include "vidc_regs.h"
 #include "video.h"
+#include "sound.h"
+#include "log.h"
+#include "telem.h"
 #include "libcfns.h"
+#include "firmware.h"
 
 
 typedef void (*cmd_fn_t)(char *args);
@@ -295,6 +299,155 @@ static void cmd_sync(char *args)
         video_sync();
 }
 
+static void cmd_commit(char *args)
+{
+        video_commit();
+}
+
+static void cmd_fs(char *args)
+{
+        int OK;
+        unsigned int en = atoh(args, &args, &OK);
+
+        if (!OK) {
+                video_dump_frame_store();
+                return;
+        }
+        video_set_frame_store(en);
+}
+
+static void cmd_hc(char *args)
+{
+        int OK;
+        unsigned int bits = atoh(args, &args, &OK);
+
+        if (!OK) {
+                mprintf("\r\n Syntax error, 0, 16 or 24 expected\r\n");
+                return;
+        }
+        /* Numbers are hex, but let 16/24 mean what they look like: */
+        if (bits == 0x16 || bits == 0x24)
+                bits = ((bits >> 4) * 10) + (bits & 0xf);
+        video_set_hicolour(bits);
+}
+
+static void cmd_rq(char *args)
+{
+        int OK;
+        unsigned int clear = atoh(args, &args, &OK);
+
+        video_dump_replay(OK && clear);
+}
+
+static void cmd_stats(char *args)
+{
+        int OK;
+        unsigned int clear = atoh(args, &args, &OK);
+
+        video_dump_stats(OK && clear);
+}
+
+static void cmd_perf(char *args)
+{
+        int OK;
+        unsigned int clear = atoh(args, &args, &OK);
+
+        perf_dump(OK && clear);
+}
+
+static void cmd_telem(char *args)
+{
+        int OK;
+        unsigned int en = atoh(args, &args, &OK);
+
+        if (!OK) {
+                telem_dump_stats();
+                return;
+        }
+        telem_set(en);
+}
+
+static void cmd_baud(char *args)
+{
+        int OK;
+        unsigned int v = atoh(args, &args, &OK);
+        unsigned int baud = 0;
+
+        if (!OK) {
+                uart_dump_stats();
+                return;
+        }
+        /* Numbers are hex, but this one's given in decimal: */
+        for (int i = 28; i >= 0; i -= 4) {
+                unsigned int d = (v >> i) & 0xf;
+
+                if (d > 9) {
+                        baud = 0;
+                        break;
+                }
+                baud = baud * 10 + d;
+        }
+        if (baud < 9600 || baud > UART_BAUD_MAX) {
+                mprintf("\r\n Baud rate 9600-%d expected\r\n", UART_BAUD_MAX);
+                return;
+        }
+        mprintf("Baud rate %d, switching\r\n", baud);
+        uart_set_baud(baud);
+}
+
+static void cmd_log(char *args)
+{
+        log_dump_stats();
+}
+
+static void cmd_ll(char *args)
+{
+        int OK;
+        unsigned int mode = atoh(args, &args, &OK);
+
+        if (!OK) {
+                mprintf("\r\n Syntax error, 0, 1 or 2 expected\r\n");
+                return;
+        }
+        video_set_line_lock(mode);
+}
+
+static void cmd_scale(char *args)
+{
+        int OK;
+        unsigned int n = atoh(args, &args, &OK);
+
+        if (!OK) {
+                mprintf("\r\n Syntax error, 0 or 2-4 expected\r\n");
+                return;
+        }
+        video_set_scale(n);
+}
+
+static void cmd_fixed(char *args)
+{
+        int OK;
+        unsigned int en = atoh(args, &args, &OK);
+
+        if (!OK) {
+                mprintf("\r\n Syntax error, 0 or 1 expected\r\n");
+                return;
+        }
+        video_set_fixed(en);
+}
+
+static void cmd_snd(char *args)
+{
+        int OK;
+        unsigned int en = atoh(args, &args, &OK);
+
+        if (!OK) {
+                sound_dump();
+                return;
+        }
+        sound_set_hdmi(en);
+}
+
 static void cmd_vidc_dump(char *args)
 {
         vidc_dumpregs();
@@ -319,6 +472,33 @@ static void cmd_autoprobe(char *args)
         mprintf("Autoprobe is %s\r\n", flag_autoprobe_mode ? "on" : "off");
 }
 
+static void cmd_probe(char *args)
+{
+        video_probe_mode();
+}
+
+static void cmd_latency(char *args)
+{
+        video_dump_latency();
+}
+
+static void cmd_modes(char *args)
+{
+        video_dump_modes();
+}
+
+static void cmd_settle(char *args)
+{
+        int OK;
+        unsigned int frames = atoh(args, &args, &OK);
+
+        if (!OK || frames > 15) {
+                mprintf("\r\n Syntax error, frames (0-f) expected\r\n");
+                return;
+        }
+        video_set_settle(frames);
+}
+
 
 /*****************************************************************************/
 
@@ -362,9 +542,60 @@ static cmd_t commands[] = {
         { .format = "sync",
           .help = "sync\t\t\tResync display to VIDC",
           .handler = cmd_sync },
+        { .format = "commit",
+          .help = "commit\t\t\tApply timing regs at next frame, without resync",
+          .handler = cmd_commit },
         { .format = "a",
           .help = "a\t\t\tToggle mode autoprobing",
           .handler = cmd_autoprobe },
+        { .format = "probe",
+          .help = "probe			Probe VIDC mode now",
+          .handler = cmd_probe },
+        { .format = "lat",
+          .help = "lat			Show mode change latency",
+          .handler = cmd_latency },
+        { .format = "modes",
+          .help = "modes\t\t\tShow mode table/cache use",
+          .handler = cmd_modes },
+        { .format = "settle",
+          .help = "settle <frames>\t\tSet mode change settle time",
+          .handler = cmd_settle },
+        { .format = "fs",
+          .help = "fs [0|1]\t\tShow/enable frame store (60Hz output)",
+          .handler = cmd_fs },
+        { .format = "hc",
+          .help = "hc <0|16|24>\t\tShow 8bpp modes as high colour",
+          .handler = cmd_hc },
+        { .format = "rq",
+          .help = "rq [1]\t\t\tShow palette/cursor write queue (1 clears)",
+          .handler = cmd_rq },
+        { .format = "stats",
+          .help = "stats [1]\t\tShow output latency/line buffer slack (1 clears)",
+          .handler = cmd_stats },
+        { .format = "perf",
+          .help = "perf [1]\t\tShow main loop time/XIP cache hits (1 clears)",
+          .handler = cmd_perf },
+        { .format = "telem",
+          .help = "telem [bits]\t\tShow/send binary telemetry (1 frames, 2 VIDC, 4 reconf)",
+          .handler = cmd_telem },
+        { .format = "baud",
+          .help = "baud [rate]\t\tShow UART stats and output cost/set baud rate",
+          .handler = cmd_baud },
+        { .format = "log",
+          .help = "log\t\t\tShow log message counts",
+          .handler = cmd_log },
+        { .format = "ll",
+          .help = "ll <0|1|2>\t\tLine lock off/when inexact/always",
+          .handler = cmd_ll },
+        { .format = "scale",
+          .help = "scale <0|2|3|4>\t\tScale modes up to n times (0 doubles as needed)",
+          .handler = cmd_scale },
+        { .format = "fixed",
+          .help = "fixed <0|1>\t\tFixed 1280x1024 output, scaled (no relock)",
+          .handler = cmd_fixed },
+        { .format = "snd",
+          .help = "snd [0|1]\t\tShow sound/enable HDMI audio",
+          .handler = cmd_snd },
         { .format = "dm",
           .help = "dm <addr> <len>\t\tHexdump memory",
           .handler = cmd_dump },
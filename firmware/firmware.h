@@ -16,6 +16,18 @@
 // irq.c
 uint32_t *irq(uint32_t *regs, uint32_t irqs);
 
+// The UART's IRQ wakes the main loop for input, so the timer IRQ is
+// just a backstop.
+#define TIMER_TICK_CYCLES (CPU_CLK_RATE/1000)
+
+// start.S
+uint32_t irq_setmask(uint32_t mask);	// 1 = masked; returns old mask
+uint32_t irq_wait(void);		// returns pending IRQs
+uint32_t irq_timer(uint32_t cycles);
+
+// main.c
+void perf_dump(int clear);
+
 // print.c
 void print_chr(char ch);
 void print_str(const char *p);
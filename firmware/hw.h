@@ -25,9 +25,23 @@
 #ifndef HW_H
 #define HW_H
 
+#define CPU_CLK_RATE    50000000        // soc_top CLK_RATE
+
 #define UART_ADDR       0x10000000
 #define UART_DIV_ADDR   0x10000004
+#define UART_STAT_ADDR  0x10000008      // Status/control, see simpleuart.v:
+#define UART_STAT_RX_AVAIL      0x01
+#define UART_STAT_TX_FULL       0x02
+#define UART_STAT_TX_IDLE       0x04
+#define UART_STAT_RX_OVERRUN    0x08    // Write 1 to clear
+#define UART_STAT_RX_IE         0x10
+#define UART_STAT_TX_IE         0x20    // IRQ while the TX FIFO's at most half full
+#define UART_FIFO_SIZE          16      // Each way, simpleuart FIFO_BITS
+#define UART_BAUD_MAX           3000000 // The ULX3S's FT231X
+#define XIP_REGS_ADDR   0x10000010      // FLASH_XIP status, cache hits/misses/wait cycles
+#define XIP_PRESENT     0x80000000      // In XIP reg 0, with the mode (1 quad, 2 dual) in 1:0
 #define IO_BASE_ADDR    0x20000000
 #define VIDO_BASE_ADDR  0x22000000      // See video.h
+#define SND_BASE_ADDR   0x23000000      // See sound.h
 
 #endif
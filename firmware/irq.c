@@ -6,6 +6,8 @@
 // means.
 
 #include "firmware.h"
+#include "video.h"
+#include "uart.h"
 
 uint32_t *irq(uint32_t *regs, uint32_t irqs)
 {
@@ -36,17 +38,17 @@ uint32_t *irq(uint32_t *regs, uint32_t irqs)
 
 	if ((irqs & (1<<4)) != 0) {
 		ext_irq_4_count++;
-		// print_str("[EXT-IRQ-4]");
+		uart_irq();
 	}
 
 	if ((irqs & (1<<5)) != 0) {
 		ext_irq_5_count++;
-		// print_str("[EXT-IRQ-5]");
+		video_irq();
 	}
 
 	if ((irqs & 1) != 0) {
 		timer_irq_count++;
-		// print_str("[TIMER-IRQ]");
+		irq_timer(TIMER_TICK_CYCLES);
 	}
 
 	if ((irqs & 6) != 0)
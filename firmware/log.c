@@ -0,0 +1,127 @@
+/* ArcDVI firmware deferred logging, see log.h
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include "firmware.h"
+#include "uart.h"
+#include "log.h"
+
+
+/* A record with no format notes args[0] messages dropped (before the next): */
+struct log_rec {
+        const char      *fmt;
+        uint32_t        args[LOG_MAX_ARGS];
+};
+
+static struct log_rec   ring[LOG_RING_SIZE];
+/* Free-running; head is written by log_put(), tail by log_drain(): */
+static volatile unsigned int head = 0;
+static volatile unsigned int tail = 0;
+static unsigned int     dropped = 0;       /* Since the last drop record */
+
+static unsigned int     total = 0;
+static unsigned int     total_dropped = 0;
+static unsigned int     max_used = 0;
+
+/* Queue a message (use log_msg()).  May be called with IRQs enabled or
+ * from the IRQ handler, so the slot is claimed with IRQs masked.  After
+ * messages have been dropped, the next needs a slot for a drop record too,
+ * so that the drop is reported in order.
+ */
+void    log_put(unsigned int nargs, const char *fmt, ...)
+{
+        va_list args;
+        uint32_t old_mask = irq_setmask(~0);
+        unsigned int used = head - tail;
+        unsigned int need = dropped ? 2 : 1;
+
+        if (used + need > LOG_RING_SIZE) {
+                dropped++;
+                total_dropped++;
+                irq_setmask(old_mask);
+                return;
+        }
+
+        struct log_rec *r;
+
+        if (dropped) {
+                r = &ring[head % LOG_RING_SIZE];
+                r->fmt = 0;
+                r->args[0] = dropped;
+                dropped = 0;
+                head++;
+        }
+        r = &ring[head % LOG_RING_SIZE];
+
+        r->fmt = fmt;
+        va_start(args, fmt);
+        for (unsigned int i = 0; i < nargs && i < LOG_MAX_ARGS; i++)
+                r->args[i] = va_arg(args, uint32_t);
+        va_end(args);
+        head++;
+        total++;
+        if (used + need > max_used)
+                max_used = used + need;
+        irq_setmask(old_mask);
+}
+
+/* Write out the oldest record, from the main loop.  Returns non-zero if
+ * there was one, so more may follow.
+ */
+int     log_drain(void)
+{
+        struct log_rec r;
+
+        uint32_t old_mask = irq_setmask(~0);
+        int have = head != tail;
+        if (have) {
+                r = ring[tail % LOG_RING_SIZE];
+                tail++;
+        }
+        irq_setmask(old_mask);
+
+        if (!have)
+                return 0;
+        if (!r.fmt)
+                mprintf("<%d log messages dropped>\r\n", r.args[0]);
+        else
+                /* Unused arguments are harmless: */
+                mprintf(r.fmt, r.args[0], r.args[1], r.args[2],
+                        r.args[3], r.args[4], r.args[5]);
+        return 1;
+}
+
+/* Write out everything queued, e.g. before printing directly: */
+void    log_flush(void)
+{
+        while (log_drain()) {
+        }
+}
+
+void    log_dump_stats(void)
+{
+        mprintf("Log: %d messages, %d dropped, %d queued (max %d of %d)\r\n",
+                total, total_dropped, head - tail, max_used, LOG_RING_SIZE);
+}
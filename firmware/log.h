@@ -0,0 +1,55 @@
+/*
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <inttypes.h>
+
+/* Deferred logging:
+ *
+ * A message is queued as a binary record, its format string and up to
+ * LOG_MAX_ARGS integer arguments, in a RAM ring.  It's only formatted and
+ * written to the UART (which waits for each character) later, from the
+ * main loop when it's idle.  So, logging is cheap and never waits, and can
+ * be done from IRQ handlers and other time-critical paths.
+ *
+ * The format is printed later, so it and any %s arguments must be string
+ * constants.  If the ring is full, the message is dropped; the number
+ * dropped is reported once there's room again.
+ */
+#define LOG_MAX_ARGS            6
+#define LOG_RING_SIZE           64      /* Records, a power of 2 */
+
+/* log_msg(fmt, ...) queues fmt with 0 to LOG_MAX_ARGS arguments: */
+#define LOG_NARGS_(f, a1, a2, a3, a4, a5, a6, n, ...)   n
+#define LOG_NARGS(...)          LOG_NARGS_(__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0, x)
+#define log_msg(...)            log_put(LOG_NARGS(__VA_ARGS__), __VA_ARGS__)
+
+void    log_put(unsigned int nargs, const char *fmt, ...);
+int     log_drain(void);
+void    log_flush(void);
+void    log_dump_stats(void);
+
+#endif
@@ -29,9 +29,22 @@
 #include "uart.h"
 #include "commands.h"
 #include "video.h"
+#include "log.h"
+#include "telem.h"
 
 
 #define UART_PROMPT "> "
+#define UART_TX_ROOM    128     /* Enough for most log messages/records */
+
+static volatile uint32_t *vr = (volatile uint32_t *)VIDO_BASE_ADDR;
+static volatile uint32_t *xip_regs = (volatile uint32_t *)XIP_REGS_ADDR;
+
+/* Time spent awake in the main loop, per pass (including any IRQs taken),
+ * in CPU clocks:  this is what running from flash slows down.
+ */
+static unsigned int loop_count;
+static unsigned int loop_max;
+static uint64_t loop_total;
 
 /* Look for new UART activity, basic line editing/dispatch command: */
 static void     serial_poll(void)
@@ -76,6 +89,8 @@ static void     serial_poll(void)
                 }
 
                 if (line_done) {
+                        /* Anything logged comes before the command's output: */
+                        log_flush();
                         cmd_parse(buf, len);
                         line_done = 0;
                         len = 0;
@@ -84,42 +99,75 @@ static void     serial_poll(void)
         }
 }
 
-uint8_t flag_autoprobe_mode = 1;
-
-static void     vidc_config_poll(void)
+void    perf_dump(int clear)
 {
-        volatile uint32_t *vr = (volatile uint32_t *)VIDO_BASE_ADDR;
-        uint32_t s = vr[VIDO_REG_SYNC];
-
-        int status = !!(s & 8);
-        int ack = !!(s & 4);
-
-        if (status != ack) {
-                // FIXME: Delay a frame or so, so that all writes have Probably Happened
-                mprintf("<VIDC RECONFIG %08x>\r\n", s);
-                vr[VIDO_REG_SYNC] = s ^ 4; // Flip ack, enables further detection.
+        mprintf("Main loop: %d passes, mean %d max %d clocks\r\n",
+                loop_count, loop_count ? (unsigned int)(loop_total / loop_count) : 0,
+                loop_max);
+
+        uint32_t xip = xip_regs[0];
+
+        if (xip & XIP_PRESENT) {
+                unsigned int hits = xip_regs[1];
+                unsigned int misses = xip_regs[2];
+                unsigned int total = hits + misses;
+
+                mprintf("XIP (%s): %d hits, %d misses (%d.%d%% hit), %d wait clocks\r\n",
+                        (xip & 3) == 1 ? "quad" : "dual", hits, misses,
+                        total ? (unsigned int)(1000ULL * hits / total) / 10 : 0,
+                        total ? (unsigned int)(1000ULL * hits / total) % 10 : 0,
+                        xip_regs[3]);
+        } else {
+                mprintf("Running from BRAM\r\n");
+        }
 
-                if (flag_autoprobe_mode)
-                        video_probe_mode();
+        if (clear) {
+                loop_count = 0;
+                loop_total = 0;
+                loop_max = 0;
+                xip_regs[0] = 0;
         }
 }
 
 void    main(void)
 {
+        uart_init();
 	mprintf("Good morning, world\n");
 
         cmd_init();
-
-        /* Active hot-spinning loop to poll various services (monitor regs,
-         * interactive UART IO, update OSD, etc.)
+        video_init();
+        irq_timer(TIMER_TICK_CYCLES);
+
+        /* The video IRQ notices VIDC reconfiguration, and this loop works
+         * out the new output timing (video_poll()).  It also deals with the
+         * rest (interactive UART IO, and writing out the log and telemetry,
+         * one message or record at a time so that input is still polled)
+         * and sleeps until the next interrupt when there's nothing to do;
+         * the UART IRQ wakes it for input, or when its TX ring has drained
+         * enough for the next message.
          */
         mprintf(UART_PROMPT);
 
         while (1) {
+                uint32_t t = vr[VIDO_REG_TIME];
+
                 /* Poll UART */
                 serial_poll();
 
-                vidc_config_poll();
+                int busy = video_poll();
+
+                /* Not if that would wait for the TX ring: */
+                busy |= uart_tx_space() >= UART_TX_ROOM &&
+                        (log_drain() || telem_drain());
+
+                t = vr[VIDO_REG_TIME] - t;
+                loop_count++;
+                loop_total += t;
+                if (t > loop_max)
+                        loop_max = t;
+
+                if (!busy)
+                        irq_wait();
         }
 
         mprintf("\nDone\n");
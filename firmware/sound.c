@@ -0,0 +1,54 @@
+/*
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "firmware.h"
+#include "uart.h"
+#include "sound.h"
+#include "hw.h"
+
+
+static volatile uint32_t *sr = (volatile uint32_t *)SND_BASE_ADDR;
+
+void    sound_set_hdmi(int enable)
+{
+        sr[SND_REG_CTRL] = enable ? 1 : 0;
+        mprintf("HDMI audio %s\r\n", enable ? "on" : "off (DVI output)");
+}
+
+/* Show status, and errors since last time */
+void    sound_dump(void)
+{
+        uint32_t st = sr[SND_REG_STATUS];
+        uint32_t e = sr[SND_REG_ERRS];
+        unsigned int sfr = st & 0xff;
+
+        mprintf("HDMI audio %s; sound %s, %d bytes buffered, "
+                "sample period %dus (%d Hz)\r\n",
+                (sr[SND_REG_CTRL] & 1) ? "on" : "off",
+                (st & 0x80000000) ? "playing" : "stopped",
+                (st >> 16) & 0x1ff, sfr + 2, 1000000 / (sfr + 2));
+        mprintf(" %d underruns, %d overflows, %d frames skipped, %d repeated\r\n",
+                e >> 24, (e >> 16) & 0xff, (e >> 8) & 0xff, e & 0xff);
+        sr[SND_REG_ERRS] = 0;
+}
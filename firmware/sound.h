@@ -0,0 +1,53 @@
+/*
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SOUND_H
+#define SOUND_H
+
+/* Sound register interface:
+ *
+ * VIDC's sound DMA is played out (at VIDC's sample rate, with its stereo
+ * positions) and resampled to 48kHz, to be sent as HDMI audio.
+ */
+#define SND_REG_CTRL            0
+/* 0            HDMI enable:  send audio and InfoFrames in data islands
+ *              (the output is plain DVI otherwise)
+ */
+#define SND_REG_STATUS          1
+/* 31           Playing, i.e. buffer primed (RO)
+ * 24:16        Bytes in the DMA buffer (RO)
+ * 7:0          VIDC sound frequency register, period is (SFR + 2)us (RO)
+ */
+#define SND_REG_ERRS            2
+/* 31:24        Underruns, buffer ran dry
+ * 23:16        Overflows, DMA lost
+ * 15:8         Frames skipped, buffer level too high
+ * 7:0          Frames repeated, buffer level too low
+ *              (all RO, saturating, write to clear)
+ */
+
+void    sound_set_hdmi(int enable);
+void    sound_dump(void);
+
+#endif
@@ -0,0 +1,250 @@
+/* ArcDVI telemetry, see telem.h
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "firmware.h"
+#include "uart.h"
+#include "vidc_regs.h"
+#include "video.h"
+#include "telem.h"
+
+
+#define TELEM_RING_SIZE         512     /* Bytes, a power of 2 */
+
+/* Queued as a length byte, the type, then the body; the sequence number
+ * and CRC are added as it's sent.  head is written by telem_put(), tail by
+ * telem_drain(), both free-running.
+ */
+static uint8_t          ring[TELEM_RING_SIZE];
+static volatile unsigned int head = 0;
+static volatile unsigned int tail = 0;
+static unsigned int     dropped = 0;            /* Since the last drop record */
+
+static unsigned int     enabled = 0;
+static uint8_t          seq = 0;
+static unsigned int     last_frame = 0;
+static uint32_t         vidc_shadow[TELEM_VIDC_REGS];
+static int              vidc_shadow_valid = 0;
+
+static unsigned int     total = 0;
+static unsigned int     total_bytes = 0;
+static unsigned int     total_dropped = 0;
+static unsigned int     max_used = 0;
+
+static const uint8_t    timing_regs[TELEM_TIMING_REGS] = { TELEM_TIMING_REG_LIST };
+
+static volatile uint32_t *vr = (volatile uint32_t *)VIDO_BASE_ADDR;
+
+static uint8_t  *put_le(uint8_t *p, uint32_t v, int bytes)
+{
+        for (int i = 0; i < bytes; i++) {
+                *p++ = (uint8_t)v;
+                v >>= 8;
+        }
+        return p;
+}
+
+static void     ring_put(uint8_t b)
+{
+        ring[head % TELEM_RING_SIZE] = b;
+        head++;
+}
+
+/* Queue a record, from the IRQ handler or with IRQs enabled.  As with the
+ * log, after a drop the next needs room for a drop record too.
+ */
+static void     telem_put(unsigned int type, const uint8_t *body, unsigned int len)
+{
+        uint32_t old_mask = irq_setmask(~0);
+        unsigned int used = head - tail;
+        unsigned int need = 2 + len + (dropped ? 4 : 0);
+
+        if (used + need > TELEM_RING_SIZE) {
+                if (dropped < 0xffff)
+                        dropped++;
+                total_dropped++;
+                irq_setmask(old_mask);
+                return;
+        }
+
+        if (dropped) {
+                ring_put(3);
+                ring_put(TELEM_DROP);
+                ring_put(dropped & 0xff);
+                ring_put(dropped >> 8);
+                dropped = 0;
+        }
+        ring_put(1 + len);
+        ring_put(type);
+        for (unsigned int i = 0; i < len; i++)
+                ring_put(body[i]);
+        if (used + need > max_used)
+                max_used = used + need;
+        irq_setmask(old_mask);
+}
+
+static void     telem_timing(unsigned int frame)
+{
+        uint8_t b[8 + 4 * TELEM_TIMING_REGS];
+        uint8_t *p = b;
+
+        p = put_le(p, vr[VIDO_REG_TIME], 4);
+        p = put_le(p, frame, 4);
+        for (int i = 0; i < TELEM_TIMING_REGS; i++)
+                p = put_le(p, vr[timing_regs[i]], 4);
+        telem_put(TELEM_TIMING, b, p - b);
+}
+
+void    telem_set(unsigned int en)
+{
+        uint32_t old_mask = irq_setmask(~0);
+        enabled = en & TELEM_EN_ALL;
+        /* The next frame record sends all the VIDC registers: */
+        vidc_shadow_valid = 0;
+        irq_setmask(old_mask);
+
+        if (enabled & TELEM_EN_RECONF)
+                telem_timing(last_frame);
+}
+
+/* Once per frame (flyback end), from the IRQ handler: */
+void    telem_frame(unsigned int frame)
+{
+        volatile uint32_t *regs = (volatile uint32_t *)IO_BASE_ADDR;
+        /* Static, to keep it off the IRQ stack: */
+        static uint8_t b[TELEM_FRAME_BODY + 8 + 3 * TELEM_VIDC_REGS];
+        uint8_t *p = b;
+
+        last_frame = frame;
+        if (!(enabled & TELEM_EN_FRAME))
+                return;
+
+        p = put_le(p, vr[VIDO_REG_TIME], 4);
+        p = put_le(p, frame, 4);
+        p = put_le(p, regs[V_DMAC_VIDEO / 4], 2);
+        p = put_le(p, regs[V_DMAC_CURSOR / 4], 2);
+        p = put_le(p, vr[VIDO_REG_SLACK], 4);
+
+        if (enabled & TELEM_EN_VIDC) {
+                uint8_t *m = p;
+                uint32_t mask[2] = { 0, 0 };
+
+                p += 8;
+                for (int i = 0; i < TELEM_VIDC_REGS; i++) {
+                        uint32_t v = regs[i] & 0xffffff;
+
+                        if (vidc_shadow_valid && v == vidc_shadow[i])
+                                continue;
+                        vidc_shadow[i] = v;
+                        mask[i / 32] |= 1u << (i % 32);
+                        p = put_le(p, v, 3);
+                }
+                put_le(m, mask[0], 4);
+                put_le(m + 4, mask[1], 4);
+                vidc_shadow_valid = 1;
+        }
+        telem_put(TELEM_FRAME, b, p - b);
+}
+
+/* When a mode change has been dealt with, from the IRQ handler or
+ * video_poll():
+ */
+void    telem_reconf(unsigned int frame, const struct telem_reconf *r)
+{
+        uint8_t b[TELEM_RECONF_BODY];
+        uint8_t *p = b;
+
+        if (!(enabled & TELEM_EN_RECONF))
+                return;
+
+        p = put_le(p, vr[VIDO_REG_TIME], 4);
+        p = put_le(p, frame, 4);
+        p = put_le(p, r->prog, 4);
+        p = put_le(p, r->live, 4);
+        p = put_le(p, r->writes, 2);
+        p = put_le(p, r->frames, 1);
+        p = put_le(p, r->source, 1);
+        p = put_le(p, r->flags, 2);
+        telem_put(TELEM_RECONF, b, p - b);
+        telem_timing(frame);
+}
+
+static void     put_escaped(uint8_t c)
+{
+        if (c == TELEM_END) {
+                uart_putch(TELEM_ESC);
+                uart_putch(TELEM_ESC_END);
+        } else if (c == TELEM_ESC) {
+                uart_putch(TELEM_ESC);
+                uart_putch(TELEM_ESC_ESC);
+        } else {
+                uart_putch(c);
+        }
+}
+
+/* Send the oldest record, from the main loop.  Returns non-zero if there
+ * was one, so more may follow.
+ */
+int     telem_drain(void)
+{
+        static uint8_t rec[TELEM_MAX_REC];
+        unsigned int len = 0;
+
+        uint32_t old_mask = irq_setmask(~0);
+        if (head != tail) {
+                len = ring[tail % TELEM_RING_SIZE];
+                /* Type, then room for the sequence number: */
+                rec[0] = ring[(tail + 1) % TELEM_RING_SIZE];
+                for (unsigned int i = 1; i < len; i++)
+                        rec[i + 1] = ring[(tail + 1 + i) % TELEM_RING_SIZE];
+                tail += 1 + len;
+        }
+        irq_setmask(old_mask);
+
+        if (!len)
+                return 0;
+
+        rec[1] = seq++;
+        len++;
+        uint16_t crc = telem_crc16(rec, len);
+        rec[len++] = crc & 0xff;
+        rec[len++] = crc >> 8;
+
+        uart_putch(TELEM_END);
+        for (unsigned int i = 0; i < len; i++)
+                put_escaped(rec[i]);
+        uart_putch(TELEM_END);
+
+        total++;
+        total_bytes += len;
+        return 1;
+}
+
+void    telem_dump_stats(void)
+{
+        mprintf("Telemetry: enabled %x, %d records (%d bytes) sent, %d dropped, "
+                "%d bytes queued (max %d of %d)\r\n",
+                enabled, total, total_bytes, total_dropped, head - tail,
+                max_used, TELEM_RING_SIZE);
+}
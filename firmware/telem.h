@@ -0,0 +1,141 @@
+/* ArcDVI telemetry:  a binary record stream on the UART
+ *
+ * The console's text dumps are far too slow to watch the video state frame
+ * by frame, so this sends compact binary records instead, interleaved with
+ * the console text.  They're queued (from the video IRQ, mostly) in a RAM
+ * ring and written out from the main loop, like the log.
+ *
+ * Each record is framed SLIP-style:  TELEM_END, then the record with any
+ * TELEM_END/TELEM_ESC bytes escaped, then TELEM_END.  Neither is ASCII, so
+ * a decoder can tell records from console text.  A record is:
+ *
+ *      type (1 byte), sequence number (1, counts records sent), body,
+ *      CRC16 (2, of the type, sequence and body; see telem_crc16())
+ *
+ * Multi-byte fields are little-endian.  The bodies:
+ *
+ * TELEM_FRAME, at every VIDC flyback end:
+ *      0       time            VIDO_REG_TIME (system clocks)
+ *      4       frame           Flyback count
+ *      8       dmac_video      V_DMAC_VIDEO, video DMAs last frame (16 bits)
+ *      10      dmac_cursor     V_DMAC_CURSOR (16 bits)
+ *      12      slack           VIDO_REG_SLACK, line buffer slack last frame
+ *      16      (TELEM_VIDC only) mask of the VIDC registers (0x00-0xfc, by
+ *              address/4) changed since the last frame record, 64 bits,
+ *              then each changed register's 24 bits of data (3 bytes) in
+ *              ascending order.  The first after enabling has them all.
+ *
+ * TELEM_RECONF, when a mode change has been dealt with:
+ *      0       time
+ *      4       frame
+ *      8       prog            Clocks from the first VIDC write to the new
+ *                              timing being programmed
+ *      12      live            ... to it being live
+ *      16      writes          VIDC timing writes coalesced (16 bits)
+ *      18      frames          Frames they spanned (8 bits)
+ *      19      source          0 table, 1 cache, 2 calculated (8 bits)
+ *      20      flags           TELEM_RECONF_* (16 bits)
+ *
+ * TELEM_TIMING, after TELEM_RECONF and on enabling:
+ *      0       time
+ *      4       frame
+ *      8       the output registers, TELEM_TIMING_REGS words (see
+ *              TELEM_TIMING_REG_LIST, VIDO_REG_* numbers)
+ *
+ * TELEM_DROP, before the next record after records were dropped (the ring
+ * was full):
+ *      0       count           Records dropped (16 bits)
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TELEM_H
+#define TELEM_H
+
+#include <stdint.h>
+
+/* Framing: */
+#define TELEM_END               0xc0
+#define TELEM_ESC               0xdb
+#define TELEM_ESC_END           0xdc
+#define TELEM_ESC_ESC           0xdd
+
+/* Record types: */
+#define TELEM_FRAME             1
+#define TELEM_RECONF            2
+#define TELEM_TIMING            3
+#define TELEM_DROP              4
+
+/* What to send (the "telem" command's argument), a bitmap: */
+#define TELEM_EN_FRAME          0x1     /* TELEM_FRAME */
+#define TELEM_EN_VIDC           0x2     /* VIDC register deltas in TELEM_FRAME */
+#define TELEM_EN_RECONF         0x4     /* TELEM_RECONF and TELEM_TIMING */
+#define TELEM_EN_ALL            0x7
+
+#define TELEM_RECONF_FS         0x01    /* Via the frame store */
+#define TELEM_RECONF_FIXED      0x02    /* Fixed, scaled output */
+#define TELEM_RECONF_LINE_LOCK  0x04
+#define TELEM_RECONF_COMMIT     0x08    /* Same timing, no resync */
+#define TELEM_RECONF_LB_FULL    0x10    /* Line too long, not displayed */
+#define TELEM_RECONF_FS_BUSY    0x20    /* Frame store refused, SDRAM too busy */
+
+#define TELEM_FRAME_BODY        16      /* Without the VIDC deltas */
+#define TELEM_RECONF_BODY       22
+#define TELEM_TIMING_REGS       16
+#define TELEM_VIDC_REGS         64
+/* Longest record, without framing:  type, seq, a frame with every VIDC
+ * register, CRC:
+ */
+#define TELEM_MAX_REC           (2 + TELEM_FRAME_BODY + 8 + 3 * TELEM_VIDC_REGS + 2)
+
+/* VIDO_REG_* in a TELEM_TIMING record, in order: */
+#define TELEM_TIMING_REG_LIST   0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 20, 30, 32, 33, 34, 35
+
+/* CRC-16/CCITT-FALSE (polynomial 0x1021, initial 0xffff), of one record: */
+static inline uint16_t telem_crc16(const uint8_t *p, unsigned int len)
+{
+        uint16_t crc = 0xffff;
+
+        while (len--) {
+                crc ^= (uint16_t)(*p++ << 8);
+                for (int i = 0; i < 8; i++)
+                        crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) :
+                                (uint16_t)(crc << 1);
+        }
+        return crc;
+}
+
+#ifndef TELEM_HOST
+struct telem_reconf {
+        uint32_t        prog, live;
+        unsigned int    writes, frames, source, flags;
+};
+
+void    telem_set(unsigned int en);
+void    telem_frame(unsigned int frame);
+void    telem_reconf(unsigned int frame, const struct telem_reconf *r);
+int     telem_drain(void);
+void    telem_dump_stats(void);
+#endif
+
+#endif
@@ -1,4 +1,10 @@
 /* Deal with picosoc's simpleuart, supply mprintf
+ *
+ * Output is buffered:  uart_putch() queues characters in a RAM ring, and
+ * the UART's interrupt moves them into its TX FIFO while there's room, so
+ * printing doesn't wait for the line unless the ring fills.  Input is
+ * taken from the RX FIFO by the same interrupt, into another ring, so
+ * uart_testgetch() is just a RAM access.
  *
  * Copyright 2017, 2021 Matt Evans
  *
@@ -29,12 +35,68 @@
 #include <stddef.h>
 #include <inttypes.h>
 
+#include "firmware.h"
 #include "libcfns.h"
 #include "uart.h"
+#include "video.h"
 
 
 #ifdef SIM
 static  int cfd;
+#else
+#define UART_TX_RING_SIZE       256     /* Bytes, powers of 2 */
+#define UART_RX_RING_SIZE       32
+
+/* Data, divider, status (see simpleuart.v): */
+static volatile uint32_t *uart_regs = (volatile uint32_t *)UART_ADDR;
+static volatile uint32_t *vr = (volatile uint32_t *)VIDO_BASE_ADDR;
+
+/* The TX ring's head is written by uart_putch(), with IRQs masked, and its
+ * tail by tx_fill(); the RX ring's head by uart_irq() and tail by
+ * uart_testgetch().  All free-running.
+ */
+static uint8_t          tx_ring[UART_TX_RING_SIZE];
+static volatile unsigned int tx_head = 0;
+static volatile unsigned int tx_tail = 0;
+static uint8_t          rx_ring[UART_RX_RING_SIZE];
+static volatile unsigned int rx_head = 0;
+static volatile unsigned int rx_tail = 0;
+static uint32_t         uart_ie = 0;
+
+static unsigned int     tx_max_used = 0;
+static unsigned int     tx_full_waits = 0;
+static unsigned int     rx_lost = 0;
+static unsigned int     rx_overruns = 0;
+/* Clocks spent printing (in mprintf) and in the IRQ, for the bytes printed: */
+static uint64_t         print_clocks = 0;
+static unsigned int     print_bytes = 0;
+static uint64_t         irq_clocks = 0;
+#endif
+
+#ifndef SIM
+static void     set_ie(uint32_t ie)
+{
+        if (ie != uart_ie) {
+                uart_ie = ie;
+                uart_regs[2] = ie;
+        }
+}
+
+/* Move what's queued into the TX FIFO, as far as it has room; with IRQs
+ * masked (or from the IRQ).  The TX IRQ stays on while anything's queued.
+ */
+static void     tx_fill(void)
+{
+        unsigned int level = (uart_regs[2] >> 16) & 0xff;
+
+        while (tx_head != tx_tail && level < UART_FIFO_SIZE) {
+                uart_regs[0] = tx_ring[tx_tail % UART_TX_RING_SIZE];
+                tx_tail++;
+                level++;
+        }
+        set_ie((uart_ie & ~UART_STAT_TX_IE) |
+               ((tx_head != tx_tail) ? UART_STAT_TX_IE : 0));
+}
 #endif
 
 void    uart_init(void)
@@ -61,6 +123,9 @@ void    uart_init(void)
                 usleep(100000);
         }
         uart_getch();
+#else
+        uart_regs[2] = UART_STAT_RX_OVERRUN;
+        set_ie(UART_STAT_RX_IE);
 #endif
 }
 
@@ -73,7 +138,31 @@ void	uart_putch(char c)
                 exit(1);
         }
 #else
-        *((volatile uint32_t*)UART_ADDR) = c;
+        while (1) {
+                uint32_t old_mask = irq_setmask(~0);
+                unsigned int used = tx_head - tx_tail;
+
+                if (used < UART_TX_RING_SIZE) {
+                        tx_ring[tx_head % UART_TX_RING_SIZE] = c;
+                        tx_head++;
+                        if (used >= tx_max_used)
+                                tx_max_used = used + 1;
+                        /* Straight out if the FIFO has room, else this
+                         * turns the TX IRQ on:
+                         */
+                        tx_fill();
+                        irq_setmask(old_mask);
+                        return;
+                }
+
+                /* The ring's full.  This might be in an IRQ handler, so
+                 * don't rely on the TX IRQ to make room, but let other
+                 * IRQs in between tries:
+                 */
+                tx_full_waits++;
+                tx_fill();
+                irq_setmask(old_mask);
+        }
 #endif
 }
 
@@ -88,11 +177,13 @@ char 	uart_getch(void)
         }
         return c;
 #else
-        uint32_t d = 0;
+        int ready;
+        char c;
+
         do {
-                d = *((volatile uint32_t*)UART_ADDR);
-        } while (d == ~0);
-	return d & 0xff;
+                c = uart_testgetch(&ready);
+        } while (!ready);
+	return c;
 #endif
 }
 
@@ -120,10 +211,76 @@ char 	uart_testgetch(int *ready)
                 exit(1);
         }
 #else
-        uint32_t d = *((volatile uint32_t*)UART_ADDR);
+        char c;
 
-        *ready = !!(d != ~0);
-	return d & 0xff;
+        if (rx_head == rx_tail) {
+                *ready = 0;
+                return 0;
+        }
+        c = rx_ring[rx_tail % UART_RX_RING_SIZE];
+        rx_tail++;
+        *ready = 1;
+	return c;
+#endif
+}
+
+/* From the IRQ handler, while RX data's waiting or the TX FIFO's emptying: */
+void    uart_irq(void)
+{
+#ifndef SIM
+        uint32_t t = vr[VIDO_REG_TIME];
+        uint32_t d;
+
+        /* Reads pop the RX FIFO, or give ~0 when it's empty: */
+        while ((d = uart_regs[0]) != ~0) {
+                if (rx_head - rx_tail < UART_RX_RING_SIZE) {
+                        rx_ring[rx_head % UART_RX_RING_SIZE] = d;
+                        rx_head++;
+                } else {
+                        rx_lost++;
+                }
+        }
+        tx_fill();
+        irq_clocks += vr[VIDO_REG_TIME] - t;
+#endif
+}
+
+/* Room in the TX ring, so that the main loop can avoid waiting on it: */
+unsigned int    uart_tx_space(void)
+{
+#ifdef SIM
+        return ~0;
+#else
+        return UART_TX_RING_SIZE - (tx_head - tx_tail);
+#endif
+}
+
+/* Wait for everything queued to be sent, from the main loop: */
+void    uart_flush(void)
+{
+#ifndef SIM
+        while (tx_head != tx_tail) {
+        }
+        while (!(uart_regs[2] & UART_STAT_TX_IDLE)) {
+        }
+#endif
+}
+
+unsigned int    uart_get_baud(void)
+{
+#ifdef SIM
+        return 9600;
+#else
+        /* A bit period is the divider + 2 clocks */
+        return CPU_CLK_RATE / (uart_regs[1] + 2);
+#endif
+}
+
+void    uart_set_baud(unsigned int baud)
+{
+#ifndef SIM
+        uart_flush();
+        uart_regs[1] = (CPU_CLK_RATE + baud / 2) / baud - 2;
 #endif
 }
 
@@ -131,12 +288,86 @@ static void u0_putch(char c, void *arg)
 {
 	/* Write to UART */
 	uart_putch(c);
+	(*(unsigned int *)arg)++;
 }
 
 void 	mprintf(const char *fmt, ...)
 {
 	va_list args;
+	unsigned int n = 0;
+#ifndef SIM
+	uint32_t t = vr[VIDO_REG_TIME];
+#endif
 	va_start(args, fmt);
-	do_printf_scan(u0_putch, NULL, fmt, args);
+	do_printf_scan(u0_putch, &n, fmt, args);
 	va_end(args);
+#ifndef SIM
+	print_clocks += vr[VIDO_REG_TIME] - t;
+	print_bytes += n;
+#endif
+}
+
+#ifndef SIM
+#define UART_BENCH_LEN  64
+
+/* Send a line of UART_BENCH_LEN bytes the old way, waiting for each
+ * character to go before writing the next (as the UART used to make the
+ * CPU do), and then through the ring; returns the CPU clocks per byte each
+ * took.  The second is queueing the line with IRQs masked (so that the
+ * UART IRQ can't run in the middle of it), plus the IRQ's work to send it
+ * afterwards, measured separately so that neither is counted twice.
+ */
+static void     uart_bench(unsigned int *polled, unsigned int *buffered)
+{
+        static const char line[UART_BENCH_LEN + 1] =
+                "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ\r\n";
+        uint32_t t, old_mask;
+        uint64_t irq0;
+
+        uart_flush();
+        t = vr[VIDO_REG_TIME];
+        for (int i = 0; i < UART_BENCH_LEN; i++) {
+                while (!(uart_regs[2] & UART_STAT_TX_IDLE)) {
+                }
+                uart_regs[0] = line[i];
+        }
+        *polled = (vr[VIDO_REG_TIME] - t) / UART_BENCH_LEN;
+
+        /* The ring's empty, so this doesn't wait for room: */
+        uart_flush();
+        old_mask = irq_setmask(~0);
+        t = vr[VIDO_REG_TIME];
+        mprintf("%s", line);
+        t = vr[VIDO_REG_TIME] - t;
+        irq0 = irq_clocks;
+        irq_setmask(old_mask);
+        uart_flush();
+        *buffered = (t + (unsigned int)(irq_clocks - irq0)) / UART_BENCH_LEN;
+}
+#endif
+
+void    uart_dump_stats(void)
+{
+#ifdef SIM
+        mprintf("UART: host pty\r\n");
+#else
+        unsigned int polled, buffered;
+        uint32_t stat = uart_regs[2];
+
+        uart_bench(&polled, &buffered);
+        if (stat & UART_STAT_RX_OVERRUN) {
+                rx_overruns++;
+                uart_regs[2] = uart_ie | UART_STAT_RX_OVERRUN;
+        }
+        mprintf("UART: %d baud, TX ring max %d of %d (waited full %d), "
+                "RX %d lost, %d overruns\r\n",
+                uart_get_baud(), tx_max_used, UART_TX_RING_SIZE, tx_full_waits,
+                rx_lost, rx_overruns);
+        mprintf("Printed %d bytes, %d clocks/byte (+%d in IRQ); "
+                "%d-byte line %d clocks/byte polled, %d buffered\r\n",
+                print_bytes,
+                print_bytes ? (unsigned int)(print_clocks / print_bytes) : 0,
+                print_bytes ? (unsigned int)(irq_clocks / print_bytes) : 0,
+                UART_BENCH_LEN, polled, buffered);
+#endif
 }
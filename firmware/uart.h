@@ -33,6 +33,12 @@ void    uart_init(void);
 void	uart_putch(char c);
 char 	uart_getch(void);
 char 	uart_testgetch(int *ready);
+void    uart_irq(void);
+unsigned int uart_tx_space(void);
+void    uart_flush(void);
+unsigned int uart_get_baud(void);
+void    uart_set_baud(unsigned int baud);
+void    uart_dump_stats(void);
 void 	mprintf(const char *fmt, ...);
 
 #endif
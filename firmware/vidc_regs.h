@@ -25,6 +25,8 @@
 #ifndef VIDC_REGS_H
 #define VIDC_REGS_H
 
+#include <stdint.h>
+
 #define VIDC_PAL_0              0
 #define VIDC_BORDERCOL          0x40
 #define VIDC_CURSORPAL1         0x44
@@ -23,20 +23,72 @@
  * SOFTWARE.
  */
 
+#include "firmware.h"
 #include "uart.h"
 #include "vidc_regs.h"
 #include "video.h"
+#include "video_calc.h"
+#include "video_modes.h"
+#include "log.h"
+#include "telem.h"
 #include "hw.h"
 
 
 static volatile uint32_t *vr = (volatile uint32_t *)VIDO_BASE_ADDR;
 
+/* Output via the SDRAM frame store, retimed to VIDO_FS_RATE: */
+static uint8_t  flag_frame_store = 0;
+
+/* Scale live output into a fixed timing (VIDEO_FIXED_*) where it fits, so
+ * that mode changes don't make the monitor relock:
+ */
+static uint8_t  flag_fixed = 0;
+
+/* Pixel clocks the hardware has (VIDO_REG_PCLK), read at init: */
+static unsigned int pclk_avail = 1;
+
+/* Line buffer size and pixel formats the hardware has (VIDO_REG_CAPS): */
+static uint32_t video_caps = 0;
+
+/* Show 8BPP modes as high colour (VIDO_REG_CTRL pixel format 4 or 5), or 0: */
+static unsigned int hicolour_bpp = 0;
+
+/* Monitor limits for calculated modes; the X scale factors are set from
+ * VIDO_REG_CAPS at init, and the maximum scale by video_set_scale():
+ */
+static struct video_limits limits;
+
+/* Lock live output lines to VIDC's hsync (VIDO_PHASE_LINE_LOCK):  never, when
+ * the line period doesn't match exactly, or always:
+ */
+enum line_lock_mode {
+        LL_OFF,
+        LL_AUTO,
+        LL_ALWAYS,
+};
+
+static enum line_lock_mode line_lock_mode = LL_AUTO;
+static const char *line_lock_names[] = { "off", "auto", "always" };
+
+/* SDRAM bandwidth the frame store can use, KB/s:  a 16-byte burst takes
+ * about 18 cycles (see sdram_ctrl.v), and keep some in hand as the write
+ * queue is short.
+ */
+#define FS_SDRAM_KBS    ((CPU_CLK_RATE / 18) * 16 / 1024 * 7 / 8)
+
+static const unsigned int bpp_bits[8] = { 1, 2, 4, 8, 16, 24, 0, 0 };
+
 
 void    video_sync(void)
 {
+        /* The IRQ handler also writes this register (to ack timing
+         * register changes), so don't let it in between read and write:
+         */
+        uint32_t old_mask = irq_setmask(~0);
         uint32_t s = vr[VIDO_REG_SYNC];
-        mprintf("Sync reg: %02x\r\nRequesting sync...", s);
         vr[VIDO_REG_SYNC] = s ^ 1;
+        irq_setmask(old_mask);
+        mprintf("Sync reg: %02x\r\nRequesting sync...", s);
         int t = 10000000;
         do {
                 s = vr[VIDO_REG_SYNC];
@@ -48,6 +100,54 @@ void    video_sync(void)
         mprintf("Timeout :(  (reg %02x)\r\n", s);
 }
 
+/* A commit applies the shadow registers at the end of the current output
+ * frame, without a resync; only for changes that keep the frame timing.
+ */
+static int      video_commit_pending(uint32_t s)
+{
+        return ((s >> 5) & 1) != ((s >> 6) & 1);
+}
+
+void    video_commit(void)
+{
+        int t = 1000000;
+        uint32_t s;
+
+        do {
+                /* As for video_sync(), keep the IRQ handler out: */
+                uint32_t old_mask = irq_setmask(~0);
+                s = vr[VIDO_REG_SYNC];
+                if (!video_commit_pending(s)) {
+                        vr[VIDO_REG_SYNC] = s ^ 0x20;
+                        irq_setmask(old_mask);
+                        return;
+                }
+                irq_setmask(old_mask);
+        } while (--t > 0);
+        mprintf("Commit timeout :(  (reg %02x)\r\n", s);
+}
+
+static unsigned int video_lb_words(void)
+{
+        return 1 << VIDO_CAPS_LB_BITS(video_caps);
+}
+
+/* Can the hardware display this pixel format and line length?  Says why not. */
+static int      video_check_format(unsigned int bpp, unsigned int words)
+{
+        if ((bpp == 4 && !(video_caps & VIDO_CAPS_16BPP)) ||
+            (bpp == 5 && !(video_caps & VIDO_CAPS_24BPP))) {
+                mprintf("*** No %dbpp support in this build ***\r\n", bpp_bits[bpp]);
+                return 0;
+        }
+        if (words > video_lb_words()) {
+                mprintf("*** Line of %d words won't fit the line buffer (%d) ***\r\n",
+                        words, video_lb_words());
+                return 0;
+        }
+        return 1;
+}
+
 /* These modes are largely incorrect, but were useful for playing around with variants.
  */
 void    video_setmode(int mode)
@@ -58,14 +158,15 @@ void    video_setmode(int mode)
         unsigned int cx;
         unsigned int bpp;
         unsigned int hires = 0;
-        unsigned int dx = 0, dy = 0;
+        unsigned int dx = 1, dy = 1;
+        unsigned int pclk = 0;
 
         switch (mode) {
         case 23: { // Equivalent to mode 23 (see comments in RTL, 78MHz pclk => 1274 total width
                 xres = 1152;    xfp = 40;       xwidth = 20;    xbp = 1274-xres-xfp-xwidth;
                 yres = 896;     yfp = 4;        ywidth = 3;     ybp = 950-yres-yfp-ywidth;
                 wpl = 36-1;     cx = 0x12c;     hires = 1;
-                bpp = 0;
+                bpp = 0;        pclk = 2;
         } break;
 
         case 25:
@@ -109,7 +210,7 @@ void    video_setmode(int mode)
                 yres = 512;     yfp = 40;       ywidth = 5;     ybp = 624-yres-yfp-ywidth;
                 wpl = (640/(32>>bpp))-1;
                 cx = (0x6d*2)+5-6;
-                dy = 1;
+                dy = 2;
         } break;
 
         case 4:
@@ -131,8 +232,8 @@ void    video_setmode(int mode)
                 yres = 512;     yfp = 40;       ywidth = 5;     ybp = 624-yres-yfp-ywidth;
                 wpl = (320/(32>>bpp))-1;
                 cx = 0x68; // shrug
-                dx = 1;
-                dy = 1;
+                dx = 2;
+                dy = 2;
         } break;
 
         default:
@@ -140,235 +241,770 @@ void    video_setmode(int mode)
                 return;
         }
 
+        if (!video_check_format(bpp, wpl + 1))
+                return;
+
         // Set mode, and sync:
 
-        vr[VIDO_REG_RES_X] = xres | (dx ? 0x80000000 : 0);
+        vr[VIDO_REG_RES_X] = xres | VIDEO_RES_SCALE(dx);
         vr[VIDO_REG_HS_FP] = xfp;
         vr[VIDO_REG_HS_WIDTH] = xwidth;
         vr[VIDO_REG_HS_BP] = xbp;
-        vr[VIDO_REG_RES_Y] = yres | (dy ? 0x80000000 : 0);
+        vr[VIDO_REG_RES_Y] = yres | VIDEO_RES_SCALE(dy);
         vr[VIDO_REG_VS_FP] = yfp;
         vr[VIDO_REG_VS_WIDTH] = ywidth;
         vr[VIDO_REG_VS_BP] = ybp;
         vr[VIDO_REG_WPLM1] = wpl;
         vr[VIDO_REG_CTRL] = cx | (hires ? 0x80000000 : 0) | (bpp << 28);
+        vr[VIDO_REG_PCLK] = pclk;
+        // Not necessarily VIDC's mode, so replay palette writes per line:
+        vr[VIDO_REG_RASTER] = 0;
 
         video_sync();
 }
 
-void    video_wait_flybk(void)
+/* The report for a calculated mode (logged, see log.h): */
+static void     video_report_mode(const struct video_mode *m, int line_lock)
+{
+        unsigned int new_total_width = m->xres + m->xfp + m->xsw + m->xbp;
+
+        log_msg("New mode %dx%d, %dbpp:\r\n",
+                m->in_xres, m->in_yres, 1 << m->in_bpp);
+        log_msg("\thfp %d, hsw %d, hbp %d (%d total)\r\n",
+                m->in_xfp, m->in_xsw, m->in_xbp, m->hcr);
+        log_msg("\tvfp %d, vsw %d, vbp %d (%d total, frame %dHz pclk %dMHz)\r\n",
+                m->in_yfp, m->in_ysw, m->in_ybp, m->vcr,
+                m->pix_rate*1000000 / (m->hcr * m->vcr), m->pix_rate);
+        log_msg("Output pclk %dMHz\r\n", video_pclk_mhz[m->pclk]);
+
+        switch (m->note) {
+        case VM_HIRES_INEXACT:
+                log_msg("Guessed hires mono mode.\r\n");
+                if (line_lock)
+                        log_msg("HR horizontal period inexact, line-locked "
+                                "(orig width %d, new width %d)\r\n",
+                                m->hcr, new_total_width);
+                else
+                        log_msg("*** Cannot match HR horizontal period! "
+                                "(orig width %d, new width %d) ***\r\n",
+                                m->hcr, new_total_width);
+                break;
+        case VM_HIRES:
+                log_msg("Guessed hires mono mode.\r\n");
+                break;
+        case VM_HIRES_NO_PCLK:
+                log_msg("*** Guessed hires mono mode, but no pixel clock "
+                        "is fast enough! ***\r\n");
+                break;
+        case VM_NO_PCLK:
+                log_msg("*** No pixel clock matches this mode's line period! ***\r\n");
+                break;
+        case VM_NO_DOUBLE:
+                log_msg("*** Can't line-double this mode! "
+                        "(%d MHz, no pixel clock gives width >= %d) ***\r\n",
+                        m->pix_rate, m->in_xres + m->in_xres/32);
+                break;
+        case VM_NO_DOUBLE_XY:
+                log_msg("*** Can't pixel/line-double this mode! ***\r\n");
+                break;
+        case VM_SCALED:
+                log_msg("Scaled %dx%d: new width %d, fp %d, xsw %d, bp %d\r\n",
+                        m->dx, m->dy, new_total_width, m->xfp, m->xsw, m->xbp);
+                break;
+        default:
+                break;
+        }
+        if (m->err_ppm && !m->hires)
+                log_msg("Line period inexact by %d ppm%s\r\n", m->err_ppm,
+                        line_lock ? ", line-locked" : "");
+        if (m->hc_width)
+                log_msg("Shown as %dbpp high colour, %d pixels%s\r\n",
+                        bpp_bits[m->bpp], m->hc_width, m->dx > 1 ? " X-scaled" : "");
+}
+
+/* Is r's frame timing the same as that currently programmed?  If so, the
+ * change is just BPP/doubling/etc. and can be committed without a resync.
+ */
+static int      video_same_timing(const struct video_regs *r, unsigned int fs)
+{
+        return (vr[VIDO_REG_PCLK] & 3) == r->pclk &&
+                (vr[VIDO_REG_RES_X] & 0x7ff) == (r->res_x & 0x7ff) &&
+                vr[VIDO_REG_HS_FP] == r->hs_fp &&
+                vr[VIDO_REG_HS_WIDTH] == r->hs_width &&
+                vr[VIDO_REG_HS_BP] == r->hs_bp &&
+                (vr[VIDO_REG_RES_Y] & 0x7ff) == (r->res_y & 0x7ff) &&
+                vr[VIDO_REG_VS_FP] == r->vs_fp &&
+                vr[VIDO_REG_VS_WIDTH] == r->vs_width &&
+                vr[VIDO_REG_VS_BP] == r->vs_bp &&
+                (vr[VIDO_REG_SCALER] & VIDO_SCALER_ENABLE) ==
+                (r->scaler & VIDO_SCALER_ENABLE) &&
+                (vr[VIDO_REG_FS_CTRL] & 1) == fs;
+}
+
+/* The output phase (its lag behind VIDC, in output pixels) that's always
+ * safe:  a whole output line, or n when scaling by n, so that the DMA has
+ * written a line before it's displayed.  With the scaler, it's VIDC's line
+ * less an output line, the most that the last output line of an input line
+ * can lag without the DMA overwriting it.  Phase calibration (below) then
+ * brings it down.
+ */
+static unsigned int video_safe_phase(const struct video_regs *r)
+{
+        unsigned int htotal = (r->res_x & 0x7ff) + r->hs_fp + r->hs_width + r->hs_bp;
+
+        if (r->scaler & VIDO_SCALER_ENABLE)
+                return (htotal << VIDO_SCALER_STEP_BITS) / (r->scaler_step >> 16) -
+                        htotal;
+        return htotal * VIDEO_RES_GET_SCALE(r->res_y);
+}
+
+/* Write the output timing (and whether it's via the frame store, in which
+ * case r should already be retimed, or line-locked, and the scaler), and
+ * either commit it (if
+ * the frame timing is unchanged) or request a resync to VIDC's next flyback.
+ * Doesn't wait; completion is signalled by the IRQ returned.
+ */
+static uint32_t video_program_mode(const struct video_regs *r, unsigned int fs,
+                                   int line_lock)
 {
-        /* This waits for a 1-to-0 transition of flyback.
-         * Depending on CPU speed/interrupts/whatever, this might
-         * wait longer than a frame!
+        int same = video_same_timing(r, fs);
+
+        vr[VIDO_REG_RES_X] = r->res_x;
+        vr[VIDO_REG_HS_FP] = r->hs_fp;
+        vr[VIDO_REG_HS_WIDTH] = r->hs_width;
+        vr[VIDO_REG_HS_BP] = r->hs_bp;
+        vr[VIDO_REG_RES_Y] = r->res_y;
+        vr[VIDO_REG_VS_FP] = r->vs_fp;
+        vr[VIDO_REG_VS_WIDTH] = r->vs_width;
+        vr[VIDO_REG_VS_BP] = r->vs_bp;
+        vr[VIDO_REG_WPLM1] = r->wplm1;
+        vr[VIDO_REG_CTRL] = r->ctrl;
+        vr[VIDO_REG_FS_CTRL] = fs;
+        vr[VIDO_REG_PCLK] = r->pclk;
+        vr[VIDO_REG_SCALER] = r->scaler;
+        vr[VIDO_REG_SCALER_STEP] = r->scaler_step;
+        vr[VIDO_REG_SCALER_X] = r->scaler_x;
+        vr[VIDO_REG_SCALER_Y] = r->scaler_y;
+        vr[VIDO_REG_FRAME_LOCK] = r->frame_lock;
+        vr[VIDO_REG_PHASE] = video_safe_phase(r) |
+                (line_lock ? VIDO_PHASE_LINE_LOCK : 0);
+
+        /* If a sync is already outstanding, it'll pick up the new timing
+         * anyway (and toggling the request again would cancel it).  A
+         * commit can't be retargeted whilst outstanding, so resync then.
          */
-        uint32_t s;
+        uint32_t s = vr[VIDO_REG_SYNC];
+        if ((s & 1) != ((s >> 1) & 1))
+                return VIDO_IRQ_SYNC_ACK;
+        if (same && !video_commit_pending(s)) {
+                vr[VIDO_REG_SYNC] = s ^ 0x20;
+                return VIDO_IRQ_COMMIT_ACK;
+        }
+        vr[VIDO_REG_SYNC] = s ^ 1;
+        return VIDO_IRQ_SYNC_ACK;
+}
 
-        // Wait for a 1 (might exit immediately):
-        do {
-                s = vr[VIDO_REG_SYNC];
-        } while (!(s & 0x10));
 
-        // Wait for a 0:
-        do {
-                s = vr[VIDO_REG_SYNC];
-        } while (s & 0x10);
-}
-
-static int      video_guess_hires(unsigned int x, unsigned int y, unsigned int bpp,
-                                  unsigned int pclk)
-{
-        // Try to guess if this is a hires mode, by very tall high-clock 4BPP modes:
-        return (pclk == 24) && (bpp == 2) && (x < (y/2));
-}
-
-void    video_probe_mode(void)
-{
-        static const unsigned int pix_rates[] = { 8, 12, 16, 24 };
-
-        video_wait_flybk();
-
-        // fp is dispend to frame (sync start)
-        // bo is dispstart-syncwidth
-        unsigned int cr = vidc_reg(VIDC_CONTROL);
-        unsigned int bpp = (cr >> 2) & 3;
-        unsigned int pix_rate = pix_rates[(cr & 3)];
-        unsigned int hcr = ((vidc_reg(VIDC_H_CYC) >> 14)*2)+2;
-        unsigned int hsw = ((vidc_reg(VIDC_H_SYNC) >> 14)*2)+2;
-        unsigned int hdsr = ((vidc_reg(VIDC_H_DISP_START) >> 14)*2) +
-                vidc_bpp_to_hdsr_offset(bpp);
-        unsigned int hder = ((vidc_reg(VIDC_H_DISP_END) >> 14)*2) +
-                vidc_bpp_to_hdsr_offset(bpp);
-        unsigned int vcr = (vidc_reg(VIDC_V_CYC) >> 14)+1;
-        unsigned int vsw = (vidc_reg(VIDC_V_SYNC) >> 14)+1;
-        unsigned int vdsr = (vidc_reg(VIDC_V_DISP_START) >> 14)+1;
-        unsigned int vder = (vidc_reg(VIDC_V_DISP_END) >> 14)+1;
-
-        unsigned int xres = hder - hdsr;
-        unsigned int yres = vder - vdsr;
-        unsigned int xfp = hcr - hder;
-        unsigned int xsw = hsw;
-        unsigned int xbp = hdsr - hsw;
-        unsigned int yfp = vcr - vder;
-        unsigned int ysw = vsw;
-        unsigned int ybp = vdsr - vsw;
-        unsigned int wpl = (xres/(32>>bpp))-1;
-        unsigned int cx = hdsr - 6;
-        unsigned int hires = 0;
-        unsigned int dx = 0, dy = 0;
-
-        mprintf("New mode %dx%d, %dbpp:\r\n"
-                "\thfp %d, hsw %d, hbp %d (%d total)\r\n"
-                "\tvfp %d, vsw %d, vbp %d (%d total, frame %dHz pclk %dMHz)\r\n",
-                xres, yres, 1 << bpp,
-                xfp, xsw, xbp, xres + xfp + xsw + xbp,
-                yfp, ysw, ybp, yres + yfp + ysw + ybp,
-                pix_rate*1000000 / (hcr * vcr), pix_rate);
-
-        // Now, some dumb heuristics to try to program a matching output mode:
-        // 1. Is it a highres mode?
-        // 2. Is it a regular VGA/mode21-like mode?
-        // 3. Otherwise, something needs doubling.
-
-        if (video_guess_hires(xres, yres, bpp, pix_rate)) {
-                /* Not totally infallible, but definitely works for mode 23 ;-)
-                 * Hopefully this will work for x900 variants.
-                 */
-                mprintf("Guessed hires mono mode.\r\n");
+/******************************************************************************/
+/* Mode lookup:
+ *
+ * The output configuration depends only on the VIDC timing registers, so it's
+ * looked up by their signature.  The standard RISC OS modes are precomputed
+ * at build time (video_modes.h, sorted by signature); other modes are
+ * calculated on first use and kept in a small LRU cache.
+ */
 
-                xres *= 4;
-                // Recalculate horizontal timing to match same period for 78MHz vs 96MHz:
-                unsigned int total_width78 = hcr*4*78/96;
+enum mode_source {
+        MODE_TABLE,
+        MODE_CACHE,
+        MODE_CALC,
+};
 
-                // Check if that was an integer...
-                if (total_width78*96/78/4 != hcr) {
-                        mprintf("*** Cannot match HR horizontal period! "
-                                "(orig width %d, new width %d) ***\r\n",
-                                hcr, total_width78);
-                        // Oh well.  Carry on and see what it looks like.  ;)
+static const char *mode_source_names[] = { "table", "cache", "calculated" };
+
+#define MODE_CACHE_SIZE 8
+
+static struct video_mode_entry  mode_cache[MODE_CACHE_SIZE];
+static uint32_t                 mode_cache_used[MODE_CACHE_SIZE]; // 0 = empty
+static uint32_t                 mode_cache_clock = 0;
+static unsigned int             mode_lookups[3];
+
+static void     video_read_timing(struct vidc_timing *t)
+{
+        t->hcr = vidc_reg(VIDC_H_CYC);
+        t->hswr = vidc_reg(VIDC_H_SYNC);
+        t->hdsr = vidc_reg(VIDC_H_DISP_START);
+        t->hder = vidc_reg(VIDC_H_DISP_END);
+        t->vcr = vidc_reg(VIDC_V_CYC);
+        t->vswr = vidc_reg(VIDC_V_SYNC);
+        t->vdsr = vidc_reg(VIDC_V_DISP_START);
+        t->vder = vidc_reg(VIDC_V_DISP_END);
+        t->control = vidc_reg(VIDC_CONTROL);
+}
+
+/* Find the output registers for VIDC timing t.  If they had to be
+ * calculated, m is filled in for the report.
+ */
+static const struct video_regs *video_lookup_mode(struct video_mode *m,
+                                                  const struct vidc_timing *t,
+                                                  enum mode_source *src)
+{
+        struct vidc_sig sig;
+        const struct video_mode_entry *e;
+        unsigned int victim = 0;
+
+        video_calc_sig(t, &sig);
+        sig.w[2] |= VIDEO_SIG_HICOLOUR(hicolour_bpp) |
+                VIDEO_SIG_SCALE(limits.max_scale);
+
+        /* The table assumes all pixel clocks are available (and no high
+         * colour or scaling, so never matches a signature with them):
+         */
+        e = video_mode_search(video_mode_table, VIDEO_MODE_TABLE_SIZE, &sig);
+        if (e && (pclk_avail & (1 << e->regs.pclk))) {
+                *src = MODE_TABLE;
+                mode_lookups[MODE_TABLE]++;
+                return &e->regs;
+        }
+
+        for (unsigned int i = 0; i < MODE_CACHE_SIZE; i++) {
+                if (mode_cache_used[i] &&
+                    video_sig_cmp(&mode_cache[i].sig, &sig) == 0) {
+                        mode_cache_used[i] = ++mode_cache_clock;
+                        *src = MODE_CACHE;
+                        mode_lookups[MODE_CACHE]++;
+                        return &mode_cache[i].regs;
                 }
-                xfp = total_width78 / 20;
-                xsw = total_width78 / 40;
-                xbp = total_width78-xres-xfp-xsw;
-                // vertical timing stays the same.
-                hires = 1;
-                bpp = 0;
-                wpl = (xres/32)-1;
-
-                cx = 0x12c; // FIXME: derive this from ... something! ;(
-
-        } else if (xres >= 640 && yres >= 480) {
-                // Defaults above are good!
-
-        } else if (xres >= 640 && yres < 480) {
-                /* We'll want some Y doublin'.  Slightly more complicated now,
-                 * because we need to recalculate the horiz timing to fit a 24MHz pclk
-                 * instead of the input one.  Specifically, we output the line twice
-                 * but need to keep the same vertical timing, which means we need to output
-                 * it twice as fast horizontally.  This is done by always using a 24MHz
-                 * output clock and changing the blanking time.
-                 *
-                 * Note, not all modes will succeed here:
-                 * - Maybe the mode is already using a 24MHz pclk (e.g. mode 37),
-                 *   meaning we can't output the input line at 2x the rate
-                 * - Or, the mode is <24 (e.g. 16MHz) but so wide that we can't output
-                 *   enough pixels at 24MHz to keep within the line period.
-                 *
-                 * The fallback is outputting the mode non-doubled, which will likely
-                 * not work (monitors/TVs seem to like 400-ish lines at a minimum).
-                 *
-                 * Longer-term FIXME by changing to a higher output pclk (e.g. 48MHz).
-                 */
+                if (mode_cache_used[i] < mode_cache_used[victim])
+                        victim = i;
+        }
 
-                /* We need exactly 1/2 of the original line period, but with a
-                 * 24MHz clock:
-                 */
-                unsigned int new_total_width = hcr*24/pix_rate/2;
+        video_calc_mode(t, m, pclk_avail, &limits);
+        if (hicolour_bpp)
+                video_calc_hicolour(m, hicolour_bpp);
+        mode_cache[victim].sig = sig;
+        video_calc_regs(m, &mode_cache[victim].regs);
+        mode_cache_used[victim] = ++mode_cache_clock;
+        *src = MODE_CALC;
+        mode_lookups[MODE_CALC]++;
+        return &mode_cache[victim].regs;
+}
 
-                /* Being too skimpy on H-blank time upsets many monitors, so
-                 * refuse to go into such a mode:
-                 */
-                unsigned int minimum_h_blanking = xres / 32; // Art not science
-
-                if (pix_rate == 24 || (new_total_width < (xres + minimum_h_blanking))) {
-                        mprintf("*** Can't line-double this mode! "
-                                "(%d MHz, width %d (min %d) ***\r\n",
-                                pix_rate, new_total_width, xres + minimum_h_blanking);
-                        /* Fall through, and set this mode verbatim, maybe
-                         * the display can cope with it directly.
-                         */
-                } else {
+void    video_dump_modes(void)
+{
+        mprintf("Mode lookups: %d table (%d entries), %d cache, %d calculated\r\n",
+                mode_lookups[MODE_TABLE], VIDEO_MODE_TABLE_SIZE,
+                mode_lookups[MODE_CACHE], mode_lookups[MODE_CALC]);
+        for (unsigned int i = 0; i < MODE_CACHE_SIZE; i++) {
+                if (!mode_cache_used[i])
+                        continue;
+                mprintf(" %d: sig %08x %08x %08x -> %dx%d, used %d\r\n", i,
+                        mode_cache[i].sig.w[0], mode_cache[i].sig.w[1],
+                        mode_cache[i].sig.w[2],
+                        mode_cache[i].regs.res_x & 0x7ff,
+                        mode_cache[i].regs.res_y & 0x7ff,
+                        mode_cache_used[i]);
+        }
+}
+
+
+/******************************************************************************/
+/* Interrupt-driven reconfiguration:
+ *
+ * The hardware collects VIDC timing register writes into a batch, and raises
+ * the timing regs IRQ once there have been no further writes for a number of
+ * frames (see video_set_settle()).  So, a mode change written over several
+ * frames still means one probe and one resync.  The handler acks it (so that
+ * any further change is seen) and latches VIDC's timing.  The main loop
+ * then looks up (or calculates) and programs the new output timing, in
+ * video_poll():  the solver can take a while, which with IRQs masked would
+ * hold up the UART.  If VIDC changes again meanwhile, that result is
+ * dropped and it starts over.  The sync ack IRQ then marks the new timing
+ * as live in the output; or, if only the pixel format changed (e.g. mode 12
+ * to 15), the new timing is committed without a resync and the commit ack
+ * IRQ marks it live.
+ * Reports are queued with log_msg() (see log.h) and written out from the
+ * main loop, so that a slow UART (or a lot to say) doesn't hold up this or
+ * the next reconfiguration.
+ *
+ * With a settle time of 0, the IRQ comes on the first write, so instead wait
+ * for the next flyback end (giving the other writes a chance to happen).
+ *
+ * Both steps are timestamped against the time of the first VIDC write,
+ * latched in hardware, giving the latency reported by video_dump_latency().
+ */
+
+uint8_t flag_autoprobe_mode = 1;
+
+enum reconf_state {
+        RECONF_IDLE,
+        RECONF_WAIT_FLYBK,
+        RECONF_PROGRAM,         /* reconf_timing latched for video_poll() */
+        RECONF_CALC,            /* video_poll() working on it */
+        RECONF_WAIT_SYNC,
+};
+
+/* video_probe_mode()'s limit, in clocks:  a flyback, the settle frames and
+ * the sync, with lots of margin.
+ */
+#define VIDEO_PROBE_TIMEOUT     CPU_CLK_RATE
+
+static volatile enum reconf_state reconf_state = RECONF_IDLE;
+static struct vidc_timing       reconf_timing;
+static struct video_mode        reconf_mode;
+static const struct video_regs  *reconf_regs;
+static const struct video_regs  *reconf_live;   /* Before retiming */
+static struct video_regs        reconf_fs_regs;
+static int                      reconf_fs;
+static struct video_regs        reconf_fixed_regs;
+static int                      reconf_fixed;
+static int                      reconf_line_lock;
+static enum mode_source         reconf_src;
+static struct video_load        reconf_load;
+static int                      reconf_fs_busy; /* Frame store refused, SDRAM too busy */
+static int                      reconf_lb_full; /* Not programmed, line too long */
+static uint32_t                 reconf_ack_irq;
+static volatile int             reconf_committed;
+static uint32_t                 reconf_t_write;
+
+static volatile unsigned int    flybk_count = 0;
+
+/* Output phase calibration:
+ *
+ * After a mode change, the output starts at the safe phase (a whole line
+ * behind VIDC).  The DMA is usually well ahead of that, so the phase is
+ * reduced until the least line buffer slack (VIDO_REG_SLACK, the DMA's lead
+ * over the scan-out) seen over a few frames is PHASE_MARGIN words:  the
+ * reduction in pixels is the spare slack times the pixels per word.  As
+ * DMA isn't exactly regular, this is repeated a few times.  A phase change
+ * is committed, and realigns the output at the next flyback without a
+ * resync.  If a line ever underruns, it goes back to the safe phase.
+ */
+#define PHASE_MARGIN            8       /* Words; DMA comes in 4-word bursts */
+#define PHASE_SETTLE_FRAMES     3       /* Commit, realign, then a whole frame */
+#define PHASE_MEASURE_FRAMES    4
+#define PHASE_MAX_STEPS         4
+
+enum phase_state {
+        PHASE_IDLE,
+        PHASE_SETTLE,
+        PHASE_MEASURE,
+};
+
+static struct {
+        enum phase_state state;
+        unsigned int    frames;
+        unsigned int    steps;
+        unsigned int    safe;           /* Pixels */
+        unsigned int    phase;
+        unsigned int    px_per_word;
+        int             min_slack;
+        int             last_slack;     /* At the final phase */
+        int             backed_off;
+} cal;
+
+static struct {
+        unsigned int    count;
+        unsigned int    commits;        /* Of 'count', without a resync */
+        uint32_t        last_prog;
+        uint32_t        last_live;
+        uint32_t        max_prog;
+        uint32_t        max_live;
+        unsigned int    writes;         /* Total coalesced into 'count' */
+        unsigned int    frames;
+        unsigned int    timeouts;       /* Probes that gave up */
+} latency;
+
+void    video_init(void)
+{
+        pclk_avail = (vr[VIDO_REG_PCLK] >> 8) & VIDEO_PCLK_ALL;
+        video_caps = vr[VIDO_REG_CAPS];
+        limits = video_default_limits;
+        /* Pairs of pixels can't be split 3 ways: */
+        if (VIDO_CAPS_PPC(video_caps) == 2)
+                limits.x_scales &= ~(1 << 2);
+
+        /* Discard any events from before we were ready, and go: */
+        vr[VIDO_REG_IRQ_STATUS] = VIDO_IRQ_ALL;
+        vr[VIDO_REG_IRQ_MASK] = VIDO_IRQ_TREGS | VIDO_IRQ_FLYBK_END |
+                VIDO_IRQ_SYNC_ACK | VIDO_IRQ_COMMIT_ACK;
+}
 
-                        yres *= 2;
-                        yfp *= 2;
-                        ysw *= 2;
-                        ybp *= 2;
+static void     video_cal_start(const struct video_regs *r)
+{
+        unsigned int bits = bpp_bits[(r->ctrl >> 28) & 7];
+
+        cal.safe = cal.phase = video_safe_phase(r);
+        if (r->scaler & VIDO_SCALER_ENABLE) {
+                unsigned int ppc = VIDO_CAPS_PPC(video_caps);
+
+                /* The X step is per pair with 2 pixels per clock: */
+                cal.px_per_word = ((32 << VIDO_SCALER_STEP_BITS) * (ppc ? ppc : 1) /
+                                   (bits ? bits : 1)) / ((r->scaler_step & 0xffff) | 1);
+        } else {
+                cal.px_per_word = (32 * VIDEO_RES_GET_SCALE(r->res_x)) /
+                        (bits ? bits : 1);
+        }
+        cal.steps = 0;
+        cal.backed_off = 0;
+        cal.frames = PHASE_SETTLE_FRAMES;
+        cal.state = PHASE_SETTLE;
+}
 
-                        // Synthesise new sync parameters using roughly a 2:1:4 ratio:
-                        xfp = new_total_width / 20;
-                        xsw = new_total_width / 40;
-                        xbp = new_total_width-xres-xfp-xsw;
+/* Apply a new phase, via a commit (retried next frame if one's pending): */
+static int      video_cal_set(unsigned int phase)
+{
+        uint32_t s = vr[VIDO_REG_SYNC];
 
-                        mprintf("Y-doubled: new width %d, fp %d, xsw %d, bp %d\r\n",
-                                new_total_width, xfp, xsw, xbp);
-                        dy = 1;
+        if (video_commit_pending(s))
+                return 0;
+        vr[VIDO_REG_PHASE] = phase | (vr[VIDO_REG_PHASE] & VIDO_PHASE_LINE_LOCK);
+        vr[VIDO_REG_SYNC] = s ^ 0x20;
+        cal.phase = phase;
+        cal.frames = PHASE_SETTLE_FRAMES;
+        cal.state = PHASE_SETTLE;
+        return 1;
+}
+
+/* Once per frame (flyback end), from the IRQ handler: */
+static void     video_cal_frame(void)
+{
+        if (cal.state == PHASE_SETTLE) {
+                if (--cal.frames == 0) {
+                        cal.min_slack = 0x7fffffff;
+                        cal.frames = PHASE_MEASURE_FRAMES;
+                        cal.state = PHASE_MEASURE;
                 }
-        } else if (xres < 640 && yres < 480) {
-                /* We'll want both X and Y doublin'.  This'll generally work unless
-                 * the mode is a weird custom almost-VGA mode, at 24MHz:
-                 */
-                unsigned int new_total_width = hcr*24/pix_rate/2;
+                return;
+        }
+        if (cal.state != PHASE_MEASURE)
+                return;
+
+        int slack = (int16_t)(vr[VIDO_REG_SLACK] & 0xffff);
+        if (slack < cal.min_slack)
+                cal.min_slack = slack;
+        if (--cal.frames != 0)
+                return;
 
-                if (pix_rate == 24) {
-                        mprintf("*** Can't line-double this 24MHz mode! ***\r\n");
+        cal.last_slack = cal.min_slack;
+        if (cal.min_slack <= 0 && cal.phase != cal.safe) {
+                /* Underran:  back off, and stop there */
+                if (video_cal_set(cal.safe)) {
+                        cal.backed_off = 1;
+                        cal.steps = PHASE_MAX_STEPS;
                 } else {
-                        wpl = (xres/(32>>bpp))-1;
-
-                        yres *= 2;
-                        yfp *= 2;
-                        ysw *= 2;
-                        ybp *= 2;
-
-                        // Synthesise new sync parameters using roughly a 2:1:4 ratio:
-                        xres *= 2;
-                        xfp = new_total_width / 20;
-                        xsw = new_total_width / 40;
-                        xbp = new_total_width-xres-xfp-xsw;
-
-                        mprintf("XY-doubled: new width %d, fp %d, xsw %d, bp %d\r\n",
-                                new_total_width, xfp, xsw, xbp);
-                        dx = 1;
-                        dy = 1;
+                        cal.frames = 1;
                 }
+                return;
         }
 
-        vr[VIDO_REG_RES_X] = xres | (dx ? 0x80000000 : 0);
-        vr[VIDO_REG_HS_FP] = xfp;
-        vr[VIDO_REG_HS_WIDTH] = xsw;
-        vr[VIDO_REG_HS_BP] = xbp;
-        vr[VIDO_REG_RES_Y] = yres | (dy ? 0x80000000 : 0);
-        vr[VIDO_REG_VS_FP] = yfp;
-        vr[VIDO_REG_VS_WIDTH] = ysw;
-        vr[VIDO_REG_VS_BP] = ybp;
-        vr[VIDO_REG_WPLM1] = wpl;
-        vr[VIDO_REG_CTRL] = cx | (hires ? 0x80000000 : 0) | (bpp << 28);
+        int spare = (cal.min_slack - PHASE_MARGIN) * (int)cal.px_per_word;
+        int phase = (int)cal.phase - spare;
 
-        video_sync();
+        if (phase < 0)
+                phase = 0;
+        if (phase > (int)cal.safe)
+                phase = cal.safe;
+        if (cal.steps >= PHASE_MAX_STEPS || phase == (int)cal.phase ||
+            (spare >= 0 && spare < (int)cal.px_per_word)) {
+                cal.state = PHASE_IDLE;
+                log_msg("Output phase %d pixels (from %d), least slack %d words%s\r\n",
+                        cal.phase, cal.safe, cal.last_slack,
+                        cal.backed_off ? ", backed off after underrun" : "");
+                return;
+        }
+        if (video_cal_set(phase))
+                cal.steps++;
+        else
+                cal.frames = 1;
+}
+
+/* Report a reconfiguration (from the IRQ handler or video_poll(), so via
+ * the log and telemetry):
+ */
+static void     video_log_reconf(void)
+{
+        const struct video_regs *r = reconf_fixed ? reconf_live : reconf_regs;
+        const struct video_load *l = &reconf_load;
+        uint32_t tr = vr[VIDO_REG_TREGS];
+        struct telem_reconf t = {
+                .prog = reconf_lb_full ? 0 : latency.last_prog,
+                .live = reconf_lb_full ? 0 : latency.last_live,
+                .writes = (tr >> 8) & 0xffff,
+                .frames = tr >> 24,
+                .source = reconf_src,
+                .flags = (reconf_fs ? TELEM_RECONF_FS : 0) |
+                        (reconf_fixed ? TELEM_RECONF_FIXED : 0) |
+                        (reconf_line_lock ? TELEM_RECONF_LINE_LOCK : 0) |
+                        (reconf_committed && !reconf_lb_full ? TELEM_RECONF_COMMIT : 0) |
+                        (reconf_lb_full ? TELEM_RECONF_LB_FULL : 0) |
+                        (reconf_fs_busy ? TELEM_RECONF_FS_BUSY : 0),
+        };
+
+        telem_reconf(flybk_count, &t);
+
+        if (reconf_src == MODE_CALC)
+                video_report_mode(&reconf_mode, reconf_line_lock);
+        else
+                log_msg("Mode %dx%d, scaled %dx%d, pclk %dMHz (%s)\r\n",
+                        r->res_x & 0x7ff, r->res_y & 0x7ff,
+                        VIDEO_RES_GET_SCALE(r->res_x), VIDEO_RES_GET_SCALE(r->res_y),
+                        video_pclk_mhz[r->pclk], mode_source_names[reconf_src]);
+        if (((r->ctrl >> 28) & 7) >= 4)
+                log_msg("Shown as %dbpp high colour\r\n",
+                        bpp_bits[(r->ctrl >> 28) & 7]);
+        if (reconf_lb_full) {
+                log_msg("*** Line of %d words won't fit the line buffer (%d), "
+                        "not displayed ***\r\n", l->words, video_lb_words());
+                return;
+        }
+        if (reconf_fs)
+                log_msg("DMA %d words/line, %dKB/s, frame store SDRAM %dKB/s\r\n",
+                        l->words, l->dma_kbs, l->fs_kbs);
+        else
+                log_msg("DMA %d words/line, %dKB/s\r\n", l->words, l->dma_kbs);
+        if (reconf_committed)
+                log_msg("Same timing, switched without resync\r\n");
+        if (reconf_line_lock)
+                log_msg("Lines locked to VIDC hsync\r\n");
+        if (reconf_fixed)
+                log_msg("Fixed output %dx%d, image %dx%d, frame-locked to VIDC\r\n",
+                        VIDEO_FIXED_XRES, VIDEO_FIXED_YRES,
+                        reconf_fixed_regs.scaler_x >> 16,
+                        reconf_fixed_regs.scaler_y >> 16);
+        else if (flag_fixed && !reconf_fs)
+                log_msg("*** Doesn't fit the fixed output, output has VIDC's "
+                        "timing ***\r\n");
+        if (reconf_fs)
+                log_msg("Via frame store, %dx%d at %dHz\r\n",
+                        r->res_x & 0x7ff, r->res_y & 0x7ff, VIDO_FS_RATE);
+        else if (reconf_fs_busy)
+                log_msg("*** Frame store would need %dKB/s of SDRAM (max %d), "
+                        "output is live ***\r\n", l->fs_kbs, FS_SDRAM_KBS);
+        else if (flag_frame_store)
+                log_msg("*** Can't retime for the frame store, "
+                        "output is live ***\r\n");
+}
+
+void    video_irq(void)
+{
+        uint32_t s = vr[VIDO_REG_IRQ_STATUS];
+        vr[VIDO_REG_IRQ_STATUS] = s;
+
+        if (s & VIDO_IRQ_TREGS) {
+                uint32_t sr = vr[VIDO_REG_SYNC];
+                // Copy status to ack, enables further detection.
+                vr[VIDO_REG_SYNC] = (sr & ~4) | ((sr >> 1) & 4);
+
+                uint32_t tr = vr[VIDO_REG_TREGS];
+                log_msg("<VIDC RECONFIG %08x: %d writes over %d frames>\r\n",
+                        sr, (tr >> 8) & 0xffff, tr >> 24);
+                reconf_t_write = vr[VIDO_REG_TREGS_TIME];
+                latency.writes += (tr >> 8) & 0xffff;
+                latency.frames += tr >> 24;
+
+                if (flag_autoprobe_mode)
+                        reconf_state = (tr & 0xf) ? RECONF_PROGRAM : RECONF_WAIT_FLYBK;
+        }
+
+        if (s & VIDO_IRQ_FLYBK_END) {
+                flybk_count++;
+                telem_frame(flybk_count);
+
+                if (reconf_state == RECONF_IDLE)
+                        video_cal_frame();
+                else
+                        cal.state = PHASE_IDLE;
+
+                if (reconf_state == RECONF_WAIT_FLYBK)
+                        reconf_state = RECONF_PROGRAM;
+        }
+
+        /* The rest is up to video_poll(): */
+        if (reconf_state == RECONF_PROGRAM)
+                video_read_timing(&reconf_timing);
+
+        if ((s & reconf_ack_irq) && reconf_state == RECONF_WAIT_SYNC) {
+                latency.last_live = vr[VIDO_REG_TIME] - reconf_t_write;
+                if (latency.last_prog > latency.max_prog)
+                        latency.max_prog = latency.last_prog;
+                if (latency.last_live > latency.max_live)
+                        latency.max_live = latency.last_live;
+                latency.count++;
+                reconf_committed = reconf_ack_irq == VIDO_IRQ_COMMIT_ACK;
+                if (reconf_committed)
+                        latency.commits++;
+                if (!reconf_fs)
+                        video_cal_start(reconf_regs);
+
+                reconf_state = RECONF_IDLE;
+                video_log_reconf();
+        }
+}
+
+/* Work out and program the output configuration for VIDC's new timing,
+ * once the IRQ handler has latched it.  From the main loop, with IRQs
+ * enabled.  Returns non-zero if there was anything to do.
+ */
+int     video_poll(void)
+{
+        uint32_t old_mask = irq_setmask(~0);
+        struct vidc_timing t = reconf_timing;
+
+        if (reconf_state != RECONF_PROGRAM) {
+                irq_setmask(old_mask);
+                return 0;
+        }
+        reconf_state = RECONF_CALC;
+        irq_setmask(old_mask);
+
+        enum mode_source src;
+        const struct video_regs *r = video_lookup_mode(&reconf_mode, &t, &src);
+
+        /* With the frame store, the output needn't match VIDC's frame
+         * period; if the mode can't be retimed, fall back to live.
+         */
+        reconf_fs = flag_frame_store &&
+                video_calc_fs_regs(r, &reconf_fs_regs, pclk_avail,
+                                   VIDO_FS_RATE);
+        /* Otherwise, a fixed output scales the live configuration
+         * (if it fits; if not, the output takes VIDC's timing).
+         */
+        reconf_fixed = flag_fixed && !reconf_fs &&
+                video_calc_fixed_regs(&t, r, &reconf_fixed_regs, pclk_avail,
+                                      VIDO_CAPS_PPC(video_caps) == 2 ? 2 : 1);
+
+        /* Check the line fits the line buffer, and that the frame
+         * store can keep up (if not, go live):
+         */
+        video_calc_load(r, reconf_fs ? &reconf_fs_regs : 0, &reconf_load);
+        reconf_fs_busy = reconf_fs && reconf_load.fs_kbs > FS_SDRAM_KBS;
+        if (reconf_fs_busy)
+                reconf_fs = 0;
+        reconf_lb_full = reconf_load.words > video_lb_words();
+        reconf_live = r;
+        if (reconf_fs)
+                r = &reconf_fs_regs;
+        else if (reconf_fixed)
+                r = &reconf_fixed_regs;
+
+        reconf_regs = r;
+        reconf_src = src;
+
+        uint32_t raster = video_calc_raster(&t, reconf_live, CPU_CLK_RATE / 1000000);
+        int line_lock = !reconf_fs && !reconf_fixed &&
+                (line_lock_mode == LL_ALWAYS ||
+                 (line_lock_mode == LL_AUTO && !video_calc_line_exact(&t, r)));
+
+        /* Program it, unless VIDC's changed again (then start over): */
+        old_mask = irq_setmask(~0);
+        if (reconf_state != RECONF_CALC) {
+                irq_setmask(old_mask);
+                return 1;
+        }
+        if (reconf_lb_full) {
+                /* Can't be displayed; leave the output as it is. */
+                reconf_line_lock = 0;
+                reconf_state = RECONF_IDLE;
+                irq_setmask(old_mask);
+                video_log_reconf();
+                return 1;
+        }
+        vr[VIDO_REG_RASTER] = raster;
+        reconf_line_lock = line_lock;
+        reconf_ack_irq = video_program_mode(r, reconf_fs, reconf_line_lock);
+        latency.last_prog = vr[VIDO_REG_TIME] - reconf_t_write;
+        reconf_state = RECONF_WAIT_SYNC;
+        irq_setmask(old_mask);
+        return 1;
+}
+
+/* Sleep until the end of the next VIDC flyback.  Not for use in IRQ context. */
+void    video_wait_flybk(void)
+{
+        unsigned int f = flybk_count;
+
+        while (flybk_count == f)
+                irq_wait();
+}
+
+/* Reprobe VIDC's configuration now, e.g. after changing autoprobe.  This
+ * waits for the next flyback, then for the new timing to go live, which
+ * never happens if VIDC has stopped (or the output doesn't sync); so give
+ * up after VIDEO_PROBE_TIMEOUT, leaving the output as it was.  The timer
+ * tick wakes irq_wait() meanwhile.  This is instead of the main loop, so
+ * does its video_poll().  Returns 0 if it timed out.
+ */
+int     video_probe_mode(void)
+{
+        uint32_t old_mask = irq_setmask(~0);
+        uint32_t t = vr[VIDO_REG_TIME];
+
+        reconf_t_write = t;
+        reconf_state = RECONF_WAIT_FLYBK;
+        irq_setmask(old_mask);
+
+        while (reconf_state != RECONF_IDLE) {
+                if (vr[VIDO_REG_TIME] - t > VIDEO_PROBE_TIMEOUT) {
+                        old_mask = irq_setmask(~0);
+                        reconf_state = RECONF_IDLE;
+                        irq_setmask(old_mask);
+                        latency.timeouts++;
+                        mprintf("Probe timed out (VIDC not running?)\r\n");
+                        log_flush();
+                        return 0;
+                }
+                if (!video_poll())
+                        irq_wait();
+        }
+        log_flush();
+        return 1;
+}
+
+static unsigned int cycles_to_us(uint32_t c)
+{
+        return c / (CPU_CLK_RATE/1000000);
+}
+
+void    video_dump_latency(void)
+{
+        mprintf("Reconfigurations: %d (%d without resync, coalescing %d writes "
+                "over %d frames), frames %d, settle %d\r\n"
+                " VIDC write to timing programmed: last %dus, max %dus\r\n"
+                " VIDC write to timing live:       last %dus, max %dus\r\n"
+                " Probes timed out: %d\r\n",
+                latency.count, latency.commits, latency.writes, latency.frames,
+                flybk_count,
+                vr[VIDO_REG_TREGS] & 0xf,
+                cycles_to_us(latency.last_prog), cycles_to_us(latency.max_prog),
+                cycles_to_us(latency.last_live), cycles_to_us(latency.max_live),
+                latency.timeouts);
 }
 
 void    video_dump_timing_regs(void)
 {
         uint32_t ctrl = vr[VIDO_REG_CTRL];
+        uint32_t pclk = vr[VIDO_REG_PCLK];
+        unsigned int psel = pclk & 3;
+
+        if (psel >= VIDEO_NUM_PCLKS)    // 3 is 78MHz too, see clocks.v
+                psel = VIDEO_NUM_PCLKS - 1;
         mprintf("Video timing regs:\r\n"
                 " X width 0x%x, front porch 0x%x, width 0x%x, back porch 0x%x, "
                 "DMA words per line-1 0x%x\r\n"
                 " Y height 0x%x, front porch 0x%x, width 0x%x, back porch 0x%x\r\n"
-                " Cursor X offset 0x%x, BPP %d, hires %d\r\n",
+                " Cursor X offset 0x%x, BPP %d, hires %d\r\n"
+                " Pixel clock %dMHz (available %x)\r\n"
+                " Line buffer %d words, %d pixels/clock, high colour %s\r\n",
                 vr[VIDO_REG_RES_X], vr[VIDO_REG_HS_FP], vr[VIDO_REG_HS_WIDTH],
                 vr[VIDO_REG_HS_BP], vr[VIDO_REG_WPLM1],
                 vr[VIDO_REG_RES_Y], vr[VIDO_REG_VS_FP], vr[VIDO_REG_VS_WIDTH],
-                vr[VIDO_REG_VS_BP], ctrl & 0x7ff, 1 << ((ctrl >> 28) & 7),
-                !!(ctrl & 0x80000000)
+                vr[VIDO_REG_VS_BP], ctrl & 0x7ff, bpp_bits[(ctrl >> 28) & 7],
+                !!(ctrl & 0x80000000),
+                video_pclk_mhz[psel], (pclk >> 8) & VIDEO_PCLK_ALL,
+                video_lb_words(), VIDO_CAPS_PPC(video_caps),
+                (video_caps & VIDO_CAPS_24BPP) ? "16/24bpp" :
+                (video_caps & VIDO_CAPS_16BPP) ? "16bpp" : "no"
                 );
 }
 
@@ -394,4 +1030,189 @@ void    video_set_y_timing(unsigned int yres, unsigned int fp, unsigned int sw,
 void    video_set_cursor_x(unsigned int offset)
 {
         vr[VIDO_REG_CTRL] = (vr[VIDO_REG_CTRL] & ~0x7ff) | (offset & 0x7ff);
+        video_commit();
+}
+
+void    video_set_settle(unsigned int frames)
+{
+        vr[VIDO_REG_TREGS] = frames & 0xf;
+}
+
+/* Switch between live output (timed by VIDC) and output from the frame
+ * store, then reprogram the current mode accordingly.
+ */
+void    video_set_frame_store(int enable)
+{
+        if (enable && !(vr[VIDO_REG_FS_STATUS] & 0x80000000)) {
+                mprintf("SDRAM not initialised, frame store unavailable\r\n");
+                return;
+        }
+        flag_frame_store = enable;
+        mprintf("Frame store is %s\r\n", enable ? "on" : "off");
+        video_probe_mode();
+}
+
+void    video_dump_frame_store(void)
+{
+        uint32_t st = vr[VIDO_REG_FS_STATUS];
+        uint32_t fr = vr[VIDO_REG_FS_FRAMES];
+        uint32_t sk = vr[VIDO_REG_FS_SKIPS];
+
+        mprintf("Frame store %s (%s), SDRAM %s\r\n"
+                " Buffers: writing %d, displaying %d, ready %d%s\r\n"
+                " Frames in %d, out %d, dropped %d, repeated %d, "
+                "bursts lost %d\r\n",
+                flag_frame_store ? "on" : "off",
+                (vr[VIDO_REG_FS_CTRL] & 1) ? "active" : "inactive",
+                (st & 0x80000000) ? "ready" : "not ready",
+                st & 3, (st >> 2) & 3, (st >> 4) & 3,
+                (st & 0x40) ? "" : " (none)",
+                fr & 0xffff, fr >> 16, sk & 0xffff, sk >> 16,
+                (st >> 8) & 0xffff);
+}
+
+/* Show the palette/cursor write replay queue's use, and optionally clear
+ * the high-water mark and lost count, e.g. to size the queue for a demo.
+ */
+void    video_dump_replay(int clear)
+{
+        uint32_t rq = vr[VIDO_REG_RQ_STATUS];
+        uint32_t ra = vr[VIDO_REG_RASTER];
+
+        mprintf("Write replay queue: %d in use, max %d, %d writes lost\r\n"
+                " Raster position scale 0x%x/65536 pixels per cycle, offset %d%s\r\n",
+                rq >> 24, (rq >> 16) & 0xff, rq & 0xffff,
+                ra & 0xfffff, (ra >> 20) & 0x7ff,
+                (ra & 0xfffff) ? "" : " (per line)");
+        if (clear)
+                vr[VIDO_REG_RQ_STATUS] = 0;
+}
+
+/* Show the output's latency behind VIDC, and how close the scan-out has got
+ * to the DMA in the line buffer, then optionally clear the histogram.
+ */
+void    video_dump_stats(int clear)
+{
+        static const char *bin_names[VIDO_SLACK_BINS] = {
+                "<=0 (underrun)", "<1/8 line", "<1/4 line", "<1/2 line",
+                "<1 line", "<=2 lines", ">2 lines (overwritten)"
+        };
+        uint32_t lat = vr[VIDO_REG_LATENCY];
+        uint32_t sl = vr[VIDO_REG_SLACK];
+        uint32_t ph = vr[VIDO_REG_PHASE];
+        uint32_t ll = vr[VIDO_REG_LINE_LOCK];
+        unsigned int psel = vr[VIDO_REG_PCLK] & 3;
+        unsigned int ppc = VIDO_CAPS_PPC(video_caps);
+        unsigned int cycles = lat & 0xffffff;
+        unsigned int htotal = (vr[VIDO_REG_RES_X] & 0x7ff) + vr[VIDO_REG_HS_FP] +
+                vr[VIDO_REG_HS_WIDTH] + vr[VIDO_REG_HS_BP];
+        unsigned int hist[VIDO_SLACK_BINS + 1];
+
+        if (psel >= VIDEO_NUM_PCLKS)
+                psel = VIDEO_NUM_PCLKS - 1;
+        if (ppc == 0)
+                ppc = 1;
+        for (int i = 0; i < (VIDO_SLACK_BINS + 1) / 2; i++) {
+                uint32_t h = vr[VIDO_REG_SLACK_HIST + i];
+                hist[i*2] = h & 0xffff;
+                hist[i*2 + 1] = h >> 16;
+        }
+
+        /* Cycles are of the output pipeline, PPC pixels each: */
+        mprintf("Phase: %d pixels (safe %d)%s\r\n",
+                ph & 0xffff, cal.safe,
+                (cal.state != PHASE_IDLE) ? ", calibrating" : "");
+        mprintf("Line lock %s (%s)", (ph & VIDO_PHASE_LINE_LOCK) ? "on" : "off",
+                line_lock_names[line_lock_mode]);
+        if (ph & VIDO_PHASE_LINE_LOCK)
+                mprintf(", last frame: %d lines corrected (max %d clocks), "
+                        "%d unlocked", ll & 0xffff, ll >> 24, (ll >> 16) & 0xff);
+        mprintf("\r\n");
+        if (vr[VIDO_REG_SCALER] & VIDO_SCALER_ENABLE)
+                mprintf("Frame lock: last frame waited %d lines%s\r\n",
+                        vr[VIDO_REG_FRAME_LOCK] >> 24,
+                        (vr[VIDO_REG_FRAME_LOCK] >> 24) == 0xff ? " (gave up)" : "");
+        mprintf("Latency: %d clocks, %dus, %d.%d lines%s\r\n"
+                " Line slack last frame: min %d, max %d words (%d per line)%s\r\n"
+                " Lines by slack, over %d frames:\r\n",
+                cycles, cycles * ppc / video_pclk_mhz[psel],
+                htotal ? (cycles * ppc) / htotal : 0,
+                htotal ? ((cycles * ppc * 10) / htotal) % 10 : 0,
+                flag_frame_store ? " (frame store, not synced)" : "",
+                (int16_t)(sl & 0xffff), (int16_t)(sl >> 16),
+                (vr[VIDO_REG_WPLM1] & 0x3ff) + 1,
+                (lat & 0x80000000) ? ", UNDERRUN seen" : "",
+                hist[VIDO_SLACK_BINS]);
+        for (int i = 0; i < VIDO_SLACK_BINS; i++)
+                mprintf("  %s:\t%d\r\n", bin_names[i], hist[i]);
+        if (clear)
+                vr[VIDO_REG_LATENCY] = 0;
+}
+
+/* Show 8BPP modes' pixels as 16BPP (5:6:5) or 24BPP (packed R, G, B) high
+ * colour, or not (0), and reprogram the current mode.
+ */
+void    video_set_hicolour(unsigned int bits)
+{
+        unsigned int bpp = (bits == 16) ? 4 : (bits == 24) ? 5 : 0;
+
+        if (bits != 0 && bpp == 0) {
+                mprintf("High colour is 16 or 24bpp\r\n");
+                return;
+        }
+        if (bpp && !video_check_format(bpp, 0))
+                return;
+        hicolour_bpp = bpp;
+        if (bpp)
+                mprintf("8bpp modes shown as %dbpp high colour\r\n", bits);
+        else
+                mprintf("High colour off\r\n");
+        video_probe_mode();
+}
+
+/* Scale modes up to n times in X and Y (2-4), where the line period and
+ * the monitor limits allow, or just double them as needed (0), and
+ * reprogram the current mode.
+ */
+void    video_set_scale(unsigned int n)
+{
+        if (n == 1 || n > VIDEO_MAX_SCALE) {
+                mprintf("Scale is 0 (double as needed) or 2-%d\r\n", VIDEO_MAX_SCALE);
+                return;
+        }
+        limits.max_scale = n;
+        if (n)
+                mprintf("Scaling up to %dx\r\n", n);
+        else
+                mprintf("Doubling as needed\r\n");
+        video_probe_mode();
+}
+
+/* Scale modes into the fixed 1280x1024 output (where they fit) or not, and
+ * reprogram the current mode.
+ */
+void    video_set_fixed(int enable)
+{
+        flag_fixed = !!enable;
+        if (flag_fixed)
+                mprintf("Fixed %dx%d output, scaled\r\n",
+                        VIDEO_FIXED_XRES, VIDEO_FIXED_YRES);
+        else
+                mprintf("Output has VIDC's timing\r\n");
+        video_probe_mode();
+}
+
+/* Set when live output lines are locked to VIDC's hsync (0 never, 1 when
+ * the line period can't be matched exactly, 2 always), and reprogram the
+ * current mode.
+ */
+void    video_set_line_lock(unsigned int mode)
+{
+        if (mode > LL_ALWAYS) {
+                mprintf("Line lock is 0 (off), 1 (auto) or 2 (always)\r\n");
+                return;
+        }
+        line_lock_mode = mode;
+        mprintf("Line lock %s\r\n", line_lock_names[mode]);
+        video_probe_mode();
 }
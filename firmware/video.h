@@ -25,9 +25,18 @@
 #ifndef VIDEO_H
 #define VIDEO_H
 
-/* Video output register interface: */
+/* Video output register interface:
+ *
+ * Registers 0-7, 9, 10, 16, 20, 22 and 32-36 are shadows:  they take effect
+ * when a frame synchronisation or commit is requested (see VIDO_REG_SYNC).
+ * A sync restarts the output at VIDC's next flyback; a commit applies them
+ * at the end of the current output frame, without losing sync, so is only
+ * suitable if the frame timing (resolution and porches/sync widths) is
+ * unchanged.
+ */
 #define VIDO_REG_RES_X          0
-/* 31           double_x        0 = regular pixels, 1 = display x pixels twice
+/* 31:30        scale_x         Display x pixels 1-4 times (factor - 1); 3
+ *                              is taken as 2 with 2 pixels per clock
  * 10:0         x_output_res
  */
 #define VIDO_REG_HS_FP          1
@@ -40,7 +49,7 @@
 /* 10:0         horiz back porch
  */
 #define VIDO_REG_RES_Y          4
-/* 31           double_y        0 = regular lines, 1 = display y lines twice
+/* 31:30        scale_y         Display y lines 1-4 times (factor - 1)
  * 10:0         y_output_res
 */
 #define VIDO_REG_VS_FP          5
@@ -53,30 +62,199 @@
 /* 10:0         vertical back porch
  */
 #define VIDO_REG_SYNC           8
-/* 4            Flyback status
- * 3            Display timing register status (toggles when HCR/VCR changed, if [2]==[3]
+/* 6            Commit ack
+ * 5            Commit request (toggle; ignored if a commit is outstanding,
+ *              i.e. if [5]!=[6])
+ * 4            Flyback status
+ * 3            Display timing register status (toggles when a batch of timing
+ *              register writes has settled, if [2]==[3], see VIDO_REG_TREGS)
  * 2            Display timing register status ack
  * 1            Frame synchronisation ack
  * 0            Frame synchronisation request
  */
 #define VIDO_REG_WPLM1          9
-/* 7:0          Words per line, minus one
+/* 9:0          Words per line, minus one (at most 2^LB_BITS, see
+ *              VIDO_REG_CAPS)
  */
 #define VIDO_REG_CTRL           10
 /* 31           HiRes   (1 = in high res mode)
- * 30:28        log2 of bits per pixel (values 0-4 valid)
+ * 30:28        Pixel format:  0-3 = VIDC 1, 2, 4, 8BPP; 4 = 16BPP (5:6:5);
+ *              5 = 24BPP (packed R, G, B bytes).  See VIDO_REG_CAPS for
+ *              whether 4/5 are supported.
  * 10:0         Cursor X offset
  */
+#define VIDO_REG_IRQ_STATUS     11
+/* 4            Commit ack (commit applied)
+ * 3            Frame synchronisation ack (sync request completed)
+ * 2            Flyback end
+ * 1            Flyback start
+ * 0            Display timing register status toggled
+ * Set on the event, whether masked or not.  Write 1 to clear.
+ */
+#define VIDO_REG_IRQ_MASK       12
+/* 4:0          1 = status bit raises the CPU interrupt (IRQ 5)
+ */
+#define VIDO_REG_TIME           13
+/* 31:0         Free-running system clock cycle count
+ */
+#define VIDO_REG_TREGS_TIME     14
+/* 31:0         VIDO_REG_TIME at the first timing register write of the last batch
+ */
+#define VIDO_REG_TREGS          15
+/* 31:24        Frames the last batch of timing register writes spanned (RO)
+ * 23:8         Number of writes in the last batch (RO)
+ * 3:0          Settle time:  a batch is complete after this many frames
+ *              without a write (0 = flag on the first write)
+ */
+#define VIDO_REG_FS_CTRL        16
+/* 0            Frame store enable:  the output free-runs at its own frame
+ *              rate, displaying frames stored in SDRAM (takes effect on sync)
+ */
+#define VIDO_REG_FS_STATUS      17
+/* 31           SDRAM initialised (RO)
+ * 23:8         Write bursts lost, SDRAM too busy (RO)
+ * 6            A completed frame is ready to be displayed (RO)
+ * 5:4          Buffer ready to be displayed (RO)
+ * 3:2          Buffer being displayed (RO)
+ * 1:0          Buffer being written (RO)
+ */
+#define VIDO_REG_FS_FRAMES      18
+/* 31:16        Output frames started (RO)
+ * 15:0         Input frames completed (RO)
+ */
+#define VIDO_REG_FS_SKIPS       19
+/* 31:16        Output frames repeating the previous frame (RO)
+ * 15:0         Input frames dropped, never displayed (RO)
+ */
+
+#define VIDO_REG_PCLK           20
+/* 10:8         Pixel clock selections available (RO, bitmap)
+ * 1:0          Pixel clock select (see video_pclk_mhz[]):  change only with
+ *              a sync, not a commit
+ */
+
+#define VIDO_REG_CAPS           21
+/* 9:8          Pixels per clock (RO)
+ * 5            24BPP pixel format supported (RO)
+ * 4            16BPP pixel format supported (RO)
+ * 3:0          LB_BITS:  line buffer holds 2^LB_BITS words per line (RO)
+ */
+#define VIDO_CAPS_LB_BITS(x)    ((x) & 0xf)
+#define VIDO_CAPS_16BPP         0x10
+#define VIDO_CAPS_24BPP         0x20
+#define VIDO_CAPS_PPC(x)        (((x) >> 8) & 3)
+
+#define VIDO_REG_RASTER         22
+/* 30:20        Pixel offset
+ * 19:0         Scale, pixels per clk cycle * 65536
+ *
+ * VIDC palette and cursor writes are replayed at the same raster position in
+ * the output, the position in the line being the time since hsync converted
+ * to pixels (from the start of display) by this.  A scale of 0 replays each
+ * at the start of its line.
+ */
+#define VIDO_REG_RQ_STATUS      23
+/* 31:24        Write replay queue entries in use (RO)
+ * 23:16        Most entries in use (write to clear)
+ * 15:0         Writes lost, queue full (write to clear)
+ */
+#define VIDO_REG_LATENCY        24
+/* 31           A display line's slack reached 0 (underrun) since cleared (RO)
+ * 23:0         Output clocks from VIDC flyback end to first display pixel,
+ *              last frame (RO)
+ *
+ * Writing clears bit 31 and the slack histogram.
+ */
+#define VIDO_REG_SLACK          25
+/* 31:16        Largest display line slack, last frame (RO, signed)
+ * 15:0         Smallest display line slack, last frame (RO, signed)
+ *
+ * A line's slack is the least the DMA was ahead of the scan-out, in line
+ * buffer words, over the line.
+ */
+#define VIDO_REG_SLACK_HIST     26
+/* 26-29:       Histogram of display lines' slack, in 16-bit (saturating)
+ *              bins, 2 per register, low first:
+ *              <= 0, < 1/8 line, < 1/4, < 1/2, < 1, <= 2, > 2 lines,
+ *              then the number of frames counted (RO)
+ */
+#define VIDO_SLACK_BINS         7
+#define VIDO_REG_PHASE          30
+/* 31           Line lock:  realign each output line (pair, when doubling) to
+ *              VIDC's hsync by adjusting its front porch
+ * 15:0         Output phase:  pixels from VIDC's flyback end to the start of
+ *              the output's first display line.  Up to one input line (the
+ *              line buffer holds two).  Takes effect on sync, or on commit
+ *              by realigning the output at the next flyback.
+ */
+#define VIDO_PHASE_LINE_LOCK    0x80000000
+#define VIDO_REG_LINE_LOCK      31
+/* 31:24        Largest correction, last frame (RO, output clocks)
+ * 23:16        Lines not corrected, error too large, last frame (RO)
+ * 15:0         Lines corrected, last frame (RO)
+ */
+#define VIDO_REG_SCALER         32
+/* 31           Scaler enable:  fit the input into the output timing by the
+ *              steps below, frame-locked to VIDC (line lock is unused)
+ * 23:0         Border colour, 0xBBGGRR
+ */
+#define VIDO_SCALER_ENABLE      0x80000000
+#define VIDO_REG_SCALER_STEP    33
+/* 31:16        Y step, input lines per output line (2.14 fixed point)
+ * 15:0         X step, input pixels per output pixel (2.14; per pair with
+ *              2 pixels per clock, which show the same pixel)
+ */
+#define VIDO_SCALER_STEP_BITS   14
+#define VIDO_REG_SCALER_X       34
+/* 26:16        Image width, output pixels
+ * 10:0         Image start, output pixels into the display
+ */
+#define VIDO_REG_SCALER_Y       35
+/* 26:16        Image height, output lines
+ * 10:0         Image start, output lines into the display
+ */
+#define VIDO_REG_FRAME_LOCK     36
+/* 31:24        Lines the last frame waited for VIDC (RO, 255 = gave up)
+ * 23:0         Lead, output pixels from the end of the last line of the frame
+ *              to the start of the image.  The last line is repeated (and the
+ *              final one cut short or stretched) so that the image starts a
+ *              phase (VIDO_REG_PHASE) after VIDC's flyback end.
+ */
+
+#define VIDO_FS_RATE            60      // Output frame rate with frame store
+
+#define VIDO_IRQ_TREGS          0x1
+#define VIDO_IRQ_FLYBK_START    0x2
+#define VIDO_IRQ_FLYBK_END      0x4
+#define VIDO_IRQ_SYNC_ACK       0x8
+#define VIDO_IRQ_COMMIT_ACK     0x10
+#define VIDO_IRQ_ALL            0x1f
 
+void    video_init(void);
+void    video_irq(void);
+int     video_poll(void);
+void    video_wait_flybk(void);
+void    video_dump_latency(void);
+void    video_dump_modes(void);
+void    video_set_settle(unsigned int frames);
 void    video_sync(void);
+void    video_commit(void);
 void    video_setmode(int mode);
-void    video_probe_mode(void);
+int     video_probe_mode(void);
 void    video_dump_timing_regs(void);
 void    video_set_x_timing(unsigned int xres, unsigned int fp, unsigned int sw,
                            unsigned int bp, unsigned int wpl);
 void    video_set_y_timing(unsigned int yres, unsigned int fp, unsigned int sw,
                            unsigned int bp);
 void    video_set_cursor_x(unsigned int offset);
+void    video_set_frame_store(int enable);
+void    video_dump_frame_store(void);
+void    video_set_hicolour(unsigned int bits);
+void    video_dump_replay(int clear);
+void    video_dump_stats(int clear);
+void    video_set_line_lock(unsigned int mode);
+void    video_set_scale(unsigned int n);
+void    video_set_fixed(int enable);
 
 #endif
 
@@ -0,0 +1,676 @@
+/* ArcDVI output mode calculation
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "vidc_regs.h"
+#include "video_calc.h"
+
+
+void    video_calc_sig(const struct vidc_timing *t, struct vidc_sig *s)
+{
+        s->w[0] = VIDC_TFIELD(t->hcr) | (VIDC_TFIELD(t->hswr) << 10) |
+                (VIDC_TFIELD(t->hdsr) << 20);
+        s->w[1] = VIDC_TFIELD(t->hder) | (VIDC_TFIELD(t->vcr) << 10) |
+                (VIDC_TFIELD(t->vswr) << 20);
+        s->w[2] = VIDC_TFIELD(t->vdsr) | (VIDC_TFIELD(t->vder) << 10) |
+                ((t->control & 0xf) << 20);
+}
+
+int     video_sig_cmp(const struct vidc_sig *a, const struct vidc_sig *b)
+{
+        for (int i = 0; i < 3; i++) {
+                if (a->w[i] != b->w[i])
+                        return (a->w[i] < b->w[i]) ? -1 : 1;
+        }
+        return 0;
+}
+
+/* Binary search of a table sorted by signature: */
+const struct video_mode_entry *video_mode_search(const struct video_mode_entry *table,
+                                                 unsigned int n,
+                                                 const struct vidc_sig *s)
+{
+        unsigned int lo = 0, hi = n;
+
+        while (lo < hi) {
+                unsigned int mid = (lo + hi) / 2;
+                int c = video_sig_cmp(&table[mid].sig, s);
+
+                if (c == 0)
+                        return &table[mid];
+                else if (c < 0)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+        return 0;
+}
+
+/* Output pixel clock selections (VIDO_REG_PCLK), in ascending order.
+ * These are fixed when the bitstream is built (the PLLs can't be retuned
+ * at run time, see clocks.v), so the solvers only choose among them.
+ */
+const unsigned int video_pclk_mhz[VIDEO_NUM_PCLKS] = { 24, 48, 78 };
+
+/* VIDC's pixel rate, in MHz, from its control register: */
+static const unsigned int vidc_pix_rates[] = { 8, 12, 16, 24 };
+
+static unsigned int vidc_pix_rate(const struct vidc_timing *t)
+{
+        return vidc_pix_rates[t->control & 3];
+}
+
+/* VIDC's line period, in its pixels (from HCR): */
+static unsigned int vidc_line_pixels(const struct vidc_timing *t)
+{
+        return (VIDC_TFIELD(t->hcr)*2)+2;
+}
+
+static int      video_guess_hires(unsigned int x, unsigned int y, unsigned int bpp,
+                                  unsigned int pclk)
+{
+        // Try to guess if this is a hires mode, by very tall high-clock 4BPP modes:
+        return (pclk == 24) && (bpp == 2) && (x < (y/2));
+}
+
+/* Split H-blanking roughly 2:1:4 between front porch, sync and back porch.
+ * It can be as little as 1/32 of the display, so proportions of the whole
+ * line (the usual total/20 etc.) could overrun it.
+ */
+static void     video_split_blank(unsigned int blank, unsigned int *fp,
+                                  unsigned int *sw, unsigned int *bp)
+{
+        *fp = blank * 2 / 7;
+        *sw = blank / 7;
+        *bp = blank - *fp - *sw;
+}
+
+/* Is candidate a a better output line than b?  An exact period beats any
+ * other, then the smallest error, then the lowest pixel clock (the faster
+ * ones are harder work for the FPGA and the cable), then the most blanking
+ * to spare.
+ */
+static int      video_solution_better(const struct video_solution *a,
+                                      const struct video_solution *b)
+{
+        if (a->exact != b->exact)
+                return a->exact;
+        if (a->err_ppm != b->err_ppm)
+                return a->err_ppm < b->err_ppm;
+        if (a->pclk != b->pclk)
+                return a->pclk < b->pclk;
+        return a->margin > b->margin;
+}
+
+/* Evaluate the candidates at one scaling (dx by dy), into *s if better: */
+static int      video_solve_scale(unsigned int in_total, unsigned int in_mhz,
+                                  unsigned int xres, unsigned int dx, unsigned int dy,
+                                  unsigned int avail, const struct video_limits *l,
+                                  struct video_solution *s, unsigned int *tried)
+{
+        unsigned int w = xres * dx;
+        unsigned int min_blank = w / l->blank_div;
+        int found = 0;
+
+        for (int i = 0; i < VIDEO_NUM_PCLKS; i++) {
+                if (!(avail & (1 << i)))
+                        continue;
+
+                unsigned int n = in_total * video_pclk_mhz[i];
+                unsigned int d = in_mhz * dy;
+                unsigned int lo = n / d;
+                unsigned int rem = n - lo * d;
+                int native = dy == 1 && video_pclk_mhz[i] == in_mhz;
+
+                for (unsigned int total = lo; total <= lo + (rem != 0); total++) {
+                        unsigned int diff = (total == lo) ? rem : d - rem;
+                        struct video_solution c;
+
+                        (*tried)++;
+                        if (total > l->max_total || total < w ||
+                            (total - w < min_blank && !native))
+                                continue;
+
+                        c.pclk = i;
+                        c.dx = dx;
+                        c.dy = dy;
+                        c.xres = w;
+                        c.total = total;
+                        c.margin = (total - w > min_blank) ? total - w - min_blank : 0;
+                        c.exact = diff == 0;
+                        c.err_ppm = diff * 1000000 / n;
+                        if (!found || video_solution_better(&c, s)) {
+                                *s = c;
+                                found = 1;
+                        }
+                }
+        }
+        return found;
+}
+
+/* Line solver:  the output runs in lock-step with VIDC, so its line period
+ * must match VIDC's (in_total pixels at in_mhz), or 1/n of it when the
+ * output shows each line n times.  This searches, within the limits l:
+ *
+ * - The scaling:  if l->max_scale allows, the largest Y factor (down to 2)
+ *   whose display fits l->max_width/max_lines, with the X factor that
+ *   keeps pixels the shape they'd be on a 4:3 monitor.  Otherwise, or if
+ *   none of those works, a display narrower/shorter than the minimums is
+ *   pixel/line-doubled if possible, falling back to less doubling (X
+ *   first, as pixel-doubling doesn't change the period) down to none.
+ * - For each available pixel clock, the output totals either side of the
+ *   ideal one (just the one if it divides exactly), each needing at least
+ *   the minimum H-blanking.  An inexact period drifts a little every line
+ *   unless the output is line-locked; whether it's noticeable depends on
+ *   the monitor.
+ *
+ * The best candidate (see video_solution_better()) at the first scaling
+ * that works is returned in *s, with its blanking split into porches.  The
+ * exception to the blanking minimum is the input timing verbatim (same
+ * clock, no line-doubling), which is what VIDC's monitor gets anyway.
+ *
+ * Returns 0 if there's no solution; s->tried is valid either way.
+ */
+int     video_solve_line(unsigned int in_total, unsigned int in_mhz,
+                         unsigned int xres, unsigned int yres, unsigned int avail,
+                         const struct video_limits *l, struct video_solution *s)
+{
+        unsigned int tried = 0;
+        int found = 0;
+
+        for (unsigned int dy = xres ? l->max_scale : 0; dy > 1 && !found; dy--) {
+                // Round dy * (4/3) * (yres/xres):
+                unsigned int dx = (dy * 8 * yres + 3 * xres) / (6 * xres);
+
+                if (dx < 1)
+                        dx = 1;
+                if (dx > l->max_scale || !(l->x_scales & (1 << (dx - 1))) ||
+                    xres * dx > l->max_width || yres * dy > l->max_lines)
+                        continue;
+                found = video_solve_scale(in_total, in_mhz, xres, dx, dy, avail,
+                                          l, s, &tried);
+        }
+        for (unsigned int dy = 1 + (yres < l->min_lines); dy >= 1 && !found; dy--) {
+                for (unsigned int dx = 1 + (xres < l->min_width); dx >= 1 && !found; dx--)
+                        found = video_solve_scale(in_total, in_mhz, xres, dx, dy, avail,
+                                                  l, s, &tried);
+        }
+
+        s->tried = tried;
+        if (found)
+                video_split_blank(s->total - s->xres, &s->xfp, &s->xsw, &s->xbp);
+        return found;
+}
+
+/* Monitors/TVs seem to like 400-ish lines at a minimum, and being too
+ * skimpy on H-blank time upsets many (1/32 is art not science).  Scaling
+ * beyond that is off by default, as not every monitor takes the odd
+ * resolutions (e.g. 1280x768 at 50Hz) it gives.
+ */
+const struct video_limits video_default_limits = {
+        640, 480, 32, VIDEO_MAX_TOTAL, 0, 1920, 1200, 0xf
+};
+
+/* Choose an output configuration for the given VIDC configuration, using
+ * the pixel clocks in avail (bitmap of VIDO_REG_PCLK selections), within
+ * the limits l (e.g. video_default_limits):
+ */
+void    video_calc_mode(const struct vidc_timing *t, struct video_mode *m,
+                        unsigned int avail, const struct video_limits *l)
+{
+        static const struct video_limits hires_limits = {
+                0, 0, 32, VIDEO_MAX_TOTAL, 0, 0, 0, 1
+        };
+
+        // fp is dispend to frame (sync start)
+        // bo is dispstart-syncwidth
+        unsigned int cr = t->control;
+        unsigned int bpp = (cr >> 2) & 3;
+        unsigned int pix_rate = vidc_pix_rate(t);
+        unsigned int hcr = vidc_line_pixels(t);
+        unsigned int hsw = (VIDC_TFIELD(t->hswr)*2)+2;
+        unsigned int hdsr = (VIDC_TFIELD(t->hdsr)*2) +
+                vidc_bpp_to_hdsr_offset(bpp);
+        unsigned int hder = (VIDC_TFIELD(t->hder)*2) +
+                vidc_bpp_to_hdsr_offset(bpp);
+        unsigned int vcr = VIDC_TFIELD(t->vcr)+1;
+        unsigned int vsw = VIDC_TFIELD(t->vswr)+1;
+        unsigned int vdsr = VIDC_TFIELD(t->vdsr)+1;
+        unsigned int vder = VIDC_TFIELD(t->vder)+1;
+
+        unsigned int xres = hder - hdsr;
+        unsigned int yres = vder - vdsr;
+        unsigned int xfp = hcr - hder;
+        unsigned int xsw = hsw;
+        unsigned int xbp = hdsr - hsw;
+        unsigned int yfp = vcr - vder;
+        unsigned int ysw = vsw;
+        unsigned int ybp = vdsr - vsw;
+        unsigned int wpl = (xres/(32>>bpp))-1;
+        unsigned int cx = hdsr - 6;
+        unsigned int hires = 0;
+        unsigned int dx = 1, dy = 1;
+        unsigned int pclk = 0;
+        struct video_solution s;
+
+        m->pix_rate = pix_rate;
+        m->in_bpp = bpp;
+        m->hcr = hcr;
+        m->vcr = vcr;
+        m->in_xres = xres;
+        m->in_xfp = xfp;
+        m->in_xsw = xsw;
+        m->in_xbp = xbp;
+        m->in_yres = yres;
+        m->in_yfp = yfp;
+        m->in_ysw = ysw;
+        m->in_ybp = ybp;
+        m->hc_width = 0;
+        m->err_ppm = 0;
+        m->note = VM_NATIVE;
+
+        if (video_guess_hires(xres, yres, bpp, pix_rate)) {
+                /* Not totally infallible, but definitely works for mode 23 ;-)
+                 * No other hires timing has been tried.
+                 *
+                 * The mono pixels come out at 4x the VIDC rate (96MHz), so
+                 * match the same horizontal period at a lower clock (78MHz
+                 * gives exactly 1274 for mode 23's 1568).
+                 */
+                if (!video_solve_line(hcr*4, pix_rate*4, xres*4, yres, avail,
+                                      &hires_limits, &s)) {
+                        // Show it as 4bpp; wrong, but shows something.
+                        m->note = VM_HIRES_NO_PCLK;
+                } else {
+                        m->note = s.exact ? VM_HIRES : VM_HIRES_INEXACT;
+
+                        xres = s.xres;
+                        xfp = s.xfp;
+                        xsw = s.xsw;
+                        xbp = s.xbp;
+                        // vertical timing stays the same.
+                        hires = 1;
+                        bpp = 0;
+                        wpl = (xres/32)-1;
+                        pclk = s.pclk;
+                        m->err_ppm = s.err_ppm;
+
+                        cx = 0x12c; // FIXME: derive this from ... something! ;(
+                }
+
+        } else {
+                /* Something might need doubling (or scaling).  A mode
+                 * with its lines shown n times keeps the same vertical
+                 * timing, so each line is output n times as fast
+                 * horizontally:  the solver finds an output clock at which
+                 * 1/n of the input line period holds the line plus some
+                 * blanking.  Not all modes succeed; the mode might be so
+                 * wide that even the fastest output clock can't fit it in
+                 * the time, and the fallback is outputting it
+                 * non-doubled (which will likely not work).
+                 */
+                int want_x = xres < l->min_width;
+                int want_y = yres < l->min_lines;
+
+                if (!video_solve_line(hcr, pix_rate, xres, yres, avail, l, &s)) {
+                        /* Set this mode verbatim, maybe the display can
+                         * cope with it directly.
+                         */
+                        m->note = want_y ? (want_x ? VM_NO_DOUBLE_XY : VM_NO_DOUBLE) :
+                                VM_NO_PCLK;
+                } else {
+                        if (want_y && s.dy == 1)
+                                m->note = want_x ? VM_NO_DOUBLE_XY : VM_NO_DOUBLE;
+                        else if (s.dx > 1 || s.dy > 1)
+                                m->note = VM_SCALED;
+
+                        yres *= s.dy;
+                        yfp *= s.dy;
+                        ysw *= s.dy;
+                        ybp *= s.dy;
+                        /* Keep VIDC's porches if its line is output as-is: */
+                        if (s.xres != xres || s.total != hcr) {
+                                xres = s.xres;
+                                xfp = s.xfp;
+                                xsw = s.xsw;
+                                xbp = s.xbp;
+                        }
+                        dx = s.dx;
+                        dy = s.dy;
+                        pclk = s.pclk;
+                        m->err_ppm = s.err_ppm;
+                }
+        }
+
+        m->xres = xres;
+        m->xfp = xfp;
+        m->xsw = xsw;
+        m->xbp = xbp;
+        m->yres = yres;
+        m->yfp = yfp;
+        m->ysw = ysw;
+        m->ybp = ybp;
+        m->wpl = wpl;
+        m->cx = cx;
+        m->bpp = bpp;
+        m->hires = hires;
+        m->dx = dx;
+        m->dy = dy;
+        m->pclk = pclk;
+        m->tried = s.tried;
+}
+
+
+/* Show an 8BPP mode's DMA data as high colour pixels instead, bpp being
+ * 4 (16BPP, 5:6:5) or 5 (24BPP, packed R, G, B):  the line holds fewer,
+ * fatter pixels, so the same words per line and timing are used but the
+ * display is narrower.  It's pixel-doubled if that still fits, and the
+ * rest of the line goes to the porches.  Hires and non-8BPP modes are left
+ * alone.
+ */
+void    video_calc_hicolour(struct video_mode *m, unsigned int bpp)
+{
+        unsigned int bits = (bpp == 4) ? 16 : 24;
+
+        if (m->in_bpp != 3 || m->hires || (bpp != 4 && bpp != 5))
+                return;
+
+        unsigned int width = m->in_xres * 8 / bits;
+        unsigned int disp = width * m->dx;
+
+        if (m->dx == 1 && disp * 2 <= m->xres) {
+                m->dx = 2;
+                disp *= 2;
+        }
+
+        unsigned int spare = m->xres - disp;
+
+        m->xfp += spare / 2;
+        m->xbp += spare - (spare / 2);
+        m->xres = disp;
+        m->bpp = bpp;
+        m->hc_width = width;
+}
+
+
+void    video_calc_regs(const struct video_mode *m, struct video_regs *r)
+{
+        r->res_x = m->xres | VIDEO_RES_SCALE(m->dx);
+        r->hs_fp = m->xfp;
+        r->hs_width = m->xsw;
+        r->hs_bp = m->xbp;
+        r->res_y = m->yres | VIDEO_RES_SCALE(m->dy);
+        r->vs_fp = m->yfp;
+        r->vs_width = m->ysw;
+        r->vs_bp = m->ybp;
+        r->wplm1 = m->wpl;
+        r->ctrl = m->cx | (m->hires ? 0x80000000 : 0) | (m->bpp << 28);
+        r->pclk = m->pclk;
+        r->scaler = 0;
+        r->scaler_step = 0;
+        r->scaler_x = 0;
+        r->scaler_y = 0;
+        r->frame_lock = 0;
+}
+
+
+/* Retime an output configuration for the frame store, which decouples the
+ * output frame rate from VIDC's:  the resolution (and scaling) is kept, but
+ * the output is given the shortest sensible vertical blanking and a line
+ * period to make 'rate' Hz, at the lowest available pixel clock that fits.
+ * Lines shorter than 400 are doubled, as the frame store can display any
+ * mode's lines twice regardless of period (the sticking point for live
+ * doubling).
+ *
+ * Returns 0 if the mode can't be displayed at that rate (the line period
+ * would leave too little H-blank at any clock), in which case the caller
+ * should stick to the live (VIDC-timed) configuration.
+ */
+int     video_calc_fs_regs(const struct video_regs *in, struct video_regs *out,
+                           unsigned int avail, unsigned int rate)
+{
+        const unsigned int yfp = 3, ysw = 3, ybp = 14;  // Blanking of 20 lines
+        unsigned int xres = in->res_x & 0x7ff;
+        unsigned int yres = in->res_y & 0x7ff;
+        unsigned int dx = VIDEO_RES_GET_SCALE(in->res_x);
+        unsigned int dy = VIDEO_RES_GET_SCALE(in->res_y);
+
+        if (dy == 1 && yres < 400) {
+                yres *= 2;
+                dy = 2;
+                if (dx == 1 && xres < 640) {
+                        xres *= 2;
+                        dx = 2;
+                }
+        }
+
+        unsigned int total_height = yres + yfp + ysw + ybp;
+        // As for doubling in video_calc_mode():
+        unsigned int minimum_h_blanking = xres / 32;
+        unsigned int fp, sw, bp;
+
+        for (int i = 0; i < VIDEO_NUM_PCLKS; i++) {
+                if (!(avail & (1 << i)))
+                        continue;
+
+                unsigned int total_width = video_pclk_mhz[i] * 1000000 /
+                        (rate * total_height);
+
+                if (total_width < xres + minimum_h_blanking)
+                        continue;
+
+                video_split_blank(total_width - xres, &fp, &sw, &bp);
+
+                *out = *in;
+                out->res_x = xres | VIDEO_RES_SCALE(dx);
+                out->hs_fp = fp;
+                out->hs_width = sw;
+                out->hs_bp = bp;
+                out->res_y = yres | VIDEO_RES_SCALE(dy);
+                out->vs_fp = yfp;
+                out->vs_width = ysw;
+                out->vs_bp = ybp;
+                out->pclk = i;
+                return 1;
+        }
+        return 0;
+}
+
+
+/* Configure the scaler to show a mode in the fixed output timing
+ * (VIDEO_FIXED_*, 1280x1024 at VIDC's frame rate), so that the monitor
+ * doesn't have to relock when VIDC's mode changes:  in is the mode's live
+ * configuration (for the size of its display, and its cursor and DMA),
+ * and t its VIDC timing.
+ *
+ * The output line can't be a multiple of VIDC's, so the image takes the
+ * same time as VIDC's display (for the line buffer), which makes its
+ * height VIDC's lines scaled by the ratio of the line periods.  Its width
+ * assumes a 4:3 picture, whatever src_w/src_h are:  VIDC's pixels aren't
+ * square (a 640x256 mode fills the same 4:3 screen as a 640x512 one), so
+ * the source's pixel counts say nothing about its shape.  The image is made
+ * 4:3 (or as wide as fits), and centred on a border.  The output frame is
+ * always the same (VESA's 1066 lines), and frame lock holds it back by the
+ * few lines VIDC's is longer (see video_timing.v), so that mode changes
+ * don't even need a resync.
+ *
+ * Returns 0 if the mode doesn't fit:  VIDC's frame is too short for
+ * the fixed output's (60Hz and above) or too long to wait for, or its
+ * display is too tall.  The caller should stick to the live configuration
+ * then.
+ */
+int     video_calc_fixed_regs(const struct vidc_timing *t, const struct video_regs *in,
+                              struct video_regs *out, unsigned int avail,
+                              unsigned int ppc)
+{
+        const unsigned int yfp = 1, ysw = 3, ybp = 38;
+        const unsigned int xres = VIDEO_FIXED_XRES, yres = VIDEO_FIXED_YRES;
+        const unsigned int total = VIDEO_FIXED_TOTAL;
+        unsigned int pix_rate = vidc_pix_rate(t);
+        unsigned int hcr = vidc_line_pixels(t);
+        unsigned int vcr = VIDC_TFIELD(t->vcr)+1;
+        unsigned int src_w = (in->res_x & 0x7ff) / VIDEO_RES_GET_SCALE(in->res_x);
+        unsigned int src_h = (in->res_y & 0x7ff) / VIDEO_RES_GET_SCALE(in->res_y);
+        unsigned int fp, sw, bp;
+        int pclk = -1;
+
+        for (int i = 0; i < VIDEO_NUM_PCLKS; i++) {
+                if ((avail & (1 << i)) && video_pclk_mhz[i] == VIDEO_FIXED_MHZ)
+                        pclk = i;
+        }
+        if (pclk < 0 || src_w == 0 || src_h == 0)
+                return 0;
+
+        /* Output lines per VIDC frame, at least one more than the output's
+         * frame, and not so many that frame lock gives up waiting:
+         */
+        unsigned int lines = (vcr * hcr * VIDEO_FIXED_MHZ) / (pix_rate * total);
+        unsigned int height = yres + yfp + ysw + ybp;
+
+        if (lines <= height || lines > height + VIDEO_FIXED_MAX_WAIT)
+                return 0;
+
+        /* VIDC lines per output line, 2.14: */
+        uint32_t step_y = (total * pix_rate * 16384) / (hcr * VIDEO_FIXED_MHZ);
+        unsigned int img_h = (src_h * 16384) / step_y;
+
+        if (step_y > 0xffff || img_h > yres || img_h == 0)
+                return 0;
+
+        unsigned int img_w = img_h * 4 / 3;     // 4:3, see above
+
+        if (img_w > xres)
+                img_w = xres;
+        img_w &= ~1;
+        if (img_w < 2)
+                return 0;
+
+        uint32_t step_x = (src_w * 16384) / img_w * ppc;
+
+        if (step_x > 0xffff)
+                return 0;
+
+        unsigned int img_x = ((xres - img_w) / 2) & ~1;
+        unsigned int img_y = (yres - img_h) / 2;
+
+        video_split_blank(total - xres, &fp, &sw, &bp);
+
+        *out = *in;
+        out->res_x = xres | VIDEO_RES_SCALE(1);
+        out->hs_fp = fp;
+        out->hs_width = sw;
+        out->hs_bp = bp;
+        out->res_y = yres | VIDEO_RES_SCALE(1);
+        out->vs_fp = yfp;
+        out->vs_width = ysw;
+        out->vs_bp = ybp;
+        out->pclk = pclk;
+        out->scaler = 0x80000000;
+        out->scaler_step = (step_y << 16) | step_x;
+        out->scaler_x = (img_w << 16) | img_x;
+        out->scaler_y = (img_h << 16) | img_y;
+        // From the start of the frame to the start of the image:
+        out->frame_lock = (ysw + ybp + img_y) * total;
+        return 1;
+}
+
+
+/* Frame rate of a configuration, in tenths of Hz: */
+static unsigned int video_regs_dhz(const struct video_regs *r)
+{
+        unsigned int tw = (r->res_x & 0x7ff) + r->hs_fp + r->hs_width + r->hs_bp;
+        unsigned int th = (r->res_y & 0x7ff) + r->vs_fp + r->vs_width + r->vs_bp;
+
+        return video_pclk_mhz[r->pclk] * 10000000 / (tw * th);
+}
+
+/* KB of line data per frame (scaled lines are only fetched once): */
+static unsigned int video_regs_kb_per_frame(const struct video_regs *r)
+{
+        unsigned int lines = (r->res_y & 0x7ff) / VIDEO_RES_GET_SCALE(r->res_y);
+
+        return ((r->wplm1 + 1) * 4 * lines) / 1024;
+}
+
+/* The memory traffic of a configuration:  live is as from video_calc_regs()
+ * (which has VIDC's frame period, whatever scaling has been done), and fs,
+ * if the frame store's in use, is as retimed by video_calc_fs_regs().  The
+ * frame store writes VIDC's frames to SDRAM and reads them back out at its
+ * own rate, so uses the sum.
+ */
+void    video_calc_load(const struct video_regs *live, const struct video_regs *fs,
+                        struct video_load *l)
+{
+        l->words = live->wplm1 + 1;
+        l->dma_kbs = video_regs_kb_per_frame(live) * video_regs_dhz(live) / 10;
+        l->fs_kbs = 0;
+        if (fs)
+                l->fs_kbs = l->dma_kbs +
+                        video_regs_kb_per_frame(fs) * video_regs_dhz(fs) / 10;
+}
+
+/* The VIDO_REG_RASTER value for output registers r of VIDC timing t, with
+ * clk at clk_mhz:  VIDC writes are stamped with the clk cycles since hsync,
+ * which this converts to pixels of the output's line (its logical pixels,
+ * i.e. before X scaling, so 4 per VIDC pixel in hires and fewer in high
+ * colour) from the start of display.
+ */
+uint32_t video_calc_raster(const struct vidc_timing *t, const struct video_regs *r,
+                           unsigned int clk_mhz)
+{
+        unsigned int bpp = (t->control >> 2) & 3;
+        unsigned int pix_rate = vidc_pix_rate(t);
+        unsigned int hdsr = (VIDC_TFIELD(t->hdsr)*2) +
+                vidc_bpp_to_hdsr_offset(bpp);
+        unsigned int hder = (VIDC_TFIELD(t->hder)*2) +
+                vidc_bpp_to_hdsr_offset(bpp);
+        unsigned int width = (r->res_x & 0x7ff) / VIDEO_RES_GET_SCALE(r->res_x);
+
+        if (hder <= hdsr || clk_mhz == 0)
+                return 0;
+
+        unsigned int in_xres = hder - hdsr;
+        uint32_t scale = (pix_rate * 65536 * width) / (clk_mhz * in_xres);
+        uint32_t offset = hdsr * width / in_xres;
+
+        if (scale > 0xfffff || offset > 0x7ff)
+                return 0;
+        return (offset << 20) | scale;
+}
+
+
+/* Does the output line period (a group of n lines, when Y-scaled by n) exactly
+ * match VIDC's?  If not, the output drifts from VIDC a little every line,
+ * unless it's line-locked (see video_timing.v).
+ */
+int     video_calc_line_exact(const struct vidc_timing *t, const struct video_regs *r)
+{
+        unsigned int pix_rate = vidc_pix_rate(t);
+        unsigned int hcr = vidc_line_pixels(t);
+        unsigned int htotal = (r->res_x & 0x7ff) + r->hs_fp + r->hs_width + r->hs_bp;
+
+        htotal *= VIDEO_RES_GET_SCALE(r->res_y);
+        return hcr * video_pclk_mhz[r->pclk] == htotal * pix_rate;
+}
@@ -0,0 +1,184 @@
+/* ArcDVI output mode calculation
+ *
+ * This is plain C without any hardware access, so that it can also be
+ * built for the host:  tools/gen_mode_table.c uses it to precompute the
+ * output configuration of the standard RISC OS modes at build time.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef VIDEO_CALC_H
+#define VIDEO_CALC_H
+
+#include <stdint.h>
+
+/* The VIDC registers that determine the output mode (raw 24-bit values): */
+struct vidc_timing {
+        uint32_t        hcr, hswr, hdsr, hder;
+        uint32_t        vcr, vswr, vdsr, vder;
+        uint32_t        control;
+};
+
+#define VIDC_TFIELD(x)          (((x) >> 14) & 0x3ff)
+
+/* A compact signature of a vidc_timing:  the eight 10-bit timing fields
+ * and the control register's bpp/pixel rate, packed into 84 bits.  Bits
+ * 24-31 of w[2] are free for the caller's own options that affect the
+ * output configuration (see VIDEO_SIG_*).
+ */
+struct vidc_sig {
+        uint32_t        w[3];
+};
+
+#define VIDEO_SIG_HICOLOUR(bpp)  ((uint32_t)(bpp) << 24)
+#define VIDEO_SIG_SCALE(n)       ((uint32_t)(n) << 28)
+
+/* Output pixel clocks, selected by VIDO_REG_PCLK (see src/clocks.v): */
+#define VIDEO_NUM_PCLKS         3
+#define VIDEO_PCLK_ALL          ((1 << VIDEO_NUM_PCLKS) - 1)
+/* Those the hardware has (24MHz is only the SIM build's): */
+#define VIDEO_PCLK_HW           0x6
+
+extern const unsigned int video_pclk_mhz[VIDEO_NUM_PCLKS];
+
+/* How video_calc_mode() got on, so a report can be printed later: */
+enum video_mode_note {
+        VM_NATIVE,
+        VM_HIRES,
+        VM_HIRES_INEXACT,
+        VM_HIRES_NO_PCLK,
+        VM_SCALED,
+        VM_NO_DOUBLE,
+        VM_NO_DOUBLE_XY,
+        VM_NO_PCLK,
+};
+
+struct video_mode {
+        /* Input (VIDC) timing: */
+        unsigned int    pix_rate;
+        unsigned int    in_bpp;
+        unsigned int    hcr, vcr;
+        unsigned int    in_xres, in_xfp, in_xsw, in_xbp;
+        unsigned int    in_yres, in_yfp, in_ysw, in_ybp;
+        /* Output timing: */
+        unsigned int    xres, xfp, xsw, xbp;
+        unsigned int    yres, yfp, ysw, ybp;
+        unsigned int    wpl;
+        unsigned int    cx;
+        unsigned int    bpp;
+        unsigned int    hires;
+        unsigned int    dx, dy;         /* Scale factors, 1-4 */
+        unsigned int    pclk;           /* Selection, see video_pclk_mhz */
+        unsigned int    err_ppm;        /* Line period error, see video_solve_line() */
+        unsigned int    tried;          /* Solver candidates evaluated */
+        unsigned int    hc_width;       /* High colour pixels per line, or 0 */
+        enum video_mode_note note;
+};
+
+/* The VIDO_REG_* values for a mode: */
+struct video_regs {
+        uint32_t        res_x, hs_fp, hs_width, hs_bp;
+        uint32_t        res_y, vs_fp, vs_width, vs_bp;
+        uint32_t        wplm1, ctrl;
+        uint32_t        pclk;
+        /* The scaler, see video_calc_fixed_regs() (else all 0): */
+        uint32_t        scaler, scaler_step, scaler_x, scaler_y, frame_lock;
+};
+
+/* Memory traffic of a configuration, see video_calc_load(): */
+struct video_load {
+        unsigned int    words;          /* DMA words per line */
+        unsigned int    dma_kbs;        /* VIDC DMA, KB/s */
+        unsigned int    fs_kbs;         /* Frame store SDRAM reads+writes, KB/s */
+};
+
+/* What the monitor will put up with, for video_solve_line(): */
+struct video_limits {
+        unsigned int    min_width;      /* Pixel-double narrower displays */
+        unsigned int    min_lines;      /* Line-double shorter displays */
+        unsigned int    blank_div;      /* H-blank at least 1/blank_div of the display */
+        unsigned int    max_total;      /* Longest line the output counters allow */
+        unsigned int    max_scale;      /* Scale up to this (2-4), or 0 to only double */
+        unsigned int    max_width;      /* Largest display when scaling */
+        unsigned int    max_lines;
+        unsigned int    x_scales;       /* Bitmap of X factors the hardware has, 1 << (n-1) */
+};
+
+#define VIDEO_MAX_TOTAL         2047
+#define VIDEO_MAX_SCALE         4
+
+/* VIDO_REG_RES_X/Y scale factor field: */
+#define VIDEO_RES_SCALE(n)      ((uint32_t)((n) - 1) << 30)
+#define VIDEO_RES_GET_SCALE(r)  ((((r) >> 30) & 3) + 1)
+
+extern const struct video_limits video_default_limits;
+
+/* The fixed output timing of video_calc_fixed_regs(): */
+#define VIDEO_FIXED_XRES        1280
+#define VIDEO_FIXED_YRES        1024
+#define VIDEO_FIXED_TOTAL       1456
+#define VIDEO_FIXED_MHZ         78
+#define VIDEO_FIXED_MAX_WAIT    250     /* Lines, see FL_MAX in video_timing.v */
+
+/* An output line found by video_solve_line(): */
+struct video_solution {
+        unsigned int    pclk;           /* Selection, see video_pclk_mhz */
+        unsigned int    dx, dy;         /* Scale factors */
+        unsigned int    xres, total;    /* Output pixels (after X-doubling) */
+        unsigned int    xfp, xsw, xbp;
+        unsigned int    margin;         /* H-blank beyond the minimum */
+        int             exact;
+        unsigned int    err_ppm;        /* Line period error, parts per million */
+        unsigned int    tried;          /* Candidates evaluated */
+};
+
+struct video_mode_entry {
+        struct vidc_sig         sig;
+        struct video_regs       regs;
+};
+
+void    video_calc_sig(const struct vidc_timing *t, struct vidc_sig *s);
+int     video_sig_cmp(const struct vidc_sig *a, const struct vidc_sig *b);
+int     video_solve_line(unsigned int in_total, unsigned int in_mhz,
+                         unsigned int xres, unsigned int yres, unsigned int avail,
+                         const struct video_limits *l, struct video_solution *s);
+void    video_calc_mode(const struct vidc_timing *t, struct video_mode *m,
+                        unsigned int avail, const struct video_limits *l);
+void    video_calc_hicolour(struct video_mode *m, unsigned int bpp);
+void    video_calc_regs(const struct video_mode *m, struct video_regs *r);
+int     video_calc_fs_regs(const struct video_regs *in, struct video_regs *out,
+                           unsigned int avail, unsigned int rate);
+int     video_calc_fixed_regs(const struct vidc_timing *t, const struct video_regs *in,
+                              struct video_regs *out, unsigned int avail,
+                              unsigned int ppc);
+void    video_calc_load(const struct video_regs *live, const struct video_regs *fs,
+                        struct video_load *l);
+int     video_calc_line_exact(const struct vidc_timing *t, const struct video_regs *r);
+uint32_t video_calc_raster(const struct vidc_timing *t, const struct video_regs *r,
+                           unsigned int clk_mhz);
+const struct video_mode_entry *video_mode_search(const struct video_mode_entry *table,
+                                                 unsigned int n,
+                                                 const struct vidc_sig *s);
+
+#endif
@@ -0,0 +1,126 @@
+/* ArcDVI: Asynchronous FIFO
+ *
+ * A small FIFO between two unrelated clock domains, for passing events
+ * (e.g. register writes) from one to the other.  The read and write
+ * pointers are Gray-coded, so each crosses the domain boundary through a
+ * two-flop synchroniser with only one bit changing at a time; the storage
+ * is read asynchronously (so maps to LUTRAM), and an entry is only visible
+ * to the reader a couple of cycles after it was written.
+ *
+ * rdata is the head entry, valid whenever !empty.  Writes when full are
+ * dropped (the writer should check full if that matters).  wlevel is the
+ * number of entries in use as seen by the writer, which lags reads by a
+ * couple of cycles (so can overestimate).
+ *
+ * The read side only advances when rce is high, so that it can be part of
+ * a clock-enabled pipeline.
+ *
+ * There's no reset:  the pointers start empty from configuration.
+ *
+ * 2 Jan 2022
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module async_fifo #(parameter WIDTH = 32,
+                    parameter DEPTH_BITS = 4)
+                  (input wire                wclk,
+                   input wire                write,
+                   input wire [WIDTH-1:0]    wdata,
+                   output wire               full,
+                   output wire [DEPTH_BITS:0] wlevel,
+
+                   input wire                rclk,
+                   input wire                rce,
+                   input wire                read,
+                   output wire [WIDTH-1:0]   rdata,
+                   output wire               empty
+                   );
+
+   localparam N = DEPTH_BITS;
+
+   reg [WIDTH-1:0]      mem[(1 << N)-1:0];
+
+   /* Pointers have an extra bit, to tell full from empty: */
+   reg [N:0]            wptr_bin;
+   reg [N:0]            wptr_gray;
+   reg [N:0]            rptr_bin;
+   reg [N:0]            rptr_gray;
+
+   reg [N:0]            wptr_gray_rs[1:0];      // wptr in rclk domain
+   reg [N:0]            rptr_gray_ws[1:0];      // rptr in wclk domain
+
+   initial begin
+           wptr_bin             = 0;
+           wptr_gray            = 0;
+           rptr_bin             = 0;
+           rptr_gray            = 0;
+           wptr_gray_rs[0]      = 0;
+           wptr_gray_rs[1]      = 0;
+           rptr_gray_ws[0]      = 0;
+           rptr_gray_ws[1]      = 0;
+   end
+
+   wire [N:0]           wptr_bin_next = wptr_bin + 1;
+   wire [N:0]           rptr_bin_next = rptr_bin + 1;
+
+   /* Full when the write pointer is a whole lap ahead of the read pointer,
+    * which in Gray code means the top two bits differ and the rest match:
+    */
+   assign full  = wptr_gray == {~rptr_gray_ws[1][N:N-1], rptr_gray_ws[1][N-2:0]};
+   assign empty = rptr_gray == wptr_gray_rs[1];
+   assign rdata = mem[rptr_bin[N-1:0]];
+
+   reg [N:0]            rptr_bin_ws;
+   integer              i;
+
+   always @(*) begin
+           rptr_bin_ws[N] = rptr_gray_ws[1][N];
+           for (i = N-1; i >= 0; i = i - 1)
+             rptr_bin_ws[i] = rptr_bin_ws[i+1] ^ rptr_gray_ws[1][i];
+   end
+
+   assign wlevel = wptr_bin - rptr_bin_ws;
+
+   always @(posedge wclk) begin
+           rptr_gray_ws[0]      <= rptr_gray;
+           rptr_gray_ws[1]      <= rptr_gray_ws[0];
+
+           if (write && !full) begin
+                   mem[wptr_bin[N-1:0]] <= wdata;
+                   wptr_bin             <= wptr_bin_next;
+                   wptr_gray            <= wptr_bin_next ^ (wptr_bin_next >> 1);
+           end
+   end
+
+   always @(posedge rclk) if (rce) begin
+           wptr_gray_rs[0]      <= wptr_gray;
+           wptr_gray_rs[1]      <= wptr_gray_rs[0];
+
+           if (read && !empty) begin
+                   rptr_bin             <= rptr_bin_next;
+                   rptr_gray            <= rptr_bin_next ^ (rptr_bin_next >> 1);
+           end
+   end
+
+endmodule // async_fifo
@@ -2,6 +2,18 @@
  *
  * Generate clocks for video and system from input crystal/VIDC clocks.
  *
+ * There's a choice of pixel clocks (each with a 5x shift clock), selected at
+ * run time:  the ECP5 PLL dividers can't be changed dynamically, so two
+ * PLLs generate them from the VIDC clock, and the ECP5's two DCSC dynamic
+ * clock selects switch between them, one for the pixel clock and one for
+ * the shift clock.  Both take the same select, so once switched the pair
+ * always comes from one PLL and keeps a fixed phase for the serialiser
+ * (which resyncs after a switch anyway, as the output does).  Selections:
+ * 1: PIXEL_CLK1_RATE (48MHz), 2 (or 3): PIXEL_CLK2_RATE (78MHz); 0 gives 1.
+ * 24MHz (0) is only the SIM build's pixel clock, VIDC's own:  it's below
+ * DVI's minimum anyway, and a third choice would need more DCSCs than the
+ * ECP5 has.  The switched clocks are constrained in the LPF.
+ *
  * Copyright 2021 Matt Evans
  *
  * Permission is hereby granted, free of charge, to any person
@@ -25,27 +37,29 @@
  * SOFTWARE.
  */
 
-module clocks(input wire  sys_clk_in,
-              input wire  vidc_clk_in,
-              output wire pixel_clk,
-              output wire shift_clk,
-              output wire sys_clk
+module clocks(input wire        sys_clk_in,
+              input wire        vidc_clk_in,
+              input wire [1:0]  pixel_clk_sel,   // Any domain
+              output wire [2:0] pixel_clk_avail, // Selections that work
+              output wire       pixel_clk,
+              output wire       shift_clk,
+              output wire       sys_clk
               );
 
    parameter VIDC_CLK_IN_RATE = 0;
    parameter SYS_CLK_IN_RATE = 0;
 
-   parameter PIXEL_CLK_RATE = 0;
-   parameter SHIFT_CLK_RATE = 0;
+   parameter PIXEL_CLK1_RATE = 0;
+   parameter PIXEL_CLK2_RATE = 0;
    parameter SYS_CLK_RATE = 0;
 
    wire [3:0]   clocksS;
    wire       	clk_lockedS;
-   wire [3:0]   clocksP;
+   wire [3:0]   clocksP;        // Pixel, shift
    wire       	clk_lockedP;
+   wire [3:0]   clocksH;        // Hires pixel, shift
+   wire       	clk_lockedH;
    assign       sys_clk = clocksS[0];
-   assign       pixel_clk = clocksP[0];
-   assign       shift_clk = clocksP[1];
 
 `ifndef SIM
 
@@ -67,8 +81,8 @@ module clocks(input wire  sys_clk_in,
    ecp5pll
      #(
        .in_hz(VIDC_CLK_IN_RATE),
-       .out0_hz(PIXEL_CLK_RATE),
-       .out1_hz(SHIFT_CLK_RATE)
+       .out0_hz(PIXEL_CLK1_RATE),
+       .out1_hz(PIXEL_CLK1_RATE*5)
        )
    ecp5pll_pix
      (
@@ -77,6 +91,21 @@ module clocks(input wire  sys_clk_in,
       .locked(clk_lockedP)
       );
 
+   ecp5pll
+     #(
+       .in_hz(VIDC_CLK_IN_RATE),
+       .out0_hz(PIXEL_CLK2_RATE),
+       .out1_hz(PIXEL_CLK2_RATE*5)
+       )
+   ecp5pll_pixhi
+     (
+      .clk_i(vidc_clk_in),
+      .clk_o(clocksH),
+      .locked(clk_lockedH)
+      );
+
+   assign pixel_clk_avail = 3'b110;
+
  `else
 
    /* Instantiate the PLLs manually, with (in theory) the same parameters as above,
@@ -213,12 +242,36 @@ module clocks(input wire  sys_clk_in,
     .LOCK(clk_lockedS)
   );
 
+   // Only the one pixel clock (see above), as selection 1:
+   assign clocksH = 4'h0;
+   assign pixel_clk_avail = 3'b010;
+
  `endif
 
+   /* Pixel clock selection.  The DCSCs are glitchless in "POS" mode with
+    * MODESEL=0, switching on the clocks' own edges, so the select can come
+    * from any domain.  SEL = 01 gives CLK0, 10 gives CLK1.
+    */
+   wire         sel_hi = pixel_clk_sel[1];
+
+   DCSC #(.DCSCMODE("POS"))
+   DCSC_PIX(.CLK0(clocksP[0]), .CLK1(clocksH[0]),
+            .SEL1(sel_hi), .SEL0(!sel_hi), .MODESEL(1'b0),
+            .DCSOUT(pixel_clk));
+
+   DCSC #(.DCSCMODE("POS"))
+   DCSC_SHIFT(.CLK0(clocksP[1]), .CLK1(clocksH[1]),
+              .SEL1(sel_hi), .SEL0(!sel_hi), .MODESEL(1'b0),
+              .DCSOUT(shift_clk));
+
 `else // !`ifndef SIM
+   /* The testbench drives the pixel clock at the VIDC rate, so there's no
+    * choice:
+    */
    assign clocksS[0] = sys_clk_in;
-   assign clocksP[0] = vidc_clk_in;
-   assign clocksP[1] = vidc_clk_in; // FIXME
+   assign pixel_clk = vidc_clk_in;
+   assign shift_clk = vidc_clk_in; // FIXME
+   assign pixel_clk_avail = 3'b001;
 `endif // !`ifndef SIM
 
 endmodule // clocks
@@ -0,0 +1,326 @@
+/* ArcDVI: SDRAM frame store
+ *
+ * Without a frame store, the output scan runs one line behind VIDC and so
+ * must exactly match its vertical timing (which some monitors won't accept,
+ * e.g. 50Hz TV modes).  With it, the VIDC DMA stream is written to whole
+ * frames in SDRAM, and the output timing generator free-runs at its own
+ * (e.g. 60Hz) rate, fetching each line from SDRAM into the line buffer just
+ * before it's displayed.
+ *
+ * Three frame buffers are used, so that neither side waits for the other
+ * and no frame is displayed part-written:
+ * - wbuf is being written from the VIDC DMA
+ * - rbuf is being displayed
+ * - ready_buf is the most recently completed frame (if ready_valid)
+ * At VIDC flyback end, the frame just written becomes ready and writing
+ * moves to the remaining buffer (if the ready frame hadn't been displayed
+ * yet, it's dropped).  At the start of an output frame, the ready frame is
+ * displayed; if there isn't a new one, the previous one is repeated.  So,
+ * a 50Hz input is shown at 60Hz by repeating one frame in six.
+ *
+ * Lines are at a stride of the line buffer size, 2^LB_ADDR_BITS words (the
+ * maximum line length), so that a line's address is just {buffer, line,
+ * word}.  By default that's 2KB, and each buffer is 2MB:
+ * SDRAM block address (16 bytes) = {2'b00, buf[1:0], line[9:0], word[8:2]}.
+ *
+ * Everything here is in the clk domain, apart from the line requests from
+ * the output timing generator (a toggle plus line number, stable from before
+ * the toggle).
+ *
+ * 18 Dec 2021
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module frame_store(input wire          clk,
+                   input wire          reset,
+
+                   /* Config (quasi-static) */
+                   input wire          enable,
+                   input wire [9:0]    wpl_m1,
+
+                   /* VIDC flyback, synchronised to clk */
+                   input wire          flybk,
+
+                   /* VIDC DMA in */
+                   input wire          load_dma,
+                   input wire [31:0]   load_dma_data,
+
+                   /* Line requests from the output (pclk domain) */
+                   input wire          line_req,
+                   input wire [9:0]    line_req_num,
+
+                   /* Line buffer write port, {line[0], word} */
+                   output reg          lb_write,
+                   output reg [10:0]   lb_addr,
+                   output reg [31:0]   lb_data,
+
+                   /* SDRAM controller */
+                   output reg          mem_req_valid,
+                   output reg          mem_req_write,
+                   output reg [20:0]   mem_req_addr,
+                   output reg [127:0]  mem_req_wdata,
+                   output reg [3:0]    mem_req_wmask,
+                   input wire          mem_req_ready,
+                   input wire          mem_rd_valid,
+                   input wire [31:0]   mem_rd_data,
+
+                   /* Status */
+                   output reg [1:0]    wbuf,
+                   output reg [1:0]    rbuf,
+                   output reg [1:0]    ready_buf,
+                   output reg          ready_valid,
+                   output reg [15:0]   in_frames,
+                   output reg [15:0]   out_frames,
+                   output reg [15:0]   dropped,    // Input frames never shown
+                   output reg [15:0]   repeated,   // Output frames shown again
+                   output reg [15:0]   overflows   // Write bursts lost
+                   );
+
+   parameter LB_ADDR_BITS = 9;  // As video_timing, up to 10
+
+   localparam PAD_BITS = 11 - LB_ADDR_BITS;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Input:  VIDC DMA to write bursts
+
+   reg                  last_flybk;
+   wire                 in_start = enable && !flybk && last_flybk;
+
+   reg                  w_started;
+   reg [9:0]            w_wpl_m1;
+   reg [9:0]            w_line;
+   reg [9:0]            w_word;
+   reg [127:0]          wb_data;
+   reg [3:0]            wb_mask;
+
+   /* Completed bursts wait in a small queue for the SDRAM: */
+   reg [20:0]           wq_addr[3:0];
+   reg [127:0]          wq_data[3:0];
+   reg [3:0]            wq_mask[3:0];
+   reg [1:0]            wq_wr;
+   reg [1:0]            wq_rd;
+   reg [2:0]            wq_count;
+   wire                 wq_push;
+   wire                 wq_pop;
+
+   /* A burst is complete at its last word, or at the end of a line: */
+   wire [1:0]           w_slot = w_word[1:0];
+   wire                 w_flush = load_dma && enable && !in_start &&
+                        (w_slot == 2'b11 || w_word == w_wpl_m1);
+   assign               wq_push = w_flush && wq_count != 4;
+
+   reg [127:0]          wb_data_new;    // Wire
+   wire [3:0]           wb_mask_new = wb_mask | (4'h1 << w_slot);
+
+   always @(*) begin
+           wb_data_new  = wb_data;
+           wb_data_new[{w_slot, 5'b00000} +: 32] = load_dma_data;
+   end
+
+   always @(posedge clk) begin
+           last_flybk   <= flybk;
+
+           if (reset || !enable) begin
+                   w_wpl_m1     <= wpl_m1;
+                   w_line       <= 0;
+                   w_word       <= 0;
+                   wb_mask      <= 4'h0;
+           end else if (in_start) begin
+                   // Frame start.  Lines are the same length for a frame:
+                   w_wpl_m1     <= wpl_m1;
+                   w_line       <= 0;
+                   w_word       <= 0;
+                   wb_mask      <= 4'h0;
+           end else if (load_dma) begin
+                   if (w_word == w_wpl_m1) begin
+                           w_word       <= 0;
+                           w_line       <= w_line + 1;
+                   end else begin
+                           w_word       <= w_word + 1;
+                   end
+
+                   wb_data      <= wb_data_new;
+                   wb_mask      <= w_flush ? 4'h0 : wb_mask_new;
+
+                   if (wq_push) begin
+                           wq_addr[wq_wr]       <= {{PAD_BITS{1'b0}}, wbuf, w_line,
+                                                    w_word[LB_ADDR_BITS-1:2]};
+                           wq_data[wq_wr]       <= wb_data_new;
+                           wq_mask[wq_wr]       <= wb_mask_new;
+                           wq_wr                <= wq_wr + 1;
+                   end
+           end
+
+           if (reset || !enable) begin
+                   wq_wr        <= 0;
+                   wq_rd        <= 0;
+                   wq_count     <= 0;
+           end else begin
+                   if (wq_pop)
+                     wq_rd      <= wq_rd + 1;
+                   wq_count     <= wq_count + (wq_push ? 3'd1 : 3'd0) - (wq_pop ? 3'd1 : 3'd0);
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Output:  line requests to read bursts
+
+   reg [2:0]            line_req_ss;
+   wire                 line_req_edge = line_req_ss[2] != line_req_ss[1];
+
+   reg                  r_pending;
+   reg [9:0]            r_pending_line;
+   reg                  r_busy;
+   reg [9:0]            r_line;
+   reg [7:0]            r_block;        // Next to request
+   reg [8:0]            r_blocks_left;  // To request
+   reg [9:0]            r_word;         // Next to receive
+   reg [10:0]           r_words_left;   // To receive
+
+   wire                 r_start = enable && r_pending && !r_busy && !in_start;
+
+   always @(posedge clk) begin
+           line_req_ss  <= {line_req_ss[1:0], line_req};
+           lb_write     <= 0;
+
+           if (reset || !enable) begin
+                   r_pending    <= 0;
+                   r_busy       <= 0;
+           end else begin
+                   /* Only the most recent request matters; if the output has
+                    * moved on, there's no point fetching a stale line.
+                    */
+                   if (line_req_edge) begin
+                           r_pending       <= 1;
+                           r_pending_line  <= line_req_num;
+                   end else if (r_start) begin
+                           r_pending       <= 0;
+                   end
+
+                   if (r_start) begin
+                           r_busy          <= 1;
+                           r_line          <= r_pending_line;
+                           r_block         <= 0;
+                           r_blocks_left   <= {1'b0, wpl_m1[9:2]} + 9'd1;
+                           r_word          <= 0;
+                           r_words_left    <= {1'b0, wpl_m1[9:2], 2'b00} + 11'd4;
+                   end else if (r_busy && mem_rd_valid) begin
+                           lb_write        <= 1;
+                           lb_addr         <= {r_line[0], r_word[LB_ADDR_BITS-1:0]};
+                           lb_data         <= mem_rd_data;
+                           r_word          <= r_word + 1;
+                           r_words_left    <= r_words_left - 1;
+                           if (r_words_left == 1)
+                             r_busy        <= 0;
+                   end
+
+                   if (mem_req_valid && mem_req_ready && !mem_req_write) begin
+                           r_block         <= r_block + 1;
+                           r_blocks_left   <= r_blocks_left - 1;
+                   end
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // SDRAM request arbitration:  reads first, as the output can't wait
+
+   wire                 r_want = r_busy && r_blocks_left != 0;
+   assign               wq_pop = mem_req_valid && mem_req_ready && mem_req_write;
+
+   always @(posedge clk) begin
+           if (reset || !enable) begin
+                   mem_req_valid        <= 0;
+           end else if (mem_req_valid) begin
+                   if (mem_req_ready)
+                     mem_req_valid      <= 0;
+           end else if (r_want && !r_start) begin
+                   mem_req_valid        <= 1;
+                   mem_req_write        <= 0;
+                   mem_req_addr         <= {{PAD_BITS{1'b0}}, rbuf, r_line,
+                                                 r_block[LB_ADDR_BITS-3:0]};
+           end else if (wq_count != 0) begin
+                   mem_req_valid        <= 1;
+                   mem_req_write        <= 1;
+                   mem_req_addr         <= wq_addr[wq_rd];
+                   mem_req_wdata        <= wq_data[wq_rd];
+                   mem_req_wmask        <= wq_mask[wq_rd];
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Triple buffering
+
+   wire                 out_start = r_start && r_pending_line == 0;
+
+   always @(posedge clk) begin
+           if (reset) begin
+                   in_frames    <= 0;
+                   out_frames   <= 0;
+                   dropped      <= 0;
+                   repeated     <= 0;
+                   overflows    <= 0;
+           end
+
+           if (reset || !enable) begin
+                   wbuf         <= 2'd0;
+                   rbuf         <= 2'd1;
+                   ready_buf    <= 2'd2;
+                   ready_valid  <= 0;
+                   w_started    <= 0;
+           end else begin
+                   if (in_start) begin
+                           /* The frame just written becomes ready (unless
+                            * this is the first, which was partial), and
+                            * writing moves to the buffer that's neither
+                            * ready nor being displayed:
+                            */
+                           w_started    <= 1;
+                           if (w_started) begin
+                                   ready_buf    <= wbuf;
+                                   ready_valid  <= 1;
+                                   wbuf         <= 2'd3 - rbuf - wbuf;
+                                   in_frames    <= in_frames + 1;
+                                   if (ready_valid)
+                                     dropped    <= dropped + 1;
+                           end
+                   end else if (out_start) begin
+                           if (ready_valid) begin
+                                   rbuf         <= ready_buf;
+                                   ready_valid  <= 0;
+                           end else begin
+                                   repeated     <= repeated + 1;
+                           end
+                           out_frames   <= out_frames + 1;
+                   end
+
+                   if (w_flush && !wq_push)
+                     overflows  <= overflows + 1;
+           end
+   end
+
+endmodule // frame_store
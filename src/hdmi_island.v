@@ -0,0 +1,529 @@
+/* ArcDVI: HDMI data island encoder
+ *
+ * Sits between the video output and vga2dvid, turning DVI into HDMI by
+ * adding data islands (carrying audio and InfoFrames) to the blanking, and
+ * the preambles and guard bands HDMI requires around video and islands.
+ *
+ * The video is delayed by 10 clocks on its way through, so that the video
+ * preamble (8 clocks) and guard band (2) can be inserted before each line's
+ * active video, as seen on the way in.  vga2dvid encodes the video as for
+ * DVI, but its TMDS symbols are replaced by out_tmds_* when out_island is
+ * set; those are registered to line up with vga2dvid's encoder output.
+ *
+ * One data island is sent on each line (including the vertical blanking),
+ * starting 4 clocks after the end of active video:  an 8 clock preamble, 2
+ * clocks of guard band, 1-3 packets of 32 clocks, and another 2 of guard
+ * band.  The number of packets is however many fit before the next line's
+ * video preamble, going by the previous line's blanking, so a mode needs at
+ * least 62 clocks of horizontal blanking to carry audio.  Each packet is:
+ * - An audio sample packet, carrying up to 4 stereo samples (2 channel
+ *   layout, 16 bits), when there are any to send; or
+ * - An Audio Clock Regeneration packet, after each measurement of the CTS
+ *   (see below); or
+ * - An AVI InfoFrame (RGB, no VIC) or audio InfoFrame (2 channel, refer to
+ *   stream header), each once per field; or
+ * - A null packet.
+ * Audio samples have priority unless there are control packets waiting and
+ * fewer than 3 samples.  At 1 packet per line, that's enough for 48kHz at
+ * any line rate over 16kHz (and vertical blanking gives slack).
+ *
+ * Audio arrives from the sound module (clk domain) via a FIFO; samples are
+ * sent within a line or two of arriving.  For ACR, N is fixed at 6144
+ * (48kHz), and CTS (pixel clocks per N/128 audio samples) is measured by
+ * counting pixel clocks between toggles of aud_acr_toggle, which the sound
+ * module toggles every 48 samples.  The sink regenerates the audio clock
+ * from those, so the audio/video latency stays constant.
+ *
+ * Nothing is added unless aud_hdmi_enable is set:  the output is then
+ * DVI, as before (just delayed).
+ *
+ * 15 Jan 2022
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module hdmi_island(input wire        pclk,
+
+                   /* Video in, from video_timing: */
+                   input wire [7:0]  in_r,
+                   input wire [7:0]  in_g,
+                   input wire [7:0]  in_b,
+                   input wire        in_hsync,
+                   input wire        in_vsync,
+                   input wire        in_blank,
+
+                   /* Video out, delayed, to vga2dvid: */
+                   output wire [7:0] out_r,
+                   output wire [7:0] out_g,
+                   output wire [7:0] out_b,
+                   output wire       out_hsync,
+                   output wire       out_vsync,
+                   output wire       out_blank,
+                   /* Replacement TMDS symbols (blue is channel 0): */
+                   output reg        out_island,
+                   output reg [9:0]  out_tmds_r,
+                   output reg [9:0]  out_tmds_g,
+                   output reg [9:0]  out_tmds_b,
+
+                   /* Audio, from the sound module: */
+                   input wire        aud_clk,
+                   input wire        aud_write,
+                   input wire [31:0] aud_data,       // {right, left}
+                   input wire        aud_acr_toggle,
+                   input wire        aud_hdmi_enable
+                   );
+
+   localparam D = 10;           // Video delay, preamble + guard band
+   localparam [19:0] ACR_N = 20'd6144;
+
+   localparam [9:0] GUARD_VIDEO_0 = 10'b1011001100;
+   localparam [9:0] GUARD_VIDEO_1 = 10'b0100110011;
+   localparam [9:0] GUARD_VIDEO_2 = 10'b1011001100;
+   localparam [9:0] GUARD_DATA    = 10'b0100110011;   // Channels 1 & 2
+
+   function [9:0] ctl;
+           input [1:0]  c;
+           begin
+                   case (c)
+                     2'b00:     ctl = 10'b1101010100;
+                     2'b01:     ctl = 10'b0010101011;
+                     2'b10:     ctl = 10'b0101010100;
+                     default:   ctl = 10'b1010101011;
+                   endcase
+           end
+   endfunction
+
+   function [9:0] terc4;
+           input [3:0]  d;
+           begin
+                   case (d)
+                     4'h0:      terc4 = 10'b1010011100;
+                     4'h1:      terc4 = 10'b1001100011;
+                     4'h2:      terc4 = 10'b1011100100;
+                     4'h3:      terc4 = 10'b1011100010;
+                     4'h4:      terc4 = 10'b0101110001;
+                     4'h5:      terc4 = 10'b0100011110;
+                     4'h6:      terc4 = 10'b0110001110;
+                     4'h7:      terc4 = 10'b0100111100;
+                     4'h8:      terc4 = 10'b1011001100;
+                     4'h9:      terc4 = 10'b0100111001;
+                     4'ha:      terc4 = 10'b0110011100;
+                     4'hb:      terc4 = 10'b1011000110;
+                     4'hc:      terc4 = 10'b1010001110;
+                     4'hd:      terc4 = 10'b1001110001;
+                     4'he:      terc4 = 10'b0101100011;
+                     default:   terc4 = 10'b1011000011;
+                   endcase
+           end
+   endfunction
+
+   /* BCH ECC (G(x) = 1 + x^6 + x^7 + x^8), one bit at a time, LSB first: */
+   function [7:0] ecc_next;
+           input [7:0]  ecc;
+           input        b;
+           begin
+                   ecc_next = (ecc >> 1) ^ ((ecc[0] ^ b) ? 8'b10000011 : 8'h00);
+           end
+   endfunction
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Video delay, and sync/enable inputs
+
+   reg [(27*D)-1:0]     dly;
+   reg                  in_blank_last;
+   reg                  out_blank_last;
+   reg                  out_vsync_last;
+   reg [1:0]            s_enable;
+   reg [2:0]            s_acr;
+
+   wire                 enable = s_enable[1];
+
+   assign {out_blank, out_vsync, out_hsync, out_b, out_g, out_r} = dly[(27*D)-1:27*(D-1)];
+
+   always @(posedge pclk) begin
+           dly            <= {dly[(27*(D-1))-1:0],
+                              in_blank, in_vsync, in_hsync, in_b, in_g, in_r};
+           in_blank_last  <= in_blank;
+           out_blank_last <= out_blank;
+           out_vsync_last <= out_vsync;
+           s_enable       <= {s_enable[0], aud_hdmi_enable};
+           s_acr          <= {s_acr[1:0], aud_acr_toggle};
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Video preamble & guard band, before each line's video
+
+   /* Active video will start D clocks after it's seen on the way in: */
+   wire                 video_coming = !in_blank && in_blank_last;
+   reg [3:0]            vp_ctr;
+   wire [3:0]           vp_k = video_coming ? 4'h0 : vp_ctr;
+   wire                 vp_active = (video_coming || vp_ctr != 0) && out_blank;
+
+   always @(posedge pclk) begin
+           if (video_coming)
+             vp_ctr <= 1;
+           else if (vp_ctr == D-1)
+             vp_ctr <= 0;
+           else if (vp_ctr != 0)
+             vp_ctr <= vp_ctr + 1;
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Output line timing
+   //
+   // line_pos counts from the end of active video, wrapping each line so that
+   // it carries on through the vertical blanking.  The line's active and
+   // blanking lengths are measured on the way past; a gap in active video
+   // longer than a line is the vertical blanking, and not counted.
+
+   wire                 out_end   = out_blank && !out_blank_last;
+   wire                 out_start = !out_blank && out_blank_last;
+
+   reg [11:0]           act_ctr;
+   reg [11:0]           blank_ctr;
+   reg [11:0]           active_len;
+   reg [11:0]           blank_len;
+   reg [11:0]           line_pos;
+
+   wire [11:0]          h_total = active_len + blank_len;
+   wire [11:0]          pos = out_end ? 12'h0 : line_pos;
+   wire [1:0]           max_packets = (blank_len >= 126) ? 2'd3 :
+                        (blank_len >= 94) ? 2'd2 :
+                        (blank_len >= 62) ? 2'd1 : 2'd0;
+
+   always @(posedge pclk) begin
+           if (out_start)
+             act_ctr   <= 1;
+           else if (!out_blank)
+             act_ctr   <= act_ctr + 1;
+
+           if (out_end)
+             active_len <= act_ctr;
+
+           if (out_end)
+             blank_ctr <= 1;
+           else if (out_blank && blank_ctr != 12'hfff)
+             blank_ctr <= blank_ctr + 1;
+
+           if (out_start && blank_ctr <= active_len)
+             blank_len <= blank_ctr;
+
+           line_pos <= (pos + 1 == h_total) ? 12'h0 : pos + 1;
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Audio input, and ACR measurement
+
+   wire                 aud_empty;
+   wire [31:0]          aud_rdata;
+   wire                 aud_pop;
+
+   async_fifo #(.WIDTH(32), .DEPTH_BITS(4))
+              AFIFO(.wclk(aud_clk),
+                    .write(aud_write),
+                    .wdata(aud_data),
+                    .full(),
+                    .wlevel(),
+
+                    .rclk(pclk),
+                    .rce(1'b1),
+                    .read(aud_pop),
+                    .rdata(aud_rdata),
+                    .empty(aud_empty)
+                    );
+
+   /* Samples for the next audio packet, sample k in [32k+31:32k]: */
+   reg [127:0]          st;
+   reg [2:0]            st_count;
+   reg [7:0]            iec_frame;      // IEC 60958 frame number, 0-191
+
+   reg [19:0]           cts_ctr;
+   reg [19:0]           cts;
+   reg                  acr_pending;
+   reg                  avi_pending;
+   reg                  aif_pending;
+
+   wire                 acr_tick = s_acr[2] ^ s_acr[1];
+   wire                 field_start = out_vsync ^ out_vsync_last;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Data islands
+
+   reg [2:0]            isl_state;
+   reg [4:0]            isl_ctr;
+   reg [1:0]            pkts_left;
+
+   /* There's no reset in this domain: */
+   initial begin
+           s_enable    = 2'b00;
+           vp_ctr      = 0;
+           active_len  = 0;
+           blank_len   = 0;
+           line_pos    = 0;
+           isl_state   = 0;
+           isl_ctr     = 0;
+           st_count    = 0;
+           iec_frame   = 0;
+           cts_ctr     = 0;
+           cts         = 0;
+           acr_pending = 0;
+           avi_pending = 0;
+           aif_pending = 0;
+   end
+
+   localparam ISL_IDLE   = 3'h0;
+   localparam ISL_PRE    = 3'h1;
+   localparam ISL_GUARD1 = 3'h2;
+   localparam ISL_PACKET = 3'h3;
+   localparam ISL_GUARD2 = 3'h4;
+
+   wire                 isl_start = (isl_state == ISL_IDLE) && enable && out_blank &&
+                        (pos == 3) && (max_packets != 0);
+   wire                 load = ((isl_state == ISL_GUARD1) && (isl_ctr == 1)) ||
+                        ((isl_state == ISL_PACKET) && (isl_ctr == 31) && (pkts_left != 0));
+
+   /* Choice of packet to load: */
+   wire                 want_ctrl = acr_pending || avi_pending || aif_pending;
+   wire                 sel_audio = (st_count != 0) && (st_count >= 3 || !want_ctrl);
+   wire                 sel_acr = !sel_audio && acr_pending;
+   wire                 sel_avi = !sel_audio && !acr_pending && avi_pending;
+   wire                 sel_aif = !sel_audio && !acr_pending && !avi_pending && aif_pending;
+   wire                 load_audio = load && sel_audio;
+
+   assign aud_pop = !aud_empty && (!enable || (st_count != 4 && !load_audio));
+
+   /* Audio subpackets:  sample k is {R, L} as 24-bit, then SB6 holding the
+    * parity, channel status, user and valid bits for each side.  The channel
+    * status block marks consumer PCM, 48kHz (bit 25), 16-bit (bit 33).
+    */
+   reg [55:0]           asp[3:0];
+   reg [3:0]            asp_block;      // B:  sample starts an IEC block
+   reg [7:0]            k_frame;
+   reg                  c_bit;
+   reg [31:0]           sample;
+   integer              k;
+   integer              i;
+
+   always @(*) begin
+           for (k = 0; k < 4; k = k + 1) begin
+                   k_frame      = iec_frame + k;
+                   if (k_frame >= 192)
+                     k_frame    = k_frame - 192;
+                   c_bit        = (k_frame == 25) || (k_frame == 33);
+                   asp_block[k] = (k < st_count) && (k_frame == 0);
+                   sample       = st[(32*k) +: 32];
+                   asp[k]       = {(^sample[31:16]) ^ c_bit, c_bit, 2'b00,
+                                   (^sample[15:0]) ^ c_bit, c_bit, 2'b00,
+                                   sample[31:16], 8'h00,
+                                   sample[15:0], 8'h00};
+           end
+   end
+
+   wire [3:0]           asp_present = (st_count == 1) ? 4'b0001 :
+                        (st_count == 2) ? 4'b0011 :
+                        (st_count == 3) ? 4'b0111 : 4'b1111;
+
+   /* The packet being sent, shifted out LSB first: */
+   reg [23:0]           hdr;
+   reg [7:0]            hdr_ecc;
+   reg [55:0]           sp[3:0];
+   reg [7:0]            sp_ecc[3:0];
+
+   always @(posedge pclk) begin
+           case (isl_state)
+             ISL_IDLE: begin
+                     if (isl_start) begin
+                             isl_state <= ISL_PRE;
+                             isl_ctr   <= 0;
+                             pkts_left <= max_packets - 1;
+                     end
+             end
+
+             ISL_PRE: begin
+                     isl_ctr <= isl_ctr + 1;
+                     if (isl_ctr == 7) begin
+                             isl_state <= ISL_GUARD1;
+                             isl_ctr   <= 0;
+                     end
+             end
+
+             ISL_GUARD1: begin
+                     isl_ctr <= isl_ctr + 1;
+                     if (isl_ctr == 1) begin
+                             isl_state <= ISL_PACKET;
+                             isl_ctr   <= 0;
+                     end
+             end
+
+             ISL_PACKET: begin
+                     isl_ctr <= isl_ctr + 1;
+                     if (isl_ctr == 31) begin
+                             if (pkts_left != 0)
+                               pkts_left <= pkts_left - 1;
+                             else
+                               isl_state <= ISL_GUARD2;
+                     end
+             end
+
+             default: begin // ISL_GUARD2
+                     isl_ctr <= isl_ctr + 1;
+                     if (isl_ctr == 1)
+                       isl_state <= ISL_IDLE;
+             end
+           endcase
+
+           /* Shift out the packet (ECC bits follow the data, which is
+            * equivalent to carrying on feeding the ECC its own output):
+            */
+           if (isl_state == ISL_PACKET) begin
+                   hdr     <= hdr >> 1;
+                   hdr_ecc <= ecc_next(hdr_ecc, (isl_ctr < 24) ? hdr[0] : hdr_ecc[0]);
+                   for (i = 0; i < 4; i = i + 1) begin
+                           sp[i]     <= sp[i] >> 2;
+                           sp_ecc[i] <= (isl_ctr < 28) ?
+                                        ecc_next(ecc_next(sp_ecc[i], sp[i][0]), sp[i][1]) :
+                                        sp_ecc[i] >> 2;
+                   end
+           end
+
+           if (load) begin
+                   hdr_ecc <= 8'h00;
+                   for (i = 0; i < 4; i = i + 1)
+                     sp_ecc[i] <= 8'h00;
+
+                   if (sel_audio) begin
+                           hdr <= {asp_block, 4'h0, 4'h0, asp_present, 8'h02};
+                           for (i = 0; i < 4; i = i + 1)
+                             sp[i] <= asp[i];
+                   end else if (sel_acr) begin
+                           hdr <= {8'h00, 8'h00, 8'h01};
+                           for (i = 0; i < 4; i = i + 1)
+                             sp[i] <= {ACR_N[7:0], ACR_N[15:8], 4'h0, ACR_N[19:16],
+                                       cts[7:0], cts[15:8], 4'h0, cts[19:16], 8'h00};
+                   end else if (sel_avi) begin
+                           /* PB0 checksum, PB2 R=same as picture: */
+                           hdr   <= {8'h0d, 8'h02, 8'h82};
+                           sp[0] <= {8'h00, 8'h00, 8'h00, 8'h00, 8'h08, 8'h00, 8'h67};
+                           sp[1] <= 56'h0;
+                           sp[2] <= 56'h0;
+                           sp[3] <= 56'h0;
+                   end else if (sel_aif) begin
+                           /* PB0 checksum, PB1 CC=2 channels: */
+                           hdr   <= {8'h0a, 8'h01, 8'h84};
+                           sp[0] <= {8'h00, 8'h00, 8'h00, 8'h00, 8'h00, 8'h01, 8'h70};
+                           sp[1] <= 56'h0;
+                           sp[2] <= 56'h0;
+                           sp[3] <= 56'h0;
+                   end else begin
+                           hdr <= 24'h0;
+                           for (i = 0; i < 4; i = i + 1)
+                             sp[i] <= 56'h0;
+                   end
+           end
+   end
+
+   /* Audio samples and pending control packets: */
+   always @(posedge pclk) begin
+           if (!enable) begin
+                   st_count <= 0;
+           end else if (load_audio) begin
+                   st_count  <= 0;
+                   iec_frame <= (iec_frame + st_count >= 192) ?
+                                iec_frame + st_count - 192 : iec_frame + st_count;
+           end else if (aud_pop) begin
+                   st[(32*st_count[1:0]) +: 32] <= aud_rdata;
+                   st_count          <= st_count + 1;
+           end
+
+           if (acr_tick) begin
+                   cts     <= cts_ctr;
+                   cts_ctr <= 1;
+           end else begin
+                   cts_ctr <= cts_ctr + 1;
+           end
+
+           if (acr_tick && enable)
+             acr_pending <= 1;
+           else if (load && sel_acr)
+             acr_pending <= 0;
+
+           if (field_start && enable) begin
+                   avi_pending <= 1;
+                   aif_pending <= 1;
+           end else begin
+                   if (load && sel_avi)
+                     avi_pending <= 0;
+                   if (load && sel_aif)
+                     aif_pending <= 0;
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Output symbols
+
+   wire [1:0]           syncs = {out_vsync, out_hsync};
+   wire                 hdr_bit = (isl_ctr < 24) ? hdr[0] : hdr_ecc[0];
+   wire [3:0]           sp_bit0;
+   wire [3:0]           sp_bit1;
+
+   genvar               j;
+   generate for (j = 0; j < 4; j = j + 1) begin: g_spbits
+           assign sp_bit0[j] = (isl_ctr < 28) ? sp[j][0] : sp_ecc[j][0];
+           assign sp_bit1[j] = (isl_ctr < 28) ? sp[j][1] : sp_ecc[j][1];
+   end endgenerate
+
+   always @(posedge pclk) begin
+           out_island <= enable && out_blank && (vp_active || isl_state != ISL_IDLE);
+
+           if (vp_active) begin
+                   if (vp_k < 8) begin
+                           out_tmds_b <= ctl(syncs);
+                           out_tmds_g <= ctl(2'b01);
+                           out_tmds_r <= ctl(2'b00);
+                   end else begin
+                           out_tmds_b <= GUARD_VIDEO_0;
+                           out_tmds_g <= GUARD_VIDEO_1;
+                           out_tmds_r <= GUARD_VIDEO_2;
+                   end
+           end else if (isl_state == ISL_PRE) begin
+                   out_tmds_b <= ctl(syncs);
+                   out_tmds_g <= ctl(2'b01);
+                   out_tmds_r <= ctl(2'b01);
+           end else if (isl_state == ISL_PACKET) begin
+                   out_tmds_b <= terc4({isl_ctr != 0, hdr_bit, syncs});
+                   out_tmds_g <= terc4(sp_bit0);
+                   out_tmds_r <= terc4(sp_bit1);
+           end else begin // Guard bands
+                   out_tmds_b <= terc4({2'b11, syncs});
+                   out_tmds_g <= GUARD_DATA;
+                   out_tmds_r <= GUARD_DATA;
+           end
+   end
+
+endmodule // hdmi_island
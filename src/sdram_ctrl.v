@@ -0,0 +1,284 @@
+/* ArcDVI: SDRAM controller
+ *
+ * A simple controller for the ULX3S's 16-bit SDR SDRAM (32MB, 4 banks of
+ * 8192 rows of 512 columns, e.g. IS42S16160), clocked from the system clock.
+ *
+ * Accesses are whole bursts of 8 halfwords, i.e. 4 words or 16 bytes (the
+ * same as a VIDC DMA burst).  Each access opens a row and closes it again
+ * with auto-precharge; there's no attempt to keep rows open, because the
+ * frame store's reads and writes are to different buffers anyway.  Writes
+ * can mask out individual words.
+ *
+ * The SDRAM is clocked by the inverse of clk, so commands/data set up on a
+ * rising clk edge are sampled half a cycle later.  Read data is driven by
+ * the SDRAM from (CL-1) SDRAM clocks after the READ, so is sampled on the
+ * clk edge CL cycles after the READ was set up.
+ *
+ * 18 Dec 2021
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module sdram_ctrl(input wire          clk,
+                  input wire          reset,
+
+                  /* Request interface: */
+                  input wire          req_valid,
+                  input wire          req_write,
+                  input wire [20:0]   req_addr,   // 16-byte block address
+                  input wire [127:0]  req_wdata,  // Word 0 in [31:0]
+                  input wire [3:0]    req_wmask,  // 1 = write this word
+                  output reg          req_ready,  // Pulses as a request is taken
+                  output reg          rd_valid,   // 4 pulses per read, in order
+                  output reg [31:0]   rd_data,
+                  output reg          init_done,
+
+                  /* SDRAM pins: */
+                  output wire         sdram_clk,
+                  output reg          sdram_cke,
+                  output reg          sdram_csn,
+                  output reg          sdram_rasn,
+                  output reg          sdram_casn,
+                  output reg          sdram_wen,
+                  output reg [12:0]   sdram_a,
+                  output reg [1:0]    sdram_ba,
+                  output reg [1:0]    sdram_dqm,
+                  output reg [15:0]   dq_out,
+                  output reg          dq_oe,
+                  input wire [15:0]   dq_in
+                  );
+
+   parameter CLK_RATE = 50000000;
+   parameter CAS_LATENCY = 2;
+
+   /* Timing, in cycles, good up to about 100MHz: */
+   localparam T_RP   = 2;       // Precharge
+   localparam T_RCD  = 2;       // Activate to read/write
+   localparam T_RFC  = 7;       // Refresh to activate
+   localparam T_MRD  = 2;       // Mode register set
+   localparam T_DAL  = 4;       // Last write data to activate (tWR + tRP)
+
+   localparam INIT_CYCLES    = (CLK_RATE/1000000)*200;   // 200us
+   // 8192 refreshes per 64ms, so one per 7.8us.  Go a bit early:
+   localparam REFRESH_CYCLES = (CLK_RATE/1000000)*15/2;
+
+   // {csn, rasn, casn, wen}:
+   localparam CMD_NOP   = 4'b0111;
+   localparam CMD_ACT   = 4'b0011;
+   localparam CMD_READ  = 4'b0101;
+   localparam CMD_WRITE = 4'b0100;
+   localparam CMD_PRE   = 4'b0010;
+   localparam CMD_REF   = 4'b0001;
+   localparam CMD_MRS   = 4'b0000;
+
+   // Burst length 8, sequential, CL as configured, burst writes:
+   localparam [12:0] MODE_REG = {3'b000, 1'b0, 2'b00,
+                                 (CAS_LATENCY == 3) ? 3'd3 : 3'd2,
+                                 1'b0, 3'b011};
+
+   localparam S_INIT_WAIT = 4'h0;
+   localparam S_INIT_REF  = 4'h2;
+   localparam S_INIT_MRS  = 4'h3;
+   localparam S_IDLE      = 4'h4;
+   localparam S_RW        = 4'h5;
+   localparam S_WRITE     = 4'h6;
+   localparam S_READ      = 4'h7;
+   localparam S_WAIT      = 4'h8;
+
+   assign sdram_clk = ~clk;
+
+   reg [3:0]            state;
+   reg [13:0]           wait_ctr;       // Generic delay, then go to next_state
+   reg [3:0]            next_state;
+   reg [1:0]            init_refs;
+   reg [9:0]            refresh_ctr;
+   reg                  refresh_due;
+
+   reg                  op_write;
+   reg [20:0]           op_addr;
+   reg [127:0]          op_wdata;
+   reg [3:0]            op_wmask;
+   reg [3:0]            beat;           // Also counts the read latency
+   reg [15:0]           dq_in_r;
+   reg [15:0]           rd_low;
+
+   wire [8:0]           op_col = {op_addr[5:0], 3'b000};
+
+   // The command pins are registered, as is the read data:
+   always @(posedge clk) begin
+           dq_in_r <= dq_in;
+   end
+
+   /* Refresh timer: */
+   always @(posedge clk) begin
+           if (reset) begin
+                   refresh_ctr  <= REFRESH_CYCLES;
+                   refresh_due  <= 0;
+           end else begin
+                   if (refresh_ctr == 0) begin
+                           refresh_ctr  <= REFRESH_CYCLES;
+                           refresh_due  <= 1;
+                   end else begin
+                           refresh_ctr  <= refresh_ctr - 1;
+                           if (state == S_IDLE && refresh_due)
+                             refresh_due <= 0; // Taken, below
+                   end
+           end
+   end
+
+   always @(posedge clk) begin
+           // Defaults, overridden below:
+           {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_NOP;
+           sdram_dqm    <= 2'b00;
+           dq_oe        <= 0;
+           req_ready    <= 0;
+           rd_valid     <= 0;
+
+           if (reset) begin
+                   state        <= S_INIT_WAIT;
+                   wait_ctr     <= INIT_CYCLES;
+                   sdram_cke    <= 1;
+                   init_done    <= 0;
+                   init_refs    <= 0;
+           end else begin
+                   case (state)
+                     S_INIT_WAIT: begin
+                             // Power-up delay with NOPs, then precharge all:
+                             if (wait_ctr != 0) begin
+                                     wait_ctr   <= wait_ctr - 1;
+                             end else begin
+                                     {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_PRE;
+                                     sdram_a    <= 13'h0400; // A10: all banks
+                                     wait_ctr   <= T_RP;
+                                     state      <= S_WAIT;
+                                     next_state <= S_INIT_REF;
+                             end
+                     end
+
+                     S_INIT_REF: begin
+                             {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_REF;
+                             init_refs  <= init_refs + 1;
+                             wait_ctr   <= T_RFC;
+                             state      <= S_WAIT;
+                             next_state <= (init_refs == 1) ? S_INIT_MRS : S_INIT_REF;
+                     end
+
+                     S_INIT_MRS: begin
+                             {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_MRS;
+                             sdram_a    <= MODE_REG;
+                             sdram_ba   <= 2'b00;
+                             wait_ctr   <= T_MRD;
+                             state      <= S_WAIT;
+                             next_state <= S_IDLE;
+                     end
+
+                     S_IDLE: begin
+                             init_done  <= 1;
+
+                             if (refresh_due) begin
+                                     {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_REF;
+                                     wait_ctr   <= T_RFC;
+                                     state      <= S_WAIT;
+                                     next_state <= S_IDLE;
+                             end else if (req_valid) begin
+                                     {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_ACT;
+                                     sdram_a    <= req_addr[20:8];      // Row
+                                     sdram_ba   <= req_addr[7:6];
+                                     req_ready  <= 1;
+                                     op_write   <= req_write;
+                                     op_addr    <= req_addr;
+                                     op_wdata   <= req_wdata;
+                                     op_wmask   <= req_wmask;
+                                     wait_ctr   <= T_RCD - 1;
+                                     state      <= S_WAIT;
+                                     next_state <= S_RW;
+                             end
+                     end
+
+                     S_RW: begin
+                             // Column access, with auto-precharge (A10):
+                             sdram_a    <= {2'b00, 1'b1, 1'b0, op_col};
+                             beat       <= 0;
+                             if (op_write) begin
+                                     {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_WRITE;
+                                     dq_out     <= op_wdata[15:0];
+                                     dq_oe      <= 1;
+                                     sdram_dqm  <= {2{~op_wmask[0]}};
+                                     op_wdata   <= {16'h0, op_wdata[127:16]};
+                                     beat       <= 1;
+                                     state      <= S_WRITE;
+                             end else begin
+                                     {sdram_csn, sdram_rasn, sdram_casn, sdram_wen} <= CMD_READ;
+                                     state      <= S_READ;
+                             end
+                     end
+
+                     S_WRITE: begin
+                             // Beats 1-7:
+                             dq_out     <= op_wdata[15:0];
+                             dq_oe      <= 1;
+                             sdram_dqm  <= {2{~op_wmask[beat[2:1]]}};
+                             op_wdata   <= {16'h0, op_wdata[127:16]};
+                             beat       <= beat + 1;
+                             if (beat == 7) begin
+                                     wait_ctr   <= T_DAL;
+                                     state      <= S_WAIT;
+                                     next_state <= S_IDLE;
+                             end
+                     end
+
+                     S_READ: begin
+                             /* beat counts cycles since the READ; beat i of
+                              * the burst is in dq_in_r when beat == CL+i:
+                              */
+                             beat       <= beat + 1;
+                             if (beat >= CAS_LATENCY) begin
+                                     if (((beat - CAS_LATENCY) & 1) == 0) begin
+                                             rd_low     <= dq_in_r;
+                                     end else begin
+                                             rd_data    <= {dq_in_r, rd_low};
+                                             rd_valid   <= 1;
+                                     end
+                                     if (beat == CAS_LATENCY + 7) begin
+                                             // Auto-precharge started at the last beat
+                                             wait_ctr   <= T_RP;
+                                             state      <= S_WAIT;
+                                             next_state <= S_IDLE;
+                                     end
+                             end
+                     end
+
+                     S_WAIT: begin
+                             if (wait_ctr != 0)
+                               wait_ctr <= wait_ctr - 1;
+                             else
+                               state    <= next_state;
+                     end
+
+                     default:
+                       state <= S_IDLE;
+                   endcase
+           end
+   end
+
+endmodule // sdram_ctrl
@@ -35,6 +35,17 @@ module soc_top(input wire        clk_25mhz,
                output wire [3:0] gpdi_dp,
                input wire        ser_rx,
                output wire       ser_tx,
+               /* Register access from an external MCU, see spi_slave.v: */
+               input wire        spi_sclk,
+               input wire        spi_csn,
+               input wire        spi_mosi,
+               output wire       spi_miso,
+               output wire       spi_irq,
+`ifdef FLASH_XIP
+               /* Firmware runs from the config flash, see spiflash_xip.v: */
+               output wire       flash_csn,
+               inout wire [3:0]  flash_io,
+`endif
                input wire [31:0] vidc_d,
                input wire        vidc_nvidw,
                input wire        vidc_nvcs,
@@ -44,37 +55,77 @@ module soc_top(input wire        clk_25mhz,
                input wire        vidc_flybk,
                input wire        vidc_ckin,
                input wire        vidc_nsndak,
-               input wire        vidc_nvidak
+               input wire        vidc_nvidak,
+
+               output wire        sdram_clk,
+               output wire        sdram_cke,
+               output wire        sdram_csn,
+               output wire        sdram_wen,
+               output wire        sdram_rasn,
+               output wire        sdram_casn,
+               output wire [12:0] sdram_a,
+               output wire [1:0]  sdram_ba,
+               output wire [1:0]  sdram_dqm,
+               inout wire [15:0]  sdram_d
                );
 
    parameter CLK_RATE = 50000000;
    parameter BAUD_RATE = 115200;
 
+   /* A wider output pipeline, running at half the pixel rate, is needed to
+    * meet timing for the fastest pixel clocks:
+    */
+`ifdef PIXELS_PER_CLK
+   localparam VIDEO_PIXELS_PER_CLK = `PIXELS_PER_CLK;
+`else
+   localparam VIDEO_PIXELS_PER_CLK = 1;
+`endif
+
+   /* Line buffer size (and so the longest line), 2^n words: */
+`ifdef LB_ADDR_BITS
+   localparam VIDEO_LB_ADDR_BITS = `LB_ADDR_BITS;
+`else
+   localparam VIDEO_LB_ADDR_BITS = 9;
+`endif
+
+   /* Firmware either in BRAM (loaded with the bitstream), or executed in
+    * place from the SPI flash at FLASH_FW_OFFSET, with only data in BRAM:
+    */
+`ifdef FLASH_XIP
+   localparam CPU_FLASH_XIP = `FLASH_XIP;
+   localparam CPU_PROGADDR = 32'h0100_0000 + `FLASH_FW_OFFSET;
+   localparam CPU_RAM_INIT_FILE = "";
+`else
+   localparam CPU_FLASH_XIP = 0;
+   localparam CPU_PROGADDR = 32'h0;
+   localparam CPU_RAM_INIT_FILE = "firmware/firmware.hex";
+`endif
+
    ////////////////////////////////////////////////////////////////////////////////
    /* Clocks and reset */
 
    wire                          clk, clk_pixel, clk_shift;
 
-   /* Two PLLs: One generates system/CPU clock from crystal input.
-    * The other generates the video output/pixel clock from the VIDC
-    * clock.
+   /* PLLs: One generates system/CPU clock from crystal input.
+    * The others generate the video output/pixel clocks from the VIDC
+    * clock; the pixel clock used is chosen by the firmware per mode (see
+    * video.v), 48MHz or 78MHz.  78MHz (24*3.25) is for hires mode 23, see
+    * video.v.
     */
-
-`ifdef HIRES_MODE
-   localparam pixel_freq = 24000000*3.25;
-`else
-   localparam pixel_freq = 24000000;
-`endif
+   wire [1:0]                    pixel_clk_sel;
+   wire [2:0]                    pixel_clk_avail;
 
    clocks #(.VIDC_CLK_IN_RATE(24000000),
             .SYS_CLK_IN_RATE(25000000),
-            .PIXEL_CLK_RATE(pixel_freq),
-            .SHIFT_CLK_RATE(pixel_freq*5),
+            .PIXEL_CLK1_RATE(48000000),
+            .PIXEL_CLK2_RATE(78000000),
             .SYS_CLK_RATE(CLK_RATE)
             ) CLKS (
                     .sys_clk_in(clk_25mhz),
                     .vidc_clk_in(vidc_ckin),
 
+                    .pixel_clk_sel(pixel_clk_sel),
+                    .pixel_clk_avail(pixel_clk_avail),
                     .pixel_clk(clk_pixel),
                     .shift_clk(clk_shift),
                     .sys_clk(clk)
@@ -96,8 +147,8 @@ module soc_top(input wire        clk_25mhz,
 
    ////////////////////////////////////////////////////////////////////////////////
    /* CPU subsystem:
-    * This can be replaced by an SPI module receiving requests from the outside
-    * world (e.g. run the firmware on an external MCU).
+    * The IO bus (iomem_*) is shared with the SPI slave below, so that an
+    * external MCU can do what the firmware does.
     */
 
    wire                    iomem_valid;
@@ -105,6 +156,19 @@ module soc_top(input wire        clk_25mhz,
    wire [31:0]             iomem_addr;
    wire [31:0]             iomem_wdata;
    wire [31:0]             iomem_rdata;
+   wire                    video_irq;
+
+   wire                    cpu_iomem_valid;
+   wire                    cpu_iomem_ready;
+   wire [3:0]              cpu_iomem_wstrb;
+   wire [31:0]             cpu_iomem_addr;
+   wire [31:0]             cpu_iomem_wdata;
+
+   wire                    cpu_flash_csn;
+   wire                    cpu_flash_clk;
+   wire [3:0]              cpu_flash_io_out;
+   wire [3:0]              cpu_flash_io_oe;
+   wire [3:0]              cpu_flash_io_in;
 
    picosocme	#(
                   .BARREL_SHIFTER(1),
@@ -114,8 +178,10 @@ module soc_top(input wire        clk_25mhz,
                   .ENABLE_IRQ_QREGS(1),
 
                   .MEM_WORDS(`MEM_SIZE/4),
-                  .PROGADDR_RESET(32'h10),
-                  .RAM_INIT_FILE("firmware/firmware.hex"),
+                  .PROGADDR_RESET(CPU_PROGADDR + 32'h10),
+                  .PROGADDR_IRQ(CPU_PROGADDR),
+                  .RAM_INIT_FILE(CPU_RAM_INIT_FILE),
+                  .FLASH_XIP(CPU_FLASH_XIP),
                   .CLK_RATE(CLK_RATE),
                   .BAUD_RATE(BAUD_RATE)
                   )
@@ -123,32 +189,94 @@ module soc_top(input wire        clk_25mhz,
                   (.clk(clk),
                    .resetn(~reset),
 
-                   .iomem_valid(iomem_valid),
-                   .iomem_ready(1'b1),
-                   .iomem_wstrb(iomem_wstrb),
-                   .iomem_addr(iomem_addr),
-                   .iomem_wdata(iomem_wdata),
+                   .iomem_valid(cpu_iomem_valid),
+                   .iomem_ready(cpu_iomem_ready),
+                   .iomem_wstrb(cpu_iomem_wstrb),
+                   .iomem_addr(cpu_iomem_addr),
+                   .iomem_wdata(cpu_iomem_wdata),
                    .iomem_rdata(iomem_rdata),
 
-                   .irq_5(1'b0),
+                   .irq_5(video_irq),
                    .irq_6(1'b0),
                    .irq_7(1'b0),
 
                    .ser_tx(ser_tx),
-                   .ser_rx(ser_rx)
+                   .ser_rx(ser_rx),
+
+                   .flash_csn(cpu_flash_csn),
+                   .flash_clk(cpu_flash_clk),
+                   .flash_io_out(cpu_flash_io_out),
+                   .flash_io_oe(cpu_flash_io_oe),
+                   .flash_io_in(cpu_flash_io_in)
                    );
 
+`ifdef FLASH_XIP
+   assign flash_csn = cpu_flash_csn;
+   assign cpu_flash_io_in = flash_io;
+
+   genvar                  fi;
+   generate for (fi = 0; fi < 4; fi = fi + 1) begin: flash_io_buf
+           assign flash_io[fi] = cpu_flash_io_oe[fi] ? cpu_flash_io_out[fi] : 1'bz;
+   end endgenerate
+
+`ifndef SIM
+   /* The flash clock is the configuration clock pin, which is only
+    * reachable through this primitive:
+    */
+   (* keep *)
+   USRMCLK FLASH_CLK(.USRMCLKI(cpu_flash_clk), .USRMCLKTS(1'b0));
+`endif
+`else
+   assign cpu_flash_io_in = 4'h0;
+`endif
+
+   /* SPI slave, the other IO bus master:  its accesses (single cycles) take
+    * priority, and the CPU's wait.
+    */
+   wire                    spi_bus_valid;
+   wire [3:0]              spi_bus_wstrb;
+   wire [31:0]             spi_bus_addr;
+   wire [31:0]             spi_bus_wdata;
+
+   spi_slave SPI(.clk(clk),
+                 .reset(reset),
+
+                 .spi_sclk(spi_sclk),
+                 .spi_csn(spi_csn),
+                 .spi_mosi(spi_mosi),
+                 .spi_miso(spi_miso),
+
+                 .irq(video_irq),
+
+                 .bus_valid(spi_bus_valid),
+                 .bus_addr(spi_bus_addr),
+                 .bus_wdata(spi_bus_wdata),
+                 .bus_wstrb(spi_bus_wstrb),
+                 .bus_ready(1'b1),
+                 .bus_rdata(iomem_rdata)
+                 );
+
+   assign spi_irq         = video_irq;
+
+   assign iomem_valid     = spi_bus_valid || cpu_iomem_valid;
+   assign iomem_wstrb     = spi_bus_valid ? spi_bus_wstrb : cpu_iomem_wstrb;
+   assign iomem_addr      = spi_bus_valid ? spi_bus_addr : cpu_iomem_addr;
+   assign iomem_wdata     = spi_bus_valid ? spi_bus_wdata : cpu_iomem_wdata;
+   assign cpu_iomem_ready = !spi_bus_valid;
+
 
    /* IO starts at 0x20000000:
     * - VIDC regs at 0x20000000
     * - CG mem at    0x21000000
     * - Video regs   0x22000000
+    * - Sound regs   0x23000000
     *
     * Peripheral select strobes:
     */
    wire                    vidc_reg_select  = iomem_valid && (iomem_addr[27:24] == 4'h0);
    wire                    cgmem_select     = iomem_valid && (iomem_addr[27:24] == 4'h1);
    wire                    video_reg_select = iomem_valid && (iomem_addr[27:24] == 4'h2);
+   wire                    sound_reg_select = iomem_valid && (iomem_addr[27:24] == 4'h3);
 
 
    ////////////////////////////////////////////////////////////////////////////////
@@ -156,21 +284,24 @@ module soc_top(input wire        clk_25mhz,
 
    wire       		conf_hires;	// Configured later, used here
 
-   wire [(12*16)-1:0] 	vidc_palette;
-   wire [(12*3)-1:0] 	vidc_cursor_palette;
-   wire [10:0]        	vidc_cursor_hstart;
-   wire [9:0]         	vidc_cursor_vstart;
-   wire [9:0]         	vidc_cursor_vend;
    wire [(24*64)-1:0]   vidc_regs;
    wire [3:0] 		fr_cnt;
    wire [15:0] 		v_dma_ctr;
    wire [15:0] 		c_dma_ctr;
-   wire                 vidc_special_written;
-   wire [23:0]          vidc_special;
-   wire [23:0]          vidc_special_data;
+   wire [15:0] 		s_dma_ctr;
+   wire                 vw_write;
+   wire [8:0]           vw_idx;
+   wire [31:0]          vw_data;
+   wire [1:0]           vw_frame;
+   wire [9:0]           vw_line;
+   wire [12:0]          vw_cycles;
+   wire [1:0]           vidc_frame;
    wire                 load_dma;
    wire                 load_dma_cursor;
+   wire                 load_dma_sound;
    wire [31:0]          load_dma_data;
+   wire [23:0]          snd_images;
+   wire [7:0]           snd_sfr;
 
    wire [5:0]           vidc_reg_idx = iomem_addr[7:2];
    wire [23:0]          vidc_reg_rdata;
@@ -178,6 +309,10 @@ module soc_top(input wire        clk_25mhz,
 
    wire                 vidc_tregs_status;
    wire                 vidc_tregs_ack;
+   wire [3:0]           vidc_tregs_settle;
+   wire                 vidc_tregs_first_write;
+   wire [15:0]          vidc_tregs_writes;
+   wire [7:0]           vidc_tregs_frames;
 
    vidc_capture	VIDCC(.clk(clk),
                       .reset(reset),
@@ -195,28 +330,35 @@ module soc_top(input wire        clk_25mhz,
 
                       .conf_hires(conf_hires),
 
-                      .vidc_palette(vidc_palette),
-                      .vidc_cursor_palette(vidc_cursor_palette),
-                      .vidc_cursor_hstart(vidc_cursor_hstart),
-                      .vidc_cursor_vstart(vidc_cursor_vstart),
-                      .vidc_cursor_vend(vidc_cursor_vend),
-
                       .vidc_reg_sel(vidc_reg_idx),
                       .vidc_reg_rdata(vidc_reg_rdata),
 
                       .tregs_status(vidc_tregs_status),
                       .tregs_status_ack(vidc_tregs_ack),
+                      .tregs_settle_frames(vidc_tregs_settle),
+                      .tregs_first_write(vidc_tregs_first_write),
+                      .tregs_writes(vidc_tregs_writes),
+                      .tregs_frames(vidc_tregs_frames),
 
                       .fr_count(fr_cnt),
                       .video_dma_counter(v_dma_ctr),
                       .cursor_dma_counter(c_dma_ctr),
+                      .sound_dma_counter(s_dma_ctr),
+
+                      .vw_write(vw_write),
+                      .vw_idx(vw_idx),
+                      .vw_data(vw_data),
+                      .vw_frame(vw_frame),
+                      .vw_line(vw_line),
+                      .vw_cycles(vw_cycles),
+                      .in_frame(vidc_frame),
 
-                      .vidc_special_written(vidc_special_written),
-                      .vidc_special(vidc_special),
-                      .vidc_special_data(vidc_special_data),
+                      .snd_images(snd_images),
+                      .snd_sfr(snd_sfr),
 
                       .load_dma(load_dma),
                       .load_dma_cursor(load_dma_cursor),
+                      .load_dma_sound(load_dma_sound),
                       .load_dma_data(load_dma_data)
                       );
 
@@ -225,6 +367,7 @@ module soc_top(input wire        clk_25mhz,
            case (iomem_addr[8:2])
              7'b1_0000_00:	vidc_rd = {16'h0, v_dma_ctr};
              7'b1_0000_01:	vidc_rd = {16'h0, c_dma_ctr};
+             7'b1_0000_10:	vidc_rd = {16'h0, s_dma_ctr};
              default:		vidc_rd = {8'h0, vidc_reg_rdata};
            endcase // case (iomem_addr[8:2])
    end
@@ -242,34 +385,52 @@ module soc_top(input wire        clk_25mhz,
    wire [7:0]              v_green;
    wire [7:0]              v_blue;
 
-   video VIDEO(.clk(clk),
+   // Frame store requests to the SDRAM controller (below):
+   wire                    mem_req_valid;
+   wire                    mem_req_write;
+   wire [20:0]             mem_req_addr;
+   wire [127:0]            mem_req_wdata;
+   wire [3:0]              mem_req_wmask;
+   wire                    mem_req_ready;
+   wire                    mem_rd_valid;
+   wire [31:0]             mem_rd_data;
+   wire                    mem_init_done;
+
+   video #(.PIXELS_PER_CLK(VIDEO_PIXELS_PER_CLK),
+           .LB_ADDR_BITS(VIDEO_LB_ADDR_BITS))
+         VIDEO(.clk(clk),
                .reset(reset),
 
                .reg_wdata(iomem_wdata),
                .reg_rdata(video_reg_rd),
-               .reg_addr(iomem_addr[5:0]),
+               .reg_addr(iomem_addr[7:0]),
                .reg_wstrobe(video_reg_select && iomem_wstrb),
 
                .load_dma(load_dma),
                .load_dma_cursor(load_dma_cursor),
                .load_dma_data(load_dma_data),
 
-               .v_cursor_x(vidc_cursor_hstart),
-               .v_cursor_y(vidc_cursor_vstart),
-               .v_cursor_yend(vidc_cursor_vend),
-
-               .vidc_palette(vidc_palette),
-               .vidc_cursor_palette(vidc_cursor_palette),
-
-               .vidc_special_written(vidc_special_written),
-               .vidc_special(vidc_special),
-               .vidc_special_data(vidc_special_data),
+               .vw_write(vw_write),
+               .vw_idx(vw_idx),
+               .vw_data(vw_data),
+               .vw_frame(vw_frame),
+               .vw_line(vw_line),
+               .vw_cycles(vw_cycles),
+               .vidc_frame(vidc_frame),
 
                .vidc_tregs_status(vidc_tregs_status),
                .vidc_tregs_ack(vidc_tregs_ack),
+               .vidc_tregs_settle(vidc_tregs_settle),
+               .vidc_tregs_first_write(vidc_tregs_first_write),
+               .vidc_tregs_writes(vidc_tregs_writes),
+               .vidc_tregs_frames(vidc_tregs_frames),
+
+               .irq(video_irq),
 
                .clk_shift(clk_shift),
                .clk_pixel(clk_pixel),
+               .clk_pixel_sel(pixel_clk_sel),
+               .clk_pixel_avail(pixel_clk_avail),
 
                .video_r(v_red),
                .video_g(v_green),
@@ -281,11 +442,89 @@ module soc_top(input wire        clk_25mhz,
                .enable_test_card(sw[0]),
 
                .sync_flybk(vidc_flybk),
+               .sync_nhs(vidc_nhs),
+
+               .mem_req_valid(mem_req_valid),
+               .mem_req_write(mem_req_write),
+               .mem_req_addr(mem_req_addr),
+               .mem_req_wdata(mem_req_wdata),
+               .mem_req_wmask(mem_req_wmask),
+               .mem_req_ready(mem_req_ready),
+               .mem_rd_valid(mem_rd_valid),
+               .mem_rd_data(mem_rd_data),
+               .mem_init_done(mem_init_done),
 
                .is_hires(conf_hires)
                );
 
 
+   ////////////////////////////////////////////////////////////////////////////////
+   // Sound, played from VIDC's sound DMA and resampled for HDMI audio
+
+   wire [31:0]             sound_reg_rd;
+   wire                    snd_write;
+   wire [31:0]             snd_data;
+   wire                    snd_acr_toggle;
+   wire                    snd_hdmi_enable;
+
+   sound #(.CLK_RATE(CLK_RATE))
+         SND(.clk(clk),
+             .reset(reset),
+
+             .reg_wdata(iomem_wdata),
+             .reg_rdata(sound_reg_rd),
+             .reg_addr(iomem_addr[3:0]),
+             .reg_wstrobe(sound_reg_select && iomem_wstrb),
+
+             .load_dma_sound(load_dma_sound),
+             .load_dma_data(load_dma_data),
+             .snd_images(snd_images),
+             .snd_sfr(snd_sfr),
+
+             .out_write(snd_write),
+             .out_data(snd_data),
+             .acr_toggle(snd_acr_toggle),
+             .hdmi_enable(snd_hdmi_enable)
+             );
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // SDRAM, for the frame store
+
+   wire [15:0]             sdram_dq_out;
+   wire                    sdram_dq_oe;
+
+   sdram_ctrl #(.CLK_RATE(CLK_RATE))
+              SDRC(.clk(clk),
+                   .reset(reset),
+
+                   .req_valid(mem_req_valid),
+                   .req_write(mem_req_write),
+                   .req_addr(mem_req_addr),
+                   .req_wdata(mem_req_wdata),
+                   .req_wmask(mem_req_wmask),
+                   .req_ready(mem_req_ready),
+                   .rd_valid(mem_rd_valid),
+                   .rd_data(mem_rd_data),
+                   .init_done(mem_init_done),
+
+                   .sdram_clk(sdram_clk),
+                   .sdram_cke(sdram_cke),
+                   .sdram_csn(sdram_csn),
+                   .sdram_rasn(sdram_rasn),
+                   .sdram_casn(sdram_casn),
+                   .sdram_wen(sdram_wen),
+                   .sdram_a(sdram_a),
+                   .sdram_ba(sdram_ba),
+                   .sdram_dqm(sdram_dqm),
+                   .dq_out(sdram_dq_out),
+                   .dq_oe(sdram_dq_oe),
+                   .dq_in(sdram_d)
+                   );
+
+   assign sdram_d = sdram_dq_oe ? sdram_dq_out : 16'hzzzz;
+
+
    ////////////////////////////////////////////////////////////////////////////////
    // Video output
 
@@ -294,8 +533,47 @@ module soc_top(input wire        clk_25mhz,
     *
     * In future, this will likely drive an external HDMI encoder by exporting
     * parallel RGB video.
+    *
+    * hdmi_island adds HDMI data islands (audio, InfoFrames) when enabled,
+    * replacing vga2dvid's symbols in the blanking.
     */
 
+   wire                    h_vsync, h_hsync, h_blank;
+   wire [7:0]              h_red;
+   wire [7:0]              h_green;
+   wire [7:0]              h_blue;
+   wire                    h_island;
+   wire [9:0]              h_tmds_red;
+   wire [9:0]              h_tmds_green;
+   wire [9:0]              h_tmds_blue;
+
+   hdmi_island HDMI(.pclk(clk_pixel),
+
+                    .in_r(v_red),
+                    .in_g(v_green),
+                    .in_b(v_blue),
+                    .in_hsync(v_hsync),
+                    .in_vsync(v_vsync),
+                    .in_blank(v_blank),
+
+                    .out_r(h_red),
+                    .out_g(h_green),
+                    .out_b(h_blue),
+                    .out_hsync(h_hsync),
+                    .out_vsync(h_vsync),
+                    .out_blank(h_blank),
+                    .out_island(h_island),
+                    .out_tmds_r(h_tmds_red),
+                    .out_tmds_g(h_tmds_green),
+                    .out_tmds_b(h_tmds_blue),
+
+                    .aud_clk(clk),
+                    .aud_write(snd_write),
+                    .aud_data(snd_data),
+                    .aud_acr_toggle(snd_acr_toggle),
+                    .aud_hdmi_enable(snd_hdmi_enable)
+                    );
+
 `ifndef SIM
    // VGA to digital video converter
    wire [1:0]    tmds[3:0];
@@ -308,12 +586,16 @@ module soc_top(input wire        clk_25mhz,
                .clk_pixel(clk_pixel),
                .clk_shift(clk_shift),
 
-               .in_red(v_red),
-               .in_green(v_green),
-               .in_blue(v_blue),
-               .in_hsync(v_hsync),
-               .in_vsync(v_vsync),
-               .in_blank(v_blank),
+               .in_red(h_red),
+               .in_green(h_green),
+               .in_blue(h_blue),
+               .in_hsync(h_hsync),
+               .in_vsync(h_vsync),
+               .in_blank(h_blank),
+               .in_island(h_island),
+               .in_island_red(h_tmds_red),
+               .in_island_green(h_tmds_green),
+               .in_island_blue(h_tmds_blue),
 
                .out_clock(tmds[3]),
                .out_red(tmds[2]),
@@ -338,11 +620,12 @@ module soc_top(input wire        clk_25mhz,
 
 
    ////////////////////////////////////////////////////////////////////////////////
-   // Finally, combine peripheral read data back to the MCU:
+   // Finally, combine peripheral read data back to the MCU (or SPI):
 
    assign iomem_rdata = vidc_reg_select ? vidc_rd :
                         cgmem_select ? 32'hffffffff :
                         video_reg_select ? video_reg_rd :
+                        sound_reg_select ? sound_reg_rd :
                         32'h0;
 
 endmodule // soc_top
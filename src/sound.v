@@ -0,0 +1,287 @@
+/* ArcDVI: VIDC sound
+ *
+ * Plays the VIDC sound DMA the way VIDC would, and resamples the result to
+ * a 48kHz stereo stream for HDMI audio (see hdmi_island.v).
+ *
+ * VIDC plays one 8-bit logarithmic (mu-law-like) sample from its DMA stream
+ * every sample period, (SFR + 2)us.  The samples are interleaved channels:
+ * sample n is played at stereo position SIRn%8, so that an N-channel stream
+ * is the channels in turn (the OS programs all 8 stereo image registers,
+ * repeating for fewer channels).  VIDC's single DAC is time-multiplexed
+ * between left and right, a stereo position giving the fraction of the
+ * sample period spent on each; the analogue filters after it average the
+ * lot, mixing the channels.
+ *
+ * This does the same digitally:  each sample is decoded and weighted by
+ * its position, giving a left/right value held for the sample period.
+ * That is integrated over each 48kHz output period and scaled to give the
+ * output sample, i.e. the average over the period (a box filter, which is
+ * fine for the rates VIDC plays at).
+ *
+ * The DMA arrives in 4-word bursts as VIDC's (24MHz-timed) FIFO drains,
+ * into a 256-byte ring buffer here, played out at the rate timed from clk.
+ * Playback starts once the buffer has SND_TARGET bytes, so the latency from
+ * DMA to output is about SND_TARGET sample periods.  The two clocks differ
+ * slightly, so the level drifts:  if it goes outside SND_TARGET +/-
+ * SND_WINDOW, a frame of 8 samples (one per channel, so as to keep the
+ * channels in place) is skipped or repeated to bring it back, bounding the
+ * latency.  If the buffer empties (e.g. sound is turned off), the output is
+ * silent until it's refilled to SND_TARGET.
+ *
+ * The 48kHz output samples are timed from clk too, and written out as
+ * {right, left} 16-bit signed values.  acr_toggle toggles every 48 samples
+ * (N/128 for the N=6144 HDMI uses for 48kHz), so that the output can
+ * measure its pixel clock against the audio clock for Audio Clock
+ * Regeneration.
+ *
+ * 15 Jan 2022
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module sound(input wire         clk,
+             input wire         reset,
+
+             // Register access
+             input wire [31:0]  reg_wdata,
+             output wire [31:0] reg_rdata,
+             input wire [3:0]   reg_addr, /* Note 1:0 ignored */
+             input wire         reg_wstrobe,
+
+             // Sound DMA and configuration, from vidc_capture
+             input wire         load_dma_sound,
+             input wire [31:0]  load_dma_data,
+             input wire [23:0]  snd_images,
+             input wire [7:0]   snd_sfr,
+
+             // 48kHz output, to hdmi_island:
+             output reg         out_write,
+             output reg [31:0]  out_data,      // {right, left}
+             output reg         acr_toggle,
+             output wire        hdmi_enable
+             );
+
+   parameter CLK_RATE = 50000000;
+
+   localparam CYCLES_PER_US = CLK_RATE / 1000000;
+   localparam OUT_RATE = 48000;
+   /* Output scale:  1/(6 * cycles per output sample), * 2^24.  The 6 is the
+    * largest stereo weight, below.
+    */
+   localparam [12:0] OUT_NORM = (1 << 24) / ((6 * CLK_RATE) / OUT_RATE);
+
+   localparam SND_TARGET = 64;  // Bytes
+   localparam SND_WINDOW = 32;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Registers
+
+   reg                  c_hdmi_enable;
+   reg [7:0]            underruns;
+   reg [7:0]            overflows;
+   reg [7:0]            skips;
+   reg [7:0]            repeats;
+
+   reg [8:0]            wr_ptr;         // Bytes, with wrap bit
+   reg [8:0]            rd_ptr;
+   reg                  playing;
+
+   wire [8:0]           level = wr_ptr - rd_ptr;
+
+   assign hdmi_enable = c_hdmi_enable;
+
+   assign reg_rdata = (reg_addr[3:2] == 2'h0) ? {31'h0, c_hdmi_enable} :
+                      (reg_addr[3:2] == 2'h1) ? {playing, 6'h0, level, 8'h0, snd_sfr} :
+                      (reg_addr[3:2] == 2'h2) ? {underruns, overflows, skips, repeats} :
+                      32'h0;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // DMA ring buffer, and playback at VIDC's sample rate
+
+   reg [31:0]           ring[63:0];
+   wire [31:0]          ring_word = ring[rd_ptr[7:2]];
+   wire [7:0]           ring_byte = (rd_ptr[1:0] == 2'h0) ? ring_word[7:0] :
+                        (rd_ptr[1:0] == 2'h1) ? ring_word[15:8] :
+                        (rd_ptr[1:0] == 2'h2) ? ring_word[23:16] :
+                        ring_word[31:24];
+
+   reg [13:0]           period_ctr;
+   wire [13:0]          period = ({6'h0, snd_sfr} + 14'd2) * CYCLES_PER_US;
+
+   /* Decode a sample:  bit 0 is the sign, [7:5] the chord (exponent) and
+    * [4:1] the step (mantissa), giving a 13-bit magnitude; it's scaled to
+    * 15 bits.
+    */
+   wire [2:0]           chord = ring_byte[7:5];
+   wire [12:0]          mag = (({8'h0, ring_byte[4:1], 1'b1} + 13'd32) << chord) - 13'd33;
+   wire [14:0]          mag15 = {mag, 2'b00};
+
+   /* Stereo position 1 is full left, 7 full right, 4 centre (as is 0):
+    * weight each side 0-6 (sixths).
+    */
+   wire [2:0]           sir = snd_images[(rd_ptr[2:0]*3) +: 3];
+   wire [2:0]           img = (sir == 3'h0) ? 3'h4 : sir;
+   wire [2:0]           w_left = 3'h7 - img;
+   wire [2:0]           w_right = img - 3'h1;
+
+   wire [17:0]          mag_left = mag15 * w_left;
+   wire [17:0]          mag_right = mag15 * w_right;
+
+   reg signed [18:0]    cur_left;       // Held for the sample period
+   reg signed [18:0]    cur_right;
+
+   always @(posedge clk) begin
+           if (load_dma_sound && (level <= (256 - 4))) begin
+                   ring[wr_ptr[7:2]] <= load_dma_data;
+           end
+   end
+
+   always @(posedge clk) begin
+           if (reset) begin
+                   wr_ptr        <= 9'h0;
+                   rd_ptr        <= 9'h0;
+                   playing       <= 0;
+                   period_ctr    <= 0;
+                   cur_left      <= 0;
+                   cur_right     <= 0;
+                   c_hdmi_enable <= 0;
+                   underruns     <= 0;
+                   overflows     <= 0;
+                   skips         <= 0;
+                   repeats       <= 0;
+           end else begin
+                   if (load_dma_sound) begin
+                           if (level <= (256 - 4))
+                             wr_ptr     <= wr_ptr + 4;
+                           else if (overflows != 8'hff)
+                             overflows  <= overflows + 1;
+                   end
+
+                   if (period_ctr != 0) begin
+                           period_ctr <= period_ctr - 1;
+                   end else begin
+                           period_ctr <= period - 1;
+
+                           if (!playing) begin
+                                   playing   <= (level >= SND_TARGET);
+                           end else if (level == 0) begin
+                                   playing   <= 0;
+                                   cur_left  <= 0;
+                                   cur_right <= 0;
+                                   if (underruns != 8'hff)
+                                     underruns <= underruns + 1;
+                           end else begin
+                                   cur_left  <= ring_byte[0] ? -$signed({1'b0, mag_left}) :
+                                                $signed({1'b0, mag_left});
+                                   cur_right <= ring_byte[0] ? -$signed({1'b0, mag_right}) :
+                                                $signed({1'b0, mag_right});
+
+                                   /* At the end of a frame, keep the level
+                                    * in its window:
+                                    */
+                                   if (rd_ptr[2:0] == 3'h7 &&
+                                       level > (SND_TARGET + SND_WINDOW)) begin
+                                           rd_ptr <= rd_ptr + 9;
+                                           if (skips != 8'hff)
+                                             skips <= skips + 1;
+                                   end else if (rd_ptr[2:0] == 3'h7 &&
+                                                level < (SND_TARGET - SND_WINDOW)) begin
+                                           rd_ptr <= rd_ptr - 7;
+                                           if (repeats != 8'hff)
+                                             repeats <= repeats + 1;
+                                   end else begin
+                                           rd_ptr <= rd_ptr + 1;
+                                   end
+                           end
+                   end
+
+                   if (reg_wstrobe) begin
+                           if (reg_addr[3:2] == 2'h0)
+                             c_hdmi_enable <= reg_wdata[0];
+                           else if (reg_addr[3:2] == 2'h2) begin
+                                   underruns <= 0;
+                                   overflows <= 0;
+                                   skips     <= 0;
+                                   repeats   <= 0;
+                           end
+                   end
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Resampling to 48kHz
+
+   reg [31:0]           rate_acc;
+   reg                  out_tick;
+   reg [5:0]            acr_ctr;
+   reg signed [29:0]    acc_left;
+   reg signed [29:0]    acc_right;
+   reg signed [29:0]    sum_left;
+   reg signed [29:0]    sum_right;
+
+   wire signed [43:0]   scaled_left = sum_left * $signed({1'b0, OUT_NORM});
+   wire signed [43:0]   scaled_right = sum_right * $signed({1'b0, OUT_NORM});
+
+   always @(posedge clk) begin
+           out_write <= 0;
+           out_tick  <= 0;
+
+           if (reset) begin
+                   rate_acc   <= 0;
+                   acr_ctr    <= 0;
+                   acr_toggle <= 0;
+                   acc_left   <= 0;
+                   acc_right  <= 0;
+           end else begin
+                   if (rate_acc >= (CLK_RATE - OUT_RATE)) begin
+                           rate_acc  <= rate_acc + OUT_RATE - CLK_RATE;
+                           out_tick  <= 1;
+                           sum_left  <= acc_left;
+                           sum_right <= acc_right;
+                           acc_left  <= cur_left;
+                           acc_right <= cur_right;
+
+                           if (acr_ctr == 47) begin
+                                   acr_ctr    <= 0;
+                                   acr_toggle <= ~acr_toggle;
+                           end else begin
+                                   acr_ctr    <= acr_ctr + 1;
+                           end
+                   end else begin
+                           rate_acc  <= rate_acc + OUT_RATE;
+                           acc_left  <= acc_left + cur_left;
+                           acc_right <= acc_right + cur_right;
+                   end
+
+                   /* The sum never exceeds 16 bits once scaled: */
+                   if (out_tick) begin
+                           out_write <= 1;
+                           out_data  <= {scaled_right[39:24], scaled_left[39:24]};
+                   end
+           end
+   end
+
+endmodule // sound
@@ -0,0 +1,248 @@
+/* ArcDVI: SPI slave register interface
+ *
+ * Lets an external MCU (e.g. the ULX3S's ESP32, on its HSPI pins) drive the
+ * same IO bus as the picorv32:  the VIDC register mirror at 0x20000000, the
+ * video registers at 0x22000000 and so on.  It's a second bus master; its
+ * accesses take priority, stalling the CPU's for the cycle or two they
+ * take.
+ *
+ * SPI mode 0 (SCK idles low, data sampled on the rising edge), MSB first,
+ * with nCS low for the whole of a transaction.  The pins are oversampled
+ * in clk, and MISO changes up to 4 clks after SCK falls, so SCK can be up to
+ * CLK_RATE/12 (about 4MHz at 50MHz).  A transaction is a command byte,
+ * then:
+ *
+ * 0x02  Write:  address (4 bytes, big-endian), then words (4 bytes each,
+ *       big-endian) written to consecutive addresses until nCS rises.
+ *
+ * 0x03  Read:  address, a dummy byte (whilst the first word's read), then
+ *       words read from consecutive addresses for as long as SCK runs.
+ *
+ * 0x0b  Write set:  base address, a 64-bit mask (8 bytes, big-endian), then
+ *       one word for each set bit, in ascending order, written to base +
+ *       4*bit.  So a whole video register set (which has holes) can be
+ *       programmed in one transaction.
+ *
+ * 0x05  Status:  every byte read back is {7'h0, irq}, the video interrupt
+ *       (which is also output on its own pin).
+ *
+ * Anything else is ignored until nCS rises.  Writes are posted:  a word's
+ * bus write happens after its last bit, so nCS can rise straight away.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module spi_slave(input wire         clk,
+                 input wire         reset,
+
+                 // SPI pins (asynchronous)
+                 input wire         spi_sclk,
+                 input wire         spi_csn,
+                 input wire         spi_mosi,
+                 output wire        spi_miso,
+
+                 input wire         irq,
+
+                 // IO bus master
+                 output wire        bus_valid,
+                 output wire [31:0] bus_addr,
+                 output wire [31:0] bus_wdata,
+                 output wire [3:0]  bus_wstrb,
+                 input wire         bus_ready,
+                 input wire [31:0]  bus_rdata
+                 );
+
+   localparam CMD_WRITE		= 8'h02;
+   localparam CMD_READ		= 8'h03;
+   localparam CMD_STATUS	= 8'h05;
+   localparam CMD_WRITE_SET	= 8'h0b;
+
+   localparam P_CMD		= 3'h0;
+   localparam P_ADDR		= 3'h1;
+   localparam P_MASK		= 3'h2;
+   localparam P_DUMMY		= 3'h3;
+   localparam P_DATA		= 3'h4;
+   localparam P_IGNORE		= 3'h5;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Pin synchronisers and edges
+
+   reg [2:0]            s_sclk;
+   reg [1:0]            s_csn;
+   reg [1:0]            s_mosi;
+
+   always @(posedge clk) begin
+           s_sclk <= {s_sclk[1:0], spi_sclk};
+           s_csn  <= {s_csn[0], spi_csn};
+           s_mosi <= {s_mosi[0], spi_mosi};
+   end
+
+   wire                 active = !s_csn[1];
+   wire                 sclk_rise = active && s_sclk[1] && !s_sclk[2];
+   wire                 sclk_fall = active && !s_sclk[1] && s_sclk[2];
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Command/address/data bytes, on SCK rising edges
+
+   reg [2:0]            phase;
+   reg [2:0]            bitn;
+   reg [6:0]            sh_in;
+   reg [7:0]            cmd;
+   reg [2:0]            count;          // Bytes of address/mask, or of a word
+   reg [31:0]           addr;           // Next to write
+   reg [63:0]           mask;           // Write set, bit 0 is addr
+   reg [31:0]           wdata;
+   reg                  wr_req;
+   reg [31:0]           rd_addr;        // Next to read
+   reg                  rd_req;
+   reg [31:0]           rd_word;
+   reg                  load_word;      // Next byte starts a read word
+
+   wire [7:0]           in_byte = {sh_in, s_mosi[1]};
+   wire                 byte_in = sclk_rise && bitn == 3'h7;
+   wire                 set_mode = cmd == CMD_WRITE_SET;
+
+   assign bus_valid = wr_req || rd_req;
+   assign bus_addr = wr_req ? addr : rd_addr;
+   assign bus_wdata = wdata;
+   assign bus_wstrb = wr_req ? 4'hf : 4'h0;
+
+   always @(posedge clk) begin
+           if (reset || !active) begin
+                   phase     <= P_CMD;
+                   bitn      <= 0;
+                   count     <= 0;
+                   rd_req    <= 0;
+                   load_word <= 0;
+           end else if (sclk_rise) begin
+                   bitn  <= bitn + 1;
+                   sh_in <= in_byte[6:0];
+           end
+
+           if (reset) begin
+                   wr_req <= 0;
+           end else if (wr_req && bus_ready) begin
+                   /* Posted, so it finishes even if nCS has risen */
+                   wr_req <= 0;
+                   addr   <= addr + 4;
+                   mask   <= {1'b0, mask[63:1]};
+           end else if (set_mode && phase == P_DATA && !mask[0] && mask != 0) begin
+                   /* Skip to the next register in the set, well before its
+                    * word arrives:
+                    */
+                   addr <= addr + 4;
+                   mask <= {1'b0, mask[63:1]};
+           end
+
+           if (rd_req && bus_ready) begin
+                   rd_req  <= 0;
+                   rd_word <= bus_rdata;
+                   rd_addr <= rd_addr + 4;
+           end
+
+           if (active && byte_in) begin
+                   load_word <= 0;
+
+                   case (phase)
+                     P_CMD: begin
+                             cmd   <= in_byte;
+                             count <= 0;
+                             phase <= (in_byte == CMD_WRITE ||
+                                       in_byte == CMD_READ ||
+                                       in_byte == CMD_WRITE_SET) ? P_ADDR :
+                                      (in_byte == CMD_STATUS) ? P_DATA : P_IGNORE;
+                     end
+
+                     P_ADDR: begin
+                             addr    <= {addr[23:0], in_byte};
+                             rd_addr <= {addr[23:0], in_byte};
+                             count   <= count + 1;
+                             if (count == 3'h3) begin
+                                     count  <= 0;
+                                     mask   <= {64{1'b1}};
+                                     phase  <= (cmd == CMD_WRITE_SET) ? P_MASK :
+                                               (cmd == CMD_READ) ? P_DUMMY : P_DATA;
+                                     rd_req <= (cmd == CMD_READ);
+                             end
+                     end
+
+                     P_MASK: begin
+                             mask  <= {mask[55:0], in_byte};
+                             count <= count + 1;
+                             if (count == 3'h7) begin
+                                     count <= 0;
+                                     phase <= P_DATA;
+                             end
+                     end
+
+                     P_DUMMY: begin
+                             load_word <= 1;
+                             phase     <= P_DATA;
+                     end
+
+                     P_DATA: begin
+                             wdata <= {wdata[23:0], in_byte};
+                             count <= (count == 3'h3) ? 3'h0 : count + 1;
+                             if (count == 3'h3) begin
+                                     if (cmd == CMD_READ)
+                                       load_word <= 1;
+                                     else if (cmd != CMD_STATUS)
+                                       wr_req <= !set_mode || mask[0];
+                             end
+                     end
+
+                     default: ;
+                   endcase
+           end
+
+           /* The next read word is fetched as soon as the last is taken: */
+           if (active && sclk_fall && load_word) begin
+                   load_word <= 0;
+                   rd_req    <= 1;
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Read data, changing on SCK falling edges
+
+   reg [31:0]           sh_out;
+
+   always @(posedge clk) begin
+           if (!active) begin
+                   sh_out <= 0;
+           end else if (sclk_fall) begin
+                   if (load_word)
+                     sh_out <= rd_word;
+                   else if (phase == P_DATA && cmd == CMD_STATUS && bitn == 3'h0)
+                     sh_out <= {7'h0, irq, 24'h0};
+                   else
+                     sh_out <= {sh_out[30:0], 1'b0};
+           end
+   end
+
+   assign spi_miso = sh_out[31];
+
+endmodule // spi_slave
@@ -0,0 +1,242 @@
+/* ArcDVI: Execute-in-place from SPI flash, with an instruction cache
+ *
+ * Serves the CPU's reads of a 16MB window onto the ULX3S configuration
+ * flash, so the firmware's text and read-only data needn't be in block RAM.
+ * A direct-mapped cache of 2^LINE_BITS lines of 8 words (2KB by default,
+ * one DP16KD) sits in front of the flash; a miss reads the whole line with
+ * one fast read command:
+ *
+ *   QUAD=1:  0x6B, Quad Output Fast Read (needs the flash's QE bit set)
+ *   QUAD=0:  0x3B, Dual Output Fast Read (works on any part)
+ *
+ * The command and address go out on IO0, then 8 dummy clocks, then the
+ * line comes back 4 (or 2) bits per clock.  SCK is clk/2, 25MHz at 50MHz,
+ * so a miss takes about 210 clocks quad (340 dual).  The word wanted is
+ * returned as soon as it has arrived (the CPU then carries on), and a read
+ * of a later word of the line being filled is returned as it arrives, so
+ * straight-line code runs at the speed of the flash even when it misses.
+ *
+ * Writes to the window are ignored.  The CPU is expected to hold valid
+ * (and the address) until ready, as picorv32 does.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module spiflash_xip(input wire         clk,
+                    input wire         reset,
+
+                    // CPU side
+                    input wire         valid,
+                    input wire         write,
+                    input wire [23:0]  addr,
+                    output wire        ready,
+                    output wire [31:0] rdata,
+
+                    // Statistics
+                    input wire         clear_stats,
+                    output reg [31:0]  hits,
+                    output reg [31:0]  misses,
+                    output reg [31:0]  wait_cycles,
+
+                    // Flash pins (IO0 = MOSI, IO1 = MISO, IO2 = WP#, IO3 = HOLD#)
+                    output reg         flash_csn,
+                    output reg         flash_clk,
+                    output reg [3:0]   flash_io_out,
+                    output reg [3:0]   flash_io_oe,
+                    input wire [3:0]   flash_io_in
+                    );
+
+   parameter QUAD = 1;
+   parameter LINE_BITS = 6;
+
+   localparam WORD_BITS = 3;
+   localparam TAG_BITS = 24 - 2 - WORD_BITS - LINE_BITS;
+   localparam [7:0] CMD = QUAD ? 8'h6b : 8'h3b;
+   localparam CLKS_PER_WORD = QUAD ? 8 : 16;
+
+   localparam S_IDLE	= 3'h0;
+   localparam S_CMD	= 3'h1;
+   localparam S_DUMMY	= 3'h2;
+   localparam S_DATA	= 3'h3;
+   localparam S_END	= 3'h4;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Cache
+
+   reg [31:0]           data[0:(1 << (LINE_BITS + WORD_BITS)) - 1];
+   reg [TAG_BITS-1:0]   tags[0:(1 << LINE_BITS) - 1];
+   reg [(1 << LINE_BITS)-1:0] line_valid;
+
+   wire [WORD_BITS-1:0] a_word = addr[2 +: WORD_BITS];
+   wire [LINE_BITS-1:0] a_line = addr[2 + WORD_BITS +: LINE_BITS];
+   wire [TAG_BITS-1:0]  a_tag = addr[23 -: TAG_BITS];
+
+   reg [2:0]            state;
+   reg                  lookup;         // Data/tag read last cycle
+   reg                  hit;
+   reg [31:0]           rd_word;
+   reg                  req_missed;     // This request started a fill
+
+   reg [LINE_BITS-1:0]  fill_line;
+   reg [TAG_BITS-1:0]   fill_tag;
+   reg [WORD_BITS-1:0]  fill_word;
+   reg                  fill_we;
+   reg [31:0]           fill_data;
+
+   always @(posedge clk) begin
+           rd_word <= data[{a_line, a_word}];
+           if (fill_we)
+             data[{fill_line, fill_word}] <= fill_data;
+   end
+
+   /* A word of the line being filled is returned as it's written: */
+   wire                 fill_hit = valid && !write && state != S_IDLE && fill_we &&
+                        fill_line == a_line && fill_tag == a_tag &&
+                        fill_word == a_word;
+
+   assign ready = (lookup && (hit || write)) || fill_hit;
+   assign rdata = fill_hit ? fill_data : rd_word;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Lookup and line fill
+
+   reg [5:0]            count;          // Bits of command/address, dummy clocks, or clocks of a word
+   reg [31:0]           sh_out;
+   reg [31:0]           sh_in;
+
+   always @(posedge clk) begin
+           lookup  <= 0;
+           fill_we <= 0;
+
+           if (fill_we)
+             fill_word <= fill_word + 1;
+
+           if (reset) begin
+                   state       <= S_IDLE;
+                   line_valid  <= 0;
+                   flash_csn   <= 1;
+                   flash_clk   <= 0;
+                   flash_io_oe <= 4'h0;
+                   req_missed  <= 0;
+           end else if (state == S_IDLE) begin
+                   if (valid && !lookup) begin
+                           lookup <= 1;
+                           hit    <= line_valid[a_line] && tags[a_line] == a_tag;
+                   end
+
+                   if (lookup && !hit && !write) begin
+                           /* Miss:  read the line.  WP# and HOLD# are held
+                            * high until the flash drives them.
+                            */
+                           fill_line            <= a_line;
+                           fill_tag             <= a_tag;
+                           fill_word            <= 0;
+                           line_valid[a_line]   <= 0;
+                           req_missed           <= 1;
+                           sh_out               <= {CMD, a_tag, a_line, {(WORD_BITS + 2){1'b0}}};
+                           flash_csn            <= 0;
+                           flash_io_out         <= {2'b11, 1'b0, CMD[7]};
+                           flash_io_oe          <= 4'b1101;
+                           count                <= 0;
+                           state                <= S_CMD;
+                   end
+           end else if (state == S_END) begin
+                   /* The last word's written this cycle */
+                   tags[fill_line]       <= fill_tag;
+                   line_valid[fill_line] <= 1;
+                   state                 <= S_IDLE;
+           end else if (!flash_clk) begin
+                   /* Rising edge:  the flash samples IO0, and its data has
+                    * been stable since the falling edge.
+                    */
+                   flash_clk <= 1;
+                   if (state == S_DATA)
+                     sh_in <= QUAD ? {sh_in[27:0], flash_io_in} :
+                              {sh_in[29:0], flash_io_in[1:0]};
+           end else begin
+                   /* Falling edge:  next bit out */
+                   flash_clk <= 0;
+                   count     <= count + 1;
+
+                   case (state)
+                     S_CMD: begin
+                             sh_out          <= {sh_out[30:0], 1'b0};
+                             flash_io_out[0] <= sh_out[30];
+                             if (count == 6'd31) begin
+                                     count       <= 0;
+                                     flash_io_oe <= QUAD ? 4'b0000 : 4'b1100;
+                                     state       <= S_DUMMY;
+                             end
+                     end
+
+                     S_DUMMY: begin
+                             if (count == 6'd7) begin
+                                     count <= 0;
+                                     state <= S_DATA;
+                             end
+                     end
+
+                     default: begin // S_DATA
+                             if (count == CLKS_PER_WORD - 1) begin
+                                     /* Bytes arrive in address order: */
+                                     count     <= 0;
+                                     fill_we   <= 1;
+                                     fill_data <= {sh_in[7:0], sh_in[15:8],
+                                                   sh_in[23:16], sh_in[31:24]};
+                                     if (fill_word == {WORD_BITS{1'b1}}) begin
+                                             flash_csn   <= 1;
+                                             flash_io_oe <= 4'h0;
+                                             state       <= S_END;
+                                     end
+                             end
+                     end
+                   endcase
+           end
+
+           if (ready)
+             req_missed <= 0;
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Statistics:  a hit is any read not starting a fill (including one of a
+   // line being filled), and wait_cycles counts those spent waiting for one.
+
+   always @(posedge clk) begin
+           if (reset || clear_stats) begin
+                   hits        <= 0;
+                   misses      <= 0;
+                   wait_cycles <= 0;
+           end else begin
+                   if (ready && !write && !req_missed)
+                     hits <= hits + 1;
+                   if (state == S_IDLE && lookup && !hit && !write)
+                     misses <= misses + 1;
+                   if (valid && !ready && state != S_IDLE)
+                     wait_cycles <= wait_cycles + 1;
+           end
+   end
+
+endmodule // spiflash_xip
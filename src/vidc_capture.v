@@ -31,41 +31,49 @@ module vidc_capture(input wire 	       	      clk,
                     input wire                vidc_nvidw,
                     input wire                vidc_nvcs,
                     input wire                vidc_nhs,
-                    input wire                vidc_nsndrq, // Unused
+                    input wire                vidc_nsndrq,
                     input wire                vidc_nvidrq,
                     input wire                vidc_flybk,
-                    input wire                vidc_nsndak, // Unused
+                    input wire                vidc_nsndak,
                     input wire                vidc_nvidak,
 
                     /* Input config */
                     input wire                conf_hires,
 
                     /* Output info: */
-                    output wire [(12*16)-1:0] vidc_palette,
-                    output wire [(12*3)-1:0]  vidc_cursor_palette,
-                    output wire [10:0]        vidc_cursor_hstart,
-                    output wire [9:0]         vidc_cursor_vstart,
-                    output wire [9:0]         vidc_cursor_vend,
-
                     input wire [5:0]          vidc_reg_sel,
                     output wire [23:0]        vidc_reg_rdata,
 
                     output reg                tregs_status,
                     input wire                tregs_status_ack,
+                    input wire [3:0]          tregs_settle_frames,
+                    output reg                tregs_first_write,
+                    output reg [15:0]         tregs_writes,
+                    output reg [7:0]          tregs_frames,
 
                     /* Debug counters: */
                     output reg [3:0]          fr_count,
                     output reg [15:0]         video_dma_counter,
                     output reg [15:0]         cursor_dma_counter,
+                    output reg [15:0]         sound_dma_counter,
+
+                    /* Palette/cursor writes, and raster position, see below: */
+                    output reg                vw_write,
+                    output reg [8:0]          vw_idx,
+                    output reg [31:0]         vw_data,
+                    output reg [1:0]          vw_frame,
+                    output reg [9:0]          vw_line,
+                    output reg [12:0]         vw_cycles,
+                    output reg [1:0]          in_frame,
 
-                    /* Extension register interface: */
-                    output reg                vidc_special_written,
-                    output wire [23:0]        vidc_special,
-                    output wire [23:0]        vidc_special_data,
+                    /* Sound configuration, see sound.v: */
+                    output wire [23:0]        snd_images,
+                    output wire [7:0]         snd_sfr,
 
                     /* DMA interface: */
                     output wire               load_dma,
                     output wire               load_dma_cursor,
+                    output wire               load_dma_sound,
                     output wire [31:0]        load_dma_data
                     );
 
@@ -88,6 +96,20 @@ module vidc_capture(input wire 	       	      clk,
     * Our special "port" register is at register offset 0x50/51
     * (i.e. reg 0x14/0x15).
     * VIDC decodes this, harmlessly, to the border reg & cursor col1 reg.
+    *
+    * Palette and cursor writes aren't exported from here as registers (which
+    * the pixel clock domain would have to read unsynchronised), but as a
+    * stream of writes for the output to replay into its own copy (via a
+    * FIFO), each stamped with the raster position it was made at (see
+    * "Input raster position" below):
+    * - vw_idx 0-19 is VIDC palette register 0-19 (16 palette entries,
+    *   border, 3 cursor colours), 12-bit data
+    * - vw_idx 0x20 is the cursor position, data {1'b0, vend[9:0],
+    *   vstart[9:0], hstart[10:0]} (as below), after any write to the cursor
+    *   position or vertical display start registers
+    * - vw_idx 0x100-0x1ff is 8BPP palette entry 0-255, 24-bit data,
+    *   from a write of a 0x0000RR op to the special register (with the
+    *   data previously written to the payload register)
     */
    reg [23:0]           vidc_regs[63:0];
 
@@ -105,19 +127,21 @@ module vidc_capture(input wire 	       	      clk,
    wire	[5:0]		vidc_reg_addr       = vidc_d_hist[1][31:26];
 
    /* Detect changes to display timing:
-    * This isn't foolproof, testing only HCR/VCR, but is enough to detect a
-    * standard OS-driven mode change.
+    * All of the timing registers, and the control register (pixel rate/bpp),
+    * are tracked.  The cursor position registers aren't, as they change
+    * every time the pointer moves.
     */
-   wire                 tregs               = (vidc_reg_addr == 8'h80/4) ||
-                        (vidc_reg_addr == 8'ha0/4);
+   wire                 tregs               = ((vidc_reg_addr >= 8'h80/4) &&
+                                               (vidc_reg_addr <= 8'hb4/4) &&
+                                               (vidc_reg_addr != 8'h98/4)) ||
+                        (vidc_reg_addr == 8'he0/4);
+   wire                 tregs_write         = nvidw_edge && tregs;
 
    always @(posedge clk) begin
            if (reset) begin
-                   tregs_status       	<= 1'b0;
                    vidc_nvidw_hist[0]   <= 1'b0;
                    vidc_nvidw_hist[1]   <= 1'b0;
                    vidc_nvidw_hist[2]   <= 1'b0;
-                   vidc_special_written <= 0;
 
            end else begin
                    // Watch for nVIDW falling edge:
@@ -135,41 +159,33 @@ module vidc_capture(input wire 	       	      clk,
                             * strobe which has been detected as being low.
                             */
                            vidc_regs[vidc_reg_addr] <= vidc_d_hist[1][23:0];
-                           vidc_special_written     <= (vidc_reg_addr == 6'h14);
-
-                           if (tregs && (tregs_status_ack == tregs_status))
-                             tregs_status <= ~tregs_status;
-                   end else begin
-                           vidc_special_written <= 0;
                    end
            end
    end
 
 
    ////////////////////////////////////////////////////////////////////////////////
-   // Registers to export directly to display circuitry:
+   // Cursor position, for the display circuitry:
 
-   assign vidc_cursor_hstart         	= conf_hires ? vidc_regs[6'h26][21:11] :
+   wire [10:0] vidc_cursor_hstart     	= conf_hires ? vidc_regs[6'h26][21:11] :
                                           vidc_regs[6'h26][23:13];
    wire [9:0] vidc_vstart    		= vidc_regs[6'h2b][23:14];
-   assign vidc_cursor_vstart 		= vidc_regs[6'h2e][23:14] - vidc_vstart;
-   assign vidc_cursor_vend 		= vidc_regs[6'h2f][23:14] - vidc_vstart;
+   wire [9:0] vidc_cursor_vstart 	= vidc_regs[6'h2e][23:14] - vidc_vstart;
+   wire [9:0] vidc_cursor_vend 		= vidc_regs[6'h2f][23:14] - vidc_vstart;
 
-   assign vidc_palette  		= { vidc_regs[15][11:0], vidc_regs[14][11:0],
-                                            vidc_regs[13][11:0], vidc_regs[12][11:0],
-                                            vidc_regs[11][11:0], vidc_regs[10][11:0],
-                                            vidc_regs[9][11:0], vidc_regs[8][11:0],
-                                            vidc_regs[7][11:0], vidc_regs[6][11:0],
-                                            vidc_regs[5][11:0], vidc_regs[4][11:0],
-                                            vidc_regs[3][11:0], vidc_regs[2][11:0],
-                                            vidc_regs[1][11:0], vidc_regs[0][11:0] };
 
-   assign vidc_cursor_palette 		= { vidc_regs[19][11:0], vidc_regs[18][11:0],
-                                            vidc_regs[17][11:0] };
+   ////////////////////////////////////////////////////////////////////////////////
+   // Sound configuration:
+   //
+   // The stereo image registers, 3 bits each, as {SIR7, ..., SIR0}.  Note SIR7
+   // is at 0x60, and SIR0-6 at 0x64-0x7c.  The sound frequency register
+   // gives the sample period, (SFR + 2)us.
 
-   // When vidc_special is changed, vidc_special_written pulses:
-   assign        vidc_special	 	= vidc_regs[6'h14];
-   assign        vidc_special_data  	= vidc_regs[6'h15];
+   assign snd_images = {vidc_regs[6'h18][2:0], vidc_regs[6'h1f][2:0],
+                        vidc_regs[6'h1e][2:0], vidc_regs[6'h1d][2:0],
+                        vidc_regs[6'h1c][2:0], vidc_regs[6'h1b][2:0],
+                        vidc_regs[6'h1a][2:0], vidc_regs[6'h19][2:0]};
+   assign snd_sfr    = vidc_regs[6'h30][7:0];
 
 
    ////////////////////////////////////////////////////////////////////////////////
@@ -204,6 +220,8 @@ module vidc_capture(input wire 	       	      clk,
    wire                 flybk_start      = ~flybk_last && flybk;
    wire                 vdak_rising_edge = vdak_last == 0 && vdak == 1;
    wire                 hs_rising_edge   = hs_last == 0 && hs == 1;
+   wire                 hs_falling_edge  = hs_last == 1 && hs == 0;
+   wire                 flybk_end        = flybk_last && !flybk;
 
    always @(posedge clk) begin
            if (reset) begin
@@ -267,9 +285,193 @@ module vidc_capture(input wire 	       	      clk,
            end
    end // always @ (posedge clk)
 
+   /* Sound DMA has its own request/ack pair, and is otherwise like video DMA:
+    * MEMC transfers four words for each request.  It's handled by a separate
+    * FSM as sound requests aren't tied to the line, and are independent
+    * of video/cursor requests (MEMC serialises the bursts on the bus).
+    */
+   wire			sdrq, sdak, sdak_last;
+   reg [2:0]	        s_sdrq;
+   reg [2:0]	        s_sdak;
+   assign		sdrq             = s_sdrq[1];
+   assign		sdak             = s_sdak[1];
+   assign		sdak_last 	 = s_sdak[2];
+
+   reg [15:0]           int_s_dma_counter;
+   reg [2:0]            snd_beat_counter;
+   reg                  s_state;
+
+   wire                 sdak_rising_edge = sdak_last == 0 && sdak == 1;
+
+   always @(posedge clk) begin
+           if (reset) begin
+                   s_state  <= 0;
+                   s_sdrq   <= 3'b111;
+                   s_sdak   <= 3'b111;
+           end else begin
+                   s_sdrq[2:0]  <= {s_sdrq[1:0], vidc_nsndrq};
+                   s_sdak[2:0]  <= {s_sdak[1:0], vidc_nsndak};
+
+                   if (flybk_start) begin
+                           sound_dma_counter  <= int_s_dma_counter;
+                           int_s_dma_counter  <= 0;
+                   end
+
+                   if (s_state == 0) begin
+                           if (sdrq == 0) begin
+                                   s_state           <= 1;
+                                   int_s_dma_counter <= int_s_dma_counter + 1;
+                                   snd_beat_counter  <= 3;
+                           end
+                   end else if (sdak_rising_edge) begin
+                           if (snd_beat_counter != 0)
+                             snd_beat_counter <= snd_beat_counter - 1;
+                           else
+                             s_state          <= 0;
+                   end
+           end
+   end
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Input raster position:
+   //
+   // Palette and cursor writes are stamped with VIDC's raster position, so
+   // that the output can replay them at the same point in its own raster
+   // (which runs a line or two behind) rather than as they arrive, and a
+   // mid-frame palette split lands on the right line.
+   //
+   // A frame starts at flyback start; in_frame counts them, Gray-coded so
+   // that the output can synchronise it.  Display lines count from 0 at
+   // flyback end, and the position within a line is in clk cycles since the
+   // start of hsync (video.v turns that into pixels).  Writes made during
+   // flyback are positioned at the start of the next frame's display.
+   //
+   // Flyback ends at the start of a line, i.e. at an hsync, but in case the
+   // two are seen a few cycles apart, an hsync just after flyback end isn't
+   // counted as a new line.
+
+   reg [9:0]            in_line;
+   reg [12:0]           in_cycles;
+   reg                  cursor_moved;
+
+   always @(posedge clk) begin
+           if (reset) begin
+                   in_frame     <= 2'b00;
+                   in_line      <= 10'h0;
+                   in_cycles    <= 13'h0;
+           end else begin
+                   if (flybk_start)
+                     in_frame   <= {in_frame[0], ~in_frame[1]}; // Gray increment
+
+                   if (flybk_end || hs_falling_edge)
+                     in_cycles  <= 13'h0;
+                   else if (in_cycles != 13'h1fff)
+                     in_cycles  <= in_cycles + 1;
+
+                   if (flybk)
+                     in_line    <= 10'h0;
+                   else if (hs_falling_edge && !flybk_end && in_cycles >= 64)
+                     in_line    <= in_line + 1;
+           end
+   end
+
+   always @(posedge clk) begin
+           vw_write     <= 0;
+           cursor_moved <= 0;
+
+           if (!reset) begin
+                   if (nvidw_edge) begin
+                           if (vidc_reg_addr < 6'h14) begin
+                                   vw_write  <= 1;
+                                   vw_idx    <= {3'b000, vidc_reg_addr};
+                                   vw_data   <= {20'h0, vidc_d_hist[1][11:0]};
+                           end else if (vidc_reg_addr == 6'h14 &&
+                                        vidc_d_hist[1][11:8] == 4'h0) begin
+                                   vw_write  <= 1;
+                                   vw_idx    <= {1'b1, vidc_d_hist[1][7:0]};
+                                   vw_data   <= {8'h0, vidc_regs[6'h15]};
+                           end
+                           cursor_moved <= (vidc_reg_addr == 6'h26) ||
+                                           (vidc_reg_addr == 6'h2b) ||
+                                           (vidc_reg_addr == 6'h2e) ||
+                                           (vidc_reg_addr == 6'h2f);
+                   end else if (cursor_moved) begin
+                           // The register's been written by now:
+                           vw_write  <= 1;
+                           vw_idx    <= 9'h020;
+                           vw_data   <= {1'b0, vidc_cursor_vend, vidc_cursor_vstart,
+                                         vidc_cursor_hstart};
+                   end
+
+                   vw_frame     <= in_frame;
+                   vw_line      <= flybk ? 10'h0 : in_line;
+                   vw_cycles    <= flybk ? 13'h0 : in_cycles;
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Timing register write coalescing:
+   //
+   // A mode change is a burst of timing register writes, possibly spread over
+   // more than one frame.  Rather than flagging the first write (and the MCU
+   // probing a half-written configuration), the writes are collected into a
+   // batch which is complete when there have been no further writes for
+   // tregs_settle_frames flyback starts.  Then tregs_status toggles (if the
+   // last toggle has been acked), and tregs_writes/tregs_frames give the
+   // number of writes and frames the batch covered.
+   //
+   // tregs_settle_frames of 0 flags each batch as soon as it starts, i.e. on
+   // the first write.
+
+   reg                  tregs_pending;
+   reg [15:0]           tregs_wr_ctr;
+   reg [7:0]            tregs_fr_ctr;
+   reg [3:0]            tregs_quiet;
+
+   always @(posedge clk) begin
+           tregs_first_write <= 0;
+
+           if (reset) begin
+                   tregs_status  <= 1'b0;
+                   tregs_pending <= 1'b0;
+                   tregs_writes  <= 16'h0;
+                   tregs_frames  <= 8'h0;
+           end else begin
+                   if (tregs_write) begin
+                           if (!tregs_pending) begin
+                                   tregs_pending     <= 1;
+                                   tregs_first_write <= 1;
+                                   tregs_wr_ctr      <= 1;
+                                   tregs_fr_ctr      <= 0;
+                           end else if (tregs_wr_ctr != 16'hffff) begin
+                                   tregs_wr_ctr      <= tregs_wr_ctr + 1;
+                           end
+                           tregs_quiet <= 0;
+
+                   end else if (tregs_pending) begin
+                           if (flybk_start) begin
+                                   if (tregs_quiet != 4'hf)
+                                     tregs_quiet  <= tregs_quiet + 1;
+                                   if (tregs_fr_ctr != 8'hff)
+                                     tregs_fr_ctr <= tregs_fr_ctr + 1;
+
+                           end else if ((tregs_quiet >= tregs_settle_frames) &&
+                                        (tregs_status_ack == tregs_status)) begin
+                                   tregs_status  <= ~tregs_status;
+                                   tregs_pending <= 0;
+                                   tregs_writes  <= tregs_wr_ctr;
+                                   tregs_frames  <= tregs_fr_ctr;
+                           end
+                   end
+           end
+   end
+
+
    // Now we know when DMA is being transferred, and have the data:
    assign load_dma              = !reset && (v_state == 1) && vdak_rising_edge;
    assign load_dma_cursor       = !reset && (v_state == 2) && vdak_rising_edge;
+   assign load_dma_sound        = !reset && s_state && sdak_rising_edge;
    assign load_dma_data 	= vidc_d_hist[2];
 
 endmodule // vidc_capture
@@ -36,31 +36,37 @@ module video(input wire		      clk,
              // Register access
              input wire [31:0]        reg_wdata,
              output wire [31:0]       reg_rdata,
-             input wire [5:0]         reg_addr, /* Note 1:0 ignored */
+             input wire [7:0]         reg_addr, /* Note 1:0 ignored */
              input wire               reg_wstrobe,
 
              // DMA
              input wire               load_dma,
              input wire               load_dma_cursor,
              input wire [31:0]        load_dma_data,
-             // Config
-             input wire [10:0]        v_cursor_x, // Note, raw
-             input wire [9:0]         v_cursor_y,
-             input wire [9:0]         v_cursor_yend,
-
-             input wire [(16*12)-1:0] vidc_palette,
-             input wire [(3*12)-1:0]  vidc_cursor_palette,
-
-             input wire               vidc_special_written,
-             input wire [23:0]        vidc_special,
-             input wire [23:0]        vidc_special_data,
+             // Palette/cursor writes, with raster position (see vidc_capture)
+             input wire               vw_write,
+             input wire [8:0]         vw_idx,
+             input wire [31:0]        vw_data,
+             input wire [1:0]         vw_frame,
+             input wire [9:0]         vw_line,
+             input wire [12:0]        vw_cycles,
+             input wire [1:0]         vidc_frame,
 
              input wire               vidc_tregs_status,
              output reg               vidc_tregs_ack,
+             output reg [3:0]         vidc_tregs_settle,
+             input wire               vidc_tregs_first_write,
+             input wire [15:0]        vidc_tregs_writes,
+             input wire [7:0]         vidc_tregs_frames,
+
+             // Interrupt to the CPU (level, active high)
+             output wire              irq,
 
              // Pixel/shift clock-related signals
              input wire               clk_pixel,
              input wire               clk_shift,
+             output wire [1:0]        clk_pixel_sel,
+             input wire [2:0]         clk_pixel_avail,
              // Video data output:
              output wire [7:0]        video_r,
              output wire [7:0]        video_g,
@@ -74,13 +80,52 @@ module video(input wire		      clk,
 
              // Async
              input wire               sync_flybk,
+             input wire               sync_nhs,
+
+             // SDRAM controller, for the frame store
+             output wire              mem_req_valid,
+             output wire              mem_req_write,
+             output wire [20:0]       mem_req_addr,
+             output wire [127:0]      mem_req_wdata,
+             output wire [3:0]        mem_req_wmask,
+             input wire               mem_req_ready,
+             input wire               mem_rd_valid,
+             input wire [31:0]        mem_rd_data,
+             input wire               mem_init_done,
 
              // Export some interesting config stuff:
              output wire              is_hires
              );
 
+   parameter PIXELS_PER_CLK = 1;    // Output pipeline width, see video_timing
+   parameter LB_ADDR_BITS = 9;      // Line buffer/max line length 2^n words
+
+`ifdef INCLUDE_HIGH_COLOUR
+   localparam HAS_HIGH_COLOUR = 1'b1;
+`else
+   localparam HAS_HIGH_COLOUR = 1'b0;
+`endif
+
+   /* The reset timing's pixel clock (see clocks.v), and line at that: */
+`ifdef SIM
+   localparam RESET_PCLK = 0;       // 24MHz
+   localparam RESET_HTOTAL = 768;
+`else
+   localparam RESET_PCLK = 1;       // 48MHz
+   localparam RESET_HTOTAL = 1536;
+`endif
+
    ////////////////////////////////////////////////////////////////////////////////
    // Output video timing configuration registers:
+   //
+   // These are shadow registers; writes don't affect the output until a sync
+   // or commit request (in the SYNC register) copies the whole set into the
+   // active registers below.  A sync restarts the output at VIDC's next
+   // flyback, whereas a commit is applied by the timing generator at the end
+   // of the current output frame without losing sync, for changes that don't
+   // alter the frame timing (BPP, words per line, scaling, cursor offset,
+   // phase, line lock).  The scaler registers change the frame timing, so
+   // need a sync.
 
    // FIXME: vs/hs params can all be smaller!
    reg [10:0]           c_res_x;
@@ -93,11 +138,31 @@ module video(input wire		      clk,
    reg [10:0]           c_vs_bp;
    reg 			c_sync;
    reg                  c_hires;
-   reg [7:0]            c_wpl_m1;
+   reg [9:0]            c_wpl_m1;
    reg [2:0]            c_bpp;
-   reg                  c_double_x;
-   reg                  c_double_y;
+   reg [1:0]            c_scale_x;      // Factor - 1
+   reg [1:0]            c_scale_y;
    reg [10:0]           c_cursor_x_offset;
+   reg                  c_commit;
+   reg                  c_fs_enable;
+   reg [1:0]            c_pclk_sel;
+   reg                  c_load_active;
+   reg [19:0]           c_raster_scale;
+   reg [10:0]           c_raster_offset;
+   reg [15:0]           c_phase;
+   reg                  c_line_lock;
+   reg                  c_scaler;
+   reg [23:0]           c_fill;
+   reg [15:0]           c_step_x;
+   reg [15:0]           c_step_y;
+   reg [10:0]           c_img_x;
+   reg [10:0]           c_img_w;
+   reg [10:0]           c_img_y;
+   reg [10:0]           c_img_h;
+   reg [23:0]           c_fl_lead;
+
+   wire                 c_commit_ack;
+   wire                 c_commit_pending = c_commit != c_commit_ack;
 
    always @(posedge clk) begin
            if (reset) begin
@@ -128,10 +193,12 @@ module video(input wire		      clk,
                    c_vs_width        <= 3;
                    c_vs_bp           <= 47;
                    c_cursor_x_offset <= (11'h44*4);
+                   c_pclk_sel        <= 2; // 78MHz
                    c_hires           <= 1;
                    c_bpp             <= 0; // log2 of
-                   c_double_x        <= 0;
-                   c_double_y        <= 0;
+                   c_scale_x         <= 0;
+                   c_scale_y         <= 0;
+                   c_phase           <= 1152+122; // One line
 `else // !`ifdef HIRES_MODE
                    // Roughly, mode 12 as somewhere to start:
                    c_wpl_m1          <= (640/2/4)-1;
@@ -139,45 +206,81 @@ module video(input wire		      clk,
                    c_res_y           <= 256;
                    c_hs_fp           <= 40;
                    c_hs_width        <= 20;
-                   c_hs_bp           <= 768-640-40-20;
+                   c_hs_bp           <= RESET_HTOTAL-640-40-20;
                    c_vs_fp           <= 40;
                    c_vs_width        <= 5;
                    c_vs_bp           <= 624-512-5-40;
                    c_cursor_x_offset <= 217;
+                   c_pclk_sel        <= RESET_PCLK;
                    c_hires           <= 0;
                    c_bpp             <= 2; // log2 of
-                   c_double_x        <= 0;
-                   c_double_y        <= 1;
+                   c_scale_x         <= 0;
+                   c_scale_y         <= 1;
+                   c_phase           <= RESET_HTOTAL*2; // Two (doubled) lines
 `endif // !`ifdef HIRES_MODE
 
                    c_sync            <= 0;
+                   c_commit          <= 0;
+                   c_fs_enable       <= 0;
+                   c_load_active     <= 1;
                    vidc_tregs_ack    <= 0;
+                   vidc_tregs_settle <= 2;
+                   c_raster_scale    <= 0;
+                   c_raster_offset   <= 0;
+                   c_line_lock       <= 0;
+                   c_scaler          <= 0;
+                   c_fill            <= 0;
 
            end else if (reg_wstrobe) begin
-                   case (reg_addr[5:2])
-                     4'h0: begin
+                   c_load_active <= 0;
+                   case (reg_addr[7:2])
+                     6'h00: begin
                              c_res_x    <= reg_wdata[10:0];
-                             c_double_x <= reg_wdata[31];
+                             c_scale_x  <= reg_wdata[31:30];
                      end
-                     4'h1:      c_hs_fp                      <= reg_wdata[10:0];
-                     4'h2:      c_hs_width                   <= reg_wdata[10:0];
-                     4'h3:      c_hs_bp                      <= reg_wdata[10:0];
-                     4'h4: begin
+                     6'h01:      c_hs_fp                      <= reg_wdata[10:0];
+                     6'h02:      c_hs_width                   <= reg_wdata[10:0];
+                     6'h03:      c_hs_bp                      <= reg_wdata[10:0];
+                     6'h04: begin
                              c_res_y    <= reg_wdata[10:0];
-                             c_double_y <= reg_wdata[31];
+                             c_scale_y  <= reg_wdata[31:30];
                      end
-                     4'h5:      c_vs_fp                      <= reg_wdata[10:0];
-                     4'h6:      c_vs_width                   <= reg_wdata[10:0];
-                     4'h7:      c_vs_bp                      <= reg_wdata[10:0];
-                     4'h8: begin
+                     6'h05:      c_vs_fp                      <= reg_wdata[10:0];
+                     6'h06:      c_vs_width                   <= reg_wdata[10:0];
+                     6'h07:      c_vs_bp                      <= reg_wdata[10:0];
+                     6'h08: begin
                              c_sync         <= reg_wdata[0];
                              vidc_tregs_ack <= reg_wdata[2];
+                             /* The active registers mustn't change while a
+                              * commit is in flight, so a second is ignored:
+                              */
+                             if (!c_commit_pending)
+                               c_commit     <= reg_wdata[5];
+                             c_load_active  <= (reg_wdata[0] != c_sync) ||
+                                               (reg_wdata[5] != c_commit &&
+                                                !c_commit_pending);
                      end
-                     4'h9:	c_wpl_m1                     <= reg_wdata[7:0];
-                     4'ha:	{c_hires, c_bpp,
+                     6'h09:	c_wpl_m1                     <= reg_wdata[9:0];
+                     6'h0a:	{c_hires, c_bpp,
                                  c_cursor_x_offset} <= { reg_wdata[31:28],
                                                          reg_wdata[10:0] };
+                     6'h0f:      vidc_tregs_settle            <= reg_wdata[3:0];
+                     6'h10:      c_fs_enable                  <= reg_wdata[0];
+                     6'h14:      c_pclk_sel                   <= reg_wdata[1:0];
+                     6'h16:      {c_raster_offset,
+                                  c_raster_scale}             <= reg_wdata[30:0];
+                     6'h1e: begin
+                             c_phase     <= reg_wdata[15:0];
+                             c_line_lock <= reg_wdata[31];
+                     end
+                     6'h20:      {c_scaler, c_fill}           <= {reg_wdata[31], reg_wdata[23:0]};
+                     6'h21:      {c_step_y, c_step_x}         <= reg_wdata;
+                     6'h22:      {c_img_w, c_img_x}           <= {reg_wdata[26:16], reg_wdata[10:0]};
+                     6'h23:      {c_img_h, c_img_y}           <= {reg_wdata[26:16], reg_wdata[10:0]};
+                     6'h24:      c_fl_lead                    <= reg_wdata[23:0];
                    endcase
+           end else begin
+                   c_load_active <= 0;
            end
    end
 
@@ -189,6 +292,92 @@ module video(input wire		      clk,
    end
    wire c_sync_ack      	= sync_ack_ss[1];
 
+   // Synchroniser for commit_ack from the clk_pixel domain:
+   wire c_commit_ack_p;
+   reg [1:0] commit_ack_ss;
+   always @(posedge clk) begin
+           commit_ack_ss 	<= {commit_ack_ss[0], c_commit_ack_p};
+   end
+   assign c_commit_ack 	= commit_ack_ss[1];
+
+   /* Active registers, as seen by the output.  These are loaded the cycle
+    * after a sync/commit request, and the request is passed on to the
+    * timing generator at the same time, so that the values are stable by the
+    * time it sees the request (via its synchroniser) and samples them.
+    *
+    * Whilst a sync is outstanding, the timing generator is held in reset
+    * and samples its config continuously, so the active registers follow
+    * the shadows then (as the raw registers used to); reprogramming during
+    * a sync needn't request another.
+    */
+   reg [10:0]           a_res_x;
+   reg [10:0]           a_hs_fp;
+   reg [10:0]           a_hs_width;
+   reg [10:0]           a_hs_bp;
+   reg [10:0]           a_res_y;
+   reg [10:0]           a_vs_fp;
+   reg [10:0]           a_vs_width;
+   reg [10:0]           a_vs_bp;
+   reg 			a_sync;
+   reg                  a_commit;
+   reg                  a_hires;
+   reg [9:0]            a_wpl_m1;
+   reg [2:0]            a_bpp;
+   reg [1:0]            a_scale_x;
+   reg [1:0]            a_scale_y;
+   reg [10:0]           a_cursor_x_offset;
+   reg                  a_fs_enable;
+   reg [1:0]            a_pclk_sel;
+   reg [15:0]           a_phase;
+   reg                  a_line_lock;
+   reg                  a_scaler;
+   reg [23:0]           a_fill;
+   reg [15:0]           a_step_x;
+   reg [15:0]           a_step_y;
+   reg [10:0]           a_img_x;
+   reg [10:0]           a_img_w;
+   reg [10:0]           a_img_y;
+   reg [10:0]           a_img_h;
+   reg [23:0]           a_fl_lead;
+   reg [19:0]           a_raster_scale;
+   reg [10:0]           a_raster_offset;
+
+   always @(posedge clk) begin
+           if (c_load_active || a_sync != c_sync_ack) begin
+                   a_res_x              <= c_res_x;
+                   a_hs_fp              <= c_hs_fp;
+                   a_hs_width           <= c_hs_width;
+                   a_hs_bp              <= c_hs_bp;
+                   a_res_y              <= c_res_y;
+                   a_vs_fp              <= c_vs_fp;
+                   a_vs_width           <= c_vs_width;
+                   a_vs_bp              <= c_vs_bp;
+                   a_hires              <= c_hires;
+                   a_wpl_m1             <= c_wpl_m1;
+                   a_bpp                <= c_bpp;
+                   a_scale_x            <= c_scale_x;
+                   a_scale_y            <= c_scale_y;
+                   a_cursor_x_offset    <= c_cursor_x_offset;
+                   a_fs_enable          <= c_fs_enable;
+                   a_pclk_sel           <= c_pclk_sel;
+                   a_phase              <= c_phase;
+                   a_line_lock          <= c_line_lock;
+                   a_scaler             <= c_scaler;
+                   a_fill               <= c_fill;
+                   a_step_x             <= c_step_x;
+                   a_step_y             <= c_step_y;
+                   a_img_x              <= c_img_x;
+                   a_img_w              <= c_img_w;
+                   a_img_y              <= c_img_y;
+                   a_img_h              <= c_img_h;
+                   a_fl_lead            <= c_fl_lead;
+                   a_raster_scale       <= c_raster_scale;
+                   a_raster_offset      <= c_raster_offset;
+                   a_sync               <= c_sync;
+                   a_commit             <= c_commit;
+           end
+   end
+
    // Synchroniser for flyback:
    reg [1:0] sync_flybk_ss;
    always @(posedge clk) begin
@@ -196,77 +385,410 @@ module video(input wire		      clk,
    end
    wire c_flybk         	= sync_flybk_ss[1];
 
-   assign reg_rdata 		= reg_addr[5:2] == 4'h0 ? {c_double_x, 20'h0, c_res_x} :
-                                  reg_addr[5:2] == 4'h1 ? {21'h0, c_hs_fp} :
-                                  reg_addr[5:2] == 4'h2 ? {21'h0, c_hs_width} :
-                                  reg_addr[5:2] == 4'h3 ? {21'h0, c_hs_bp} :
-                                  reg_addr[5:2] == 4'h4 ? {c_double_y, 20'h0, c_res_y} :
-                                  reg_addr[5:2] == 4'h5 ? {21'h0, c_vs_fp} :
-                                  reg_addr[5:2] == 4'h6 ? {21'h0, c_vs_width} :
-                                  reg_addr[5:2] == 4'h7 ? {21'h0, c_vs_bp} :
-                                  reg_addr[5:2] == 4'h8 ? {27'h0, c_flybk,
+   ////////////////////////////////////////////////////////////////////////////////
+   // Frame store
+   //
+   // When enabled, VIDC's frames are stored in SDRAM and the output free-runs
+   // at its own frame rate, fetching lines as needed (see frame_store.v).  It
+   // follows the active config, so is enabled/disabled with a sync.
+
+   wire                 fs_line_req;
+   wire [9:0]           fs_line;
+   wire                 fs_lb_write;
+   wire [10:0]          fs_lb_addr;
+   wire [31:0]          fs_lb_data;
+   wire [1:0]           fs_wbuf;
+   wire [1:0]           fs_rbuf;
+   wire [1:0]           fs_ready_buf;
+   wire                 fs_ready_valid;
+   wire [15:0]          fs_in_frames;
+   wire [15:0]          fs_out_frames;
+   wire [15:0]          fs_dropped;
+   wire [15:0]          fs_repeated;
+   wire [15:0]          fs_overflows;
+
+   frame_store #(.LB_ADDR_BITS(LB_ADDR_BITS))
+               FS(.clk(clk),
+                  .reset(reset),
+
+                  .enable(a_fs_enable && mem_init_done),
+                  .wpl_m1(a_wpl_m1),
+                  .flybk(c_flybk),
+
+                  .load_dma(load_dma),
+                  .load_dma_data(load_dma_data),
+
+                  .line_req(fs_line_req),
+                  .line_req_num(fs_line),
+
+                  .lb_write(fs_lb_write),
+                  .lb_addr(fs_lb_addr),
+                  .lb_data(fs_lb_data),
+
+                  .mem_req_valid(mem_req_valid),
+                  .mem_req_write(mem_req_write),
+                  .mem_req_addr(mem_req_addr),
+                  .mem_req_wdata(mem_req_wdata),
+                  .mem_req_wmask(mem_req_wmask),
+                  .mem_req_ready(mem_req_ready),
+                  .mem_rd_valid(mem_rd_valid),
+                  .mem_rd_data(mem_rd_data),
+
+                  .wbuf(fs_wbuf),
+                  .rbuf(fs_rbuf),
+                  .ready_buf(fs_ready_buf),
+                  .ready_valid(fs_ready_valid),
+                  .in_frames(fs_in_frames),
+                  .out_frames(fs_out_frames),
+                  .dropped(fs_dropped),
+                  .repeated(fs_repeated),
+                  .overflows(fs_overflows)
+                  );
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Palette/cursor write replay
+   //
+   // VIDC palette and cursor writes are queued for the output to apply at the
+   // same raster position as VIDC did (see video_timing).  The position within
+   // a line comes in clk cycles since hsync; it's converted to pixels of the
+   // output's line (from its start of display) using a scale and offset set
+   // up by the MCU for the mode:  pixels = (cycles * scale)/65536 - offset.
+   // A scale of 0 puts every write at the start of its line.  They're active
+   // registers, so change with the output timing they describe.
+   //
+   // The queue's fill level is watched, with its high-water mark and the
+   // number of writes lost (queue full) kept for the MCU; writing the status
+   // register clears them.
+
+   wire [32:0]          vw_x_scaled     = vw_cycles * a_raster_scale;
+   wire [16:0]          vw_x_raw        = vw_x_scaled[32:16];
+   wire [10:0]          vw_x            = (vw_x_raw < a_raster_offset) ? 11'h0 :
+                                          (vw_x_raw - a_raster_offset > 17'h7ff) ? 11'h7ff :
+                                          vw_x_raw - a_raster_offset;
+
+   wire                 rq_full;
+   wire [7:0]           rq_level;
+   reg [7:0]            rq_max;
+   reg [15:0]           rq_overflows;
+
+   always @(posedge clk) begin
+           if (reset || (reg_wstrobe && reg_addr[7:2] == 6'h17)) begin
+                   rq_max       <= 8'h0;
+                   rq_overflows <= 16'h0;
+           end else begin
+                   if (rq_level > rq_max)
+                     rq_max     <= rq_level;
+                   if (vw_write && rq_full && rq_overflows != 16'hffff)
+                     rq_overflows <= rq_overflows + 1;
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Latency/slack statistics
+   //
+   // video_timing measures, each output frame, the latency from VIDC's
+   // flyback to the output's display, and the slack between the DMA writing
+   // the line buffer and the scan-out reading it (see there).  Its snapshot
+   // is stable for a frame after stats_toggle toggles, so is copied here
+   // once the toggle has been synchronised.  The per-frame histograms are
+   // accumulated (saturating) with a count of frames, and an underrun is
+   // flagged if any line's slack reached 0; writing the latency register
+   // clears these.  The line and frame lock counts are just the last frame's.
+
+   wire                 stats_toggle_p;
+   wire [23:0]          stats_latency;
+   wire [15:0]          stats_slack_min;
+   wire [15:0]          stats_slack_max;
+   wire [(7*11)-1:0]    stats_slack_hist;
+   wire [31:0]          stats_line_lock;
+   wire [7:0]           stats_frame_lock;
+
+   reg [2:0]            stats_ss;       // Synchroniser and 'last' value
+   reg [23:0]           s_latency;
+   reg [15:0]           s_slack_min;
+   reg [15:0]           s_slack_max;
+   reg [(8*16)-1:0]     s_hist;         // 7 bins, then frames
+   reg                  s_underrun;
+   reg [31:0]           s_line_lock;
+   reg [7:0]            s_frame_lock;
+   integer              si;
+
+   wire                 stats_clear     = reg_wstrobe && reg_addr[7:2] == 6'h18;
+
+   always @(posedge clk) begin
+           stats_ss     <= {stats_ss[1:0], stats_toggle_p};
+
+           if (reset || stats_clear) begin
+                   s_hist       <= 0;
+                   s_underrun   <= 0;
+           end else if (stats_ss[2] != stats_ss[1]) begin
+                   s_latency    <= stats_latency;
+                   s_slack_min  <= stats_slack_min;
+                   s_slack_max  <= stats_slack_max;
+                   s_line_lock  <= stats_line_lock;
+                   s_frame_lock <= stats_frame_lock;
+                   for (si = 0; si < 7; si = si + 1) begin
+                           if ({5'h0, s_hist[(16*si) +: 16]} + stats_slack_hist[(11*si) +: 11] > 17'hffff)
+                             s_hist[(16*si) +: 16] <= 16'hffff;
+                           else
+                             s_hist[(16*si) +: 16] <= s_hist[(16*si) +: 16] +
+                                                      stats_slack_hist[(11*si) +: 11];
+                   end
+                   if (s_hist[(16*7) +: 16] != 16'hffff)
+                     s_hist[(16*7) +: 16] <= s_hist[(16*7) +: 16] + 1;
+                   if (stats_slack_hist[10:0] != 0)
+                     s_underrun <= 1;
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Interrupts:
+   //
+   // Status bits are set on an event (whether or not masked), and are cleared
+   // by writing 1 to them.  The IRQ output is the OR of status bits enabled in
+   // the mask.  The events are:
+   // 0: VIDC timing register status toggled (a batch of timing register
+   //    writes has settled, see vidc_capture)
+   // 1: Flyback start
+   // 2: Flyback end
+   // 3: Frame sync ack (the sync requested via c_sync has completed)
+   // 4: Commit ack (the commit requested via c_commit has been applied)
+   //
+   // A free-running timestamp is also provided, with a copy latched at the
+   // first VIDC timing register write of a batch, so that the time from the
+   // VIDC write to the firmware reprogramming the output timing can be
+   // measured.
+
+   reg [4:0]            c_irq_status;
+   reg [4:0]            c_irq_mask;
+   reg [31:0]           c_timestamp;
+   reg [31:0]           c_tregs_timestamp;
+   reg                  last_tregs_status;
+   reg                  last_flybk;
+   reg                  last_sync_ack;
+   reg                  last_commit_ack;
+
+   wire                 ev_tregs        = vidc_tregs_status != last_tregs_status;
+   wire                 ev_flybk_start  = c_flybk && !last_flybk;
+   wire                 ev_flybk_end    = !c_flybk && last_flybk;
+   wire                 ev_sync_ack     = c_sync_ack != last_sync_ack;
+   wire                 ev_commit_ack   = c_commit_ack != last_commit_ack;
+   wire [4:0]           irq_events      = {ev_commit_ack, ev_sync_ack, ev_flybk_end,
+                                           ev_flybk_start, ev_tregs};
+   wire [4:0]           irq_clear       = (reg_wstrobe && reg_addr[7:2] == 6'h0b) ?
+                                          reg_wdata[4:0] : 5'h0;
+
+   always @(posedge clk) begin
+           last_tregs_status    <= vidc_tregs_status;
+           last_flybk           <= c_flybk;
+           last_sync_ack        <= c_sync_ack;
+           last_commit_ack      <= c_commit_ack;
+
+           if (vidc_tregs_first_write)
+             c_tregs_timestamp  <= c_timestamp;
+
+           if (reset) begin
+                   c_irq_status <= 5'h0;
+                   c_irq_mask   <= 5'h0;
+                   c_timestamp  <= 32'h0;
+           end else begin
+                   c_timestamp  <= c_timestamp + 1;
+                   // A new event wins over a simultaneous clear:
+                   c_irq_status <= (c_irq_status & ~irq_clear) | irq_events;
+
+                   if (reg_wstrobe && reg_addr[7:2] == 6'h0c)
+                     c_irq_mask <= reg_wdata[4:0];
+           end
+   end
+
+   assign irq                   = |(c_irq_status & c_irq_mask);
+
+   assign reg_rdata 		= reg_addr[7:2] == 6'h00 ? {c_scale_x, 19'h0, c_res_x} :
+                                  reg_addr[7:2] == 6'h01 ? {21'h0, c_hs_fp} :
+                                  reg_addr[7:2] == 6'h02 ? {21'h0, c_hs_width} :
+                                  reg_addr[7:2] == 6'h03 ? {21'h0, c_hs_bp} :
+                                  reg_addr[7:2] == 6'h04 ? {c_scale_y, 19'h0, c_res_y} :
+                                  reg_addr[7:2] == 6'h05 ? {21'h0, c_vs_fp} :
+                                  reg_addr[7:2] == 6'h06 ? {21'h0, c_vs_width} :
+                                  reg_addr[7:2] == 6'h07 ? {21'h0, c_vs_bp} :
+                                  reg_addr[7:2] == 6'h08 ? {25'h0, c_commit_ack, c_commit, c_flybk,
                                                            vidc_tregs_status, vidc_tregs_ack,
                                                            c_sync_ack, c_sync} :
-                                  reg_addr[5:2] == 4'h9 ? {24'h0, c_wpl_m1} :
-                                  reg_addr[5:2] == 4'ha ? {c_hires, c_bpp, 17'h0, c_cursor_x_offset} :
+                                  reg_addr[7:2] == 6'h09 ? {22'h0, c_wpl_m1} :
+                                  reg_addr[7:2] == 6'h0a ? {c_hires, c_bpp, 17'h0, c_cursor_x_offset} :
+                                  reg_addr[7:2] == 6'h0b ? {27'h0, c_irq_status} :
+                                  reg_addr[7:2] == 6'h0c ? {27'h0, c_irq_mask} :
+                                  reg_addr[7:2] == 6'h0d ? c_timestamp :
+                                  reg_addr[7:2] == 6'h0e ? c_tregs_timestamp :
+                                  reg_addr[7:2] == 6'h0f ? {vidc_tregs_frames, vidc_tregs_writes,
+                                                           4'h0, vidc_tregs_settle} :
+                                  reg_addr[7:2] == 6'h10 ? {31'h0, c_fs_enable} :
+                                  reg_addr[7:2] == 6'h11 ? {mem_init_done, 7'h0, fs_overflows[15:0],
+                                                           1'b0, fs_ready_valid, fs_ready_buf,
+                                                           fs_rbuf, fs_wbuf} :
+                                  reg_addr[7:2] == 6'h12 ? {fs_out_frames, fs_in_frames} :
+                                  reg_addr[7:2] == 6'h13 ? {fs_repeated, fs_dropped} :
+                                  reg_addr[7:2] == 6'h14 ? {21'h0, clk_pixel_avail,
+                                                           6'h0, c_pclk_sel} :
+                                  reg_addr[7:2] == 6'h15 ? {22'h0, PIXELS_PER_CLK[1:0],
+                                                           2'h0, HAS_HIGH_COLOUR, HAS_HIGH_COLOUR,
+                                                           LB_ADDR_BITS[3:0]} :
+                                  reg_addr[7:2] == 6'h16 ? {1'b0, c_raster_offset, c_raster_scale} :
+                                  reg_addr[7:2] == 6'h17 ? {rq_level, rq_max, rq_overflows} :
+                                  reg_addr[7:2] == 6'h18 ? {s_underrun, 7'h0, s_latency} :
+                                  reg_addr[7:2] == 6'h19 ? {s_slack_max, s_slack_min} :
+                                  reg_addr[7:2] == 6'h1a ? s_hist[31:0] :
+                                  reg_addr[7:2] == 6'h1b ? s_hist[63:32] :
+                                  reg_addr[7:2] == 6'h1c ? s_hist[95:64] :
+                                  reg_addr[7:2] == 6'h1d ? s_hist[127:96] :
+                                  reg_addr[7:2] == 6'h1e ? {c_line_lock, 15'h0, c_phase} :
+                                  reg_addr[7:2] == 6'h1f ? s_line_lock :
+                                  reg_addr[7:2] == 6'h20 ? {c_scaler, 7'h0, c_fill} :
+                                  reg_addr[7:2] == 6'h21 ? {c_step_y, c_step_x} :
+                                  reg_addr[7:2] == 6'h22 ? {5'h0, c_img_w, 5'h0, c_img_x} :
+                                  reg_addr[7:2] == 6'h23 ? {5'h0, c_img_h, 5'h0, c_img_y} :
+                                  reg_addr[7:2] == 6'h24 ? {s_frame_lock, c_fl_lead} :
                                   32'h0;
 
-   assign is_hires 	 	= c_hires;
-
-   // Apply magic number to move the cursor.  FIXME, derive this from VIDC regs...
-   wire [10:0] norm_cursor_x  	= v_cursor_x - c_cursor_x_offset;
+   assign is_hires 	 	= a_hires;
 
+   /* The pixel clock changes as the active registers are loaded.  That's
+    * only sensible on a sync (which restarts the output anyway); the clock
+    * muxes stop the clock for a few cycles, and a commit would be lost.
+    */
+   assign clk_pixel_sel 	= a_pclk_sel;
 
    ////////////////////////////////////////////////////////////////////////////////
    // Video & timing generator
 
-   video_timing VTI(
+   /* With two pixels per clock, video_timing is enabled on every other
+    * clk_pixel edge (vt_ce), and its pairs of pixels are serialised here.
+    * This stays outside video_timing, as its paths are single-cycle.
+    */
+   reg                          vt_ce;
+   wire [7:0]                   vt_r, vt_g, vt_b;
+   wire [23:0]                  vt_rgb_2nd;
+   wire                         vt_hsync, vt_vsync, vt_blank;
+
+   initial vt_ce = 0;
+
+   video_timing #(.PIXELS_PER_CLK(PIXELS_PER_CLK),
+                  .LB_ADDR_BITS(LB_ADDR_BITS))
+                VTI(
                     .pclk(clk_pixel),
+                    .pce(vt_ce),
 
-                    .o_r(video_r),
-                    .o_g(video_g),
-                    .o_b(video_b),
-                    .o_hsync(video_hsync),
-                    .o_vsync(video_vsync),
-                    .o_blank(video_blank),
+                    .o_r(vt_r),
+                    .o_g(vt_g),
+                    .o_b(vt_b),
+                    .o_hsync(vt_hsync),
+                    .o_vsync(vt_vsync),
+                    .o_blank(vt_blank),
+                    .o_rgb_2nd(vt_rgb_2nd),
 
                     .load_dma_clk(clk),
                     .load_dma(load_dma),
                     .load_dma_cursor(load_dma_cursor),
                     .load_dma_data(load_dma_data),
 
-                    .vidc_palette(vidc_palette),
-                    .vidc_cursor_palette(vidc_cursor_palette),
-
-                    .vidc_special_written(vidc_special_written),
-                    .vidc_special(vidc_special),
-                    .vidc_special_data(vidc_special_data),
-
-                    .v_cursor_x(norm_cursor_x),
-                    .v_cursor_y(v_cursor_y),
-                    .v_cursor_yend(v_cursor_yend),
-
-                    .t_horiz_res(c_res_x),
-                    .t_horiz_fp(c_hs_fp),
-                    .t_horiz_sync_width(c_hs_width),
-                    .t_horiz_bp(c_hs_bp),
-
-                    .t_vert_res(c_res_y),
-                    .t_vert_fp(c_vs_fp),
-                    .t_vert_sync_width(c_vs_width),
-                    .t_vert_bp(c_vs_bp),
-
-                    .t_words_per_line_m1(c_wpl_m1),
-                    .t_hires(c_hires),
-                    .t_bpp(c_bpp),
-                    .t_double_x(c_double_x),
-                    .t_double_y(c_double_y),
+                    .fs_enable(a_fs_enable),
+                    .fs_load(fs_lb_write),
+                    .fs_load_addr(fs_lb_addr),
+                    .fs_load_data(fs_lb_data),
+                    .fs_line_req(fs_line_req),
+                    .fs_line(fs_line),
+
+                    .vw_write(vw_write),
+                    .vw_idx(vw_idx),
+                    .vw_data(vw_data),
+                    .vw_frame(vw_frame),
+                    .vw_line(vw_line),
+                    .vw_x(vw_x),
+                    .vidc_frame(vidc_frame),
+                    .rq_full(rq_full),
+                    .rq_level(rq_level),
+
+                    .t_horiz_res(a_res_x),
+                    .t_horiz_fp(a_hs_fp),
+                    .t_horiz_sync_width(a_hs_width),
+                    .t_horiz_bp(a_hs_bp),
+
+                    .t_vert_res(a_res_y),
+                    .t_vert_fp(a_vs_fp),
+                    .t_vert_sync_width(a_vs_width),
+                    .t_vert_bp(a_vs_bp),
+
+                    .t_words_per_line_m1(a_wpl_m1),
+                    .t_hires(a_hires),
+                    .t_bpp(a_bpp),
+                    .t_scale_x(a_scale_x),
+                    .t_scale_y(a_scale_y),
+                    .t_cursor_x_offset(a_cursor_x_offset),
+                    .t_phase(a_phase),
+                    .t_line_lock(a_line_lock),
+                    .t_scaler(a_scaler),
+                    .t_step_x(a_step_x),
+                    .t_step_y(a_step_y),
+                    .t_img_x(a_img_x),
+                    .t_img_w(a_img_w),
+                    .t_img_y(a_img_y),
+                    .t_img_h(a_img_h),
+                    .t_fill(a_fill),
+                    .t_fl_lead(a_fl_lead),
 
                     .sync_flyback(sync_flybk),
-                    .config_sync_req(c_sync),
+                    .sync_hsync(sync_nhs),
+                    .config_sync_req(a_sync),
                     .config_sync_ack(c_sync_ack_p),
+                    .config_commit_req(a_commit),
+                    .config_commit_ack(c_commit_ack_p),
+
+                    .stats_toggle(stats_toggle_p),
+                    .stats_latency(stats_latency),
+                    .stats_slack_min(stats_slack_min),
+                    .stats_slack_max(stats_slack_max),
+                    .stats_slack_hist(stats_slack_hist),
+                    .stats_line_lock(stats_line_lock),
+                    .stats_frame_lock(stats_frame_lock),
 
                     .enable_test_card(enable_test_card)
                     );
 
+   generate if (PIXELS_PER_CLK == 2) begin: g_ser
+           /* video_timing's outputs change on the edge where vt_ce is high
+            * (which clears it); the next edge takes the pair, giving its
+            * first pixel, then the one after gives its second.
+            */
+           reg [23:0]   o_rgb;
+           reg [23:0]   o_rgb_second;
+           reg          o_hs, o_vs, o_blank;
+
+           always @(posedge clk_pixel) begin
+                   vt_ce                <= ~vt_ce;
+
+                   if (!vt_ce) begin
+                           o_rgb        <= {vt_b, vt_g, vt_r};
+                           o_rgb_second <= vt_rgb_2nd;
+                           o_hs         <= vt_hsync;
+                           o_vs         <= vt_vsync;
+                           o_blank      <= vt_blank;
+                   end else begin
+                           o_rgb        <= o_rgb_second;
+                   end
+           end
+
+           assign {video_b, video_g, video_r} = o_rgb;
+           assign video_hsync   = o_hs;
+           assign video_vsync   = o_vs;
+           assign video_blank   = o_blank;
+   end else begin: g_ser
+           assign {video_b, video_g, video_r} = {vt_b, vt_g, vt_r};
+           assign video_hsync   = vt_hsync;
+           assign video_vsync   = vt_vsync;
+           assign video_blank   = vt_blank;
+   end endgenerate
+
 endmodule
@@ -4,7 +4,30 @@
  *
  * Timing is dynamically provided (possibly from another clock domain)
  * with an update handshake.  The handshake synchronises the scan-out
- * to an async input flyback signal's falling edge (a bit like a genlock).
+ * to an async input flyback signal's falling edge (a bit like a genlock),
+ * with a programmable phase (the output's lag behind the input).  Optionally,
+ * each line is then locked to the input's hsync too (see "Line lock").
+ *
+ * The output pipeline can process one or two pixels per clock (parameter
+ * PIXELS_PER_CLK).  With two, it only advances on every other pixel clock,
+ * and the parent serialises its pairs of pixels; that's much easier to meet
+ * timing at for high-resolution modes, but costs a second copy of the pixel
+ * selection, palette and cursor logic.
+ *
+ * The line buffer holds two lines of up to 2^LB_ADDR_BITS words (parameter,
+ * up to 10).  Pixels and lines can be repeated 1-4 times each (t_scale_x/y,
+ * the factor minus one), since a line is only needed for one input line
+ * period however many times it's output; with two pixels per clock, an X
+ * factor of 3 (which would split pixels across pairs) is taken as 2.  With
+ * INCLUDE_HIGH_COLOUR, 16BPP (5:6:5) and packed 24BPP (bytes R, G, B) pixel
+ * formats are supported as well as VIDC's 1-8BPP.
+ *
+ * Alternatively, the scaler fits the input into a fixed output timing by
+ * fractional steps, frame-locked to VIDC (see "Scaler").
+ *
+ * It also measures how far behind VIDC the output runs, and how close the
+ * scan-out gets to the DMA writing the line buffer (see "Latency/slack
+ * statistics").
  *
  * 17 Nov 2021
  *
@@ -32,9 +55,10 @@
  */
 
 
-//`define INCLUDE_HIGH_COLOUR // Not finished!
+//`define INCLUDE_HIGH_COLOUR
 
 module video_timing(input wire        	     pclk,
+                    input wire               pce,           // See "Clocking"
                     output wire [7:0]        o_r,
                     output wire [7:0]        o_g,
                     output wire [7:0]        o_b,
@@ -42,6 +66,7 @@ module video_timing(input wire        	     pclk,
                     output wire              o_vsync,
                     output wire              o_blank,
                     output wire              o_de,
+                    output wire [23:0]       o_rgb_2nd,     // {b, g, r}, see "Outputs"
 
                     /* Dynamic timing configuration */
                     input wire [10:0]        t_horiz_res,
@@ -52,23 +77,43 @@ module video_timing(input wire        	     pclk,
                     input wire [10:0]        t_vert_fp,
                     input wire [10:0]        t_vert_sync_width,
                     input wire [10:0]        t_vert_bp,
-                    input wire [7:0]         t_words_per_line_m1,
+                    input wire [9:0]         t_words_per_line_m1,
                     input wire [2:0]         t_bpp,
                     input wire               t_hires,
-                    input wire               t_double_x,
-                    input wire               t_double_y,
-
-                    /* Per-frame dynamic stuff, e.g. cursor */
-                    input wire [10:0]        v_cursor_x,
-                    input wire [9:0]         v_cursor_y,
-                    input wire [9:0]         v_cursor_yend,
-
-                    input wire [(16*12)-1:0] vidc_palette,
-                    input wire [(3*12)-1:0]  vidc_cursor_palette,
-
-                    input wire               vidc_special_written,
-                    input wire [23:0]        vidc_special,
-                    input wire [23:0]        vidc_special_data,
+                    input wire [1:0]         t_scale_x,
+                    input wire [1:0]         t_scale_y,
+                    input wire [10:0]        t_cursor_x_offset,
+                    input wire [15:0]        t_phase,
+                    input wire               t_line_lock,
+
+                    /* Scaler:  fractional steps (2.14, input pixels/lines
+                     * per output pixel/line), the image's position in the
+                     * display, the border colour ({b, g, r}), and the frame
+                     * lock lead (pixels), see "Scaler"
+                     */
+                    input wire               t_scaler,
+                    input wire [15:0]        t_step_x,
+                    input wire [15:0]        t_step_y,
+                    input wire [10:0]        t_img_x,
+                    input wire [10:0]        t_img_w,
+                    input wire [10:0]        t_img_y,
+                    input wire [10:0]        t_img_h,
+                    input wire [23:0]        t_fill,
+                    input wire [23:0]        t_fl_lead,
+
+                    /* VIDC palette/cursor writes (in load_dma_clk domain),
+                     * with the input raster position they were made at (see
+                     * vidc_capture), and VIDC's current frame (Gray-coded)
+                     */
+                    input wire               vw_write,
+                    input wire [8:0]         vw_idx,
+                    input wire [31:0]        vw_data,
+                    input wire [1:0]         vw_frame,
+                    input wire [9:0]         vw_line,
+                    input wire [10:0]        vw_x,
+                    input wire [1:0]         vidc_frame,
+                    output wire              rq_full,       // load_dma_clk domain
+                    output wire [7:0]        rq_level,      // load_dma_clk domain
 
                     /* VIDC incoming data written to line buffer */
                     input wire               load_dma_clk,
@@ -76,18 +121,74 @@ module video_timing(input wire        	     pclk,
                     input wire               load_dma_cursor,
                     input wire [31:0]        load_dma_data,
 
-                    /* VIDC external flyback to sync to: */
+                    /* Frame store:  line buffer is written from here instead
+                     * (in load_dma_clk domain), and lines are requested by
+                     * number (toggle fs_line_req)
+                     */
+                    input wire               fs_enable,
+                    input wire               fs_load,
+                    input wire [10:0]        fs_load_addr, // {line[0], word}
+                    input wire [31:0]        fs_load_data,
+                    output reg               fs_line_req,
+                    output reg [9:0]         fs_line,
+
+                    /* VIDC external flyback to sync to, and hsync (nHS,
+                     * active low) for line lock:
+                     */
                     input wire               sync_flyback,
+                    input wire               sync_hsync,
 
                     /* Sync handshake (when t_* are stable) */
                     input wire               config_sync_req,
                     output reg               config_sync_ack,
 
+                    /* Commit handshake: apply t_* at the next frame boundary,
+                     * without resyncing (when t_* are stable)
+                     */
+                    input wire               config_commit_req,
+                    output reg               config_commit_ack,
+
+                    /* Latency/line buffer slack statistics for the last
+                     * frame, updated as stats_toggle toggles (see below)
+                     */
+                    output reg               stats_toggle,
+                    output reg [23:0]        stats_latency,
+                    output reg [15:0]        stats_slack_min,
+                    output reg [15:0]        stats_slack_max,
+                    output reg [(7*11)-1:0]  stats_slack_hist,
+                    output reg [31:0]        stats_line_lock,
+                    output reg [7:0]         stats_frame_lock,
+
                     input wire               enable_test_card
                     );
 
    parameter ctr_width_x	= 11;
    parameter ctr_width_y	= 11;
+   parameter PIXELS_PER_CLK	= 1;    // 1 or 2
+   parameter LB_ADDR_BITS	= 9;    // Line buffer: 2 lines of 2^n words
+   parameter RQ_DEPTH_BITS	= 5;    // Palette/cursor write queue: 2^n entries
+
+   localparam STEP_FRAC		= 14;   // Scaler step fraction bits
+
+   localparam LB_WORDS		= 1 << LB_ADDR_BITS;
+
+   /* Horizontal positions are in units of PIXELS_PER_CLK pixels: */
+   localparam HSHIFT		= (PIXELS_PER_CLK == 2) ? 1 : 0;
+
+   genvar                       lane;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Clocking
+
+   /* Everything runs on pclk.  With two pixels per clock, the pipeline only
+    * advances on the pclk edges where pce (from the parent) is high, every
+    * other one, so paths between its registers have two pclks and are
+    * declared multicycle for that build (see the Makefile).  The parent
+    * takes each pair on the next edge, and serialises it.  A "cycle" below
+    * is an enabled one.
+    */
+   wire                         vce = (PIXELS_PER_CLK == 2) ? pce : 1'b1;
 
 
    ////////////////////////////////////////////////////////////////////////////////
@@ -97,10 +198,25 @@ module video_timing(input wire        	     pclk,
     *
     * The purpose is to wait for the external flyback to finish, then
     * kick off the timing generator to bumble on, synchronised forever more.
+    * It's released at the start of its first display line, t_phase pixels
+    * after the flyback:  the phase must give the DMA time to get ahead of
+    * the scan-out.  A whole line (several when scaling) is always safe, as the
+    * DMA then has a line buffer to itself, but is usually more than needed.
+    * The line buffer holds two lines, so the phase can be up to one input
+    * line (the line being read would otherwise be overwritten).
+    *
+    * The phase can also change without a resync, via a commit:  at the next
+    * flyback, the timing generator is realigned (restarted at its first
+    * display line, after the new phase) without stopping the output, which
+    * just changes one frame's length by the difference.
+    *
+    * With the frame store, the output isn't synchronised to VIDC at all, so
+    * the timing generator is just restarted.  With the scaler, the frame
+    * lock follows a new phase within a frame or two, so there's no realign.
     */
    reg [1:0]    pclk_sync_req;
    reg [2:0]    pclk_sync_fb; // Synchroniser and 'last' value
-   always @(posedge pclk) begin
+   always @(posedge pclk) if (vce) begin
            pclk_sync_req 	<= {pclk_sync_req[0], config_sync_req};
            pclk_sync_fb 	<= {pclk_sync_fb[1:0], sync_flyback};
    end
@@ -112,68 +228,156 @@ module video_timing(input wire        	     pclk,
    reg          doing_resync;
    reg          vid_enable;
    reg [1:0] 	init_ctr;
+   reg [ctr_width_x+4:0] phase;         // Config, in units of PIXELS_PER_CLK
+   reg [ctr_width_x+4:0] phase_now;     // Phase the timing gen is aligned at
+   reg [ctr_width_x+4:0] phase_ctr;
+   reg          phase_wait;
+   reg          realign;        // Restart the timing gen, without resync
 
    initial begin // Bleh, add RESET pls
       config_sync_ack  <= 0;
+      config_commit_ack <= 0;
       doing_resync <= 0;
       vid_enable   <= 1;
+      phase_wait   <= 0;
+      realign      <= 0;
    end
 
-   always @(posedge pclk) begin
+   always @(posedge pclk) if (vce) begin
+           realign <= 0;
+
            if (!doing_resync) begin
                    if (sync_request_pending) begin
                            doing_resync <= 1;
                            vid_enable   <= 0;
                            init_ctr     <= 2'h3;
+                           phase_wait   <= 0;
+                   end else if (fs_enable || scaler || phase == phase_now) begin
+                           phase_wait   <= 0;
+                   end else if (flyback_falling) begin
+                           phase_ctr    <= phase;
+                           phase_wait   <= 1;
+                   end else if (phase_wait) begin
+                           if (phase_ctr == 0) begin
+                                   realign      <= 1;
+                                   phase_now    <= phase;
+                                   phase_wait   <= 0;
+                           end else begin
+                                   phase_ctr    <= phase_ctr - 1;
+                           end
                    end
            end else if (init_ctr != 0) begin
                    /* Reset for at least 3 cycles. This might miss
                     * a sync point which is OK; we wait for the next frame.
                     */
                    init_ctr               <= init_ctr - 1;
-           end else if (flyback_falling) begin
-                   // Flyback just finished.  Release the timing gen:
+           end else if (fs_enable || (phase_wait && phase_ctr == 0)) begin
+                   // Release the timing gen:
                    vid_enable             <= 1;
                    doing_resync           <= 0;
+                   phase_wait             <= 0;
+                   phase_now              <= phase;
                    // Ack request:
                    config_sync_ack        <= ~config_sync_ack;
+           end else if (phase_wait) begin
+                   phase_ctr              <= phase_ctr - 1;
+           end else if (flyback_falling) begin
+                   // Flyback just finished, count out the phase:
+                   phase_ctr              <= phase;
+                   phase_wait             <= 1;
            end
    end // always @ (posedge pclk)
 
+   /* The timing generator restarts at its first display line: */
+   wire         gen_restart = !vid_enable || realign;
+
 
    ////////////////////////////////////////////////////////////////////////////////
    // Line buffer:
 
    /* Buffer 0 is used for line 0, 2, 4, etc., buffer 1 used for line 1, 3, 5, etc.
     * The input DMA is written to buffer 0 first, then wrapping to alternate buffers.
-    * The output scan selects a buffer based on line number, and starts a line
-    * later than the input scan (so that the first buffer is full by the time the
-    * display starts).
+    * The output scan selects a buffer based on line number, and starts up to a
+    * line later than the input scan (the phase, see above), so that the DMA
+    * stays ahead of the display.
+    *
+    * With the frame store, lines are instead written (to the buffer for the
+    * line number) as they are fetched from SDRAM, see "Frame store line
+    * requests" below.
+    *
+    * Addresses are {line[0], word}.  With high colour, the buffer is split
+    * into banks of even and odd words so that two consecutive words can be
+    * read at once, as a 24BPP pixel (or pair of pixels) can straddle words.
     */
-   reg [31:0] 	line_buffer[(256*2)-1:0]; // 2x 1KB buffers
+`ifdef INCLUDE_HIGH_COLOUR
+   reg [31:0] 	line_buffer_e[LB_WORDS-1:0];
+   reg [31:0] 	line_buffer_o[LB_WORDS-1:0];
+`else
+   reg [31:0] 	line_buffer[(LB_WORDS*2)-1:0];
+`endif
 
    /* Note pulses for load_dma etc. are in the load_dma_clk
     * domain.  (This should be slower than pclk... but beware!)
     */
 
-   reg [8:0] 	line_w_ptr;
+   reg [LB_ADDR_BITS:0] 	line_w_ptr;
+   reg [LB_ADDR_BITS-1:0] 	line_w_wpl_m1;
    reg [2:0] 	dclk_sync_fb;
    wire      	flyback_falling2 = dclk_sync_fb[1] == 0 && dclk_sync_fb[2] == 1;
 
+   wire         lb_write      = fs_enable ? fs_load : (load_dma && !flyback_falling2);
+   wire [LB_ADDR_BITS:0] 	lb_waddr = fs_enable ? fs_load_addr[LB_ADDR_BITS:0] : line_w_ptr;
+   wire [31:0] 	lb_wdata      = fs_enable ? fs_load_data : load_dma_data;
+
    always @(posedge load_dma_clk) begin
            // Synchronise flyback into load_dma_clk domain:
            dclk_sync_fb 	<= {dclk_sync_fb[1:0], sync_flyback};
 
-           if (flyback_falling2) begin
-                   /* At frame start, reset to beginning of buffer 0: */
-                   line_w_ptr <= 0;
+           /* With the frame store, the line buffer is written at the address
+            * given instead, and line_w_ptr is unused.
+            */
+           if (fs_enable) begin
+           end else if (flyback_falling2) begin
+                   /* At frame start, reset to beginning of buffer 0.
+                    * The line length only changes here, so that a commit
+                    * doesn't split the lines of a frame in progress:
+                    */
+                   line_w_ptr    <= 0;
+                   line_w_wpl_m1 <= t_words_per_line_m1[LB_ADDR_BITS-1:0];
            end else if (load_dma) begin
                    /* At the end of a line in, wrap to next buffer: */
-                   if (line_w_ptr[7:0] != t_words_per_line_m1)
+                   if (line_w_ptr[LB_ADDR_BITS-1:0] != line_w_wpl_m1)
                      line_w_ptr            <= line_w_ptr + 1;
                    else
-                     line_w_ptr            <= {~line_w_ptr[8], 8'h00};
-                   line_buffer[line_w_ptr] <= load_dma_data;
+                     line_w_ptr            <= {~line_w_ptr[LB_ADDR_BITS], {LB_ADDR_BITS{1'b0}}};
+           end
+   end
+
+   /* Words written this frame, for the slack statistics.  It crosses to pclk
+    * Gray-coded, so only one bit changes per write.  (The reset at flyback
+    * isn't a single step, but the output isn't displaying then.)
+    */
+   reg [19:0]   lb_w_count;
+   reg [19:0]   lb_w_gray;
+
+   always @(posedge load_dma_clk) begin
+           if (flyback_falling2)
+             lb_w_count <= 0;
+           else if (lb_write && !fs_enable)
+             lb_w_count <= lb_w_count + 1;
+           lb_w_gray    <= lb_w_count ^ (lb_w_count >> 1);
+   end
+
+   always @(posedge load_dma_clk) begin
+           if (lb_write) begin
+`ifdef INCLUDE_HIGH_COLOUR
+                   if (lb_waddr[0])
+                     line_buffer_o[lb_waddr[LB_ADDR_BITS:1]] <= lb_wdata;
+                   else
+                     line_buffer_e[lb_waddr[LB_ADDR_BITS:1]] <= lb_wdata;
+`else
+                   line_buffer[lb_waddr] <= lb_wdata;
+`endif
            end
    end
 
@@ -183,19 +387,20 @@ module video_timing(input wire        	     pclk,
 
    /* Don't need double-buffering, because 4 beats (16 bytes) of cursor data is loaded
     * every other line, before the cursor is displayed.
+    *
+    * But, the whole cursor (up to 128 lines) is kept, because with the frame
+    * store the output doesn't display the cursor at the same time as VIDC
+    * loads it.
     */
-   reg [31:0] 	cursor_buffer[3:0];	// Need to store 4 beats from hsync time
-   reg [1:0]  	cursor_w_ptr;
+   reg [31:0] 	cursor_buffer[255:0];
+   reg [7:0]  	cursor_w_ptr;
 
    always @(posedge load_dma_clk) begin
            if (flyback_falling2) begin
                    /* At frame start, reset to beginning of buffer 0: */
                    cursor_w_ptr <= 0;
            end else if (load_dma_cursor) begin
-                   if (cursor_w_ptr == 3)
-                     cursor_w_ptr <= 0;
-                   else
-                     cursor_w_ptr <= cursor_w_ptr + 1;
+                   cursor_w_ptr <= cursor_w_ptr + 1;
                    cursor_buffer[cursor_w_ptr] <= load_dma_data;
            end
    end
@@ -219,55 +424,139 @@ module video_timing(input wire        	     pclk,
    reg [ctr_width_y-1:0]        ti_v_total;
    reg                          en_hires;
    reg [2:0]                    bpp;
-   reg                          double_x;
-   reg                          double_y;
+   reg [1:0]                    scale_x;        // Factor - 1
+   reg [1:0]                    scale_y;
+   reg [10:0]                   cursor_x_offset;
+   reg                          line_lock;
+   reg                          scaler;
+   reg [15:0]                   step_x;
+   reg [15:0]                   step_y;
+   reg [ctr_width_x-1:0]        ti_img_x_start; // Last px/py before/of the image
+   reg [ctr_width_x-1:0]        ti_img_x_end;
+   reg [ctr_width_y-1:0]        ti_img_y_start;
+   reg [ctr_width_y-1:0]        ti_img_y_end;
+   reg [23:0]                   fill;
+   reg [23:0]                   fl_lead;
+   wire                         commit_apply;
+   wire                         frame_end;      // Last pixel of a frame
+
+   /* The last pixel before/of the display, in pixels rather than units of
+    * PIXELS_PER_CLK (for the cursor and test card):
+    */
+   wire [ctr_width_x-1:0]       h_disp_start_px = (PIXELS_PER_CLK == 2) ?
+                                {ti_h_disp_start[ctr_width_x-2:0], 1'b1} : ti_h_disp_start;
+   wire [ctr_width_x-1:0]       h_disp_end_px   = (PIXELS_PER_CLK == 2) ?
+                                {ti_h_disp_end[ctr_width_x-2:0], 1'b1} : ti_h_disp_end;
 
    /* Timing configuration */
-   always @(posedge pclk) begin
-           // To initialise new timing, hold clk_pixel_ena=0 for 3 cycles:
-           if (!vid_enable) begin
-                   ti_h_sync_off   <= t_horiz_sync_width - 1;
-                   ti_h_disp_start <= t_horiz_sync_width + t_horiz_bp - 1;
-                   ti_h_disp_end   <= t_horiz_sync_width + t_horiz_bp + t_horiz_res - 1;
-                   ti_h_total      <= t_horiz_sync_width + t_horiz_bp + t_horiz_res + t_horiz_fp - 1;
+   always @(posedge pclk) if (vce) begin
+           /* To initialise new timing, hold clk_pixel_ena=0 for 3 cycles.
+            * A commit instead takes the new config at the end of a frame:
+            */
+           if (!vid_enable || commit_apply) begin
+                   /* With 2 pixels per clock, these are rounded down to
+                    * whole pairs (so an odd line total loses a pixel):
+                    */
+                   ti_h_sync_off   <= (t_horiz_sync_width >> HSHIFT) - 1;
+                   ti_h_disp_start <= ((t_horiz_sync_width + t_horiz_bp) >> HSHIFT) - 1;
+                   ti_h_disp_end   <= ((t_horiz_sync_width + t_horiz_bp + t_horiz_res) >> HSHIFT) - 1;
+                   ti_h_total      <= ((t_horiz_sync_width + t_horiz_bp + t_horiz_res +
+                                        t_horiz_fp) >> HSHIFT) - 1;
 
                    ti_v_sync_off   <= t_vert_sync_width - 1;
                    ti_v_disp_start <= t_vert_sync_width + t_vert_bp - 1;
                    ti_v_disp_end   <= t_vert_sync_width + t_vert_bp + t_vert_res - 1;
                    ti_v_total      <= t_vert_sync_width + t_vert_bp + t_vert_res + t_vert_fp - 1;
 
+                   /* Without the scaler, the image is the whole display: */
+                   if (t_scaler) begin
+                           ti_img_x_start <= ((t_horiz_sync_width + t_horiz_bp + t_img_x) >> HSHIFT) - 1;
+                           ti_img_x_end   <= ((t_horiz_sync_width + t_horiz_bp + t_img_x +
+                                               t_img_w) >> HSHIFT) - 1;
+                           ti_img_y_start <= t_vert_sync_width + t_vert_bp + t_img_y - 1;
+                           ti_img_y_end   <= t_vert_sync_width + t_vert_bp + t_img_y + t_img_h - 1;
+                   end else begin
+                           ti_img_x_start <= ((t_horiz_sync_width + t_horiz_bp) >> HSHIFT) - 1;
+                           ti_img_x_end   <= ((t_horiz_sync_width + t_horiz_bp + t_horiz_res) >> HSHIFT) - 1;
+                           ti_img_y_start <= t_vert_sync_width + t_vert_bp - 1;
+                           ti_img_y_end   <= t_vert_sync_width + t_vert_bp + t_vert_res - 1;
+                   end
+
                    en_hires       <= t_hires;
                    bpp            <= t_bpp;
-                   double_x       <= t_double_x;
-                   double_y       <= t_double_y;
+                   scale_x        <= (PIXELS_PER_CLK == 2 && t_scale_x == 2'd2) ?
+                                     2'd1 : t_scale_x;
+                   scale_y        <= t_scale_y;
+                   cursor_x_offset <= t_cursor_x_offset;
+                   phase          <= t_phase >> HSHIFT;
+                   line_lock      <= t_line_lock;
+                   scaler         <= t_scaler;
+                   step_x         <= t_step_x;
+                   step_y         <= t_step_y;
+                   fill           <= t_fill;
+                   fl_lead        <= t_fl_lead >> HSHIFT;
            end
    end
 
 
    ////////////////////////////////////////////////////////////////////////////////
-   // Capture of dynamic configuration
+   // Cursor position
 
-   /* Initially, this means cursor, but eventually palette etc. will have to
-    * come in from the outside.  If we say it mustn't change outside of flyback,
-    * it's easier to synchronise (this is OK for cursor, not OK for palette).
+   /* The cursor position comes through the write replay queue (see "VIDC
+    * write replay" below), so changes at the point in the frame that VIDC saw
+    * it change; normally that's in flyback, and it's then stable for the
+    * whole frame.
     */
+   reg [10:0] 	v_cursor_x;     // Raw, before cursor_x_offset
+   reg [9:0] 	v_cursor_y;
+   reg [9:0] 	v_cursor_yend;
+
    reg [10:0] 	cursor_x;
    reg [10:0] 	cursor_xend;
-   reg [9:0] 	cursor_y;
-   reg [9:0] 	cursor_yend;
+   reg [ctr_width_y-1:0] cursor_y;
+   reg [ctr_width_y-1:0] cursor_yend;
+
+   wire [10:0]  norm_cursor_x = v_cursor_x - cursor_x_offset;
+
+   /* Scaled to output pixels/lines: */
+   wire [10:0]  scaled_cursor_x = (scale_x == 2'd0) ? norm_cursor_x :
+                (scale_x == 2'd1) ? {norm_cursor_x[9:0], 1'b0} :
+                (scale_x == 2'd2) ? {norm_cursor_x[9:0], 1'b0} + norm_cursor_x :
+                {norm_cursor_x[8:0], 2'b00};
+   wire [7:0]   scaled_cursor_w = {{1'b0, scale_x} + 3'd1, 5'h0};     // 32 pixels, scaled
+   wire [ctr_width_y-1:0] y_start = {{(ctr_width_y-10){1'b0}}, v_cursor_y};
+   wire [ctr_width_y-1:0] y_end = {{(ctr_width_y-10){1'b0}}, v_cursor_yend};
+   wire [ctr_width_y-1:0] scaled_cursor_y = (scale_y == 2'd0) ? y_start :
+                          (scale_y == 2'd1) ? {y_start, 1'b0} :
+                          (scale_y == 2'd2) ? {y_start, 1'b0} + y_start :
+                          {y_start, 2'b00};
+   wire [ctr_width_y-1:0] scaled_cursor_yend = (scale_y == 2'd0) ? y_end :
+                          (scale_y == 2'd1) ? {y_end, 1'b0} :
+                          (scale_y == 2'd2) ? {y_end, 1'b0} + y_end :
+                          {y_end, 2'b00};
+
+   /* The scaler doesn't repeat whole pixels, so instead the cursor is found
+    * from the input pixel/line being displayed, on the image:
+    */
+   wire [10:0]  sc_cursor_x = dispx - norm_cursor_x;
+   wire [ctr_width_y-1:0] sc_cursor_y = dispy - y_start;
+   wire         sc_on_cursor_x = img_x && sc_cursor_x < 11'd32;
+   wire         sc_on_cursor_y = img_y && dispy >= y_start && dispy < y_end;
+
+   /* With the frame store, the output frame start is asynchronous to VIDC
+    * (and writes are applied as they arrive), so take the cursor position
+    * once per frame to avoid tearing:
+    */
+   wire         cursor_capture = fs_enable ? frame_end : 1'b1;
 
-   always @(posedge pclk) begin
-           if (flyback_falling) begin
+   always @(posedge pclk) if (vce) begin
+           if (cursor_capture) begin
                    // These values are the px value before which the cursor appears/ends:
-                   cursor_x    <= (double_x ? {v_cursor_x, 1'b0} : v_cursor_x) +
-                                  ti_h_disp_start;
-                   cursor_xend <= (double_x ? {v_cursor_x, 1'b0} : v_cursor_x) +
-                                  ti_h_disp_start + (double_x ? 64 : 32);
+                   cursor_x    <= scaled_cursor_x + h_disp_start_px;
+                   cursor_xend <= scaled_cursor_x + h_disp_start_px + scaled_cursor_w;
                    // The y coordinate is the py value before the cursor start/end line:
-                   cursor_y    <= (double_y ? {v_cursor_y, 1'b0} : v_cursor_y) +
-                                  ti_v_disp_start;
-                   cursor_yend <= (double_y ? {v_cursor_yend, 1'b0} : v_cursor_yend) +
-                                  ti_v_disp_start;
+                   cursor_y    <= scaled_cursor_y + ti_v_disp_start;
+                   cursor_yend <= scaled_cursor_yend + ti_v_disp_start;
            end
    end
 
@@ -283,57 +572,141 @@ module video_timing(input wire        	     pclk,
    reg                          v_on_display;
 
    /* Convenience counters for actual pixel addresses.  Note dispx/dispy
-    * counters move every other (output) pixel when pixel/line doubling
-    * is enabled:
+    * move every scale_x+1 (output) pixels/scale_y+1 lines, counted by
+    * dispx_rep/dispy_rep.  With 2 pixels per clock, dispx is the first
+    * pixel of the pair (and the second is the same pixel, when scaling),
+    * so it moves by 2 per clock unscaled and 1 every 1 or 2 clocks scaled:
     */
-   reg [ctr_width_x:0]		internal_dispx;
-   reg [ctr_width_y:0]        	internal_dispy;
-   wire [ctr_width_x-1:0]	dispx;
-   wire [ctr_width_y-1:0]       dispy;
-
-   always @(posedge pclk) begin
-           if (!vid_enable) begin
-                   /* A sync "resets" to the line before the first horizontal
-                    * line on display.  When doubling lines, reset to -2 so
-                    * that the DMA in completes the line before 2 are scanned out.
+   reg [ctr_width_x-1:0]	dispx;
+   reg [ctr_width_y-1:0]        dispy;
+   reg [1:0]                    dispx_rep;
+   reg [1:0]                    dispy_rep;
+   reg [STEP_FRAC-1:0]          dispx_frac;     // With the scaler
+   reg [STEP_FRAC-1:0]          dispy_frac;
+   /* On the image (as de is on the display), which is the whole display
+    * unless the scaler puts a border around it:
+    */
+   reg                          img_x;
+   reg                          img_y;
+   wire [1:0]                   dispx_reps_m1 = (PIXELS_PER_CLK == 1) ? scale_x :
+                                (scale_x == 2'd3) ? 2'd1 : 2'd0;
+   wire [1:0]                   dispx_step = (PIXELS_PER_CLK == 2 && scale_x == 2'd0) ?
+                                2'd2 : 2'd1;
+   /* The lanes of a pair show different pixels (else, the same one): */
+   wire                         pair_split = scale_x == 2'd0 && !scaler;
+
+   /* The last px of the line is normally ti_h_total, but line lock (below)
+    * can move it:
+    */
+   reg                          ll_adj;
+   reg [ctr_width_x-1:0]        ll_h_end;
+   wire [ctr_width_x-1:0]       h_end = ll_adj ? ll_h_end : ti_h_total;
+
+   /* With the scaler, the last line of the frame is repeated, and the final
+    * one cut short or stretched, until frame lock says to go on (see
+    * "Scaler"):
+    */
+   localparam FL_MAX		= 8'hff;
+
+   reg                          fl_run;         // Counting down to fl_due
+   reg                          fl_due;
+   reg [23:0]                   fl_ctr;
+   reg [7:0]                    fl_lines;       // Repeated this frame
+
+   wire                         fl_last = scaler && py == ti_v_total;
+   wire                         fl_half = px >= {1'b0, ti_h_total[ctr_width_x-1:1]};
+   wire                         fl_soon = fl_run && !fl_due &&
+                                fl_ctr <= {{(24-ctr_width_x){1'b0}}, 1'b0, ti_h_total[ctr_width_x-1:1]};
+   wire                         fl_stretch = fl_last && px == h_end && fl_soon;
+   wire                         fl_wait = scaler && !fl_due && fl_lines != FL_MAX;
+
+   wire                         line_end = fl_last ? ((fl_due && fl_half) ||
+                                                      (px == h_end && !fl_soon)) :
+                                px == h_end;
+
+   always @(posedge pclk) if (vce) begin
+           if (gen_restart) begin
+                   /* A sync "resets" to the start of the first line on
+                    * display (py is the line before the display at
+                    * ti_v_disp_start), which is released after the phase
+                    * (see above).
                     */
                    px              <= {ctr_width_x{1'b0}};
-                   py              <= ti_v_disp_start - { {ctr_width_y-1{1'b0}}, double_y }; // -0 or -1
+                   /* With the frame store, start at the last line instead, so
+                    * that the first frame is complete (and its lines are
+                    * fetched, below):
+                    */
+                   /* With the scaler, it's the first line of the image: */
+                   py              <= fs_enable ? ti_v_total : ti_img_y_start + 1;
                    hsync           <= 1;
                    vsync           <= 0;
                    de              <= 0;
                    v_on_display    <= 1;
-                   internal_dispx  <= 0;
-                   internal_dispy  <= 0;
-           end else if (px == ti_h_total) begin
+                   img_x           <= 0;
+                   img_y           <= !fs_enable;
+                   dispx           <= 0;
+                   dispx_rep       <= 0;
+                   dispx_frac      <= 0;
+                   dispy           <= 0;
+                   dispy_rep       <= 0;
+                   dispy_frac      <= 0;
+           end else if (line_end) begin
                    px      <= 0;
                    hsync   <= 1;
                    de      <= 0;
+                   img_x   <= 0;
+
+                   if (py == ti_img_y_start)
+                     img_y <= 1;
+                   if (py == ti_img_y_end)
+                     img_y <= 0;
 
                    if (py == ti_v_total) begin
-                           py           <= 0;
-                           vsync        <= 1;
+                           if (!fl_wait) begin
+                                   py           <= 0;
+                                   vsync        <= 1;
+                           end
                    end else begin
                            py    <= py + 1;
 
                            if (py == ti_v_disp_start) begin
                                    v_on_display <= 1;
                            end else if (py == ti_v_disp_end) begin
-                                   v_on_display 	<= 0;
-                                   internal_dispy 	<= 0;
+                                   v_on_display <= 0;
+                                   dispy        <= 0;
+                                   dispy_rep    <= 0;
+                                   dispy_frac   <= 0;
+                           end else if (scaler) begin
+                                   if (img_y && py != ti_img_y_end)
+                                     {dispy, dispy_frac} <= {dispy, dispy_frac} + step_y;
                            end else if (v_on_display) begin
-                                   internal_dispy 	<= internal_dispy + 1;
+                                   if (dispy_rep == scale_y) begin
+                                           dispy_rep <= 0;
+                                           dispy     <= dispy + 1;
+                                   end else begin
+                                           dispy_rep <= dispy_rep + 1;
+                                   end
                            end
 
                            if (py == ti_v_sync_off)
                              vsync <= 0;
                    end
            end else begin
-                   px    <= px + 1;
-                   if (de)
-                     internal_dispx <= internal_dispx + 1;
-                   else
-                     internal_dispx <= 0;
+                   if (!fl_stretch)
+                     px  <= px + 1;
+                   if (!de) begin
+                           dispx      <= 0;
+                           dispx_rep  <= 0;
+                           dispx_frac <= 0;
+                   end else if (scaler) begin
+                           if (img_x)
+                             {dispx, dispx_frac} <= {dispx, dispx_frac} + step_x;
+                   end else if (dispx_rep == dispx_reps_m1) begin
+                           dispx_rep <= 0;
+                           dispx     <= dispx + dispx_step;
+                   end else begin
+                           dispx_rep <= dispx_rep + 1;
+                   end
 
                    // Syncs:
                    if (px == ti_h_sync_off)
@@ -344,14 +717,260 @@ module video_timing(input wire        	     pclk,
 
                    if (px == ti_h_disp_end)
                      de <= 0;
+
+                   if (px == ti_img_x_start && img_y)
+                     img_x <= 1;
+
+                   if (px == ti_img_x_end)
+                     img_x <= 0;
            end
    end // always @ (posedge pclk)
 
-   // The actual logical pixel address:
-   assign dispx = double_x ? internal_dispx[ctr_width_x:1] :
-                  internal_dispx[ctr_width_x-1:0];
-   assign dispy = double_y ? internal_dispy[ctr_width_y:1] :
-                  internal_dispy[ctr_width_y-1:0];
+   assign frame_end = line_end && py == ti_v_total && !fl_wait;
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Line lock
+
+   /* The output line period is VIDC's (or 1/n of it, when scaling by n) in
+    * whole output pixels, so unless that divides exactly the output gains a
+    * fraction of a pixel on VIDC every line, which adds up over a frame to
+    * eat into the phase (and so the DMA's lead).
+    *
+    * With line lock, each output line (or group of n lines, when scaling) is
+    * re-aligned to VIDC's hsync instead:  at the end of its display, the
+    * time since VIDC's last nHS falling edge is compared with the same
+    * measurement on the first line after the timing generator was
+    * (re)started, and the front porch is stretched or shrunk by the
+    * difference.  A correction is at most LL_MAX (in units of
+    * PIXELS_PER_CLK), and always leaves a pixel of front porch.  An error
+    * greater than LL_WINDOW isn't corrected, and the line counts as
+    * unlocked; that happens with no hsync, or a composite one in VIDC's
+    * vsync.
+    *
+    * Per frame, the number of lines corrected, the number unlocked and the
+    * largest correction are counted, and output with the statistics below
+    * as stats_line_lock, {largest[7:0], unlocked[7:0], corrected[15:0]}.
+    */
+   localparam LL_MAX		= 8;
+   localparam LL_WINDOW		= 32;
+   localparam LLW		= ctr_width_x + 4;      // Holds +/- a group of 4 lines
+
+   reg [2:0]            ll_hs_s;        // Synchroniser and 'last' value
+   reg [LLW-2:0]        ll_since;       // Cycles since VIDC's hsync, saturating
+   reg [LLW-2:0]        ll_ref;
+   reg                  ll_ref_valid;
+   reg [1:0]            ll_rep;         // Line of a group
+   reg [15:0]           ll_lines;
+   reg [7:0]            ll_unlocked;
+   reg [7:0]            ll_max;
+
+   wire                 ll_hs_start = ll_hs_s[2] && !ll_hs_s[1];
+   wire                 ll_no_hs = &ll_since;
+   wire                 ll_decide = line_lock && vid_enable && !fs_enable && !scaler &&
+                        px == ti_h_disp_end && ll_rep == scale_y;
+
+   /* The error is wrapped into +/- half the (group's) period, as the
+    * reference can be near either end of VIDC's line:
+    */
+   wire [LLW-2:0]       ll_line = {{(LLW-1-ctr_width_x){1'b0}}, ti_h_total} + 1;
+   wire [LLW-2:0]       ll_period = (scale_y == 2'd0) ? ll_line :
+                        (scale_y == 2'd1) ? {ll_line[LLW-3:0], 1'b0} :
+                        (scale_y == 2'd2) ? {ll_line[LLW-3:0], 1'b0} + ll_line :
+                        {ll_line[LLW-4:0], 2'b00};
+   wire signed [LLW-1:0] ll_diff = $signed({1'b0, ll_since}) - $signed({1'b0, ll_ref});
+   wire signed [LLW-1:0] ll_half = $signed({2'b0, ll_period[LLW-2:1]});
+   wire signed [LLW-1:0] ll_err = (ll_diff > ll_half) ? ll_diff - $signed({1'b0, ll_period}) :
+                         (ll_diff < -ll_half) ? ll_diff + $signed({1'b0, ll_period}) :
+                         ll_diff;
+   wire                 ll_in_window = ll_err >= -LL_WINDOW && ll_err <= LL_WINDOW;
+
+   /* Measured early means the output is ahead, so stretch the line: */
+   wire signed [LLW-1:0] ll_fp = (ti_h_total > ti_h_disp_end) ?
+                         $signed({{(LLW-ctr_width_x){1'b0}}, ti_h_total - ti_h_disp_end - 1'b1}) : 0;
+   wire signed [LLW-1:0] ll_corr_c = (ll_err > LL_MAX) ? -LL_MAX :
+                         (ll_err < -LL_MAX) ? LL_MAX : -ll_err;
+   wire signed [LLW-1:0] ll_corr = (ll_corr_c < -ll_fp) ? -ll_fp : ll_corr_c;
+   wire [LLW-1:0]       ll_corr_abs = (ll_corr < 0) ? -ll_corr : ll_corr;
+
+   initial begin
+      ll_adj       = 0;
+      ll_ref_valid = 0;
+      ll_lines     = 0;
+      ll_unlocked  = 0;
+      ll_max       = 0;
+   end
+
+   always @(posedge pclk) if (vce) begin
+           ll_hs_s      <= {ll_hs_s[1:0], sync_hsync};
+           if (ll_hs_start)
+             ll_since   <= 0;
+           else if (!ll_no_hs)
+             ll_since   <= ll_since + 1;
+
+           if (gen_restart) begin
+                   ll_adj       <= 0;
+                   ll_rep       <= 0;
+                   ll_ref_valid <= 0;
+           end else if (line_end) begin
+                   ll_adj       <= 0;
+                   ll_rep       <= (ll_rep == scale_y) ? 2'd0 : ll_rep + 1;
+           end else if (!line_lock) begin
+                   ll_ref_valid <= 0;
+           end else if (ll_decide) begin
+                   if (!ll_ref_valid) begin
+                           if (!ll_no_hs) begin
+                                   ll_ref       <= ll_since;
+                                   ll_ref_valid <= 1;
+                           end
+                   end else if (!ll_no_hs && ll_in_window) begin
+                           ll_adj       <= 1;
+                           ll_h_end     <= ti_h_total + ll_corr[ctr_width_x-1:0];
+                           if (ll_corr != 0 && ll_lines != 16'hffff)
+                             ll_lines   <= ll_lines + 1;
+                           if (ll_corr_abs > ll_max)
+                             ll_max     <= ll_corr_abs[7:0];
+                   end else if (ll_unlocked != 8'hff) begin
+                           ll_unlocked  <= ll_unlocked + 1;
+                   end
+           end
+
+           if (frame_end) begin
+                   stats_line_lock      <= {ll_max, ll_unlocked, ll_lines};
+                   ll_lines             <= 0;
+                   ll_unlocked          <= 0;
+                   ll_max               <= 0;
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Scaler
+
+   /* Instead of repeating pixels and lines a whole number of times, the
+    * scaler steps through the input by a fraction (2.14) per output pixel
+    * and line, so that any mode can be fitted into one fixed output timing:
+    * the image is put at t_img_x/y (t_img_w x t_img_h output pixels) in the
+    * display, and the rest is filled with t_fill.  With two pixels per
+    * clock, the step is per pair, and both pixels of a pair are the same.
+    *
+    * The output line doesn't divide VIDC's, so the image still has to take
+    * as long as VIDC's display for the line buffer to keep up:  the Y step
+    * is the ratio of the line periods, which sets the image's height.  Each
+    * output line then shows the input line VIDC is a phase ahead of, which
+    * is in the line buffer just as when scaling by whole factors.
+    *
+    * Rather than line lock, the frame is locked to VIDC:  the generator
+    * stretches the front porch, repeating the last line of the frame until
+    * it's t_fl_lead before the image should start (a phase after VIDC's
+    * flyback ends), fl_due.  The final line ends exactly then, so is cut
+    * short (to no less than half a line) or stretched by up to half.
+    * VIDC's frame period is measured, so that the time can be counted from
+    * the flyback before if the lead is longer than the phase.  The firmware
+    * makes the output frame a little shorter than VIDC's, so it normally
+    * waits a few lines; the lines repeated in the last frame are
+    * output as stats_frame_lock (with the statistics below).  It repeats at
+    * most FL_MAX lines, so it carries on without VIDC.
+    */
+   reg [23:0]           fl_since;       // Cycles since VIDC's flyback ended, so
+                                        // its frame period at the next
+   wire [23:0]          fl_phase = {{(24-ctr_width_x-5){1'b0}}, phase};
+
+   initial begin
+      fl_since     = 0;
+      fl_run       = 0;
+      fl_due       = 0;
+      fl_lines     = 0;
+   end
+
+   always @(posedge pclk) if (vce) begin
+           if (gen_restart) begin
+                   fl_due       <= 0;
+                   fl_lines     <= 0;
+           end else if (line_end && py == ti_v_total) begin
+                   if (fl_wait) begin
+                           fl_lines             <= fl_lines + 1;
+                   end else begin
+                           fl_due               <= 0;
+                           fl_lines             <= 0;
+                           stats_frame_lock     <= fl_lines;
+                   end
+           end
+
+           if (flyback_falling) begin
+                   fl_since     <= 0;
+                   fl_ctr       <= (fl_phase >= fl_lead) ? fl_phase - fl_lead :
+                                   fl_since + fl_phase - fl_lead;
+                   fl_run       <= scaler;
+           end else begin
+                   if (fl_since != 24'hffffff)
+                     fl_since   <= fl_since + 1;
+                   if (fl_run) begin
+                           if (fl_ctr == 0) begin
+                                   fl_due       <= 1;
+                                   fl_run       <= 0;
+                           end else begin
+                                   fl_ctr       <= fl_ctr - 1;
+                           end
+                   end
+           end
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Configuration commit
+
+   /* A commit request toggles, and at the end of the current frame (as px/py
+    * wrap to 0) the timing configuration above takes the new t_*, then the
+    * ack toggles.  The output keeps running throughout, so this is for
+    * changes that don't need a resync to VIDC (e.g. BPP, scaling or words
+    * per line), and sync is not lost.
+    *
+    * During a resync the config is taken continuously anyway, so a commit
+    * pending then is just acked at the first frame end after it.
+    */
+   reg [1:0]    pclk_commit_req;
+   always @(posedge pclk) if (vce) begin
+           pclk_commit_req 	<= {pclk_commit_req[0], config_commit_req};
+   end
+
+   wire         commit_request_pending = pclk_commit_req[1] != config_commit_ack;
+   assign       commit_apply           = vid_enable && commit_request_pending && frame_end;
+
+   always @(posedge pclk) if (vce) begin
+           if (commit_apply)
+             config_commit_ack  <= ~config_commit_ack;
+   end
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Frame store line requests
+
+   /* Line 0 is requested at the end of the previous frame, then line y+1 as
+    * line y starts being displayed (so a line has a whole line period, or
+    * several when scaling, to be fetched).  The line number is stable from
+    * before the toggle, so can be sampled when the toggle arrives in the
+    * frame store's clock domain.
+    *
+    * The requests are made whether or not the frame store is enabled.
+    */
+   initial begin
+      fs_line_req <= 0;
+      fs_line     <= 0;
+   end
+
+   always @(posedge pclk) if (vce) begin
+           if (vid_enable) begin
+                   if (frame_end) begin
+                           fs_line      <= 0;
+                           fs_line_req  <= ~fs_line_req;
+                   end else if (px == ti_h_disp_start && v_on_display &&
+                                fs_line != dispy[9:0] + 10'd1) begin
+                           fs_line      <= dispy[9:0] + 10'd1;
+                           fs_line_req  <= ~fs_line_req;
+                   end
+           end
+   end
 
 
    ////////////////////////////////////////////////////////////////////////////////
@@ -364,185 +983,368 @@ module video_timing(input wire        	     pclk,
     * There are 4 stages of output pipeline, accommodating linebuffer and palette
     * access plus pixel reformatting.
     */
-   reg       	hsync_delayed, vsync_delayed, de_delayed;
-   reg       	hsync_delayed2, vsync_delayed2, de_delayed2, blank_delayed2;
-   reg          hsync_delayed3, vsync_delayed3, de_delayed3, blank_delayed3;
-   reg          hsync_delayed4, vsync_delayed4, de_delayed4, blank_delayed4;
+   reg       	hsync_delayed, vsync_delayed, de_delayed, img_delayed;
+   reg       	hsync_delayed2, vsync_delayed2, de_delayed2, blank_delayed2, img_delayed2;
+   reg          hsync_delayed3, vsync_delayed3, de_delayed3, blank_delayed3, img_delayed3;
+   reg          hsync_delayed4, vsync_delayed4, de_delayed4, blank_delayed4, img_delayed4;
 
-   always @(posedge pclk) begin
+   always @(posedge pclk) if (vce) begin
            hsync_delayed  <= hsync;
            vsync_delayed  <= vsync;
            de_delayed     <= de;
+           img_delayed    <= img_x;
 
            hsync_delayed2 <= hsync_delayed;
            vsync_delayed2 <= vsync_delayed;
            de_delayed2    <= de_delayed;
            blank_delayed2 <= ~de_delayed;
+           img_delayed2   <= img_delayed;
 
            hsync_delayed3 <= hsync_delayed2;
            vsync_delayed3 <= vsync_delayed2;
            de_delayed3    <= de_delayed2;
            blank_delayed3 <= blank_delayed2;
+           img_delayed3   <= img_delayed2;
 
            hsync_delayed4 <= hsync_delayed3;
            vsync_delayed4 <= vsync_delayed3;
            de_delayed4    <= de_delayed3;
            blank_delayed4 <= blank_delayed3;
+           img_delayed4   <= img_delayed3;
    end
 
 
    ////////////////////////////////////////////////////////////////////////////////
    // Test image generator
 
-   // These signals are aligned in time with hsync_delayed and friends.
-   reg [7:0] 	tc_r;
-   reg [7:0] 	tc_g;
-   reg [7:0] 	tc_b;
-
-   // These signals are aligned in time with hsync_delayed2 and friends.
-   reg [7:0] 	tc_r2;
-   reg [7:0] 	tc_g2;
-   reg [7:0] 	tc_b2;
-
-   // These signals are aligned in time with hsync_delayed3 and friends.
-   reg [7:0] 	tc_r3;
-   reg [7:0] 	tc_g3;
-   reg [7:0] 	tc_b3;
-
-   wire      	stripex = (px == (ti_h_disp_start+1)) ||
-                (px == (ti_h_disp_end)) || (px[7:0] == 8'h00);
-   wire      	stripey = (py == (ti_v_disp_start+1)) ||
-                (py == ti_v_disp_end) || (py[7:0] == 8'h00);
-   wire [7:0] 	stripe = (stripex || stripey) ? 8'hff : 8'h0;
-
-   always @(posedge pclk) begin
-           tc_r <= dispx[7:0] | stripe;
-           tc_g <= dispy[7:0] | stripe;
-           tc_b <= (dispx[8:1] ^ dispy[8:1]) | stripe;
-
-           tc_r2 	<= tc_r;
-           tc_g2 	<= tc_g;
-           tc_b2 	<= tc_b;
-
-           tc_r3 	<= tc_r2;
-           tc_g3 	<= tc_g2;
-           tc_b3 	<= tc_b2;
-   end
+   /* One per lane, i.e. pixel of the PIXELS_PER_CLK processed each cycle.
+    * Lane n's output pixel is at x = (px * PIXELS_PER_CLK) + n.
+    */
+   wire [(24*PIXELS_PER_CLK)-1:0] tc_rgb3;      // Lane n in [24n+23:24n], as {b, g, r}
+
+   generate for (lane = 0; lane < PIXELS_PER_CLK; lane = lane + 1) begin: g_tc
+           // These signals are aligned in time with hsync_delayed and friends.
+           reg [7:0]    tc_r;
+           reg [7:0]    tc_g;
+           reg [7:0]    tc_b;
+
+           // These signals are aligned in time with hsync_delayed2 and friends.
+           reg [7:0]    tc_r2;
+           reg [7:0]    tc_g2;
+           reg [7:0]    tc_b2;
+
+           // These signals are aligned in time with hsync_delayed3 and friends.
+           reg [7:0]    tc_r3;
+           reg [7:0]    tc_g3;
+           reg [7:0]    tc_b3;
+
+           wire [ctr_width_x-1:0] x = (PIXELS_PER_CLK == 2) ?
+                                      {px[ctr_width_x-2:0], lane == 1} : px;
+           wire [ctr_width_x-1:0] lx = dispx | (lane == 1 && pair_split);
+
+           wire         stripex = (x == (h_disp_start_px+1)) ||
+                        (x == (h_disp_end_px)) || (x[7:0] == 8'h00);
+           wire         stripey = (py == (ti_v_disp_start+1)) ||
+                        (py == ti_v_disp_end) || (py[7:0] == 8'h00);
+           wire [7:0]   stripe = (stripex || stripey) ? 8'hff : 8'h0;
+
+           always @(posedge pclk) if (vce) begin
+                   tc_r <= lx[7:0] | stripe;
+                   tc_g <= dispy[7:0] | stripe;
+                   tc_b <= (lx[8:1] ^ dispy[8:1]) | stripe;
+
+                   tc_r2 	<= tc_r;
+                   tc_g2 	<= tc_g;
+                   tc_b2 	<= tc_b;
+
+                   tc_r3 	<= tc_r2;
+                   tc_g3 	<= tc_g2;
+                   tc_b3 	<= tc_b2;
+           end
+
+           assign tc_rgb3[(24*lane)+23:(24*lane)] = {tc_b3, tc_g3, tc_r3};
+   end endgenerate
 
 
    ////////////////////////////////////////////////////////////////////////////////
    // Cursor video data
 
-   reg [31:0] 	cursor_data;
    reg        	on_cursor_x;
    reg        	on_cursor_y;
-   reg [5:0]  	internal_cursor_disp_x;
-   reg [10:0] 	internal_cursor_disp_y;	 // FIXME: make smaller
-   wire [4:0] 	cursor_disp_x;
-   wire [9:0] 	cursor_disp_y;
-   reg [3:0]  	cxidx;
-   reg        	was_cursor_pix;
-   reg        	was_cursor_pix2;
-   reg [1:0] 	cursor_pixel; // Wire
-   reg [1:0] 	cursor_pixel_hr; // Wire
-   reg [1:0]    cursor_pixel2;
-   reg [1:0]    cursor_pixel2_hr;
+   // The logical cursor pixel coordinates, moving as dispx/dispy do:
+   reg [4:0]  	cursor_disp_x;
+   reg [9:0] 	cursor_disp_y;
+   reg [1:0]    cursor_rep_x;
+   reg [1:0]    cursor_rep_y;
    // This logic culminates in this signal, valid aligned with hsync_delayed3 et al:
-   reg [1:0]    cursor_pixel3;
+   wire [(2*PIXELS_PER_CLK)-1:0] cursor_pixels3;        // Lane n in [2n+1:2n]
 
-   always @(posedge pclk) begin
-           if (px == ti_h_total && py == ti_v_total) begin
+   /* The px at which a cursor line has been scanned.  With 2 pixels per clock,
+    * it's the pair after the one containing the cursor's last pixel:
+    */
+   wire [ctr_width_x-1:0] cursor_line_done = (PIXELS_PER_CLK == 2) ?
+                          cursor_xend[10:1] + 1 : cursor_xend;
+
+   always @(posedge pclk) if (vce) begin
+           if (frame_end) begin
                    on_cursor_x   <= 0;
                    on_cursor_y   <= 0;
            end else begin
                    if (py == cursor_y) begin
-                           internal_cursor_disp_y <= 0;
-                           on_cursor_y <= 1;
+                           cursor_disp_y <= 0;
+                           cursor_rep_y  <= 0;
+                           on_cursor_y   <= 1;
                    end
                    if (py == cursor_yend) begin
                            on_cursor_y <= 0;
                    end
                    if (px == cursor_x) begin
-                           internal_cursor_disp_x <= 0;
+                           cursor_disp_x <= 0;
+                           cursor_rep_x  <= 0;
                            on_cursor_x   <= 1;
                    end
                    if (px == cursor_xend) begin
                            on_cursor_x   <= 0;
-                           if (on_cursor_y)
-                             internal_cursor_disp_y <= internal_cursor_disp_y + 1;
                    end
+                   if (px == cursor_line_done && on_cursor_y) begin
+                           if (cursor_rep_y == scale_y) begin
+                                   cursor_rep_y  <= 0;
+                                   cursor_disp_y <= cursor_disp_y + 1;
+                           end else begin
+                                   cursor_rep_y  <= cursor_rep_y + 1;
+                           end
+                   end
+
+                   if (on_cursor_x) begin
+                           if (cursor_rep_x == scale_x) begin
+                                   cursor_rep_x  <= 0;
+                                   cursor_disp_x <= cursor_disp_x + 1;
+                           end else begin
+                                   cursor_rep_x  <= cursor_rep_x + 1;
+                           end
+                   end
+           end
+   end // always @ (posedge pclk)
 
-                   if (on_cursor_x)
-                     internal_cursor_disp_x <= internal_cursor_disp_x + 1;
+   generate for (lane = 0; lane < PIXELS_PER_CLK; lane = lane + 1) begin: g_cursor
+           wire         lane_on_cursor_x;
+           wire [4:0]   lane_cursor_disp_x;
+
+           if (PIXELS_PER_CLK == 2) begin: g_pos
+                   /* The cursor can start at either pixel of a pair, so
+                    * on_cursor_x/cursor_disp_x (which count in pairs) don't
+                    * work.  Instead, each lane finds its offset into the
+                    * cursor, which starts at pixel cursor_x+1:
+                    */
+                   wire [ctr_width_x:0] cx = {px, lane == 1} - {1'b0, cursor_x} - 1;
+
+                   assign lane_on_cursor_x   = scaler ? sc_on_cursor_x : cx < scaled_cursor_w;
+                   assign lane_cursor_disp_x = scaler ? sc_cursor_x[4:0] :
+                                               (scale_x == 2'd0) ? cx[4:0] :
+                                               (scale_x == 2'd1) ? cx[5:1] : cx[6:2];
+           end else begin: g_pos
+                   assign lane_on_cursor_x   = scaler ? sc_on_cursor_x : on_cursor_x;
+                   assign lane_cursor_disp_x = scaler ? sc_cursor_x[4:0] : cursor_disp_x;
            end
 
-           /* The buffer contains 16 bytes, i.e. 64 pixels, i.e. 2 lines.
-            * Line 0 is bytes 0-7 (words 0-1), line 1 is bytes 8-15 (words 2-3).
-            */
-           cursor_data    	<= cursor_buffer[ {cursor_disp_y[0], cursor_disp_x[4]} ];
-           cxidx          	<= cursor_disp_x[3:0];
-           was_cursor_pix 	<= on_cursor_x && on_cursor_y;
+           wire [6:0]   lane_cursor_disp_y = scaler ? sc_cursor_y[6:0] : cursor_disp_y[6:0];
+           wire         lane_on_cursor_y   = scaler ? sc_on_cursor_y : on_cursor_y;
+
+           reg [31:0] 	cursor_data;
+           reg [3:0]  	cxidx;
+           reg        	was_cursor_pix;
+           reg        	was_cursor_pix2;
+           reg [1:0] 	cursor_pixel; // Wire
+           reg [1:0]    cursor_pixel2;
+           reg [1:0]    cursor_pixel3;
+
+           always @(posedge pclk) if (vce) begin
+                   /* Each line is 8 bytes, i.e. 32 pixels.
+                    * Line 0 is bytes 0-7 (words 0-1), line 1 is bytes 8-15 (words 2-3).
+                    * (With 2 lanes, their pixels can be in different words.)
+                    */
+                   cursor_data    	<= cursor_buffer[ {lane_cursor_disp_y, lane_cursor_disp_x[4]} ];
+                   cxidx          	<= lane_cursor_disp_x[3:0];
+                   was_cursor_pix 	<= lane_on_cursor_x && lane_on_cursor_y;
 
-           was_cursor_pix2 	<= was_cursor_pix;
-   end // always @ (posedge pclk)
+                   was_cursor_pix2 	<= was_cursor_pix;
+           end
 
-   // The logical cursor pixel coordinates:
-   assign 	cursor_disp_x = double_x ? internal_cursor_disp_x[5:1] :
-                                internal_cursor_disp_x[4:0];
-   assign 	cursor_disp_y = double_y ? internal_cursor_disp_y[10:1] :
-                                internal_cursor_disp_y[9:0];
+           always @(*) begin
+                   cursor_pixel = 2'b00;
+
+                   case (cxidx)
+                     4'h0:	cursor_pixel = cursor_data[1:0];
+                     4'h1:	cursor_pixel = cursor_data[3:2];
+                     4'h2:	cursor_pixel = cursor_data[5:4];
+                     4'h3:	cursor_pixel = cursor_data[7:6];
+                     4'h4:	cursor_pixel = cursor_data[9:8];
+                     4'h5:	cursor_pixel = cursor_data[11:10];
+                     4'h6:	cursor_pixel = cursor_data[13:12];
+                     4'h7:	cursor_pixel = cursor_data[15:14];
+                     4'h8:	cursor_pixel = cursor_data[17:16];
+                     4'h9:	cursor_pixel = cursor_data[19:18];
+                     4'ha:	cursor_pixel = cursor_data[21:20];
+                     4'hb:	cursor_pixel = cursor_data[23:22];
+                     4'hc:	cursor_pixel = cursor_data[25:24];
+                     4'hd:	cursor_pixel = cursor_data[27:26];
+                     4'he:	cursor_pixel = cursor_data[29:28];
+                     default:	cursor_pixel = cursor_data[31:30];
+                   endcase // case (cxidx)
+           end
 
-   always @(*) begin
-           cursor_pixel = 2'b00;
-
-           case (cxidx)
-             4'h0:	cursor_pixel = cursor_data[1:0];
-             4'h1:	cursor_pixel = cursor_data[3:2];
-             4'h2:	cursor_pixel = cursor_data[5:4];
-             4'h3:	cursor_pixel = cursor_data[7:6];
-             4'h4:	cursor_pixel = cursor_data[9:8];
-             4'h5:	cursor_pixel = cursor_data[11:10];
-             4'h6:	cursor_pixel = cursor_data[13:12];
-             4'h7:	cursor_pixel = cursor_data[15:14];
-             4'h8:	cursor_pixel = cursor_data[17:16];
-             4'h9:	cursor_pixel = cursor_data[19:18];
-             4'ha:	cursor_pixel = cursor_data[21:20];
-             4'hb:	cursor_pixel = cursor_data[23:22];
-             4'hc:	cursor_pixel = cursor_data[25:24];
-             4'hd:	cursor_pixel = cursor_data[27:26];
-             4'he:	cursor_pixel = cursor_data[29:28];
-             default:	cursor_pixel = cursor_data[31:30];
-           endcase // case (cxidx)
+           always @(posedge pclk) if (vce) begin
+                   cursor_pixel2 	<= cursor_pixel;
+                   cursor_pixel3 	<= !was_cursor_pix2 ? 2'b00 : cursor_pixel2;
+           end
+
+           assign cursor_pixels3[(2*lane)+1:(2*lane)] = cursor_pixel3;
+   end endgenerate
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // VIDC write replay
+
+   /* The output keeps its own copies of the palettes and cursor position, in
+    * the pclk domain.  VIDC's palette and cursor register writes come across
+    * through a FIFO, and are replayed into them, rather than the output
+    * reading VIDC's registers from the other clock domain (which could catch
+    * a colour mid-change).  It also means the 16-entry palette is a little
+    * LUTRAM, instead of a 16:1 mux of 192 bits of registers.
+    *
+    * Each write carries the input raster position it was made at (frame,
+    * display line and pixel), and is held at the head of the queue until
+    * the output's raster gets to the same position, so that a palette
+    * change made mid-frame (or mid-line) changes the same pixels of the
+    * output as it did on VIDC, though the output runs a line or so behind.
+    *
+    * The output's frame number, out_frame, is taken from VIDC's at the start
+    * of each output frame's display (or on a resync, when the output starts
+    * displaying at VIDC's flyback end).  A write for the current frame is
+    * applied once the output's display position reaches it (or the frame's
+    * display has finished); one for the next frame, made in VIDC's flyback,
+    * once the current frame's display has finished; and any other is stale
+    * and applied at once, so that the queue can't get stuck.  With the frame
+    * store, or whilst resynchronising, the output isn't timed by VIDC, and
+    * writes are applied as they arrive.
+    *
+    * One write is applied per cycle when due, so the queue only holds the
+    * writes made during the line or so the output is behind VIDC (or VIDC's
+    * flyback), unless pclk stops for a while (e.g. changing the pixel
+    * clock).  Writes made when it's full are lost; the fill level is output
+    * so that this can be watched.
+    */
+   reg [1:0]    vidc_frame_s0;
+   reg [1:0]    vidc_frame_s1;
+   reg [1:0]    out_frame;
+   reg          out_frame_done;
+
+   // Gray to binary:
+   wire [1:0]   vidc_frame_now  = {vidc_frame_s1[1], ^vidc_frame_s1};
+
+   initial begin
+      vidc_frame_s0  = 0;
+      vidc_frame_s1  = 0;
+      out_frame      = 0;
+      out_frame_done = 1;
+      v_cursor_x     = 0;
+      v_cursor_y     = 0;
+      v_cursor_yend  = 0;
+   end
+
+   always @(posedge pclk) if (vce) begin
+           vidc_frame_s0        <= vidc_frame;
+           vidc_frame_s1        <= vidc_frame_s0;
+
+           if (gen_restart || (line_end && py == ti_v_disp_start)) begin
+                   out_frame      <= vidc_frame_now;
+                   out_frame_done <= 0;
+           end else if (line_end && py == ti_v_disp_end) begin
+                   out_frame_done <= 1;
+           end
    end
 
-   always @(posedge pclk) begin
-           cursor_pixel2 	<= cursor_pixel;
-           cursor_pixel3 	<= !was_cursor_pix2 ? 2'b00 : cursor_pixel2;
+   wire         rq_empty;
+   wire [63:0] 	rq_q;
+   wire         rq_apply;
+   wire [RQ_DEPTH_BITS:0] rq_wlevel;
+
+   async_fifo #(.WIDTH(64), .DEPTH_BITS(RQ_DEPTH_BITS))
+              RQ(.wclk(load_dma_clk),
+                 .write(vw_write),
+                 .wdata({vw_frame, vw_line, vw_x, vw_idx, vw_data}),
+                 .full(rq_full),
+                 .wlevel(rq_wlevel),
+
+                 .rclk(pclk),
+                 .rce(vce),
+                 .read(rq_apply),
+                 .rdata(rq_q),
+                 .empty(rq_empty)
+                 );
+
+   assign rq_level = rq_wlevel;
+
+   wire [1:0] 	rq_frame  = {rq_q[63], ^rq_q[63:62]}; // Gray to binary
+   wire [9:0] 	rq_line   = rq_q[61:52];
+   wire [10:0] 	rq_x      = rq_q[51:41];
+   wire [8:0] 	rq_idx    = rq_q[40:32];
+   wire [31:0] 	rq_data   = rq_q[31:0];
+
+   wire [1:0]   rq_ahead   = rq_frame - out_frame;
+   wire         rq_reached = out_frame_done || (dispy > rq_line) ||
+                             (dispy == rq_line && dispx >= rq_x);
+   wire         rq_at_start = rq_line == 10'h0 && rq_x == 11'h0;
+
+   assign rq_apply = !rq_empty &&
+                     (fs_enable || !vid_enable ||
+                      (rq_ahead == 2'd0 && rq_reached) ||
+                      (rq_ahead == 2'd1 && out_frame_done && rq_at_start) ||
+                      rq_ahead[1]);
+
+   always @(posedge pclk) if (vce) begin
+           if (rq_apply && rq_idx == 9'h020)
+             {v_cursor_yend, v_cursor_y, v_cursor_x} <= rq_data[30:0];
    end
 
 
    ////////////////////////////////////////////////////////////////////////////////
-   // Video data
+   // Palettes
+
+   reg [11:0] 	vidc_pal[15:0];
+   reg [11:0] 	cursor_pal0;
+   reg [11:0] 	cursor_pal1;
+   reg [11:0] 	cursor_pal2;
+
+   always @(posedge pclk) if (vce) begin
+           if (rq_apply && rq_idx[8:4] == 5'h00)
+             vidc_pal[rq_idx[3:0]] <= rq_data[11:0];
+   end
+
+   always @(posedge pclk) if (vce) begin
+           if (rq_apply) begin
+                   case (rq_idx)
+                     9'h011:	cursor_pal0 <= rq_data[11:0];
+                     9'h012:	cursor_pal1 <= rq_data[11:0];
+                     9'h013:	cursor_pal2 <= rq_data[11:0];
+                     default:	;
+                   endcase
+           end
+   end
 
 `ifdef INCLUDE_HIGH_COLOUR
-   /* Prototyping:  Extend the 256 colour palette to 24bits.
+   /* Extend the 256 colour palette to 24bits, and make it writable via the
+    * special register (see vidc_capture).
     *
     * This needs a better solution for 1/2/4bpp modes, e.g. a VIDC control reg
-    * extension bit causing them to use this RAM instead of getting the palette
-    * from vidc_palette.  Alternatively, pipe VIDC palette writes through to
-    * this RAM.
+    * extension bit causing them to use this RAM instead of vidc_pal.
     */
    reg [23:0] 	palette8b [255:0];
    initial $readmemh("palette24.mem", palette8b);
 
-   /* Capture special-reg writes into this palette:
-    */
-   always @(posedge load_dma_clk) begin
-           if (vidc_special_written) begin
-                   if (vidc_special[11:8] == 4'h0) begin
-                           palette8b[vidc_special[7:0]] <= vidc_special_data;
-                   end
-           end
+   always @(posedge pclk) if (vce) begin
+           if (rq_apply && rq_idx[8])
+             palette8b[rq_idx[7:0]] <= rq_data[23:0];
    end
 `define INTERNAL_RGB 24
 `else
@@ -551,191 +1353,366 @@ module video_timing(input wire        	     pclk,
  `define INTERNAL_RGB 12
 `endif
 
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Video data
+
    /* Generate video image: */
    reg [31:0] 	rdata;
    reg [4:0]  	xidx;
 
-   wire [8:0] 	read_line_idx = (bpp == 0) ? /* 1BPP */
-                {dispy[0], 2'b00, dispx[ctr_width_x-1:5]} :
-                (bpp == 1) ? /* 2BPP */
-                {dispy[0], 1'b0, dispx[ctr_width_x-1:4]} :
-                (bpp == 2) ? /* 4BPP */
-                {dispy[0], dispx[ctr_width_x-1:3]} :
 `ifdef INCLUDE_HIGH_COLOUR
-                (bpp == 3) ? /* 8BPP */
-                {dispy[0], dispx[9:2]} :
-                {dispy[0], dispx[8:1]}; /* 16BPP */
+   /* 24BPP pixels are 3 bytes, so are at byte 3*X: */
+   wire [ctr_width_x+1:0] 	dispx_x3 = {dispx, 1'b0} + dispx;
+`endif
+
+   wire [ctr_width_x-1:0] 	read_word = (bpp == 0) ? (dispx >> 5) : /* 1BPP */
+                                (bpp == 1) ? (dispx >> 4) : /* 2BPP */
+                                (bpp == 2) ? (dispx >> 3) : /* 4BPP */
+`ifdef INCLUDE_HIGH_COLOUR
+                                (bpp == 3) ? (dispx >> 2) : /* 8BPP */
+                                (bpp == 4) ? (dispx >> 1) : /* 16BPP */
+                                dispx_x3[ctr_width_x+1:2];  /* 24BPP */
 `else
-                {dispy[0], dispx[9:2]}; /* 8BPP */
+                                (dispx >> 2); /* 8BPP */
 `endif
 
-   /* Read the video RAM, indexed by X scaled by BPP: */
-   always @(posedge pclk) begin
+   wire [LB_ADDR_BITS:0] 	read_line_idx = {dispy[0], read_word[LB_ADDR_BITS-1:0]};
+
+`ifdef INCLUDE_HIGH_COLOUR
+   /* Read words w and w+1 (wrapping within the line), one from each bank.
+    * rdata is word w, and rdata_hi is word w+1:
+    */
+   wire [LB_ADDR_BITS-2:0] 	read_word_e = read_word[LB_ADDR_BITS-1:1] + read_word[0];
+   reg [31:0] 	rdata_e;
+   reg [31:0] 	rdata_o;
+   reg          rdata_sel;
+   reg [1:0]  	xoff;
+   wire [31:0] 	rdata_hi = rdata_sel ? rdata_e : rdata_o;
+
+   always @(posedge pclk) if (vce) begin
+           rdata_e 	<= line_buffer_e[{dispy[0], read_word_e}];
+           rdata_o 	<= line_buffer_o[read_line_idx[LB_ADDR_BITS:1]];
+           rdata_sel 	<= read_word[0];
+           xoff 	<= dispx_x3[1:0];
+           xidx  	<= dispx[4:0];
+   end
+
+   always @(*) begin
+           rdata 	= rdata_sel ? rdata_o : rdata_e;
+   end
+`else
+   /* Read the video RAM, indexed by X scaled by BPP.  The pixels of a pair
+    * are always in the same word:
+    */
+   always @(posedge pclk) if (vce) begin
            rdata 	<= line_buffer[read_line_idx];
            xidx  	<= dispx[4:0];
    end
+`endif
 
-   /* Pixel selection/reformatting: */
+   /* Pixel selection/reformatting, per lane: */
+   wire [(`INTERNAL_RGB*PIXELS_PER_CLK)-1:0] read_pixels3; // Lane n in [(n+1)*RGB-1:n*RGB]
 
-   reg 		read_1b_pixel;
-   reg [3:0]    read_124b_pixel;
-   reg [`INTERNAL_RGB-1:0]	read_8b_pixel_rgb;
-   reg          read_1b_pixel_d; // wire
-   reg [1:0]    read_2b_pixel_d; // wire
-   reg [3:0]    read_4b_pixel_d; // wire
-   reg [7:0]    read_8b_pixel_d; // wire
+   generate for (lane = 0; lane < PIXELS_PER_CLK; lane = lane + 1) begin: g_pix
+           wire [4:0]   lxidx = xidx | (lane == 1 && pair_split);
 
-   /* Replacing the ternary ops with these case statements gave a significant perf
-    * improvement; yosys seems to do a much better job with these.
-    */
-   always @(*) begin
-           read_1b_pixel_d 	= 0;
-           case (xidx[4:0])
-             0: read_1b_pixel_d       	= rdata[0];
-             1: read_1b_pixel_d       	= rdata[1];
-             2: read_1b_pixel_d       	= rdata[2];
-             3: read_1b_pixel_d       	= rdata[3];
-             4: read_1b_pixel_d       	= rdata[4];
-             5: read_1b_pixel_d       	= rdata[5];
-             6: read_1b_pixel_d       	= rdata[6];
-             7: read_1b_pixel_d       	= rdata[7];
-             8: read_1b_pixel_d       	= rdata[8];
-             9: read_1b_pixel_d       	= rdata[9];
-             10: read_1b_pixel_d      	= rdata[10];
-             11: read_1b_pixel_d      	= rdata[11];
-             12: read_1b_pixel_d      	= rdata[12];
-             13: read_1b_pixel_d      	= rdata[13];
-             14: read_1b_pixel_d      	= rdata[14];
-             15: read_1b_pixel_d      	= rdata[15];
-             16: read_1b_pixel_d      	= rdata[16];
-             17: read_1b_pixel_d      	= rdata[17];
-             18: read_1b_pixel_d      	= rdata[18];
-             19: read_1b_pixel_d      	= rdata[19];
-             20: read_1b_pixel_d      	= rdata[20];
-             21: read_1b_pixel_d      	= rdata[21];
-             22: read_1b_pixel_d      	= rdata[22];
-             23: read_1b_pixel_d      	= rdata[23];
-             24: read_1b_pixel_d      	= rdata[24];
-             25: read_1b_pixel_d      	= rdata[25];
-             26: read_1b_pixel_d      	= rdata[26];
-             27: read_1b_pixel_d      	= rdata[27];
-             28: read_1b_pixel_d      	= rdata[28];
-             29: read_1b_pixel_d      	= rdata[29];
-             30: read_1b_pixel_d      	= rdata[30];
-             default: read_1b_pixel_d 	= rdata[31];
-           endcase // case (xidx[4:0])
-
-           read_2b_pixel_d 	= 0;
-           case (xidx[3:0])
-             0: read_2b_pixel_d 	= rdata[1:0];
-             1: read_2b_pixel_d 	= rdata[3:2];
-             2: read_2b_pixel_d 	= rdata[5:4];
-             3: read_2b_pixel_d 	= rdata[7:6];
-             4: read_2b_pixel_d 	= rdata[9:8];
-             5: read_2b_pixel_d 	= rdata[11:10];
-             6: read_2b_pixel_d 	= rdata[13:12];
-             7: read_2b_pixel_d 	= rdata[15:14];
-             8: read_2b_pixel_d 	= rdata[17:16];
-             9: read_2b_pixel_d 	= rdata[19:18];
-             10: read_2b_pixel_d 	= rdata[21:20];
-             11: read_2b_pixel_d 	= rdata[23:22];
-             12: read_2b_pixel_d 	= rdata[25:24];
-             13: read_2b_pixel_d 	= rdata[27:26];
-             14: read_2b_pixel_d 	= rdata[29:28];
-             default: read_2b_pixel_d 	= rdata[31:30];
-           endcase // case (xidx[3:0])
-
-           read_4b_pixel_d	= 0;
-           case (xidx[2:0])
-             0: read_4b_pixel_d 	= rdata[3:0];
-             1: read_4b_pixel_d 	= rdata[7:4];
-             2: read_4b_pixel_d 	= rdata[11:8];
-             3: read_4b_pixel_d 	= rdata[15:12];
-             4: read_4b_pixel_d 	= rdata[19:16];
-             5: read_4b_pixel_d 	= rdata[23:20];
-             6: read_4b_pixel_d 	= rdata[27:24];
-             default: read_4b_pixel_d 	= rdata[31:28];
-           endcase // case (xidx[2:0])
-
-           read_8b_pixel_d	= 0;
-           case (xidx[1:0])
-             0:	read_8b_pixel_d       	= rdata[7:0];
-             1: read_8b_pixel_d       	= rdata[15:8];
-             2: read_8b_pixel_d       	= rdata[23:16];
-             default: read_8b_pixel_d 	= rdata[31:24];
-           endcase // case (xidx[1:0])
-   end // always @ (*)
+           reg          read_1b_pixel;
+           reg [3:0]    read_124b_pixel;
+           reg [`INTERNAL_RGB-1:0] read_8b_pixel_rgb;
+           reg          read_1b_pixel_d; // wire
+           reg [1:0]    read_2b_pixel_d; // wire
+           reg [3:0]    read_4b_pixel_d; // wire
+           reg [7:0]    read_8b_pixel_d; // wire
+
+           /* Replacing the ternary ops with these case statements gave a significant perf
+            * improvement; yosys seems to do a much better job with these.
+            */
+           always @(*) begin
+                   read_1b_pixel_d 	= 0;
+                   case (lxidx[4:0])
+                     0: read_1b_pixel_d       	= rdata[0];
+                     1: read_1b_pixel_d       	= rdata[1];
+                     2: read_1b_pixel_d       	= rdata[2];
+                     3: read_1b_pixel_d       	= rdata[3];
+                     4: read_1b_pixel_d       	= rdata[4];
+                     5: read_1b_pixel_d       	= rdata[5];
+                     6: read_1b_pixel_d       	= rdata[6];
+                     7: read_1b_pixel_d       	= rdata[7];
+                     8: read_1b_pixel_d       	= rdata[8];
+                     9: read_1b_pixel_d       	= rdata[9];
+                     10: read_1b_pixel_d      	= rdata[10];
+                     11: read_1b_pixel_d      	= rdata[11];
+                     12: read_1b_pixel_d      	= rdata[12];
+                     13: read_1b_pixel_d      	= rdata[13];
+                     14: read_1b_pixel_d      	= rdata[14];
+                     15: read_1b_pixel_d      	= rdata[15];
+                     16: read_1b_pixel_d      	= rdata[16];
+                     17: read_1b_pixel_d      	= rdata[17];
+                     18: read_1b_pixel_d      	= rdata[18];
+                     19: read_1b_pixel_d      	= rdata[19];
+                     20: read_1b_pixel_d      	= rdata[20];
+                     21: read_1b_pixel_d      	= rdata[21];
+                     22: read_1b_pixel_d      	= rdata[22];
+                     23: read_1b_pixel_d      	= rdata[23];
+                     24: read_1b_pixel_d      	= rdata[24];
+                     25: read_1b_pixel_d      	= rdata[25];
+                     26: read_1b_pixel_d      	= rdata[26];
+                     27: read_1b_pixel_d      	= rdata[27];
+                     28: read_1b_pixel_d      	= rdata[28];
+                     29: read_1b_pixel_d      	= rdata[29];
+                     30: read_1b_pixel_d      	= rdata[30];
+                     default: read_1b_pixel_d 	= rdata[31];
+                   endcase // case (lxidx[4:0])
+
+                   read_2b_pixel_d 	= 0;
+                   case (lxidx[3:0])
+                     0: read_2b_pixel_d 	= rdata[1:0];
+                     1: read_2b_pixel_d 	= rdata[3:2];
+                     2: read_2b_pixel_d 	= rdata[5:4];
+                     3: read_2b_pixel_d 	= rdata[7:6];
+                     4: read_2b_pixel_d 	= rdata[9:8];
+                     5: read_2b_pixel_d 	= rdata[11:10];
+                     6: read_2b_pixel_d 	= rdata[13:12];
+                     7: read_2b_pixel_d 	= rdata[15:14];
+                     8: read_2b_pixel_d 	= rdata[17:16];
+                     9: read_2b_pixel_d 	= rdata[19:18];
+                     10: read_2b_pixel_d 	= rdata[21:20];
+                     11: read_2b_pixel_d 	= rdata[23:22];
+                     12: read_2b_pixel_d 	= rdata[25:24];
+                     13: read_2b_pixel_d 	= rdata[27:26];
+                     14: read_2b_pixel_d 	= rdata[29:28];
+                     default: read_2b_pixel_d 	= rdata[31:30];
+                   endcase // case (lxidx[3:0])
+
+                   read_4b_pixel_d	= 0;
+                   case (lxidx[2:0])
+                     0: read_4b_pixel_d 	= rdata[3:0];
+                     1: read_4b_pixel_d 	= rdata[7:4];
+                     2: read_4b_pixel_d 	= rdata[11:8];
+                     3: read_4b_pixel_d 	= rdata[15:12];
+                     4: read_4b_pixel_d 	= rdata[19:16];
+                     5: read_4b_pixel_d 	= rdata[23:20];
+                     6: read_4b_pixel_d 	= rdata[27:24];
+                     default: read_4b_pixel_d 	= rdata[31:28];
+                   endcase // case (lxidx[2:0])
+
+                   read_8b_pixel_d	= 0;
+                   case (lxidx[1:0])
+                     0:	read_8b_pixel_d       	= rdata[7:0];
+                     1: read_8b_pixel_d       	= rdata[15:8];
+                     2: read_8b_pixel_d       	= rdata[23:16];
+                     default: read_8b_pixel_d 	= rdata[31:24];
+                   endcase // case (lxidx[1:0])
+           end // always @ (*)
 
 `ifdef INCLUDE_HIGH_COLOUR
-   reg  [23:0]   read_16b_pixel_rgb;
-   wire [15:0]   read_16b_pixel_d;
-
-   assign read_16b_pixel_d 		= xidx[0] ? rdata[31:16] : rdata[15:0];
-   always @(posedge pclk) begin
-           read_16b_pixel_rgb <= { read_16b_pixel_d[15:11], {3{read_16b_pixel_d[11]}},
-                                   read_16b_pixel_d[10:5],  {2{read_16b_pixel_d[5]}},
-                                   read_16b_pixel_d[4:0],   {3{read_16b_pixel_d[0]}} };
-   end
-`endif
+           reg  [23:0]   read_16b_pixel_rgb;
+           wire [15:0]   read_16b_pixel_d;
+           reg  [23:0]   read_24b_pixel_rgb;
+           reg  [23:0]   read_24b_pixel_d; // wire
+           /* The second pixel of a pair is 3 bytes on: */
+           wire [2:0]    lxoff = {1'b0, xoff} + ((lane == 1 && pair_split) ? 3'd3 : 3'd0);
+
+           assign read_16b_pixel_d 		= lxidx[0] ? rdata[31:16] : rdata[15:0];
+
+           always @(*) begin
+                   read_24b_pixel_d 	= 0;
+                   case (lxoff)
+                     0: read_24b_pixel_d 	= rdata[23:0];
+                     1: read_24b_pixel_d 	= rdata[31:8];
+                     2: read_24b_pixel_d 	= {rdata_hi[7:0], rdata[31:16]};
+                     3: read_24b_pixel_d 	= {rdata_hi[15:0], rdata[31:24]};
+                     4: read_24b_pixel_d 	= rdata_hi[23:0];
+                     default: read_24b_pixel_d 	= rdata_hi[31:8];
+                   endcase // case (lxoff)
+           end
 
-   // These signals are aligned with hsync_delayed2 et al:
-   always @(posedge pclk) begin
-           read_1b_pixel     <= read_1b_pixel_d;
-           read_8b_pixel_rgb <= palette8b[read_8b_pixel_d];
+           /* Expand 5:6:5 to 8:8:8 by replicating the top bits into the
+            * bottom, so that full scale stays full scale:
+            */
+           always @(posedge pclk) if (vce) begin
+                   read_16b_pixel_rgb <= { read_16b_pixel_d[15:11], read_16b_pixel_d[15:13],
+                                           read_16b_pixel_d[10:5],  read_16b_pixel_d[10:9],
+                                           read_16b_pixel_d[4:0],   read_16b_pixel_d[4:2] };
+                   read_24b_pixel_rgb <= read_24b_pixel_d;
+           end
+`endif
 
-           read_124b_pixel   <= (bpp == 0) ? {3'h0, read_1b_pixel_d} :
-                                (bpp == 1) ? {2'h0, read_2b_pixel_d} :
-                                read_4b_pixel_d;
-   end
+           // These signals are aligned with hsync_delayed2 et al:
+           always @(posedge pclk) if (vce) begin
+                   read_1b_pixel     <= read_1b_pixel_d;
+                   read_8b_pixel_rgb <= palette8b[read_8b_pixel_d];
 
-   reg [11:0] 	vidc_palette_out; // Wire
+                   read_124b_pixel   <= (bpp == 0) ? {3'h0, read_1b_pixel_d} :
+                                        (bpp == 1) ? {2'h0, read_2b_pixel_d} :
+                                        read_4b_pixel_d;
+           end
 
-   /* This is an unsynchronised read of regs from another clock domain,
-    * achtung! */
-   always @(*) begin
-           vidc_palette_out = 0;
-
-           case (read_124b_pixel)
-             4'h0:	vidc_palette_out = vidc_palette[(12*1)-1:(12*0)];
-             4'h1:	vidc_palette_out = vidc_palette[(12*2)-1:(12*1)];
-             4'h2:	vidc_palette_out = vidc_palette[(12*3)-1:(12*2)];
-             4'h3:	vidc_palette_out = vidc_palette[(12*4)-1:(12*3)];
-             4'h4:	vidc_palette_out = vidc_palette[(12*5)-1:(12*4)];
-             4'h5:	vidc_palette_out = vidc_palette[(12*6)-1:(12*5)];
-             4'h6:	vidc_palette_out = vidc_palette[(12*7)-1:(12*6)];
-             4'h7:	vidc_palette_out = vidc_palette[(12*8)-1:(12*7)];
-             4'h8:	vidc_palette_out = vidc_palette[(12*9)-1:(12*8)];
-             4'h9:	vidc_palette_out = vidc_palette[(12*10)-1:(12*9)];
-             4'ha:	vidc_palette_out = vidc_palette[(12*11)-1:(12*10)];
-             4'hb:	vidc_palette_out = vidc_palette[(12*12)-1:(12*11)];
-             4'hc:	vidc_palette_out = vidc_palette[(12*13)-1:(12*12)];
-             4'hd:	vidc_palette_out = vidc_palette[(12*14)-1:(12*13)];
-             4'he:	vidc_palette_out = vidc_palette[(12*15)-1:(12*14)];
-             default:	vidc_palette_out = vidc_palette[(12*16)-1:(12*15)];
-           endcase
-   end
+           wire [11:0] 	vidc_palette_out = vidc_pal[read_124b_pixel];
 
-   // These signals are aligned with hsync_delayed3 et al:
-   reg [`INTERNAL_RGB-1:0] 	read_pixel3;
+           // These signals are aligned with hsync_delayed3 et al:
+           reg [`INTERNAL_RGB-1:0] 	read_pixel3;
 
-   always @(posedge pclk) begin
+           always @(posedge pclk) if (vce) begin
 `ifdef INCLUDE_HIGH_COLOUR
-           if (bpp == 4) begin
-                   read_pixel3 	<= read_16b_pixel_rgb;
-           end else
+                   if (bpp == 5) begin
+                           read_pixel3 	<= read_24b_pixel_rgb;
+                   end else if (bpp == 4) begin
+                           read_pixel3 	<= read_16b_pixel_rgb;
+                   end else
 `endif
-           if (bpp == 3) begin
-                   read_pixel3 	<= read_8b_pixel_rgb;
-           end else if (en_hires) begin
-                   read_pixel3 	<= read_1b_pixel ? {`INTERNAL_RGB{1'b0}} : {`INTERNAL_RGB{1'b1}};
-           end else begin // regular 1, 2, 4bpp:
+                   if (bpp == 3) begin
+                           read_pixel3 	<= read_8b_pixel_rgb;
+                   end else if (en_hires) begin
+                           read_pixel3 	<= read_1b_pixel ? {`INTERNAL_RGB{1'b0}} : {`INTERNAL_RGB{1'b1}};
+                   end else begin // regular 1, 2, 4bpp:
 `ifdef INCLUDE_HIGH_COLOUR
-             read_pixel3 <= { vidc_palette_out[11:8], {4{vidc_palette_out[8]}},
-                              vidc_palette_out[7:4],  {4{vidc_palette_out[4]}},
-                              vidc_palette_out[3:0],  {4{vidc_palette_out[0]}} };
+                     read_pixel3 <= { vidc_palette_out[11:8], {4{vidc_palette_out[8]}},
+                                      vidc_palette_out[7:4],  {4{vidc_palette_out[4]}},
+                                      vidc_palette_out[3:0],  {4{vidc_palette_out[0]}} };
 `else
-             read_pixel3 <= vidc_palette_out;
+                     read_pixel3 <= vidc_palette_out;
 `endif
+                   end
+           end
+
+           assign read_pixels3[(`INTERNAL_RGB*(lane+1))-1:(`INTERNAL_RGB*lane)] = read_pixel3;
+   end endgenerate
+
+
+   ////////////////////////////////////////////////////////////////////////////////
+   // Latency/slack statistics
+
+   /* Latency is the time (in cycles) from VIDC's flyback ending to the
+    * output's first display pixel (o_de) of the frame, or of the image with
+    * the scaler.
+    *
+    * Slack is how far the DMA is ahead of the scan-out in the line buffer:
+    * words written this frame less the word being read, counting the lines
+    * before.  At or below 0, a word's being read before it was written (an
+    * underrun); above two lines, the line being read has been overwritten by
+    * the next-but-one.  The minimum over each display line is counted in a
+    * histogram, binned by fractions of the line length:
+    *
+    *   0: <= 0 (underrun)      1: < 1/8 line    2: < 1/4 line
+    *   3: < 1/2 line           4: < 1 line      5: <= 2 lines
+    *   6: > 2 lines (overwritten)
+    *
+    * The write count is a few cycles old by the time it gets here, so slack
+    * is slightly understated.  At the end of each output frame, the latency,
+    * the frame's minimum/maximum line slack and its histogram are copied to
+    * the stats_* outputs (as is the line lock count, above), which are then
+    * stable for a frame, and stats_toggle toggles.  With the frame store,
+    * the line buffer isn't written by the DMA and no lines are counted.  With
+    * the scaler, only the image counts (its border isn't read from the line
+    * buffer).
+    */
+   reg [19:0]   lb_w_gray_s[1:0];
+   reg [19:0]   lb_w_bin;       // Wire
+   reg [19:0]   lb_w_seen;
+   integer      gi;
+
+   always @(*) begin
+           lb_w_bin[19] = lb_w_gray_s[1][19];
+           for (gi = 18; gi >= 0; gi = gi - 1)
+             lb_w_bin[gi] = lb_w_bin[gi+1] ^ lb_w_gray_s[1][gi];
+   end
+
+   /* Read position:  words in the lines before dispy, plus read_word */
+   wire [10:0]  st_wpl = {1'b0, t_words_per_line_m1} + 11'd1;
+   reg [19:0]   st_r_base;
+   reg [ctr_width_y-1:0] st_r_line;
+   wire [19:0]  st_r_pos = st_r_base + read_word;
+   wire signed [20:0] st_slack = {1'b0, lb_w_seen} - {1'b0, st_r_pos};
+
+   reg signed [20:0] st_line_min;
+   reg          st_line_active;
+   reg signed [20:0] st_frame_min;
+   reg signed [20:0] st_frame_max;
+   reg          st_frame_lines;
+   reg [(7*11)-1:0] st_hist;
+   reg [23:0]   st_lat_ctr;
+   reg [23:0]   st_lat;
+   reg          st_lat_run;
+   reg          st_de_last;
+
+   wire signed [20:0] st_wpl_s = {10'h0, st_wpl};
+   wire [2:0]   st_bin = (st_line_min <= 0) ? 3'd0 :
+                (st_line_min < (st_wpl_s >>> 3)) ? 3'd1 :
+                (st_line_min < (st_wpl_s >>> 2)) ? 3'd2 :
+                (st_line_min < (st_wpl_s >>> 1)) ? 3'd3 :
+                (st_line_min < st_wpl_s) ? 3'd4 :
+                (st_line_min <= (st_wpl_s <<< 1)) ? 3'd5 : 3'd6;
+
+   initial begin
+      stats_toggle   = 0;
+      st_r_line      = 0;
+      st_r_base      = 0;
+      st_line_active = 0;
+      st_frame_lines = 0;
+      st_hist        = 0;
+      st_lat_run     = 0;
+   end
+
+   always @(posedge pclk) if (vce) begin
+           lb_w_gray_s[0]       <= lb_w_gray;
+           lb_w_gray_s[1]       <= lb_w_gray_s[0];
+           lb_w_seen            <= lb_w_bin;
+
+           /* dispy moves on (or back to 0) in the blanking before a line;
+            * the scaler can skip lines, so catch up a line per clock:
+            */
+           if (dispy == 0) begin
+                   st_r_line    <= 0;
+                   st_r_base    <= 20'h0;
+           end else if (dispy != st_r_line) begin
+                   st_r_line    <= st_r_line + 1;
+                   st_r_base    <= st_r_base + st_wpl;
+           end
+
+           if (img_x && vid_enable && !fs_enable) begin
+                   if (!st_line_active || st_slack < st_line_min)
+                     st_line_min <= st_slack;
+                   st_line_active <= 1;
+           end else if (st_line_active) begin
+                   /* End of a display line: */
+                   st_line_active <= 0;
+                   if (!st_frame_lines || st_line_min < st_frame_min)
+                     st_frame_min <= st_line_min;
+                   if (!st_frame_lines || st_line_min > st_frame_max)
+                     st_frame_max <= st_line_min;
+                   st_frame_lines <= 1;
+                   st_hist[(11*st_bin) +: 11] <= st_hist[(11*st_bin) +: 11] + 1;
+           end
+
+           st_de_last           <= img_delayed4;
+           if (flyback_falling) begin
+                   st_lat_ctr   <= 0;
+                   st_lat_run   <= 1;
+           end else if (st_lat_run) begin
+                   if (img_delayed4 && !st_de_last) begin
+                           st_lat       <= st_lat_ctr;
+                           st_lat_run   <= 0;
+                   end else if (st_lat_ctr != 24'hffffff) begin
+                           st_lat_ctr   <= st_lat_ctr + 1;
+                   end
+           end
+
+           if (frame_end) begin
+                   stats_latency        <= st_lat;
+                   stats_slack_min      <= !st_frame_lines ? 16'h0 :
+                                           (st_frame_min < -21'sd32768) ? 16'h8000 :
+                                           (st_frame_min > 21'sd32767) ? 16'h7fff :
+                                           st_frame_min[15:0];
+                   stats_slack_max      <= !st_frame_lines ? 16'h0 :
+                                           (st_frame_max < -21'sd32768) ? 16'h8000 :
+                                           (st_frame_max > 21'sd32767) ? 16'h7fff :
+                                           st_frame_max[15:0];
+                   stats_slack_hist     <= st_hist;
+                   stats_toggle         <= ~stats_toggle;
+                   st_frame_lines       <= 0;
+                   st_hist              <= 0;
            end
    end
 
@@ -744,11 +1721,9 @@ module video_timing(input wire        	     pclk,
    // Final video output pipeline stage
 
    /* Overlay cursor onto video: (false colour for mode 23 :) ) */
-   wire [11:0] cursor_col0int            = en_hires ? 12'hff0 :
-               vidc_cursor_palette[(12*0)+11:(12*0)];
-   wire [11:0] cursor_col1int            = vidc_cursor_palette[(12*1)+11:(12*1)];
-   wire [11:0] cursor_col2int            = en_hires ? 12'h900 :
-               vidc_cursor_palette[(12*2)+11:(12*2)];
+   wire [11:0] cursor_col0int            = en_hires ? 12'hff0 : cursor_pal0;
+   wire [11:0] cursor_col1int            = cursor_pal1;
+   wire [11:0] cursor_col2int            = en_hires ? 12'h900 : cursor_pal2;
 `ifdef INCLUDE_HIGH_COLOUR
    wire [23:0] cursor_col0 = { cursor_col0int[11:8], {4{cursor_col0int[8]}},
                                cursor_col0int[7:4],  {4{cursor_col0int[4]}},
@@ -764,35 +1739,62 @@ module video_timing(input wire        	     pclk,
    wire [11:0] cursor_col1 = cursor_col1int;
    wire [11:0] cursor_col2 = cursor_col2int;
 `endif
-   wire [`INTERNAL_RGB-1:0] final_pixel_rgb 	= cursor_pixel3 == 2'b00 ? read_pixel3 :
-               (cursor_pixel3 == 2'b01) ? cursor_col0 :
-               (cursor_pixel3 == 2'b10) ? cursor_col1 :
-               cursor_col2;
-   wire [3:0]  final_pixel_r = final_pixel_rgb[3:0];
-   wire [3:0]  final_pixel_g = final_pixel_rgb[7:4];
-   wire [3:0]  final_pixel_b = final_pixel_rgb[11:8];
-
+`ifdef INCLUDE_HIGH_COLOUR
+   wire [23:0] fill_col    = fill;
+`else
+   wire [11:0] fill_col    = {fill[23:20], fill[15:12], fill[7:4]};
+`endif
    /* These output signals are aligned with hsync_delayed4 et al: */
-   reg [7:0]    o_r_delayed4;
-   reg [7:0]    o_g_delayed4;
-   reg [7:0]    o_b_delayed4;
-
-   always @(posedge pclk) begin
-           /* Select between test card & 4-to-8 expanded video data: */
+   wire [(24*PIXELS_PER_CLK)-1:0] o_rgb_delayed4;       // Lane n in [24n+23:24n], as {b, g, r}
+
+   generate for (lane = 0; lane < PIXELS_PER_CLK; lane = lane + 1) begin: g_out
+           wire [1:0]   cursor_pixel3 = cursor_pixels3[(2*lane)+1:(2*lane)];
+           wire [`INTERNAL_RGB-1:0] read_pixel3 =
+                        read_pixels3[(`INTERNAL_RGB*(lane+1))-1:(`INTERNAL_RGB*lane)];
+           wire [7:0]   tc_r3 = tc_rgb3[(24*lane)+7:(24*lane)];
+           wire [7:0]   tc_g3 = tc_rgb3[(24*lane)+15:(24*lane)+8];
+           wire [7:0]   tc_b3 = tc_rgb3[(24*lane)+23:(24*lane)+16];
+
+           /* Outside the scaler's image, it's the border: */
+           wire [`INTERNAL_RGB-1:0] final_pixel_rgb 	= !img_delayed3 ? fill_col :
+                        cursor_pixel3 == 2'b00 ? read_pixel3 :
+                        (cursor_pixel3 == 2'b01) ? cursor_col0 :
+                        (cursor_pixel3 == 2'b10) ? cursor_col1 :
+                        cursor_col2;
+           wire [3:0]   final_pixel_r = final_pixel_rgb[3:0];
+           wire [3:0]   final_pixel_g = final_pixel_rgb[7:4];
+           wire [3:0]   final_pixel_b = final_pixel_rgb[11:8];
+
+           reg [7:0]    o_r_delayed4;
+           reg [7:0]    o_g_delayed4;
+           reg [7:0]    o_b_delayed4;
+
+           always @(posedge pclk) if (vce) begin
+                   /* Select between test card & 4-to-8 expanded video data: */
 `ifdef INCLUDE_HIGH_COLOUR
-           o_r_delayed4 <= (enable_test_card) ? tc_r3 : final_pixel_rgb[7:0];
-           o_g_delayed4 <= (enable_test_card) ? tc_g3 : final_pixel_rgb[15:8];
-           o_b_delayed4 <= (enable_test_card) ? tc_b3 : final_pixel_rgb[23:16];
+                   o_r_delayed4 <= (enable_test_card) ? tc_r3 : final_pixel_rgb[7:0];
+                   o_g_delayed4 <= (enable_test_card) ? tc_g3 : final_pixel_rgb[15:8];
+                   o_b_delayed4 <= (enable_test_card) ? tc_b3 : final_pixel_rgb[23:16];
 `else
-           o_r_delayed4 <= (enable_test_card) ? tc_r3 : {final_pixel_r[3:0], {4{final_pixel_r[3]}}};
-           o_g_delayed4 <= (enable_test_card) ? tc_g3 : {final_pixel_g[3:0], {4{final_pixel_g[3]}}};
-           o_b_delayed4 <= (enable_test_card) ? tc_b3 : {final_pixel_b[3:0], {4{final_pixel_b[3]}}};
+                   o_r_delayed4 <= (enable_test_card) ? tc_r3 : {final_pixel_r[3:0], {4{final_pixel_r[3]}}};
+                   o_g_delayed4 <= (enable_test_card) ? tc_g3 : {final_pixel_g[3:0], {4{final_pixel_g[3]}}};
+                   o_b_delayed4 <= (enable_test_card) ? tc_b3 : {final_pixel_b[3:0], {4{final_pixel_b[3]}}};
 `endif
-   end
+           end
+
+           assign o_rgb_delayed4[(24*lane)+23:(24*lane)] = {o_b_delayed4, o_g_delayed4, o_r_delayed4};
+   end endgenerate
+
 
-   assign o_r 		= o_r_delayed4;
-   assign o_g 		= o_g_delayed4;
-   assign o_b 		= o_b_delayed4;
+   ////////////////////////////////////////////////////////////////////////////////
+   // Outputs
+
+   /* With two pixels per clock, the pair's second pixel is o_rgb_2nd, and
+    * the parent serialises them (see "Clocking").  The syncs are the same
+    * for both pixels.
+    */
+   assign {o_b, o_g, o_r} = o_rgb_delayed4[23:0];
+   assign o_rgb_2nd     = o_rgb_delayed4[(24*PIXELS_PER_CLK)-1:(24*PIXELS_PER_CLK)-24];
    assign o_hsync 	= hsync_delayed4;
    assign o_vsync 	= vsync_delayed4;
    assign o_de 		= de_delayed4;
@@ -0,0 +1,135 @@
+/* Collects HDMI audio samples, for checking against the sound stimulus.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "audio_monitor.h"
+
+AudioMonitor::AudioMonitor()
+{
+        reset();
+}
+
+void    AudioMonitor::reset()
+{
+        chan[0].clear();
+        chan[1].clear();
+        acr_packets = 0;
+        cts_min = ~0u;
+        cts_max = 0;
+}
+
+void    AudioMonitor::sample(int sent, unsigned int n, const uint32_t *s,
+                             int acr_sent, uint32_t cts)
+{
+        if (sent) {
+                for (unsigned int i = 0; i < n; i++) {
+                        chan[0].push_back((int16_t)(s[i] & 0xffff));
+                        chan[1].push_back((int16_t)(s[i] >> 16));
+                }
+        }
+        if (acr_sent) {
+                acr_packets++;
+                if (cts < cts_min)
+                        cts_min = cts;
+                if (cts > cts_max)
+                        cts_max = cts;
+        }
+}
+
+/* VIDC multiplexes the channels, so a channel is on for half the time, at
+ * 1/(2 * period):  its images alias down to 16-ish kHz, and would add zero
+ * crossings.  A 3-tap average (a null at 16kHz) removes most of that.
+ */
+std::vector<double> AudioMonitor::smoothed(int c) const
+{
+        const std::vector<int16_t> &v = chan[c];
+        std::vector<double> o;
+
+        for (size_t i = 2; i < v.size(); i++)
+                o.push_back((v[i-2] + v[i-1] + v[i]) / 3.0);
+        return o;
+}
+
+double  AudioMonitor::frequency(int c) const
+{
+        std::vector<double> v = smoothed(c);
+        double first = -1, last = -1;
+        int crossings = 0;
+
+        for (size_t i = 1; i < v.size(); i++) {
+                if (v[i-1] < 0 && v[i] >= 0) {
+                        /* Interpolate where it crossed: */
+                        double t = (i - 1) + -v[i-1] / (v[i] - v[i-1]);
+                        if (first < 0)
+                                first = t;
+                        last = t;
+                        crossings++;
+                }
+        }
+        if (crossings < 3)
+                return 0;
+        return (crossings - 1) * rate / (last - first);
+}
+
+int     AudioMonitor::peak(int c) const
+{
+        std::vector<double> v = smoothed(c);
+        double p = 0;
+
+        for (size_t i = 0; i < v.size(); i++) {
+                if (fabs(v[i]) > p)
+                        p = fabs(v[i]);
+        }
+        return (int)p;
+}
+
+/* Bit 0 is the sign, [7:5] the chord and [4:1] the step, as mu-law
+ * (but not inverted).
+ */
+int     AudioMonitor::vidc_decode(uint8_t b)
+{
+        int chord = b >> 5;
+        int step = (b >> 1) & 0xf;
+        int mag = (((step << 1) + 33) << chord) - 33;
+
+        return (b & 1) ? -mag : mag;
+}
+
+uint8_t AudioMonitor::vidc_encode(int lin)
+{
+        int sign = lin < 0;
+        int mag = (sign ? -lin : lin) + 33;
+        int chord = 0;
+
+        if (mag > 8191)
+                mag = 8191;
+        while (chord < 7 && mag >= (64 << chord))
+                chord++;
+        int step = (mag >> (chord + 1)) & 0xf;
+
+        return (chord << 5) | (step << 1) | sign;
+}
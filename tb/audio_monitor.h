@@ -0,0 +1,70 @@
+/* Collects the audio samples sent in HDMI audio sample packets (see
+ * src/hdmi_island.v), and measures each channel's tone frequency and
+ * amplitude.  Also the VIDC sound byte encoding, for making the stimulus.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef AUDIO_MONITOR_H
+#define AUDIO_MONITOR_H
+
+#include <stdint.h>
+#include <vector>
+
+class AudioMonitor {
+public:
+        AudioMonitor();
+
+        void            reset();
+
+        /* Call on every pixel clock edge:  n (0-4) samples, {right, left},
+         * sent in an audio sample packet, and ACR packets' CTS.
+         */
+        void            sample(int sent, unsigned int n, const uint32_t *s,
+                               int acr_sent, uint32_t cts);
+
+        uint64_t        count() const                   { return chan[0].size(); }
+        /* Channel 0 is left.  Frequency from rising zero crossings (0 if
+         * there aren't enough), and largest magnitude, both measured after
+         * a light low-pass filter:
+         */
+        double          frequency(int c) const;
+        int             peak(int c) const;
+
+        uint64_t        acr_packets;
+        uint32_t        cts_min;
+        uint32_t        cts_max;
+
+        static const int rate = 48000;
+
+        /* VIDC's 8-bit log format, from/to 13-bit signed linear: */
+        static uint8_t  vidc_encode(int lin);
+        static int      vidc_decode(uint8_t b);
+
+private:
+        std::vector<double> smoothed(int c) const;
+
+        std::vector<int16_t> chan[2];
+};
+
+#endif
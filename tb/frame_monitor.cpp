@@ -0,0 +1,118 @@
+/* Collects the video_timing output (RGB + DE, VSync) into whole frames.
+ *
+ * The geometry is discovered from DE:  the width is the length of the first
+ * displayed line, and the height is the number of DE runs before VSync.
+ * Lines of differing lengths mark the frame as ragged.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+
+#include "frame_monitor.h"
+
+FrameMonitor::FrameMonitor()
+{
+        frames = 0;
+        w = 0;
+        h = 0;
+        x = 0;
+        irregular = false;
+        frame_tag = 0;
+        last_de = 0;
+        last_vsync = 0;
+}
+
+void    FrameMonitor::sample(int de, int vsync, uint8_t r, uint8_t g, uint8_t b)
+{
+        if (vsync && !last_vsync) {
+                if (h > 0) {
+                        frames++;
+                        if (frame_fn)
+                                frame_fn(*this);
+                }
+                buf.clear();
+                w = 0;
+                h = 0;
+                irregular = false;
+        }
+        last_vsync = vsync;
+
+        if (de) {
+                if (!last_de) {
+                        if (h == 0 && tag_fn)
+                                frame_tag = tag_fn();
+                        x = 0;
+                }
+                buf.push_back(((uint32_t)r << 16) | ((uint32_t)g << 8) | b);
+                x++;
+        } else if (last_de) {
+                /* End of a line */
+                if (h == 0)
+                        w = x;
+                else if (x != w)
+                        irregular = true;
+                h++;
+        }
+        last_de = de;
+}
+
+uint32_t        FrameMonitor::crc32(const uint32_t *pix, unsigned int n)
+{
+        static uint32_t table[256];
+
+        if (!table[1]) {
+                for (uint32_t i = 0; i < 256; i++) {
+                        uint32_t c = i;
+                        for (int k = 0; k < 8; k++)
+                                c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+                        table[i] = c;
+                }
+        }
+
+        uint32_t crc = 0xffffffff;
+        for (unsigned int i = 0; i < n; i++) {
+                /* Just the 24 RGB bits, R first */
+                crc = table[(crc ^ (pix[i] >> 16)) & 0xff] ^ (crc >> 8);
+                crc = table[(crc ^ (pix[i] >> 8)) & 0xff] ^ (crc >> 8);
+                crc = table[(crc ^ pix[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+}
+
+bool    FrameMonitor::write_ppm(const char *path, const uint32_t *pix,
+                                unsigned int w, unsigned int h)
+{
+        FILE *f = fopen(path, "wb");
+        if (!f)
+                return false;
+
+        fprintf(f, "P6\n%u %u\n255\n", w, h);
+        for (unsigned int i = 0; i < w * h; i++) {
+                uint8_t rgb[3] = { (uint8_t)(pix[i] >> 16), (uint8_t)(pix[i] >> 8),
+                                   (uint8_t)pix[i] };
+                fwrite(rgb, 3, 1, f);
+        }
+        fclose(f);
+        return true;
+}
@@ -0,0 +1,77 @@
+/* Collects the video_timing output (RGB + DE, VSync) into whole frames.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FRAME_MONITOR_H
+#define FRAME_MONITOR_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+class FrameMonitor {
+public:
+        typedef std::function<void(const FrameMonitor &)> frame_fn_t;
+        typedef std::function<uint64_t(void)> tag_fn_t;
+
+        FrameMonitor();
+
+        /* Called once per frame, at output VSync, if any lines were displayed */
+        void            set_frame_fn(frame_fn_t fn)     { frame_fn = fn; }
+        /* Called at the first displayed pixel of a frame; e.g. to note which
+         * input frame is being shown.
+         */
+        void            set_tag_fn(tag_fn_t fn)         { tag_fn = fn; }
+
+        /* Call on every pixel clock edge */
+        void            sample(int de, int vsync, uint8_t r, uint8_t g, uint8_t b);
+
+        unsigned int    width() const                   { return w; }
+        unsigned int    height() const                  { return h; }
+        bool            ragged() const                  { return irregular; }
+        uint64_t        tag() const                     { return frame_tag; }
+        const uint32_t  *pixels() const                 { return buf.data(); }
+
+        uint64_t        frames;
+
+        /* 0x00RRGGBB pixels */
+        static uint32_t crc32(const uint32_t *pix, unsigned int n);
+        static bool     write_ppm(const char *path, const uint32_t *pix,
+                                  unsigned int w, unsigned int h);
+
+private:
+        frame_fn_t      frame_fn;
+        tag_fn_t        tag_fn;
+
+        std::vector<uint32_t> buf;
+        unsigned int    w;
+        unsigned int    h;
+        unsigned int    x;
+        bool            irregular;
+        uint64_t        frame_tag;
+        int             last_de;
+        int             last_vsync;
+};
+
+#endif
@@ -0,0 +1,242 @@
+/* Display timings for the standard RISC OS 3 screen modes, as VIDC lists.
+ *
+ * These are used by the simulation models to play a mode change into the
+ * design the same way the OS would, and by tools/gen_mode_table.c to build
+ * the firmware's table of known modes.  Each mode's timing is given in the
+ * form of the OS's VIDC parameter lists (and monitor definition files):
+ * sync, back porch, left/top border, display, right/bottom border and front
+ * porch, in pixels horizontally and lines vertically.  riscos_mode_to_vidc()
+ * turns that into register values with the PRM's formulae, truncating as
+ * the OS does, so the table's signatures are those of the OS's writes
+ * (gen_mode_table checks that every mode here hits).  VIDC then puts the
+ * display where the registers say, which can be a pixel earlier than the
+ * list (see riscos_vidc_raster()).
+ *
+ * The lists should be compared against a real machine's writes, e.g. with
+ * the "telem" command's VIDC register records (tools/telem_dump).
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RISCOS_MODES_H
+#define RISCOS_MODES_H
+
+#include <string.h>
+
+#include "../firmware/vidc_regs.h"
+
+/* VIDC control register pixel rate field: */
+#define PIXRATE_8MHZ    0
+#define PIXRATE_12MHZ   1
+#define PIXRATE_16MHZ   2
+#define PIXRATE_24MHZ   3
+
+struct riscos_mode {
+        int             mode;
+        int             pixrate;        /* Control register [1:0] */
+        int             bpp;            /* log2, i.e. control register [3:2] */
+        int             hires;          /* Needs a HIRES_MODE build */
+
+        /* The VIDC list's horizontal timing, in pixels */
+        int             h_sync, h_bporch, h_lborder, h_disp, h_rborder, h_fporch;
+        /* ...and vertical, in lines */
+        int             v_sync, v_bporch, v_tborder, v_disp, v_bborder, v_fporch;
+};
+
+/* Timings shared by several modes, horizontal then vertical: */
+
+/* 16MHz, 640 pixels, on a TV-standard monitor */
+#define TV_640          72, 62, 88, 640, 88, 74
+/* 8MHz, 320 pixels (the 160-pixel modes double pixels in software) */
+#define TV_320          36, 31, 44, 320, 44, 37
+/* 24MHz, 1056 pixels */
+#define TV_1056         108, 72, 106, 1056, 106, 88
+/* 16MHz, 768 pixels of overscan */
+#define TV_768          72, 62, 24, 768, 24, 74
+#define TV_256          3, 16, 17, 256, 17, 3
+#define TV_250          3, 16, 20, 250, 20, 3
+#define TV_288          3, 16, 1, 288, 1, 3
+
+/* 24MHz, 640x512 on a multisync monitor */
+#define MS_640          56, 112, 0, 640, 0, 88
+#define MS_512          3, 18, 0, 512, 0, 1
+
+/* 24MHz, 640 pixels at VGA's line rate, 480 lines at 60Hz and 352/200 at
+ * 70Hz:
+ */
+#define VGA_640         96, 46, 0, 640, 0, 18
+#define VGA_480         2, 32, 0, 480, 0, 11
+#define VGA_352         2, 58, 0, 352, 0, 37
+#define VGA_200         2, 124, 0, 200, 0, 123
+
+/* 1152x896 mono: VIDC runs 288 "4bpp" pixels per line at 24MHz, shifted
+ * out 4x faster by the external hires circuitry.
+ */
+#define HIRES_288       36, 51, 0, 288, 0, 17
+#define HIRES_896       3, 47, 0, 896, 0, 4
+
+/* Modes 29-32 (800x600) and 37-40 (896x352) aren't here:  they need a
+ * 36MHz VIDC clock, which the capture can't tell from the usual 24MHz.
+ */
+static const struct riscos_mode riscos_modes[] = {
+        /* 640x256 (line-doubled on output) */
+        {  0, PIXRATE_16MHZ, 0, 0,      TV_640, TV_256 },
+        {  8, PIXRATE_16MHZ, 1, 0,      TV_640, TV_256 },
+        { 12, PIXRATE_16MHZ, 2, 0,      TV_640, TV_256 },
+        { 15, PIXRATE_16MHZ, 3, 0,      TV_640, TV_256 },
+        /* 640x250 text */
+        {  3, PIXRATE_16MHZ, 0, 0,      TV_640, TV_250 },
+        { 11, PIXRATE_16MHZ, 1, 0,      TV_640, TV_250 },
+        { 14, PIXRATE_16MHZ, 2, 0,      TV_640, TV_250 },
+
+        /* 320x256 (pixel- and line-doubled on output) */
+        {  4, PIXRATE_8MHZ,  0, 0,      TV_320, TV_256 },
+        {  1, PIXRATE_8MHZ,  1, 0,      TV_320, TV_256 },
+        {  9, PIXRATE_8MHZ,  2, 0,      TV_320, TV_256 },
+        { 13, PIXRATE_8MHZ,  3, 0,      TV_320, TV_256 },
+        /* 160x256, the same to VIDC */
+        {  5, PIXRATE_8MHZ,  1, 0,      TV_320, TV_256 },
+        {  2, PIXRATE_8MHZ,  2, 0,      TV_320, TV_256 },
+        { 10, PIXRATE_8MHZ,  3, 0,      TV_320, TV_256 },
+        /* 320x250 text, and teletext */
+        {  6, PIXRATE_8MHZ,  0, 0,      TV_320, TV_250 },
+        {  7, PIXRATE_8MHZ,  2, 0,      TV_320, TV_250 },
+
+        /* 1056x256 and 1056x250 */
+        { 16, PIXRATE_24MHZ, 2, 0,      TV_1056, TV_256 },
+        { 24, PIXRATE_24MHZ, 3, 0,      TV_1056, TV_256 },
+        { 17, PIXRATE_24MHZ, 2, 0,      TV_1056, TV_250 },
+
+        /* 768x288 overscan */
+        { 33, PIXRATE_16MHZ, 0, 0,      TV_768, TV_288 },
+        { 34, PIXRATE_16MHZ, 1, 0,      TV_768, TV_288 },
+        { 35, PIXRATE_16MHZ, 2, 0,      TV_768, TV_288 },
+        { 36, PIXRATE_16MHZ, 3, 0,      TV_768, TV_288 },
+        { 22, PIXRATE_16MHZ, 2, 0,      TV_768, TV_288 },
+
+        /* 640x512 multisync */
+        { 18, PIXRATE_24MHZ, 0, 0,      MS_640, MS_512 },
+        { 19, PIXRATE_24MHZ, 1, 0,      MS_640, MS_512 },
+        { 20, PIXRATE_24MHZ, 2, 0,      MS_640, MS_512 },
+        { 21, PIXRATE_24MHZ, 3, 0,      MS_640, MS_512 },
+
+        /* 640x480, 640x352 and 640x200 VGA */
+        { 25, PIXRATE_24MHZ, 0, 0,      VGA_640, VGA_480 },
+        { 26, PIXRATE_24MHZ, 1, 0,      VGA_640, VGA_480 },
+        { 27, PIXRATE_24MHZ, 2, 0,      VGA_640, VGA_480 },
+        { 28, PIXRATE_24MHZ, 3, 0,      VGA_640, VGA_480 },
+        { 41, PIXRATE_24MHZ, 0, 0,      VGA_640, VGA_352 },
+        { 42, PIXRATE_24MHZ, 1, 0,      VGA_640, VGA_352 },
+        { 43, PIXRATE_24MHZ, 2, 0,      VGA_640, VGA_352 },
+        { 44, PIXRATE_24MHZ, 0, 0,      VGA_640, VGA_200 },
+        { 45, PIXRATE_24MHZ, 1, 0,      VGA_640, VGA_200 },
+        { 46, PIXRATE_24MHZ, 2, 0,      VGA_640, VGA_200 },
+
+        /* 1152x896 mono */
+        { 23, PIXRATE_24MHZ, 2, 1,      HIRES_288, HIRES_896 },
+};
+
+#define NUM_RISCOS_MODES        (sizeof(riscos_modes)/sizeof(riscos_modes[0]))
+
+static inline const struct riscos_mode *riscos_mode_find(int mode)
+{
+        for (unsigned int i = 0; i < NUM_RISCOS_MODES; i++) {
+                if (riscos_modes[i].mode == mode)
+                        return &riscos_modes[i];
+        }
+        return 0;
+}
+
+/* The register values the OS writes for a mode (raw, without the address
+ * in [31:26]):
+ */
+struct riscos_vidc {
+        uint32_t        control;
+        uint32_t        hcr, hswr, hbsr, hdsr, hder, hber;
+        uint32_t        vcr, vswr, vbsr, vdsr, vder, vber;
+};
+
+static inline void riscos_mode_to_vidc(const struct riscos_mode *m,
+                                       struct riscos_vidc *r)
+{
+        int off = vidc_bpp_to_hdsr_offset(m->bpp);
+        int hb = m->h_sync + m->h_bporch;
+        int hd = hb + m->h_lborder;
+        int vb = m->v_sync + m->v_bporch;
+        int vd = vb + m->v_tborder;
+
+        r->control = (uint32_t)((m->bpp << 2) | m->pixrate);
+
+        r->hcr = (uint32_t)((hd + m->h_disp + m->h_rborder + m->h_fporch - 2) / 2) << 14;
+        r->hswr = (uint32_t)((m->h_sync - 2) / 2) << 14;
+        r->hbsr = (uint32_t)((hb - 1) / 2) << 14;
+        r->hdsr = (uint32_t)((hd - off) / 2) << 14;
+        r->hder = (uint32_t)((hd + m->h_disp - off) / 2) << 14;
+        r->hber = (uint32_t)((hd + m->h_disp + m->h_rborder - 1) / 2) << 14;
+
+        r->vcr = (uint32_t)(vd + m->v_disp + m->v_bborder + m->v_fporch - 1) << 14;
+        r->vswr = (uint32_t)(m->v_sync - 1) << 14;
+        r->vbsr = (uint32_t)(vb - 1) << 14;
+        r->vdsr = (uint32_t)(vd - 1) << 14;
+        r->vder = (uint32_t)(vd + m->v_disp - 1) << 14;
+        r->vber = (uint32_t)(vd + m->v_disp + m->v_bborder - 1) << 14;
+}
+
+static inline int riscos_mode_same_vidc(const struct riscos_mode *a,
+                                        const struct riscos_mode *b)
+{
+        struct riscos_vidc ra, rb;
+
+        riscos_mode_to_vidc(a, &ra);
+        riscos_mode_to_vidc(b, &rb);
+        return memcmp(&ra, &rb, sizeof(ra)) == 0;
+}
+
+/* Where VIDC's raster puts things, given the registers:  pixels and lines
+ * from the start of sync.
+ */
+struct riscos_raster {
+        int             pixrate, bpp;
+        int             h_total, h_sync, h_disp_start, h_disp_end;
+        int             v_total, v_sync, v_disp_start, v_disp_end;
+};
+
+static inline void riscos_vidc_raster(const struct riscos_vidc *r,
+                                      struct riscos_raster *ra)
+{
+        int bpp = (r->control >> 2) & 3;
+        int off = vidc_bpp_to_hdsr_offset(bpp);
+
+        ra->pixrate = r->control & 3;
+        ra->bpp = bpp;
+        ra->h_total = 2 * (int)((r->hcr >> 14) & 0x3ff) + 2;
+        ra->h_sync = 2 * (int)((r->hswr >> 14) & 0x3ff) + 2;
+        ra->h_disp_start = 2 * (int)((r->hdsr >> 14) & 0x3ff) + off;
+        ra->h_disp_end = 2 * (int)((r->hder >> 14) & 0x3ff) + off;
+        ra->v_total = (int)((r->vcr >> 14) & 0x3ff) + 1;
+        ra->v_sync = (int)((r->vswr >> 14) & 0x3ff) + 1;
+        ra->v_disp_start = (int)((r->vdsr >> 14) & 0x3ff) + 1;
+        ra->v_disp_end = (int)((r->vder >> 14) & 0x3ff) + 1;
+}
+
+#endif
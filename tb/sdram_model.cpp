@@ -0,0 +1,181 @@
+/* Model of a 16-bit SDR SDRAM, see sdram_model.h.
+ *
+ * Timing is only modelled as far as the CAS latency; the controller's
+ * tRCD/tRP/tRFC etc. aren't checked.  Auto-precharge (A10 on READ/WRITE)
+ * closes the row at the end of the burst.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include "sdram_model.h"
+
+#define NUM_ROWS        8192
+#define NUM_COLS        512
+#define BURST_LEN       8
+
+/* {csn, rasn, casn, wen}: */
+#define CMD_NOP         0x7
+#define CMD_ACT         0x3
+#define CMD_READ        0x5
+#define CMD_WRITE       0x4
+#define CMD_PRE         0x2
+#define CMD_REF         0x1
+#define CMD_MRS         0x0
+
+SdramModel::SdramModel()
+        : reads(0), writes(0), refreshes(0), errors(0),
+          mem(4 * NUM_ROWS * NUM_COLS), edge(0),
+          mode_set(0), cas_latency(2), init_refreshes(0),
+          wr_beat(-1), wr_base(0), rd_start(0), rd_active(0), rd_base(0), dq_out(0)
+{
+        for (int b = 0; b < 4; b++) {
+                row_open[b] = 0;
+                row[b] = 0;
+        }
+}
+
+void    SdramModel::error(const char *what)
+{
+        if (errors++ < 10)
+                printf("\n*** SDRAM: %s (edge %llu)\n", what, (unsigned long long)edge);
+}
+
+int     SdramModel::tick(const struct sdram_pins &p)
+{
+        unsigned int cmd = ((p.csn & 1) << 3) | ((p.rasn & 1) << 2) |
+                ((p.casn & 1) << 1) | (p.wen & 1);
+        unsigned int b = p.ba & 3;
+
+        edge++;
+
+        /* Write data beats 1-7 follow the WRITE: */
+        if (wr_beat > 0) {
+                if (!p.dq_oe)
+                        error("write data not driven");
+                if (!(p.dqm & 1))
+                        mem[wr_base + wr_beat] = (mem[wr_base + wr_beat] & 0xff00) | (p.dq & 0xff);
+                if (!(p.dqm & 2))
+                        mem[wr_base + wr_beat] = (mem[wr_base + wr_beat] & 0x00ff) | (p.dq & 0xff00);
+                if (++wr_beat == BURST_LEN)
+                        wr_beat = -1;
+                if (cmd != CMD_NOP)
+                        error("command during write burst");
+        }
+
+        if (cmd != CMD_NOP && cmd != CMD_REF && cmd != CMD_PRE && cmd != CMD_MRS &&
+            (!mode_set || init_refreshes < 2))
+                error("access before initialisation");
+
+        switch (cmd) {
+        case CMD_NOP:
+                break;
+
+        case CMD_MRS:
+                if ((p.a & 7) != 3 || (p.a & 8))
+                        error("mode register isn't sequential BL8");
+                cas_latency = (p.a >> 4) & 7;
+                if (cas_latency != 2 && cas_latency != 3)
+                        error("unsupported CAS latency");
+                mode_set = 1;
+                break;
+
+        case CMD_REF:
+                for (int i = 0; i < 4; i++)
+                        if (row_open[i])
+                                error("refresh with a row open");
+                if (!mode_set)
+                        init_refreshes++;
+                refreshes++;
+                break;
+
+        case CMD_PRE:
+                if (p.a & 0x400) {
+                        for (int i = 0; i < 4; i++)
+                                row_open[i] = 0;
+                } else {
+                        row_open[b] = 0;
+                }
+                break;
+
+        case CMD_ACT:
+                if (row_open[b])
+                        error("activate of an open bank");
+                row_open[b] = 1;
+                row[b] = p.a & (NUM_ROWS - 1);
+                break;
+
+        case CMD_READ:
+        case CMD_WRITE: {
+                if (!row_open[b]) {
+                        error("read/write to a closed bank");
+                        break;
+                }
+                unsigned int col = p.a & (NUM_COLS - 1);
+                if (col & (BURST_LEN - 1))
+                        error("unaligned burst");
+                unsigned int base = ((b * NUM_ROWS) + row[b]) * NUM_COLS +
+                        (col & ~(BURST_LEN - 1));
+
+                if (cmd == CMD_WRITE) {
+                        writes++;
+                        wr_base = base;
+                        /* Beat 0 comes with the command: */
+                        if (!p.dq_oe)
+                                error("write data not driven");
+                        if (!(p.dqm & 1))
+                                mem[base] = (mem[base] & 0xff00) | (p.dq & 0xff);
+                        if (!(p.dqm & 2))
+                                mem[base] = (mem[base] & 0x00ff) | (p.dq & 0xff00);
+                        wr_beat = 1;
+                } else {
+                        reads++;
+                        rd_base = base;
+                        rd_active = 1;
+                        /* Beat 0 is driven from CL-1 edges later, so that it's
+                         * valid at the CL'th edge:
+                         */
+                        rd_start = edge + cas_latency - 1;
+                }
+                if (p.a & 0x400)
+                        row_open[b] = 0;        /* Auto-precharge */
+                else
+                        error("expected auto-precharge");
+        } break;
+
+        default:
+                error("unsupported command");
+        }
+
+        if (rd_active && edge >= rd_start) {
+                uint64_t beat = edge - rd_start;
+                if (beat < BURST_LEN) {
+                        if (p.dq_oe)
+                                error("bus contention");
+                        dq_out = mem[rd_base + beat];
+                        return 1;
+                }
+                rd_active = 0;
+        }
+        return 0;
+}
@@ -0,0 +1,86 @@
+/* Model of the ULX3S's 16-bit SDR SDRAM (32MB, 4 banks x 8192 rows x 512
+ * columns), enough to run src/sdram_ctrl.v against:  BL8 sequential bursts,
+ * DQM write masking, CL 2 or 3.  Protocol errors (commands before
+ * initialisation, accesses to closed rows, etc.) are counted and reported.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SDRAM_MODEL_H
+#define SDRAM_MODEL_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Pin state, active-low signals as on the real part: */
+struct sdram_pins {
+        int             csn;
+        int             rasn;
+        int             casn;
+        int             wen;
+        unsigned int    a;
+        unsigned int    ba;
+        unsigned int    dqm;
+        unsigned int    dq;             /* From the controller */
+        int             dq_oe;
+};
+
+class SdramModel {
+public:
+        SdramModel();
+
+        /* Call at each SDRAM clock rising edge (i.e. clk falling edge), with
+         * the pins as set up by the controller.  Returns whether the SDRAM
+         * drives DQ until the next edge, and if so, rd_data gives the value.
+         */
+        int             tick(const struct sdram_pins &p);
+        unsigned int    rd_data() const                 { return dq_out; }
+
+        /* Statistics */
+        uint64_t        reads;                  /* Bursts */
+        uint64_t        writes;
+        uint64_t        refreshes;
+        uint64_t        errors;
+
+private:
+        void            error(const char *what);
+
+        std::vector<uint16_t> mem;
+        uint64_t        edge;
+
+        int             mode_set;
+        int             cas_latency;
+        int             init_refreshes;
+        int             row_open[4];
+        unsigned int    row[4];
+
+        /* Burst in progress: */
+        int             wr_beat;                /* -1 = none */
+        unsigned int    wr_base;
+        uint64_t        rd_start;               /* Edge of first data */
+        int             rd_active;
+        unsigned int    rd_base;
+        unsigned int    dq_out;
+};
+
+#endif
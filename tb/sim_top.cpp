@@ -0,0 +1,1103 @@
+/* Verilator testbench for soc_top:  a cycle model of the whole design
+ * (CPU + firmware, VIDC capture, video output) driven by the VIDC BFM.
+ *
+ * For each requested RISC OS mode, the BFM plays the OS's register writes,
+ * then streams whole frames of DMA; the firmware reacts as it would on real
+ * hardware.  UART output from the firmware is decoded and printed.  The
+ * point is speed:  it reports simulated frames per wall-clock second.
+ *
+ * Every output frame is also captured (tb/frame_monitor.cpp) and compared
+ * pixel-for-pixel against the reference renderer (tb/vidc_ref.cpp) given
+ * the same DMA data and VIDC state.  The first few frames after a mode
+ * change are skipped, whilst the firmware reprograms the output.
+ *
+ * With -F, the firmware is told (over its UART) to use the SDRAM frame
+ * store, modelled by tb/sdram_model.cpp.  The output then runs at 60Hz,
+ * a frame or two behind the input, so a frame is accepted if it matches
+ * any of the last few input frames.
+ *
+ * With -a, the BFM also plays a stereo tone through sound DMA, and the
+ * firmware turns on HDMI audio.  The audio sample packets are collected
+ * (tb/audio_monitor.cpp) and each mode checks the sample rate, the tones'
+ * frequencies and levels, the ACR packets' CTS and that the sound buffer
+ * neither ran dry nor overflowed.
+ *
+ * With -S, after boot an SPI master (tb/spi_master.cpp) drives the SPI
+ * slave interface through the host library (tools/arcdvi_spi.c):  it reads
+ * back the video registers, reprograms the same mode in one transaction
+ * and checks a burst write reads back.  At the end, the time that took is
+ * compared with the firmware's longest run of video register writes (i.e.
+ * a mode programmed over the CPU's MMIO path).
+ *
+ * In a FLASH_XIP build, the firmware runs from a model of the SPI flash
+ * (tb/spiflash_model.cpp), loaded with firmware/firmware_xip.bin.  With -P,
+ * the firmware's "perf" report (main loop time and, for XIP, cache hit
+ * rate) for the run is printed at the end, to compare the two.
+ *
+ * With -T, the firmware's binary telemetry (firmware/telem.h) is turned on
+ * after boot, and pulled out of its UART output by the host decoder
+ * (tools/telem_decoder.cpp), which checks the framing, CRCs and sequence.
+ * Each mode checks the frame records' DMA counts against the BFM's, and
+ * the VIDC timing registers rebuilt from their deltas against what was
+ * written.  The raw stream is written to a file, for tools/telem_dump.
+ *
+ * With -B, the firmware is told to switch the UART to another baud rate
+ * after boot, and the testbench follows once it's said it's switching; the
+ * rest of the run (commands in, output and telemetry out) is at that rate.
+ * With -P, the firmware's UART statistics and its measurement of the CPU
+ * clocks each printed byte costs are printed at the end too.
+ *
+ * Usage: sim_top [-m mode[,mode...]] [-f frames] [-s settle] [-c] [-n] [-d] [-v] [-q] [-t] [-F] [-a] [-S] [-P] [-T file] [-B baud]
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "verilated.h"
+#if VM_TRACE
+#include "verilated_vcd_c.h"
+#endif
+#include "Vsim_top.h"
+
+#include "vidc_bfm.h"
+#include "../firmware/vidc_regs.h"
+#include "vidc_ref.h"
+#include "frame_monitor.h"
+#include "sdram_model.h"
+#include "audio_monitor.h"
+#include "spi_master.h"
+#ifdef FLASH_XIP
+#include "spiflash_model.h"
+#endif
+#include "../tools/arcdvi_spi.h"
+#include "../tools/telem_decoder.h"
+#include "../firmware/hw.h"
+#include "../firmware/video.h"
+
+/* These must match the -G overrides in the Makefile: */
+#define SYS_CLK_RATE    50000000
+#define BAUD_RATE       2500000
+
+/* Clock half-periods, in ps.  Note: under SIM, clocks.v passes clk_25mhz
+ * straight through as the system clock, so it's driven at SYS_CLK_RATE.
+ */
+#define SYS_HALF_PS     (1000000000000ULL / SYS_CLK_RATE / 2)
+#define VIDC_HALF_PS    20833ULL        /* 24MHz */
+
+#ifdef FLASH_XIP
+#define BOOT_TIME_PS    (3000ULL * 1000000)     /* Slower from flash, cache cold */
+#else
+#define BOOT_TIME_PS    (500ULL * 1000000)      /* 500us for firmware to start */
+#endif
+/* The firmware takes input from the UART's FIFO by interrupt, so it can be
+ * sent back to back:
+ */
+#define UART_RX_GAP     0
+
+/* How many input frames the frame store's output can lag by: */
+#define FS_MAX_LAG      3
+
+/* The -a stimulus:  left and right tones, played as VIDC 2-channel stereo */
+#define SND_PERIOD_US   16
+#define SND_AMPLITUDE   4000
+#define SND_FREQ_LEFT   1000
+#define SND_FREQ_RIGHT  1500
+/* Upper bound on the sound buffer level (target 64 bytes, +/- 32, plus a
+ * DMA burst and some slack):
+ */
+#define SND_MAX_LEVEL   112
+
+/* The -S interface:  SCK at SYS_CLK_RATE/12, the most spi_slave.v takes */
+#define SPI_DIV         12
+/* A video register write this long after the last starts a new burst: */
+#define MMIO_BURST_GAP  200
+
+/* Long enough for the firmware to answer a command, for -P: */
+#define REPLY_TIME_PS   (5000ULL * 1000000)
+
+
+static Vsim_top         *top;
+static VidcBfm          bfm;
+static FrameMonitor     mon;
+static VidcRef          ref;
+static SdramModel       sdram;
+static AudioMonitor     amon;
+static SpiMaster        spi(SPI_DIV);
+#ifdef FLASH_XIP
+static SpiFlashModel    flash;
+#endif
+static uint64_t         sim_ps;
+static uint64_t         t_sys;
+static uint64_t         t_vidc;
+static uint64_t         sys_cycles;
+static int              quiet;
+static int              verbose;
+static int              dump_frames;
+static int              frame_store;
+static int              audio;
+static int              snd_max_level;
+static std::deque<char> uart_rx_queue;
+/* Clocks per bit; for -B, the new one once the firmware says it's switching: */
+static int              uart_period = SYS_CLK_RATE / BAUD_RATE;
+static int              uart_new_period;
+static std::string      uart_line;
+
+/* Telemetry, for -T */
+static TelemDecoder     telem;
+static FILE             *telem_file;
+static uint64_t         telem_frames;
+static uint64_t         telem_reconfs;
+static TelemRecord      telem_last_frame;
+
+/* Firmware video register write bursts, for -S */
+static uint64_t         vw_last;
+static uint64_t         vw_start;
+static unsigned int     vw_count;
+static uint64_t         vw_max_cycles;
+static unsigned int     vw_max_count;
+
+/* Checking state */
+static int              checking = 1;
+static uint64_t         check_from;             /* BFM frame number */
+static uint64_t         frames_checked;
+static uint64_t         frames_bad;
+static uint64_t         frames_skipped;
+static const struct riscos_mode *ref_mode;
+static int              ref_dx, ref_dy;
+static std::vector<uint32_t> ref_words;
+static std::vector<uint32_t> ref_cursor;
+static std::vector<uint32_t> ref_image;
+
+#if VM_TRACE
+static VerilatedVcdC    *tfp;
+#endif
+
+double sc_time_stamp()
+{
+        return sim_ps;
+}
+
+static void     uart_print(uint8_t c)
+{
+        if (quiet)
+                return;
+        if (c == '\n' || c == '\r' || c == '\t' || (c >= 32 && c < 127))
+                putchar(c);
+        else
+                printf("[%d]", c);
+        fflush(stdout);
+}
+
+/* Decode the firmware's serial output, a la tb_top.v: */
+static void     uart_tick(int tx)
+{
+        static int state = 0;
+        static int ctr = 0;
+        static int bits = 0;
+        static uint8_t buffer;
+
+        if (state == 0) {
+                if (tx == 0) {
+                        state = 1;
+                        ctr = uart_period / 2;  /* Centre of start bit */
+                }
+                return;
+        }
+
+        if (--ctr > 0)
+                return;
+        ctr = uart_period;
+
+        if (state == 1) {
+                state = 2;
+                bits = 0;
+        } else if (state == 2) {
+                buffer = (tx << 7) | (buffer >> 1);
+                if (++bits == 8)
+                        state = 3;
+        } else {
+                /* Stop bit */
+                state = 0;
+                if (uart_new_period) {
+                        /* The firmware waits for this line to go before
+                         * changing rate, so follow it at its end:
+                         */
+                        if (buffer == '\n') {
+                                if (uart_line.find("switching") != std::string::npos) {
+                                        uart_period = uart_new_period;
+                                        uart_new_period = 0;
+                                }
+                                uart_line.clear();
+                        } else if (uart_line.size() < 200) {
+                                uart_line += buffer;
+                        }
+                }
+                if (telem_file) {
+                        /* The decoder passes the text on */
+                        fputc(buffer, telem_file);
+                        telem.feed(buffer);
+                } else {
+                        uart_print(buffer);
+                }
+        }
+}
+
+/* Send characters to the firmware, e.g. to type a command: */
+static void     uart_send(const char *str)
+{
+        while (*str)
+                uart_rx_queue.push_back(*str++);
+}
+
+static void     uart_rx_tick(void)
+{
+        static int ctr = 0;
+        static int bit = -1;            /* -1 = idle, 0 = start, 9 = stop */
+        static uint8_t c;
+
+        if (ctr > 0) {
+                ctr--;
+                return;
+        }
+
+        if (bit < 0) {
+                if (uart_rx_queue.empty())
+                        return;
+                c = uart_rx_queue.front();
+                uart_rx_queue.pop_front();
+                bit = 0;
+                top->ser_rx = 0;
+        } else if (bit < 9) {
+                top->ser_rx = (bit == 8) ? 1 : (c >> bit) & 1;
+                bit++;
+        } else {
+                /* End of the stop bit, then idle a while: */
+                bit = -1;
+                ctr = UART_RX_GAP;
+                return;
+        }
+        ctr = uart_period - 1;
+}
+
+static void     configure_ref(const struct riscos_mode *m, int dx, int dy)
+{
+        struct vidc_ref_config c;
+
+        c.width = m->h_disp;
+        c.height = m->v_disp;
+        c.bpp = m->bpp;
+        c.hires = m->hires;
+        c.double_x = dx;
+        c.double_y = dy;
+        for (int i = 0; i < 16; i++)
+                c.palette[i] = bfm.reg(VIDC_PAL_0 + i*4) & 0xfff;
+        c.cursor_palette[0] = bfm.reg(VIDC_CURSORPAL1) & 0xfff;
+        c.cursor_palette[1] = bfm.reg(VIDC_CURSORPAL2) & 0xfff;
+        c.cursor_palette[2] = bfm.reg(VIDC_CURSORPAL3) & 0xfff;
+        c.cursor_x = bfm.cursor_xpos();
+        c.cursor_y = bfm.cursor_ypos();
+        c.cursor_h = bfm.cursor_height();
+        ref.configure(c);
+
+        ref_mode = m;
+        ref_dx = dx;
+        ref_dy = dy;
+
+        ref_cursor.resize(((c.cursor_h + 1) / 2) * 4);
+        for (unsigned int i = 0; i < ref_cursor.size(); i++)
+                ref_cursor[i] = VidcBfm::cursor_word(i & 3);
+}
+
+/* Called by the monitor with each complete output frame: */
+static void     check_frame(const FrameMonitor &f)
+{
+        const struct riscos_mode *m = bfm.mode();
+
+        if (!checking || !m || f.tag() < check_from) {
+                frames_skipped++;
+                return;
+        }
+
+        unsigned int in_w = m->h_disp;
+        unsigned int in_h = m->v_disp;
+        int dx = (f.width() == in_w * 2);
+        int dy = (f.height() == in_h * 2);
+
+        frames_checked++;
+
+        if (f.ragged() || f.width() != (in_w << dx) || f.height() != (in_h << dy)) {
+                if (frames_bad++ < 10)
+                        printf("\n*** Frame %llu: output %ux%u%s doesn't fit input %ux%u\n",
+                               (unsigned long long)f.tag(), f.width(), f.height(),
+                               f.ragged() ? " (ragged)" : "", in_w, in_h);
+                return;
+        }
+
+        if (m != ref_mode || dx != ref_dx || dy != ref_dy)
+                configure_ref(m, dx, dy);
+
+        unsigned int wpl = ref.words_per_line();
+        unsigned int npix = f.width() * f.height();
+        ref_words.resize(wpl * in_h);
+        ref_image.resize(npix);
+
+        if (verbose)
+                printf("\n[ Frame %llu %ux%u CRC %08x ]\n", (unsigned long long)f.tag(),
+                       f.width(), f.height(), FrameMonitor::crc32(f.pixels(), npix));
+
+        /* Live output shows the input frame being scanned; the frame store
+         * shows a recently completed one:
+         */
+        unsigned int lags = frame_store ? FS_MAX_LAG + 1 : 1;
+        for (unsigned int lag = 0; lag < lags; lag++) {
+                for (unsigned int l = 0; l < in_h; l++)
+                        for (unsigned int w = 0; w < wpl; w++)
+                                ref_words[l * wpl + w] = bfm.data(f.tag() - lag, l, w);
+
+                ref.render(ref_words.data(), ref_cursor.data(), ref_image.data());
+
+                if (memcmp(f.pixels(), ref_image.data(), npix * sizeof(uint32_t)) == 0)
+                        return;
+        }
+
+        unsigned int first = 0, diffs = 0;
+        for (unsigned int i = 0; i < npix; i++) {
+                if (f.pixels()[i] != ref_image[i]) {
+                        if (!diffs)
+                                first = i;
+                        diffs++;
+                }
+        }
+
+        if (frames_bad++ < 10) {
+                printf("\n*** Frame %llu: %u pixels differ; first at (%u, %u), "
+                       "got %06x expected %06x (CRC %08x vs %08x)\n",
+                       (unsigned long long)f.tag(), diffs,
+                       first % f.width(), first / f.width(),
+                       f.pixels()[first], ref_image[first],
+                       FrameMonitor::crc32(f.pixels(), npix),
+                       FrameMonitor::crc32(ref_image.data(), npix));
+                if (dump_frames) {
+                        char name[64];
+                        snprintf(name, sizeof(name), "frame_%llu_got.ppm",
+                                 (unsigned long long)f.tag());
+                        FrameMonitor::write_ppm(name, f.pixels(), f.width(), f.height());
+                        snprintf(name, sizeof(name), "frame_%llu_exp.ppm",
+                                 (unsigned long long)f.tag());
+                        FrameMonitor::write_ppm(name, ref_image.data(), f.width(), f.height());
+                }
+        }
+}
+
+/* Sound DMA byte n:  even bytes are the left channel, odd the right, each
+ * played every SND_PERIOD_US.
+ */
+static uint8_t  tone_byte(uint64_t n)
+{
+        double t = n * SND_PERIOD_US * 1e-6;
+        double f = (n & 1) ? SND_FREQ_RIGHT : SND_FREQ_LEFT;
+
+        return AudioMonitor::vidc_encode(lrint(SND_AMPLITUDE * sin(2 * M_PI * f * t)));
+}
+
+static void     vreg_write_tick(int w)
+{
+        if (!w)
+                return;
+        if (!vw_count || sys_cycles - vw_last > MMIO_BURST_GAP) {
+                vw_start = sys_cycles;
+                vw_count = 0;
+        }
+        vw_count++;
+        vw_last = sys_cycles;
+        if (vw_count > vw_max_count) {
+                vw_max_count = vw_count;
+                vw_max_cycles = sys_cycles - vw_start + 1;
+        }
+}
+
+/* Step to the next clock edge, whichever comes first */
+static void     step(void)
+{
+        if (t_sys <= t_vidc) {
+                sim_ps = t_sys;
+                t_sys += SYS_HALF_PS;
+                top->clk_25mhz = !top->clk_25mhz;
+                top->eval();
+                if (top->clk_25mhz) {
+                        sys_cycles++;
+                        uart_tick(top->ser_tx);
+                        uart_rx_tick();
+                        vreg_write_tick(top->mon_cpu_vreg_write);
+                        spi.tick(top->spi_miso);
+                        top->spi_sclk = spi.sclk();
+                        top->spi_csn = spi.csn();
+                        top->spi_mosi = spi.mosi();
+#ifdef FLASH_XIP
+                        struct spiflash_pins fp;
+                        fp.csn = top->flash_csn;
+                        fp.clk = top->flash_clk;
+                        fp.io = top->flash_io_out;
+                        fp.io_oe = top->flash_io_oe;
+                        flash.tick(fp);
+                        top->flash_io_in = flash.io_out();
+                        top->flash_io_in_oe = flash.io_oe();
+#endif
+                } else {
+                        /* The SDRAM is clocked by the inverse of clk: */
+                        struct sdram_pins sp;
+                        sp.csn = top->sdram_csn;
+                        sp.rasn = top->sdram_rasn;
+                        sp.casn = top->sdram_casn;
+                        sp.wen = top->sdram_wen;
+                        sp.a = top->sdram_a;
+                        sp.ba = top->sdram_ba;
+                        sp.dqm = top->sdram_dqm;
+                        sp.dq = top->sdram_wdata;
+                        sp.dq_oe = top->sdram_wdata_oe;
+                        top->sdram_rdata_oe = sdram.tick(sp);
+                        top->sdram_rdata = sdram.rd_data();
+                }
+        } else {
+                sim_ps = t_vidc;
+                t_vidc += VIDC_HALF_PS;
+                top->vidc_ckin = !top->vidc_ckin;
+                top->eval();
+                if (top->vidc_ckin) {
+                        /* In SIM, the pixel clock is the VIDC clock: */
+                        mon.sample(top->mon_de, top->mon_vsync,
+                                   top->mon_r, top->mon_g, top->mon_b);
+                        if (audio) {
+                                uint32_t s[4];
+                                for (int i = 0; i < 4; i++)
+                                        s[i] = top->mon_aud_samples[i];
+                                amon.sample(top->mon_aud_sent, top->mon_aud_count, s,
+                                            top->mon_acr_sent, top->mon_acr_cts);
+                                if (top->mon_snd_playing &&
+                                    top->mon_snd_level > snd_max_level)
+                                        snd_max_level = top->mon_snd_level;
+                        }
+
+                        /* VIDC outputs change just after its clock edge; they're
+                         * asynchronous to the capture logic anyway.
+                         */
+                        bfm.tick();
+                        const struct vidc_pins &p = bfm.pins();
+                        top->vidc_d = p.d;
+                        top->vidc_nvidw = p.nvidw;
+                        top->vidc_nvcs = p.nvcs;
+                        top->vidc_nhs = p.nhs;
+                        top->vidc_nsndrq = p.nsndrq;
+                        top->vidc_nvidrq = p.nvidrq;
+                        top->vidc_flybk = p.flybk;
+                        top->vidc_nsndak = p.nsndak;
+                        top->vidc_nvidak = p.nvidak;
+                }
+        }
+#if VM_TRACE
+        if (tfp)
+                tfp->dump(sim_ps);
+#endif
+}
+
+/* Check the audio collected over the last t_ps; returns 1 if bad.
+ * The tones are each half of VIDC's sample time, so appear at half level.
+ */
+static int      check_audio(int mode, uint64_t t_ps, uint64_t sur0, uint32_t errs0)
+{
+        double rate = amon.count() / (t_ps / 1e12);
+        double fl = amon.frequency(0);
+        double fr = amon.frequency(1);
+        int expect = AudioMonitor::vidc_decode(AudioMonitor::vidc_encode(SND_AMPLITUDE)) * 2;
+        int pl = amon.peak(0);
+        int pr = amon.peak(1);
+        uint32_t errs = top->mon_snd_errs;
+        int rc = 0;
+
+        printf("mode %2d audio: %.0f Hz, tones %.1f/%.1f Hz, peaks %d/%d (%d), "
+               "%llu ACR CTS %u-%u, max level %d",
+               mode, rate, fl, fr, pl, pr, expect,
+               (unsigned long long)amon.acr_packets, amon.cts_min, amon.cts_max,
+               snd_max_level);
+
+        if (rate < AudioMonitor::rate * 0.95 || rate > AudioMonitor::rate * 1.01 ||
+            fabs(fl - SND_FREQ_LEFT) > SND_FREQ_LEFT * 0.01 ||
+            fabs(fr - SND_FREQ_RIGHT) > SND_FREQ_RIGHT * 0.01 ||
+            abs(pl - expect) > expect / 10 || abs(pr - expect) > expect / 10) {
+                printf(" *** bad audio");
+                rc = 1;
+        }
+        /* In SIM, the pixel clock is 24MHz:  N/128 samples = 1ms */
+        if (!amon.acr_packets || amon.cts_min < 24000 - 2 || amon.cts_max > 24000 + 2) {
+                printf(" *** bad ACR");
+                rc = 1;
+        }
+        if (bfm.sound_underruns != sur0) {
+                printf(", %llu sound FIFO underruns",
+                       (unsigned long long)(bfm.sound_underruns - sur0));
+                rc = 1;
+        }
+        /* Underruns and overflows, [31:16] */
+        if ((errs >> 16) != (errs0 >> 16)) {
+                printf(", buffer errors %08x (was %08x)", errs, errs0);
+                rc = 1;
+        }
+        if (snd_max_level > SND_MAX_LEVEL) {
+                printf(" *** buffer level too high");
+                rc = 1;
+        }
+        printf("\n");
+        return rc;
+}
+
+/* Host library transfers, run to completion: */
+static int      spi_xfer(void *ctx, const uint8_t *tx, uint8_t *rx, unsigned int len)
+{
+        spi.start(tx, len);
+        while (spi.busy() && !Verilated::gotFinish())
+                step();
+        if (rx)
+                memcpy(rx, spi.rx().data(), len);
+        return Verilated::gotFinish() ? -1 : 0;
+}
+
+/* The -S checks; returns 1 if bad.  The time to program a mode (in
+ * system clocks, from the first nCS fall to the last rise) is returned in
+ * mode_cycles.
+ */
+static int      run_spi_test(uint64_t *mode_cycles)
+{
+        struct arcdvi_spi d = { spi_xfer, 0 };
+        uint32_t w[VIDO_REG_FRAME_LOCK + 1];
+        unsigned int st;
+        int rc = 0;
+
+        if (arcdvi_spi_status(&d, &st) ||
+            arcdvi_spi_read(&d, VIDO_BASE_ADDR, w, VIDO_REG_FRAME_LOCK + 1))
+                return 1;
+        printf("SPI: status %x, %u regs read in %llu cycles; res %ux%u, ctrl %08x\n",
+               st, VIDO_REG_FRAME_LOCK + 1, (unsigned long long)spi.last_cycles,
+               w[VIDO_REG_RES_X] & 0x7ff, w[VIDO_REG_RES_Y] & 0x7ff,
+               w[VIDO_REG_CTRL]);
+
+        /* Reprogram the same mode (the readback's as written), committing
+         * rather than resyncing as it's the same timing:
+         */
+        struct video_regs r;
+        r.res_x = w[VIDO_REG_RES_X];
+        r.hs_fp = w[VIDO_REG_HS_FP];
+        r.hs_width = w[VIDO_REG_HS_WIDTH];
+        r.hs_bp = w[VIDO_REG_HS_BP];
+        r.res_y = w[VIDO_REG_RES_Y];
+        r.vs_fp = w[VIDO_REG_VS_FP];
+        r.vs_width = w[VIDO_REG_VS_WIDTH];
+        r.vs_bp = w[VIDO_REG_VS_BP];
+        r.wplm1 = w[VIDO_REG_WPLM1];
+        r.ctrl = w[VIDO_REG_CTRL];
+        r.pclk = w[VIDO_REG_PCLK];
+        r.scaler = w[VIDO_REG_SCALER];
+        r.scaler_step = w[VIDO_REG_SCALER_STEP];
+        r.scaler_x = w[VIDO_REG_SCALER_X];
+        r.scaler_y = w[VIDO_REG_SCALER_Y];
+        r.frame_lock = w[VIDO_REG_FRAME_LOCK];
+
+        uint64_t c0 = sys_cycles;
+        if (arcdvi_spi_program_mode(&d, &r, w[VIDO_REG_FS_CTRL], w[VIDO_REG_PHASE], 1))
+                return 1;
+        *mode_cycles = sys_cycles - c0;
+
+        uint32_t v[VIDO_REG_FRAME_LOCK + 1];
+        if (arcdvi_spi_read(&d, VIDO_BASE_ADDR, v, VIDO_REG_FRAME_LOCK + 1))
+                return 1;
+        for (int i = 0; i <= VIDO_REG_FRAME_LOCK; i++) {
+                /* Less the frame lock's read-only status: */
+                uint32_t m = (i == VIDO_REG_FRAME_LOCK) ? 0x00ffffff : 0xffffffff;
+                if (((ARCDVI_SPI_MODE_MASK >> i) & 1) && ((v[i] ^ w[i]) & m)) {
+                        printf("*** SPI: reg %d was %08x, now %08x\n", i, w[i], v[i]);
+                        rc = 1;
+                }
+        }
+
+        /* A burst write, and back, of the scaler's shadows (unused until
+         * a sync or commit):
+         */
+        static const uint32_t pat[3] = { 0x5a5aa5a5, 0x04560123, 0x03210456 };
+        uint32_t back[3];
+
+        if (arcdvi_spi_write(&d, VIDO_BASE_ADDR + 4 * VIDO_REG_SCALER_STEP, pat, 3) ||
+            arcdvi_spi_read(&d, VIDO_BASE_ADDR + 4 * VIDO_REG_SCALER_STEP, back, 3) ||
+            arcdvi_spi_write(&d, VIDO_BASE_ADDR + 4 * VIDO_REG_SCALER_STEP,
+                             &w[VIDO_REG_SCALER_STEP], 3))
+                return 1;
+        for (int i = 0; i < 3; i++) {
+                if (back[i] != pat[i]) {
+                        printf("*** SPI: burst word %d wrote %08x, read %08x\n",
+                               i, pat[i], back[i]);
+                        rc = 1;
+                }
+        }
+
+        printf("SPI: %llu transactions, %llu bytes%s\n",
+               (unsigned long long)spi.transactions, (unsigned long long)spi.bytes,
+               rc ? "" : ", OK");
+        return rc;
+}
+
+static void     telem_record(const TelemRecord &r)
+{
+        if (r.type == TELEM_FRAME) {
+                telem_frames++;
+                telem_last_frame = r;
+        } else if (r.type == TELEM_RECONF) {
+                telem_reconfs++;
+        }
+}
+
+/* At the end of a mode:  the last frame's DMA counts (of the last full
+ * frame, vid_bursts/cur_bursts) and the VIDC timing registers should
+ * match the BFM's.
+ */
+static int      check_telem(int mode, uint64_t reconfs0, uint64_t frames0,
+                            uint64_t vid_bursts, uint64_t cur_bursts)
+{
+        int rc = 0;
+
+        if (telem_reconfs == reconfs0 || telem_frames == frames0) {
+                printf("*** Telemetry: mode %d, %llu reconfigurations, %llu frames\n",
+                       mode, (unsigned long long)(telem_reconfs - reconfs0),
+                       (unsigned long long)(telem_frames - frames0));
+                return 1;
+        }
+
+        /* A DMA request can land on flyback start, so allow one either way: */
+        if (llabs((long long)telem_last_frame.dmac_video - (long long)vid_bursts) > 1 ||
+            llabs((long long)telem_last_frame.dmac_cursor - (long long)cur_bursts) > 1) {
+                printf("*** Telemetry: mode %d, DMAs %u video, %u cursor; expected %llu, %llu\n",
+                       mode, telem_last_frame.dmac_video, telem_last_frame.dmac_cursor,
+                       (unsigned long long)vid_bursts, (unsigned long long)cur_bursts);
+                rc = 1;
+        }
+
+        for (unsigned int a = VIDC_H_CYC; a <= VIDC_CONTROL; a += 4) {
+                if (a > VIDC_V_CURSOR_END && a != VIDC_CONTROL)
+                        continue;
+                if (!((telem.vidc_valid >> (a / 4)) & 1) ||
+                    telem.vidc[a / 4] != (bfm.reg(a) & 0xffffff)) {
+                        printf("*** Telemetry: mode %d, VIDC reg %02x is %06x, expected %06x\n",
+                               mode, a, telem.vidc[a / 4], bfm.reg(a) & 0xffffff);
+                        rc = 1;
+                }
+        }
+        return rc;
+}
+
+static void     usage(const char *name)
+{
+        fprintf(stderr, "Usage: %s [-m mode[,mode...]] [-f frames] [-s settle] "
+                "[-c] [-n] [-d] [-v] [-q] [-t] [-F] [-a] [-S] [-P] [-T file] [-B baud]\n"
+                "\t-m\tRISC OS modes to run (default: all non-hires modes, one of each VIDC timing)\n"
+                "\t-f\tFrames to run per mode (default 100)\n"
+                "\t-s\tFrames to skip checking after a mode change (default 5)\n"
+                "\t-c\tEnable the cursor (and check it)\n"
+                "\t-n\tDon't check output frames\n"
+                "\t-d\tDump mismatching frames as PPM\n"
+                "\t-v\tPrint each frame's CRC\n"
+                "\t-q\tDon't print firmware UART output\n"
+                "\t-t\tWrite sim_top.vcd (needs a --trace build)\n"
+                "\t-F\tOutput via the SDRAM frame store\n"
+                "\t-a\tPlay sound, and check the HDMI audio\n"
+                "\t-S\tExercise the SPI interface, and time a mode change over it\n"
+                "\t-P\tPrint the firmware's performance and UART counters at the end\n"
+                "\t-T\tTurn on telemetry, check it, and write the raw stream to file\n"
+                "\t-B\tSwitch the UART to this baud rate after boot\n", name);
+        exit(1);
+}
+
+int     main(int argc, char **argv)
+{
+        std::vector<const struct riscos_mode *> modes;
+        unsigned int frames_per_mode = 100;
+        /* Includes the frames vidc_capture waits for mode change writes to
+         * settle (2 by default) before the firmware is told.
+         */
+        unsigned int settle_frames = 5;
+        int cursor = 0;
+        int trace = 0;
+        int spi_test = 0;
+        int perf = 0;
+        const char *telem_name = 0;
+        unsigned int baud = 0;
+        uint64_t spi_mode_cycles = 0;
+        int c;
+
+        Verilated::commandArgs(argc, argv);
+
+        while ((c = getopt(argc, argv, "m:f:s:cndvqthFaSPT:B:")) != -1) {
+                switch (c) {
+                case 'm': {
+                        char *s = optarg;
+                        while (*s) {
+                                char *e;
+                                int mn = strtol(s, &e, 0);
+                                const struct riscos_mode *m = riscos_mode_find(mn);
+                                if (e == s || !m) {
+                                        fprintf(stderr, "Unknown mode '%s'\n", s);
+                                        exit(1);
+                                }
+                                modes.push_back(m);
+                                s = (*e == ',') ? e + 1 : e;
+                        }
+                } break;
+                case 'f':
+                        frames_per_mode = strtoul(optarg, 0, 0);
+                        break;
+                case 's':
+                        settle_frames = strtoul(optarg, 0, 0);
+                        break;
+                case 'c':
+                        cursor = 1;
+                        break;
+                case 'n':
+                        checking = 0;
+                        break;
+                case 'd':
+                        dump_frames = 1;
+                        break;
+                case 'v':
+                        verbose = 1;
+                        break;
+                case 'q':
+                        quiet = 1;
+                        break;
+                case 't':
+                        trace = 1;
+                        break;
+                case 'F':
+                        frame_store = 1;
+                        break;
+                case 'a':
+                        audio = 1;
+                        break;
+                case 'S':
+                        spi_test = 1;
+                        break;
+                case 'P':
+                        perf = 1;
+                        break;
+                case 'T':
+                        telem_name = optarg;
+                        break;
+                case 'B':
+                        baud = strtoul(optarg, 0, 0);
+                        if (baud < 9600 || baud > UART_BAUD_MAX) {
+                                fprintf(stderr, "Baud rate 9600-%d expected\n", UART_BAUD_MAX);
+                                exit(1);
+                        }
+                        break;
+                default:
+                        usage(argv[0]);
+                }
+        }
+
+        if (modes.empty()) {
+                /* In SIM the pixel clock is 24MHz, too slow for hires modes.
+                 * Modes that VIDC sees identically (e.g. 2 and 9) run once.
+                 */
+                for (unsigned int i = 0; i < NUM_RISCOS_MODES; i++) {
+                        const struct riscos_mode *m = &riscos_modes[i];
+                        int seen = 0;
+
+                        for (unsigned int j = 0; j < i; j++)
+                                seen |= riscos_mode_same_vidc(m, &riscos_modes[j]);
+                        if (!m->hires && !seen)
+                                modes.push_back(m);
+                }
+        }
+
+        if (checking && !ref.load_palette8("palette.mem")) {
+                fprintf(stderr, "Can't read palette.mem (run from the top directory)\n");
+                exit(1);
+        }
+        if (telem_name) {
+                telem_file = fopen(telem_name, "wb");
+                if (!telem_file) {
+                        perror(telem_name);
+                        exit(1);
+                }
+                telem.set_text_fn(uart_print);
+                telem.set_record_fn(telem_record);
+        }
+
+        mon.set_tag_fn([]() { return bfm.frames; });
+        mon.set_frame_fn(check_frame);
+
+#ifdef FLASH_XIP
+        if (!flash.load("firmware/firmware_xip.bin", FLASH_FW_OFFSET)) {
+                fprintf(stderr, "Can't read firmware/firmware_xip.bin (run from the top directory)\n");
+                exit(1);
+        }
+#endif
+
+        top = new Vsim_top;
+
+#if VM_TRACE
+        if (trace) {
+                Verilated::traceEverOn(true);
+                tfp = new VerilatedVcdC;
+                top->trace(tfp, 99);
+                tfp->open("sim_top.vcd");
+        }
+#else
+        if (trace)
+                fprintf(stderr, "Tracing not built in, ignoring -t\n");
+#endif
+
+        top->clk_25mhz = 0;
+        top->vidc_ckin = 0;
+        top->btn = 0;
+        top->sw = 0;
+        top->ser_rx = 1;
+        top->vidc_nvidw = 1;
+        top->vidc_nvcs = 1;
+        top->vidc_nhs = 1;
+        top->vidc_nsndrq = 1;
+        top->vidc_nvidrq = 1;
+        top->vidc_flybk = 0;
+        top->vidc_nsndak = 1;
+        top->vidc_nvidak = 1;
+        top->sdram_rdata = 0;
+        top->sdram_rdata_oe = 0;
+        top->spi_sclk = 0;
+        top->spi_csn = 1;
+        top->spi_mosi = 0;
+#ifdef FLASH_XIP
+        top->flash_io_in = 0;
+        top->flash_io_in_oe = 0;
+#endif
+        top->eval();
+
+        printf("Starting sim\n");
+
+        while (sim_ps < BOOT_TIME_PS && !Verilated::gotFinish())
+                step();
+
+        if (frame_store) {
+                /* Takes effect from the first mode change: */
+                uart_send("fs 1\r");
+                while (!uart_rx_queue.empty() && !Verilated::gotFinish())
+                        step();
+        }
+
+        if (audio) {
+                static const int images[8] = { 1, 7, 1, 7, 1, 7, 1, 7 };
+
+                uart_send("snd 1\r");
+                while (!uart_rx_queue.empty() && !Verilated::gotFinish())
+                        step();
+                bfm.set_sound(SND_PERIOD_US, images, tone_byte);
+        }
+
+        int rc = 0;
+
+        if (baud) {
+                /* The firmware's divider is rounded the same way: */
+                char cmd[32];
+
+                snprintf(cmd, sizeof(cmd), "baud %u\r", baud);
+                uart_new_period = (SYS_CLK_RATE + baud / 2) / baud;
+                uart_send(cmd);
+                uint64_t t = sim_ps;
+                while (uart_new_period && sim_ps - t < REPLY_TIME_PS &&
+                       !Verilated::gotFinish())
+                        step();
+                if (uart_new_period) {
+                        printf("*** UART: firmware didn't switch to %u baud\n", baud);
+                        uart_new_period = 0;
+                        rc = 1;
+                } else if (!quiet) {
+                        printf("[ UART now %u clocks/bit ]\n", uart_period);
+                }
+        }
+
+        /* Measure from here, not the boot: */
+        if (perf) {
+                uart_send("perf 1\r");
+                while (!uart_rx_queue.empty() && !Verilated::gotFinish())
+                        step();
+        }
+
+        if (telem_file) {
+                uart_send("telem 7\r");
+                while (!uart_rx_queue.empty() && !Verilated::gotFinish())
+                        step();
+        }
+
+        if (spi_test)
+                rc |= run_spi_test(&spi_mode_cycles);
+
+        for (unsigned int i = 0; i < modes.size() && !Verilated::gotFinish(); i++) {
+                const struct riscos_mode *m = modes[i];
+                uint64_t f0 = bfm.frames;
+                uint64_t vb0 = bfm.video_bursts;
+                uint64_t cb0 = bfm.cursor_bursts;
+                uint64_t ur0 = bfm.underruns;
+                uint64_t ps0 = sim_ps;
+                uint64_t cyc0 = sys_cycles;
+                uint64_t fc0 = frames_checked;
+                uint64_t fb0 = frames_bad;
+                uint64_t tr0 = telem_reconfs;
+                uint64_t tf0 = telem_frames;
+                /* The BFM's DMAs in the last full frame, for -T: */
+                uint64_t fl = bfm.frames;
+                uint64_t vbl = bfm.video_bursts, cbl = bfm.cursor_bursts;
+                uint64_t vid_frame = 0, cur_frame = 0;
+
+                if (!quiet)
+                        printf("\n[ Mode %d ]\n", m->mode);
+                bfm.set_mode(m);
+                bfm.set_cursor(64, 32, cursor ? 32 : 0);
+                /* The new mode starts in the frame after the writes: */
+                check_from = f0 + 1 + settle_frames + (frame_store ? FS_MAX_LAG : 0);
+
+                /* Audio is measured from when the output's settled: */
+                uint64_t aps0 = 0;
+                uint64_t sur0 = 0;
+                uint32_t errs0 = 0;
+                int aud_started = 0;
+
+                auto w0 = std::chrono::steady_clock::now();
+                while (bfm.frames - f0 < frames_per_mode && !Verilated::gotFinish()) {
+                        step();
+                        if (bfm.frames != fl) {
+                                vid_frame = bfm.video_bursts - vbl;
+                                cur_frame = bfm.cursor_bursts - cbl;
+                                vbl = bfm.video_bursts;
+                                cbl = bfm.cursor_bursts;
+                                fl = bfm.frames;
+                        }
+                        if (audio && !aud_started && bfm.frames >= check_from) {
+                                amon.reset();
+                                snd_max_level = 0;
+                                aps0 = sim_ps;
+                                sur0 = bfm.sound_underruns;
+                                errs0 = top->mon_snd_errs;
+                                aud_started = 1;
+                        }
+                }
+                auto w1 = std::chrono::steady_clock::now();
+
+                double wall = std::chrono::duration<double>(w1 - w0).count();
+                uint64_t nf = bfm.frames - f0;
+
+                printf("\nmode %2d: %llu frames, %.3f ms simulated, %.2f s wall, "
+                       "%.1f frames/s (%.2f Mcyc/s); %llu video, %llu cursor bursts",
+                       m->mode, (unsigned long long)nf,
+                       (sim_ps - ps0) / 1e9, wall, nf / wall,
+                       (sys_cycles - cyc0) / wall / 1e6,
+                       (unsigned long long)(bfm.video_bursts - vb0),
+                       (unsigned long long)(bfm.cursor_bursts - cb0));
+                if (checking)
+                        printf("; %llu checked, %llu bad",
+                               (unsigned long long)(frames_checked - fc0),
+                               (unsigned long long)(frames_bad - fb0));
+                if (frames_bad != fb0 || (checking && frames_checked == fc0))
+                        rc = 1;
+                if (bfm.underruns != ur0) {
+                        printf(", %llu FIFO underruns",
+                               (unsigned long long)(bfm.underruns - ur0));
+                        rc = 1;
+                }
+                printf("\n");
+                if (audio && aud_started)
+                        rc |= check_audio(m->mode, sim_ps - aps0, sur0, errs0);
+                if (telem_file && frames_per_mode > settle_frames + 2)
+                        rc |= check_telem(m->mode, tr0, tf0, vid_frame, cur_frame);
+        }
+
+        if (perf) {
+                uart_send("perf\r");
+                uart_send("baud\r");
+                uint64_t t = sim_ps;
+                while ((!uart_rx_queue.empty() || sim_ps - t < REPLY_TIME_PS) &&
+                       !Verilated::gotFinish())
+                        step();
+                printf("\n");
+        }
+
+        printf("Done (%llu register writes, %llu output frames, %llu not checked).\n",
+               (unsigned long long)bfm.reg_writes, (unsigned long long)mon.frames,
+               (unsigned long long)frames_skipped);
+        if (frame_store)
+                printf("SDRAM: %llu reads, %llu writes, %llu refreshes\n",
+                       (unsigned long long)sdram.reads, (unsigned long long)sdram.writes,
+                       (unsigned long long)sdram.refreshes);
+        if (spi_test && spi_mode_cycles) {
+                printf("SPI: mode programmed in %llu cycles (%.1f us); "
+                       "firmware MMIO: %u writes in %llu cycles (%.1f us)\n",
+                       (unsigned long long)spi_mode_cycles,
+                       spi_mode_cycles * 1e6 / SYS_CLK_RATE, vw_max_count,
+                       (unsigned long long)vw_max_cycles,
+                       vw_max_cycles * 1e6 / SYS_CLK_RATE);
+        }
+        if (telem_file) {
+                printf("Telemetry: %llu records (%llu frames, %llu reconfigurations), "
+                       "%llu CRC errors, %llu bad, %llu lost, %llu dropped\n",
+                       (unsigned long long)telem.records, (unsigned long long)telem_frames,
+                       (unsigned long long)telem_reconfs, (unsigned long long)telem.crc_errors,
+                       (unsigned long long)telem.bad_records, (unsigned long long)telem.seq_lost,
+                       (unsigned long long)telem.dropped);
+                if (telem.crc_errors || telem.bad_records || telem.seq_lost || telem.dropped)
+                        rc = 1;
+                fclose(telem_file);
+        }
+#ifdef FLASH_XIP
+        printf("SPI flash: %llu reads, %llu bytes\n",
+               (unsigned long long)flash.reads, (unsigned long long)flash.bytes);
+        if (flash.errors) {
+                printf("*** %llu SPI flash errors\n", (unsigned long long)flash.errors);
+                rc = 1;
+        }
+#endif
+        if (sdram.errors) {
+                printf("*** %llu SDRAM protocol errors\n", (unsigned long long)sdram.errors);
+                rc = 1;
+        }
+
+        top->final();
+#if VM_TRACE
+        if (tfp)
+                tfp->close();
+#endif
+        delete top;
+
+        return rc;
+}
@@ -0,0 +1,185 @@
+/* Verilator wrapper for soc_top:  passes the pins through, and brings
+ * internal video output signals out to the C++ testbench (tb/sim_top.cpp)
+ * for frame capture/checking.  The SDRAM is modelled in C++
+ * (tb/sdram_model.cpp), which drives the data bus when reading.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+module sim_top(input wire        clk_25mhz,
+               input wire        btn,
+               input wire [3:0]  sw,
+               output wire       led,
+               input wire        ser_rx,
+               output wire       ser_tx,
+               input wire        spi_sclk,
+               input wire        spi_csn,
+               input wire        spi_mosi,
+               output wire       spi_miso,
+               output wire       spi_irq,
+               input wire [31:0] vidc_d,
+               input wire        vidc_nvidw,
+               input wire        vidc_nvcs,
+               input wire        vidc_nhs,
+               input wire        vidc_nsndrq,
+               input wire        vidc_nvidrq,
+               input wire        vidc_flybk,
+               input wire        vidc_ckin,
+               input wire        vidc_nsndak,
+               input wire        vidc_nvidak,
+
+               /* Monitor outputs, in the pixel clock domain: */
+               output wire [7:0] mon_r,
+               output wire [7:0] mon_g,
+               output wire [7:0] mon_b,
+               output wire       mon_de,
+               output wire       mon_hsync,
+               output wire       mon_vsync,
+               /* HDMI audio:  packets sent (samples {right, left}), and
+                * the sound buffer state (system clock domain):
+                */
+               output wire         mon_aud_sent,
+               output wire [2:0]   mon_aud_count,
+               output wire [127:0] mon_aud_samples,
+               output wire         mon_acr_sent,
+               output wire [19:0]  mon_acr_cts,
+               output wire [8:0]   mon_snd_level,
+               output wire         mon_snd_playing,
+               output wire [31:0]  mon_snd_errs,
+               /* The CPU writing a video register (system clock domain): */
+               output wire         mon_cpu_vreg_write,
+
+`ifdef FLASH_XIP
+               /* SPI flash pins, out to the model (tb/spiflash_model.cpp): */
+               output wire        flash_csn,
+               output wire        flash_clk,
+               output wire [3:0]  flash_io_out,
+               output wire [3:0]  flash_io_oe,
+               input wire [3:0]   flash_io_in,
+               input wire [3:0]   flash_io_in_oe,
+`endif
+
+               /* SDRAM pins, out to the model: */
+               output wire        sdram_cke,
+               output wire        sdram_csn,
+               output wire        sdram_wen,
+               output wire        sdram_rasn,
+               output wire        sdram_casn,
+               output wire [12:0] sdram_a,
+               output wire [1:0]  sdram_ba,
+               output wire [1:0]  sdram_dqm,
+               output wire [15:0] sdram_wdata,
+               output wire        sdram_wdata_oe,
+               input wire [15:0]  sdram_rdata,
+               input wire         sdram_rdata_oe
+               );
+
+   parameter CLK_RATE = 50000000;
+   parameter BAUD_RATE = 115200;
+
+   wire [3:0]                    gpdi_dp;
+   wire                          sdram_clk;
+   wire [15:0]                   sdram_d;
+`ifdef FLASH_XIP
+   wire [3:0]                    flash_io;
+`endif
+
+   soc_top #(.CLK_RATE(CLK_RATE),
+             .BAUD_RATE(BAUD_RATE)
+             ) DUT (
+                    .clk_25mhz(clk_25mhz),
+                    .btn(btn),
+                    .sw(sw),
+                    .led(led),
+                    .gpdi_dp(gpdi_dp),
+                    .ser_rx(ser_rx),
+                    .ser_tx(ser_tx),
+                    .spi_sclk(spi_sclk),
+                    .spi_csn(spi_csn),
+                    .spi_mosi(spi_mosi),
+                    .spi_miso(spi_miso),
+                    .spi_irq(spi_irq),
+`ifdef FLASH_XIP
+                    .flash_csn(flash_csn),
+                    .flash_io(flash_io),
+`endif
+                    .vidc_d(vidc_d),
+                    .vidc_nvidw(vidc_nvidw),
+                    .vidc_nvcs(vidc_nvcs),
+                    .vidc_nhs(vidc_nhs),
+                    .vidc_nsndrq(vidc_nsndrq),
+                    .vidc_nvidrq(vidc_nvidrq),
+                    .vidc_flybk(vidc_flybk),
+                    .vidc_ckin(vidc_ckin),
+                    .vidc_nsndak(vidc_nsndak),
+                    .vidc_nvidak(vidc_nvidak),
+                    .sdram_clk(sdram_clk),
+                    .sdram_cke(sdram_cke),
+                    .sdram_csn(sdram_csn),
+                    .sdram_wen(sdram_wen),
+                    .sdram_rasn(sdram_rasn),
+                    .sdram_casn(sdram_casn),
+                    .sdram_a(sdram_a),
+                    .sdram_ba(sdram_ba),
+                    .sdram_dqm(sdram_dqm),
+                    .sdram_d(sdram_d)
+                    );
+
+   assign mon_r     = DUT.VIDEO.VTI.o_r;
+   assign mon_g     = DUT.VIDEO.VTI.o_g;
+   assign mon_b     = DUT.VIDEO.VTI.o_b;
+   assign mon_de    = DUT.VIDEO.VTI.o_de;
+   assign mon_hsync = DUT.VIDEO.VTI.o_hsync;
+   assign mon_vsync = DUT.VIDEO.VTI.o_vsync;
+
+   assign mon_aud_sent    = DUT.HDMI.load_audio;
+   assign mon_aud_count   = DUT.HDMI.st_count;
+   assign mon_aud_samples = DUT.HDMI.st;
+   assign mon_acr_sent    = DUT.HDMI.load && DUT.HDMI.sel_acr;
+   assign mon_acr_cts     = DUT.HDMI.cts;
+   assign mon_snd_level   = DUT.SND.level;
+   assign mon_snd_playing = DUT.SND.playing;
+   assign mon_snd_errs    = {DUT.SND.underruns, DUT.SND.overflows,
+                             DUT.SND.skips, DUT.SND.repeats};
+
+   assign mon_cpu_vreg_write = DUT.cpu_iomem_valid && DUT.cpu_iomem_ready &&
+                               DUT.cpu_iomem_addr[27:24] == 4'h2 &&
+                               |DUT.cpu_iomem_wstrb;
+
+`ifdef FLASH_XIP
+   /* On the board, the flash clock goes via USRMCLK: */
+   assign flash_clk      = DUT.cpu_flash_clk;
+   assign flash_io_out   = DUT.cpu_flash_io_out;
+   assign flash_io_oe    = DUT.cpu_flash_io_oe;
+
+   genvar                        fi;
+   generate for (fi = 0; fi < 4; fi = fi + 1) begin: flash_io_drv
+           assign flash_io[fi] = flash_io_in_oe[fi] ? flash_io_in[fi] : 1'bz;
+   end endgenerate
+`endif
+
+   assign sdram_wdata    = DUT.SDRC.dq_out;
+   assign sdram_wdata_oe = DUT.SDRC.dq_oe;
+   assign sdram_d        = sdram_rdata_oe ? sdram_rdata : 16'hzzzz;
+
+endmodule // sim_top
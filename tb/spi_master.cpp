@@ -0,0 +1,103 @@
+/* SPI master model, see spi_master.h
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "spi_master.h"
+
+SpiMaster::SpiMaster(unsigned int div)
+        : last_cycles(0), transactions(0), bytes(0),
+          half(div / 2), count(0), state(IDLE), bit(0), cycles(0),
+          sclk_out(0), csn_out(1), mosi_out(0)
+{
+}
+
+void    SpiMaster::set_mosi()
+{
+        mosi_out = (tx_bytes[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+void    SpiMaster::start(const uint8_t *tx, unsigned int len)
+{
+        tx_bytes.assign(tx, tx + len);
+        rx_bytes.assign(len, 0);
+        bit = 0;
+        count = 0;
+        cycles = 0;
+        state = len ? LEAD : IDLE;
+        if (!len)
+                return;
+
+        /* nCS falls, with the first bit set up half a clock before SCK
+         * rises:
+         */
+        csn_out = 0;
+        sclk_out = 0;
+        set_mosi();
+        transactions++;
+        bytes += len;
+}
+
+void    SpiMaster::tick(int miso)
+{
+        if (state == IDLE)
+                return;
+        if (state != GAP)
+                cycles++;
+        if (++count < half)
+                return;
+        count = 0;
+
+        switch (state) {
+        case LEAD:
+                state = BITS;
+                break;
+
+        case BITS:
+                if (!sclk_out) {
+                        /* Both ends sample on the rising edge: */
+                        sclk_out = 1;
+                        if (miso)
+                                rx_bytes[bit / 8] |= 0x80 >> (bit % 8);
+                } else {
+                        sclk_out = 0;
+                        if (++bit == tx_bytes.size() * 8)
+                                state = TRAIL;
+                        else
+                                set_mosi();
+                }
+                break;
+
+        case TRAIL:
+                csn_out = 1;
+                mosi_out = 0;
+                last_cycles = cycles;
+                state = GAP;
+                break;
+
+        default:
+                /* nCS stays high at least half a clock between transactions */
+                state = IDLE;
+                break;
+        }
+}
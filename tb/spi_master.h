@@ -0,0 +1,77 @@
+/* SPI master model, for driving src/spi_slave.v in the Verilator testbench
+ * as an external MCU would:  mode 0, MSB first, nCS low for a whole
+ * transaction, SCK a whole number of system clocks.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SPI_MASTER_H
+#define SPI_MASTER_H
+
+#include <stdint.h>
+#include <vector>
+
+class SpiMaster {
+public:
+        /* SCK period in system clocks (even, at least 12 for spi_slave.v): */
+        SpiMaster(unsigned int div = 12);
+
+        /* Starts a transaction of len bytes; rx() has as many afterwards. */
+        void            start(const uint8_t *tx, unsigned int len);
+        int             busy() const                    { return state != IDLE; }
+        const std::vector<uint8_t> &rx() const          { return rx_bytes; }
+
+        /* Call at each system clock rising edge, with MISO as the slave
+         * drives it; the pins then hold until the next call.
+         */
+        void            tick(int miso);
+        int             sclk() const                    { return sclk_out; }
+        int             csn() const                     { return csn_out; }
+        int             mosi() const                    { return mosi_out; }
+
+        /* System clocks the last transaction took, nCS low to high, and
+         * totals:
+         */
+        uint64_t        last_cycles;
+        uint64_t        transactions;
+        uint64_t        bytes;
+
+private:
+        enum { IDLE, LEAD, BITS, TRAIL, GAP };
+
+        void            set_mosi();
+
+        unsigned int    half;
+        unsigned int    count;
+        int             state;
+        std::vector<uint8_t> tx_bytes;
+        std::vector<uint8_t> rx_bytes;
+        unsigned int    bit;
+        uint64_t        cycles;
+
+        int             sclk_out;
+        int             csn_out;
+        int             mosi_out;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/* SPI flash model, see spiflash_model.h
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include "spiflash_model.h"
+
+#define FLASH_SIZE      (16 * 1024 * 1024)
+
+SpiFlashModel::SpiFlashModel()
+        : reads(0), bytes(0), errors(0),
+          mem(FLASH_SIZE, 0xff), last_clk(0), selected(0), rises(0),
+          cmd_addr(0), width(0), data_start(0), out(0), out_oe(0)
+{
+}
+
+void    SpiFlashModel::error(const char *what)
+{
+        if (errors++ < 10)
+                fprintf(stderr, "*** SPI flash: %s (cmd/addr %08x)\n", what, cmd_addr);
+}
+
+bool    SpiFlashModel::load(const char *path, uint32_t offset)
+{
+        FILE *f = fopen(path, "rb");
+
+        if (!f)
+                return false;
+        size_t n = fread(&mem[offset % FLASH_SIZE], 1, FLASH_SIZE - offset % FLASH_SIZE, f);
+        fclose(f);
+        return n > 0;
+}
+
+void    SpiFlashModel::tick(const struct spiflash_pins &p)
+{
+        if (p.csn) {
+                selected = 0;
+                out_oe = 0;
+                last_clk = p.clk;
+                return;
+        }
+        if (!selected) {
+                selected = 1;
+                rises = 0;
+                cmd_addr = 0;
+                width = 0;
+        }
+
+        if (p.clk && !last_clk) {
+                /* Command then address, on IO0 */
+                if (rises < 32)
+                        cmd_addr = (cmd_addr << 1) | (p.io & 1);
+                rises++;
+
+                if (rises == 8) {
+                        switch (cmd_addr & 0xff) {
+                        case 0x03:      width = 1; data_start = 32; break;
+                        case 0x0b:      width = 1; data_start = 40; break;
+                        case 0x3b:      width = 2; data_start = 40; break;
+                        case 0x6b:      width = 4; data_start = 40; break;
+                        default:
+                                error("unsupported command");
+                                break;
+                        }
+                        if (width)
+                                reads++;
+                }
+        } else if (!p.clk && last_clk && width && rises >= data_start) {
+                /* Next bits of data, MSB first from the address given: */
+                unsigned int pos = (rises - data_start) * width;
+                uint32_t a = (cmd_addr + pos / 8) % FLASH_SIZE;
+                unsigned int bits = (mem[a] >> (8 - width - pos % 8)) & ((1 << width) - 1);
+
+                if (pos % 8 == 0)
+                        bytes++;
+                if (width == 1) {
+                        out = bits << 1;        /* MISO */
+                        out_oe = 0x2;
+                } else {
+                        out = bits;
+                        out_oe = (1 << width) - 1;
+                }
+        }
+        last_clk = p.clk;
+
+        if (p.io_oe & out_oe)
+                error("IO driven by both controller and flash");
+}
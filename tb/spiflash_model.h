@@ -0,0 +1,77 @@
+/* Model of the ULX3S's SPI configuration flash, enough to run
+ * src/spiflash_xip.v against:  the read commands (0x03, 0x0B, and dual and
+ * quad output 0x3B/0x6B), with a 16MB array that an image is loaded into.
+ * Anything else, or both ends driving an IO at once, counts as an error.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SPIFLASH_MODEL_H
+#define SPIFLASH_MODEL_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Pin state, from the controller (IO0 = MOSI, IO1 = MISO): */
+struct spiflash_pins {
+        int             csn;
+        int             clk;
+        unsigned int    io;
+        unsigned int    io_oe;
+};
+
+class SpiFlashModel {
+public:
+        SpiFlashModel();
+
+        /* Loads a binary file at offset; returns false if it can't. */
+        bool            load(const char *path, uint32_t offset);
+
+        /* Call whenever the controller's pins might have changed (i.e. at
+         * each of its clock's rising edges).  Data changes after SCK falls,
+         * and then io_out()/io_oe() give what the flash drives.
+         */
+        void            tick(const struct spiflash_pins &p);
+        unsigned int    io_out() const                  { return out; }
+        unsigned int    io_oe() const                   { return out_oe; }
+
+        /* Statistics */
+        uint64_t        reads;                  /* Read commands */
+        uint64_t        bytes;
+        uint64_t        errors;
+
+private:
+        void            error(const char *what);
+
+        std::vector<uint8_t> mem;
+        int             last_clk;
+        int             selected;
+        unsigned int    rises;                  /* SCK rising edges since nCS fell */
+        uint32_t        cmd_addr;
+        unsigned int    width;                  /* Data bits per clock */
+        unsigned int    data_start;             /* Rising edges before the data */
+        unsigned int    out;
+        unsigned int    out_oe;
+};
+
+#endif
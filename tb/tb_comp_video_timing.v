@@ -47,6 +47,7 @@ module tb_comp_video_timing();
    wire [7:0]            pb;
    wire                  hs, vs, de;
    reg                   load_dma;
+   reg                   vw_write;
 
 `define C_RES_X 1152
 `define C_HFP 40
@@ -61,6 +62,7 @@ module tb_comp_video_timing();
    video_timing #(
                   ) DUT (
                          .pclk(clk),
+                         .pce(1'b1),
 
                          .t_horiz_res(`C_RES_X),
                          .t_horiz_fp(`C_HFP),
@@ -72,15 +74,23 @@ module tb_comp_video_timing();
                          .t_vert_sync_width(`C_VSW),
                          .t_vert_bp(`C_VBP),
 
-                         .t_words_per_line_m1(8'd35),
+                         .t_words_per_line_m1(10'd35),
                          .t_bpp(2'd3),
                          .t_hires(1'b1),
-                         .t_double_x(1'b0),
-                         .t_double_y(1'b0),
-
-                         .v_cursor_x(11'h69),
-                         .v_cursor_y(10'h123),
-                         .v_cursor_yend(10'h143),
+                         .t_scale_x(2'd0),
+                         .t_scale_y(2'd0),
+                         .t_cursor_x_offset(11'h0),
+                         .t_phase(`C_RES_X + `C_HFP + `C_HSW + `C_HBP),
+                         .t_line_lock(1'b0),
+                         .t_scaler(1'b0),
+                         .t_step_x(16'h0),
+                         .t_step_y(16'h0),
+                         .t_img_x(11'h0),
+                         .t_img_w(11'h0),
+                         .t_img_y(11'h0),
+                         .t_img_h(11'h0),
+                         .t_fill(24'h0),
+                         .t_fl_lead(24'h0),
 
                          .o_r(pr),
                          .o_g(pg),
@@ -93,10 +103,31 @@ module tb_comp_video_timing();
                          .load_dma(load_dma),
                          .load_dma_data(32'hfeedface),
 
+                         .fs_enable(1'b0),
+                         .fs_load(1'b0),
+                         .fs_load_addr(11'h0),
+                         .fs_load_data(32'h0),
+                         .fs_line_req(),
+                         .fs_line(),
+
                          .sync_flyback(flybk),
+                         .sync_hsync(1'b1),
 
                          .config_sync_req(csr),
                          .config_sync_ack(csa),
+                         .config_commit_req(1'b0),
+                         .config_commit_ack(),
+
+                         // Just the cursor position:
+                         .vw_write(vw_write),
+                         .vw_idx(9'h020),
+                         .vw_data({1'b0, 10'h143, 10'h123, 11'h69}),
+                         .vw_frame(2'b00),
+                         .vw_line(10'h0),
+                         .vw_x(11'h0),
+                         .vidc_frame(2'b00),
+                         .rq_full(),
+                         .rq_level(),
 
                          .enable_test_card(1'b1)
 	                 );
@@ -112,6 +143,7 @@ module tb_comp_video_timing();
            end
            clk   <= 1;
            load_dma <= 0;
+           vw_write <= 0;
            flybk <= 1;
            csr   <= 0;
 
@@ -119,6 +151,10 @@ module tb_comp_video_timing();
            #(`CLK*2);
            reset <= 0;
 
+           vw_write <= 1;
+           #(`CLK);
+           vw_write <= 0;
+
            #(`CLK*10);
 
            csr <= 1;
@@ -52,7 +52,10 @@ module tb_top();
                     .btn(1'b0),
 
                     .ser_rx(1'b1),
-                    .ser_tx(ser_tx)
+                    .ser_tx(ser_tx),
+                    .spi_sclk(1'b0),
+                    .spi_csn(1'b1),
+                    .spi_mosi(1'b0)
 	            );
 
    ////////////////////////////////////////////////////////////////////////////////
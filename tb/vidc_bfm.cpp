@@ -0,0 +1,399 @@
+/* Bus-functional model of VIDC/MEMC video pins.
+ *
+ * Simplifications compared to the real thing:
+ * - The FIFO is modelled as a word count; VIDC requests a 4-word burst whenever
+ *   at least half of its 8-word FIFO is empty, starting after hsync on each
+ *   display line.  As on the real part, the stream runs continuously across
+ *   lines, so a burst can straddle a line boundary (e.g. mode 4, 10 words/line).
+ * - MEMC answers a request after 3 VIDC clocks, then delivers 4 beats each
+ *   of 3 clocks (2 low, 1 high on /VIDAK).  That's about 625ns per burst,
+ *   roughly what MEMC manages for N+3S cycles at 8MHz.
+ * - Cursor data is fetched as one 4-word burst during hsync on every other
+ *   cursor line (two lines of 32 2bpp pixels).
+ * - Register writes (2 clocks of /VIDW low) are held off until flyback,
+ *   and never overlap DMA.
+ * - Sound DMA is a 4-word burst on /SNDRQ//SNDAK (timed as for video),
+ *   requested when the last word of VIDC's 4-word sound FIFO starts to
+ *   play; it takes priority over video DMA.
+ * - There's no border/interlace modelling.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vidc_bfm.h"
+#include "../firmware/vidc_regs.h"
+
+#define DMA_LATENCY     3       /* VIDC clocks from /VIDRQ to first /VIDAK */
+#define DMA_BEAT_LOW    2
+#define DMA_BEAT        3
+#define DMA_BEATS       4
+#define DMA_LEN         (DMA_LATENCY + (DMA_BEATS * DMA_BEAT))
+#define FIFO_WORDS      8
+
+#define WR_LEN          4       /* Data setup, 2x /VIDW low, hold */
+
+static const int pix_rate_mhz[4] = { 8, 12, 16, 24 };
+
+/* Roughly the desktop palette, in VIDC's BGR 4:4:4 */
+static const uint16_t default_palette[16] = {
+        0xfff, 0xddd, 0xbbb, 0x999, 0x777, 0x555, 0x333, 0x000,
+        0x940, 0x0ee, 0x0c0, 0x00d, 0xbee, 0x080, 0x0bf, 0xfa0
+};
+
+static inline uint32_t  vidc_wr(unsigned int addr, uint32_t val)
+{
+        return (addr << 24) | (val & 0xffffff);
+}
+
+VidcBfm::VidcBfm()
+{
+        p.d = 0;
+        p.nvidw = 1;
+        p.nvcs = 1;
+        p.nhs = 1;
+        p.nsndrq = 1;
+        p.flybk = 0;
+        p.nsndak = 1;
+        p.nvidrq = 1;
+        p.nvidak = 1;
+
+        for (int i = 0; i < 64; i++)
+                regs[i] = 0;
+
+        frames = 0;
+        video_bursts = 0;
+        cursor_bursts = 0;
+        reg_writes = 0;
+        underruns = 0;
+        sound_bursts = 0;
+        sound_underruns = 0;
+        sound_bytes = 0;
+
+        cur_mode = 0;
+        next_mode = 0;
+        data_fn = pattern;
+
+        pix_acc = 0;
+        h = 0;
+        v = 0;
+        words_per_line = 0;
+        words_fetched = 0;
+        words_consumed = 0;
+        consumed_bits = 0;
+        cursor_line_pending = 0;
+        underrun_line = -1;
+
+        cursor_x = 0;
+        cursor_y = 0;
+        cursor_h = 0;
+
+        snd_period = 0;
+        snd_ctr = 0;
+        snd_fetched = 0;
+
+        dma_type = DMA_IDLE;
+        dma_phase = 0;
+        dma_word_base = 0;
+
+        wr_phase = 0;
+        writes_armed = 0;
+}
+
+uint32_t        VidcBfm::pattern(unsigned int frame, unsigned int line, unsigned int word)
+{
+        return (line * 0x00010001u) ^ (word * 0x01000193u) ^ (frame << 28);
+}
+
+/* Cursor image: a recognisable 2bpp pattern, the same for every line pair */
+uint32_t        VidcBfm::cursor_word(unsigned int beat)
+{
+        return 0xe4e4e4e4 ^ (beat * 0x11111111);
+}
+
+void    VidcBfm::write_reg(unsigned int addr, uint32_t val)
+{
+        wq.push_back(vidc_wr(addr, val));
+}
+
+void    VidcBfm::set_cursor(int x, int y, int height)
+{
+        cursor_x = x;
+        cursor_y = y;
+        cursor_h = height;
+
+        if (!cur_mode && !next_mode)
+                return;
+
+        const struct riscos_raster *m = next_mode ? &next_r : &cur_r;
+
+        /* HCSR is 11 bits at [23:13], in pixels from sync, minus 6 (which the
+         * firmware's cursor X offset accounts for).
+         */
+        write_reg(VIDC_H_CURSOR_START, (uint32_t)(m->h_disp_start - 6 + x) << 13);
+        write_reg(VIDC_V_CURSOR_START, (uint32_t)(m->v_disp_start - 1 + y) << 14);
+        write_reg(VIDC_V_CURSOR_END, (uint32_t)(m->v_disp_start - 1 + y + height) << 14);
+}
+
+void    VidcBfm::set_sound(unsigned int period_us, const int images[8], sound_fn_t fn)
+{
+        /* SIR0-6 follow SIR7: */
+        write_reg(VIDC_STEREO7, images[7]);
+        for (int i = 0; i < 7; i++)
+                write_reg(VIDC_STEREO0 + i*4, images[i]);
+        write_reg(VIDC_SOUND_FREQ, period_us - 2);
+        sound_fn = fn;
+}
+
+void    VidcBfm::set_mode(const struct riscos_mode *m)
+{
+        struct riscos_vidc r;
+
+        riscos_mode_to_vidc(m, &r);
+
+        /* Ordered like the OS does it: control first, then timing (HCR/VCR
+         * writes are what the capture logic spots), then palette.
+         */
+        write_reg(VIDC_CONTROL, r.control);
+
+        write_reg(VIDC_H_CYC, r.hcr);
+        write_reg(VIDC_H_SYNC, r.hswr);
+        write_reg(VIDC_H_BORDER_START, r.hbsr);
+        write_reg(VIDC_H_DISP_START, r.hdsr);
+        write_reg(VIDC_H_DISP_END, r.hder);
+        write_reg(VIDC_H_BORDER_END, r.hber);
+
+        write_reg(VIDC_V_CYC, r.vcr);
+        write_reg(VIDC_V_SYNC, r.vswr);
+        write_reg(VIDC_V_BORDER_START, r.vbsr);
+        write_reg(VIDC_V_DISP_START, r.vdsr);
+        write_reg(VIDC_V_DISP_END, r.vder);
+        write_reg(VIDC_V_BORDER_END, r.vber);
+
+        for (int i = 0; i < 16; i++)
+                write_reg(VIDC_PAL_0 + i*4, default_palette[i]);
+        write_reg(VIDC_BORDERCOL, 0);
+        write_reg(VIDC_CURSORPAL1, 0xfff);
+        write_reg(VIDC_CURSORPAL2, 0x000);
+        write_reg(VIDC_CURSORPAL3, 0x00f);
+
+        next_mode = m;
+        riscos_vidc_raster(&r, &next_r);
+        set_cursor(cursor_x, cursor_y, cursor_h);
+}
+
+/* New frame starts at the top of vsync */
+void    VidcBfm::start_frame()
+{
+        if (next_mode && wq.empty()) {
+                cur_mode = next_mode;
+                cur_r = next_r;
+                next_mode = 0;
+                words_per_line = ((cur_r.h_disp_end - cur_r.h_disp_start)
+                                  << cur_r.bpp) / 32;
+        }
+        words_fetched = 0;
+        words_consumed = 0;
+        consumed_bits = 0;
+}
+
+/* Raster counters and sync outputs */
+void    VidcBfm::hw_tick()
+{
+        const struct riscos_raster *m = &cur_r;
+
+        pix_acc += pix_rate_mhz[m->pixrate];
+        if (pix_acc < 24)
+                return;
+        pix_acc -= 24;
+
+        int in_disp_line = (v >= m->v_disp_start) && (v < m->v_disp_end);
+
+        /* Consume the pixel at h, if it's displayed: */
+        if (in_disp_line && (h >= m->h_disp_start) && (h < m->h_disp_end)) {
+                consumed_bits += 1 << m->bpp;
+                if (consumed_bits >= 32) {
+                        consumed_bits -= 32;
+                        words_consumed++;
+                        if (words_consumed > words_fetched && underrun_line != v) {
+                                underruns++;
+                                underrun_line = v;
+                        }
+                }
+        }
+
+        if (++h == m->h_total) {
+                h = 0;
+                if (++v == m->v_total) {
+                        v = 0;
+                        start_frame();
+                        m = &cur_r;
+                }
+
+                /* Cursor data for the next two lines is fetched in hsync: */
+                int l = v - m->v_disp_start;
+                cursor_line_pending = (cursor_h > 0) &&
+                        (v >= m->v_disp_start) && (v < m->v_disp_end) &&
+                        (l >= cursor_y) && (l < cursor_y + cursor_h) &&
+                        (((l - cursor_y) & 1) == 0);
+
+                if (v == m->v_disp_end) {
+                        /* Flyback starts: the OS gets its VSync IRQ about now,
+                         * so queued register writes go out.
+                         */
+                        frames++;
+                        writes_armed = 1;
+                }
+        }
+
+        p.nhs = (h < m->h_sync) ? 0 : 1;
+        p.nvcs = (v < m->v_sync) ? 0 : 1;
+        p.flybk = ((v >= m->v_disp_start) && (v < m->v_disp_end)) ? 0 : 1;
+}
+
+void    VidcBfm::dma_tick()
+{
+        if (dma_type == DMA_IDLE) {
+                /* Shares the data bus with register writes: */
+                if (wr_phase != 0 || !cur_mode)
+                        return;
+
+                const struct riscos_raster *m = &cur_r;
+                int in_disp_line = (v >= m->v_disp_start) && (v < m->v_disp_end);
+                int total_words = words_per_line * (m->v_disp_end - m->v_disp_start);
+
+                if (snd_period && (snd_fetched - sound_bytes) <= 4) {
+                        dma_type = DMA_SOUND;
+                        dma_phase = 0;
+                        sound_bursts++;
+                        p.nsndrq = 0;
+                        return;
+                } else if (p.nhs == 0) {
+                        if (cursor_line_pending) {
+                                cursor_line_pending = 0;
+                                dma_type = DMA_CURSOR;
+                                cursor_bursts++;
+                        }
+                } else if (in_disp_line && (words_fetched < total_words) &&
+                           (words_fetched - words_consumed) <= (FIFO_WORDS - DMA_BEATS)) {
+                        dma_type = DMA_VIDEO;
+                        dma_word_base = words_fetched;
+                        words_fetched += DMA_BEATS;
+                        video_bursts++;
+                }
+                if (dma_type == DMA_IDLE)
+                        return;
+                dma_phase = 0;
+                p.nvidrq = 0;
+                return;
+        }
+
+        dma_phase++;
+        if (dma_phase == DMA_LEN) {
+                dma_type = DMA_IDLE;
+                return;
+        }
+        if (dma_phase < DMA_LATENCY)
+                return;
+
+        int beat = (dma_phase - DMA_LATENCY) / DMA_BEAT;
+        int bp = (dma_phase - DMA_LATENCY) % DMA_BEAT;
+
+        if (dma_type == DMA_SOUND) {
+                if (bp == 0) {
+                        p.nsndrq = 1;
+                        p.nsndak = 0;
+                        p.d = 0;
+                        for (int i = 0; i < 4; i++)
+                                p.d |= (uint32_t)sound_fn(snd_fetched++) << (i*8);
+                } else if (bp == DMA_BEAT_LOW) {
+                        p.nsndak = 1;
+                }
+                return;
+        }
+
+        if (bp == 0) {
+                p.nvidrq = 1;
+                p.nvidak = 0;
+                if (dma_type == DMA_VIDEO) {
+                        unsigned int w = dma_word_base + beat;
+                        p.d = data_fn(frames, w / words_per_line, w % words_per_line);
+                } else {
+                        p.d = cursor_word(beat);
+                }
+        } else if (bp == DMA_BEAT_LOW) {
+                p.nvidak = 1;
+        }
+}
+
+void    VidcBfm::write_tick()
+{
+        if (wr_phase == 0) {
+                if (dma_type != DMA_IDLE || wq.empty() || (cur_mode && !writes_armed))
+                        return;
+                p.d = wq.front();
+                wq.pop_front();
+                wr_phase = 1;
+                return;
+        }
+
+        if (wr_phase == 1)
+                p.nvidw = 0;
+        else if (wr_phase == WR_LEN - 1)
+                p.nvidw = 1;
+
+        if (++wr_phase == WR_LEN) {
+                wr_phase = 0;
+                reg_writes++;
+                regs[p.d >> 26] = p.d & 0xffffff;
+                /* Sound starts once its rate's been set: */
+                if ((p.d >> 24) == VIDC_SOUND_FREQ && sound_fn)
+                        snd_period = ((p.d & 0xff) + 2) * 24;
+                if (wq.empty()) {
+                        writes_armed = 0;
+                        /* Nothing running yet?  Start up in the new mode: */
+                        if (!cur_mode)
+                                start_frame();
+                }
+        }
+}
+
+/* VIDC plays a sound byte every sample period: */
+void    VidcBfm::sound_tick()
+{
+        if (!snd_period || ++snd_ctr < snd_period)
+                return;
+        snd_ctr = 0;
+        if (snd_fetched > sound_bytes)
+                sound_bytes++;
+        else
+                sound_underruns++;
+}
+
+void    VidcBfm::tick()
+{
+        if (cur_mode)
+                hw_tick();
+        sound_tick();
+        write_tick();
+        dma_tick();
+}
@@ -0,0 +1,166 @@
+/* Bus-functional model of VIDC (and the MEMC side of its DMA), for driving
+ * the ArcDVI capture pins from a C++ testbench.
+ *
+ * The model is ticked once per VIDC clock (24MHz) and produces the pin state
+ * that soc_top would see from an Archimedes:  /HS, /VCS, FLYBK, register
+ * writes on /VIDW, 4-beat video/cursor DMA bursts on /VIDRQ//VIDAK, and
+ * sound DMA bursts on /SNDRQ//SNDAK.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VIDC_BFM_H
+#define VIDC_BFM_H
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+
+#include "riscos_modes.h"
+
+/* Pin state, active-low signals as on the real part: */
+struct vidc_pins {
+        uint32_t        d;
+        int             nvidw;
+        int             nvcs;
+        int             nhs;
+        int             nsndrq;
+        int             nvidrq;
+        int             flybk;
+        int             nsndak;
+        int             nvidak;
+};
+
+class VidcBfm {
+public:
+        /* Supplies DMA data for (frame, display line, word in line). */
+        typedef std::function<uint32_t(unsigned int, unsigned int, unsigned int)> data_fn_t;
+        /* Supplies sound DMA data, byte n of the (endless) sound buffer. */
+        typedef std::function<uint8_t(uint64_t)> sound_fn_t;
+
+        VidcBfm();
+
+        /* Queue the register writes the OS would make for a mode change.
+         * The writes are played out at the start of the next flyback, and the
+         * new timing takes effect from the following frame.
+         */
+        void            set_mode(const struct riscos_mode *m);
+        /* Queue a single register write; addr is VIDC byte address (0x80 = HCR) */
+        void            write_reg(unsigned int addr, uint32_t val);
+        void            set_cursor(int x, int y, int height);
+        void            set_data_fn(data_fn_t fn)       { data_fn = fn; }
+        /* Start sound:  queue writes of the sample period (us) and stereo
+         * images (SIR0-7, 1 = left to 7 = right), then sound DMA runs from
+         * when they've been made.
+         */
+        void            set_sound(unsigned int period_us, const int images[8], sound_fn_t fn);
+
+        /* Advance one VIDC clock. */
+        void            tick();
+
+        const struct vidc_pins &pins() const            { return p; }
+        const struct riscos_mode *mode() const          { return cur_mode; }
+
+        /* What's been written to VIDC so far, by byte address */
+        uint32_t        reg(unsigned int addr) const    { return regs[(addr >> 2) & 63]; }
+        /* The data a frame's DMA carries, and the cursor image */
+        uint32_t        data(unsigned int frame, unsigned int line, unsigned int word) const
+        {
+                return data_fn(frame, line, word);
+        }
+        static uint32_t cursor_word(unsigned int beat);
+        int             cursor_xpos() const             { return cursor_x; }
+        int             cursor_ypos() const             { return cursor_y; }
+        int             cursor_height() const           { return cursor_h; }
+
+        /* Statistics */
+        uint64_t        frames;                 /* Completed frames (at flyback start) */
+        uint64_t        video_bursts;
+        uint64_t        cursor_bursts;
+        uint64_t        reg_writes;
+        uint64_t        underruns;              /* VIDC FIFO would have run dry */
+        uint64_t        sound_bursts;
+        uint64_t        sound_underruns;        /* Sound FIFO ran dry */
+        uint64_t        sound_bytes;            /* Sound bytes played */
+
+        /* Default pattern: distinct per frame/line/word, easy to spot in a dump */
+        static uint32_t pattern(unsigned int frame, unsigned int line, unsigned int word);
+
+private:
+        void            start_frame();
+        void            hw_tick();
+        void            dma_tick();
+        void            write_tick();
+        void            sound_tick();
+
+        struct vidc_pins p;
+        uint32_t        regs[64];
+
+        const struct riscos_mode *cur_mode;
+        const struct riscos_mode *next_mode;
+        /* Their timing, as VIDC has it from the registers written: */
+        struct riscos_raster cur_r;
+        struct riscos_raster next_r;
+
+        data_fn_t       data_fn;
+
+        /* Raster position: pixel counter advances at the mode's pixel rate,
+         * derived from the 24MHz tick by a fractional accumulator.
+         */
+        int             pix_acc;
+        int             h;
+        int             v;
+        int             words_per_line;
+
+        /* DMA stream bookkeeping, per frame */
+        int             words_fetched;
+        int             words_consumed;
+        int             consumed_bits;
+        int             underrun_line;
+        int             cursor_line_pending;
+
+        /* Cursor */
+        int             cursor_x;
+        int             cursor_y;
+        int             cursor_h;
+
+        /* Sound:  bytes fetched/played, and sample period in VIDC clocks
+         * (0 = off).
+         */
+        sound_fn_t      sound_fn;
+        int             snd_period;
+        int             snd_ctr;
+        uint64_t        snd_fetched;
+
+        /* DMA burst in progress: */
+        enum { DMA_IDLE, DMA_VIDEO, DMA_CURSOR, DMA_SOUND } dma_type;
+        int             dma_phase;
+        int             dma_word_base;
+
+        /* Register writes in progress: */
+        std::deque<uint32_t>    wq;
+        int             wr_phase;
+        int             writes_armed;
+};
+
+#endif
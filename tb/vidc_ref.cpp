@@ -0,0 +1,192 @@
+/* Software reference renderer for VIDC video.
+ *
+ * This has to keep up with checking every frame of a long simulation, so
+ * the unpacking is table-driven:  on configure(), each possible byte value
+ * is expanded once into its run of final RGB pixels (8, 4, 2 or 1 of them
+ * depending on bpp, twice as many if pixel-doubling).  Rendering a line is
+ * then one fixed-size copy per byte, which the compiler turns into vector
+ * moves.  Line doubling is a row copy.
+ *
+ * The colour rules mirror video_timing.v:
+ * - 1/2/4bpp index VIDC palette registers 0-15
+ * - 8bpp indexes the fixed palette8b[] (palette.mem), not VIDC's registers
+ * - Hires mono is pixel 1 = black, pixel 0 = white
+ * - 4-bit components are widened as {c[3:0], {4{c[3]}}}
+ * - Cursor colours 1-3 come from VIDC regs 17-19, except hires uses
+ *   false colours for 1 and 3
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "vidc_ref.h"
+
+VidcRef::VidcRef()
+{
+        memset(&cfg, 0, sizeof(cfg));
+        memset(palette8, 0, sizeof(palette8));
+        lut_stride = 0;
+}
+
+uint32_t        VidcRef::expand(uint16_t c)
+{
+        uint32_t r = c & 0xf;
+        uint32_t g = (c >> 4) & 0xf;
+        uint32_t b = (c >> 8) & 0xf;
+
+        r = (r << 4) | ((r & 8) ? 0xf : 0);
+        g = (g << 4) | ((g & 8) ? 0xf : 0);
+        b = (b << 4) | ((b & 8) ? 0xf : 0);
+        return (r << 16) | (g << 8) | b;
+}
+
+bool    VidcRef::load_palette8(const char *path)
+{
+        FILE *f = fopen(path, "r");
+        if (!f)
+                return false;
+
+        unsigned int v;
+        int n = 0;
+        while (n < 256 && fscanf(f, "%x", &v) == 1)
+                palette8[n++] = v & 0xfff;
+        fclose(f);
+        return n == 256;
+}
+
+void    VidcRef::configure(const struct vidc_ref_config &c)
+{
+        cfg = c;
+
+        unsigned int ppb = 8 >> cfg.bpp;
+        unsigned int mask = (1 << (1 << cfg.bpp)) - 1;
+        uint32_t colour[256];
+
+        if (cfg.hires) {
+                colour[0] = 0xffffff;
+                colour[1] = 0;
+        } else if (cfg.bpp == 3) {
+                for (int i = 0; i < 256; i++)
+                        colour[i] = expand(palette8[i]);
+        } else {
+                for (int i = 0; i < 16; i++)
+                        colour[i] = expand(cfg.palette[i]);
+        }
+
+        lut_stride = ppb << cfg.double_x;
+        lut.resize(256 * lut_stride);
+        for (unsigned int b = 0; b < 256; b++) {
+                uint32_t *l = &lut[b * lut_stride];
+                for (unsigned int p = 0; p < ppb; p++) {
+                        uint32_t rgb = colour[(b >> (p << cfg.bpp)) & mask];
+                        if (cfg.double_x) {
+                                *l++ = rgb;
+                                *l++ = rgb;
+                        } else {
+                                *l++ = rgb;
+                        }
+                }
+        }
+
+        cursor_rgb[0] = 0;
+        cursor_rgb[1] = expand(cfg.hires ? 0xff0 : cfg.cursor_palette[0]);
+        cursor_rgb[2] = expand(cfg.cursor_palette[1]);
+        cursor_rgb[3] = expand(cfg.hires ? 0x900 : cfg.cursor_palette[2]);
+}
+
+template <int N>
+void    VidcRef::render_line(const uint8_t *src, unsigned int bytes, uint32_t *dst) const
+{
+        const uint32_t *l = lut.data();
+
+        for (unsigned int i = 0; i < bytes; i++) {
+                memcpy(dst, &l[src[i] * N], N * sizeof(uint32_t));
+                dst += N;
+        }
+}
+
+void    VidcRef::render_cursor(const uint32_t *cursor, uint32_t *out) const
+{
+        unsigned int ow = out_width();
+
+        for (int row = 0; row < cfg.cursor_h; row++) {
+                unsigned int y = cfg.cursor_y + row;
+                if (y >= cfg.height)
+                        break;
+
+                const uint32_t *cw = &cursor[((row / 2) * 4) + ((row & 1) * 2)];
+
+                for (unsigned int i = 0; i < 32; i++) {
+                        unsigned int x = cfg.cursor_x + i;
+                        if (x >= cfg.width)
+                                break;
+                        unsigned int pix = (cw[i / 16] >> ((i % 16) * 2)) & 3;
+                        if (!pix)
+                                continue;
+
+                        for (int dy = 0; dy <= cfg.double_y; dy++) {
+                                uint32_t *o = &out[((y << cfg.double_y) + dy) * ow +
+                                                   (x << cfg.double_x)];
+                                o[0] = cursor_rgb[pix];
+                                if (cfg.double_x)
+                                        o[1] = cursor_rgb[pix];
+                        }
+                }
+        }
+}
+
+void    VidcRef::render(const uint32_t *words, const uint32_t *cursor, uint32_t *out) const
+{
+        unsigned int wpl = words_per_line();
+        unsigned int ow = out_width();
+        uint8_t bytes[256 * 4];         /* Line buffer limit of 256 words */
+
+        for (unsigned int y = 0; y < cfg.height; y++) {
+                const uint32_t *w = &words[y * wpl];
+                uint32_t *o = &out[(y << cfg.double_y) * ow];
+
+                /* DMA words are little-endian: pixel 0 is in the LSBs */
+                for (unsigned int i = 0; i < wpl; i++) {
+                        bytes[i*4 + 0] = w[i];
+                        bytes[i*4 + 1] = w[i] >> 8;
+                        bytes[i*4 + 2] = w[i] >> 16;
+                        bytes[i*4 + 3] = w[i] >> 24;
+                }
+
+                switch (lut_stride) {
+                case 1:         render_line<1>(bytes, wpl * 4, o);      break;
+                case 2:         render_line<2>(bytes, wpl * 4, o);      break;
+                case 4:         render_line<4>(bytes, wpl * 4, o);      break;
+                case 8:         render_line<8>(bytes, wpl * 4, o);      break;
+                default:        render_line<16>(bytes, wpl * 4, o);     break;
+                }
+
+                if (cfg.double_y)
+                        memcpy(o + ow, o, ow * sizeof(uint32_t));
+        }
+
+        if (cursor && cfg.cursor_h > 0)
+                render_cursor(cursor, out);
+}
@@ -0,0 +1,90 @@
+/* Software reference renderer for VIDC video:  turns a frame's worth of DMA
+ * data plus VIDC register state into the RGB image that video_timing should
+ * produce (including its 4-to-8 bit colour expansion), for golden-frame
+ * comparison in the testbenches.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VIDC_REF_H
+#define VIDC_REF_H
+
+#include <stdint.h>
+#include <vector>
+
+struct vidc_ref_config {
+        unsigned int    width;                  /* Input pixels per line */
+        unsigned int    height;                 /* Input lines */
+        unsigned int    bpp;                    /* log2, 0-3 */
+        int             hires;                  /* Mono hires: 1 = black, 0 = white */
+        int             double_x;
+        int             double_y;
+
+        uint16_t        palette[16];            /* VIDC regs 0-15 (12b BGR) */
+        uint16_t        cursor_palette[3];      /* VIDC regs 17-19 */
+
+        /* Cursor position in input pixels/lines; cursor_h = 0 for none */
+        int             cursor_x;
+        int             cursor_y;
+        int             cursor_h;
+};
+
+class VidcRef {
+public:
+        VidcRef();
+
+        /* The 8bpp palette is fixed, from palette.mem (256 lines of 12b hex) */
+        bool            load_palette8(const char *path);
+
+        /* Set up for a new mode/palette; cheap, but don't call per frame */
+        void            configure(const struct vidc_ref_config &c);
+
+        unsigned int    out_width() const       { return cfg.width << cfg.double_x; }
+        unsigned int    out_height() const      { return cfg.height << cfg.double_y; }
+        unsigned int    words_per_line() const  { return (cfg.width << cfg.bpp) / 32; }
+
+        /* words holds height*words_per_line() DMA words.  cursor holds 4 words
+         * (two 32-pixel lines) per pair of cursor lines.  out receives
+         * out_width()*out_height() pixels of 0x00RRGGBB.
+         */
+        void            render(const uint32_t *words, const uint32_t *cursor,
+                               uint32_t *out) const;
+
+        /* As video_timing expands a 12-bit VIDC colour to 24 bits */
+        static uint32_t expand(uint16_t c);
+
+private:
+        template <int N> void   render_line(const uint8_t *src, unsigned int bytes,
+                                            uint32_t *dst) const;
+        void            render_cursor(const uint32_t *cursor, uint32_t *out) const;
+
+        struct vidc_ref_config cfg;
+        uint16_t        palette8[256];
+
+        /* For each byte value, the (possibly x-doubled) run of output pixels */
+        std::vector<uint32_t> lut;
+        unsigned int    lut_stride;
+        uint32_t        cursor_rgb[4];
+};
+
+#endif
@@ -0,0 +1,151 @@
+/* ArcDVI SPI host library, see arcdvi_spi.h
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "arcdvi_spi.h"
+#include "../firmware/hw.h"
+#include "../firmware/video.h"
+
+/* Command, address, 8 bytes of mask, then the words: */
+#define XFER_MAX        (1 + 4 + 8 + 4 * ARCDVI_SPI_MAX_WORDS)
+
+#define SPI_ERR_ARGS    -1000
+
+static uint8_t  *put_be(uint8_t *p, uint64_t v, int bytes)
+{
+        for (int i = bytes - 1; i >= 0; i--)
+                *p++ = (uint8_t)(v >> (8 * i));
+        return p;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                ((uint32_t)p[2] << 8) | p[3];
+}
+
+int     arcdvi_spi_write(struct arcdvi_spi *d, uint32_t addr,
+                         const uint32_t *words, unsigned int n)
+{
+        uint8_t tx[XFER_MAX];
+        uint8_t *p = tx;
+
+        if (n > ARCDVI_SPI_MAX_WORDS)
+                return SPI_ERR_ARGS;
+
+        *p++ = ARCDVI_SPI_WRITE;
+        p = put_be(p, addr, 4);
+        for (unsigned int i = 0; i < n; i++)
+                p = put_be(p, words[i], 4);
+        return d->xfer(d->ctx, tx, 0, (unsigned int)(p - tx));
+}
+
+int     arcdvi_spi_read(struct arcdvi_spi *d, uint32_t addr,
+                        uint32_t *words, unsigned int n)
+{
+        uint8_t tx[XFER_MAX];
+        uint8_t rx[XFER_MAX];
+        uint8_t *p = tx;
+
+        if (n > ARCDVI_SPI_MAX_WORDS)
+                return SPI_ERR_ARGS;
+
+        /* Command, address, dummy, then clocking out the words: */
+        unsigned int len = 1 + 4 + 1 + 4 * n;
+
+        memset(tx, 0, len);
+        *p++ = ARCDVI_SPI_READ;
+        put_be(p, addr, 4);
+
+        int r = d->xfer(d->ctx, tx, rx, len);
+        if (r)
+                return r;
+        for (unsigned int i = 0; i < n; i++)
+                words[i] = get_be32(&rx[6 + 4 * i]);
+        return 0;
+}
+
+int     arcdvi_spi_write_set(struct arcdvi_spi *d, uint32_t base, uint64_t mask,
+                             const uint32_t *words)
+{
+        uint8_t tx[XFER_MAX];
+        uint8_t *p = tx;
+        unsigned int n = 0;
+
+        *p++ = ARCDVI_SPI_WRITE_SET;
+        p = put_be(p, base, 4);
+        p = put_be(p, mask, 8);
+        for (int b = 0; b < 64; b++) {
+                if (mask & (1ULL << b))
+                        p = put_be(p, words[n++], 4);
+        }
+        return d->xfer(d->ctx, tx, 0, (unsigned int)(p - tx));
+}
+
+int     arcdvi_spi_status(struct arcdvi_spi *d, unsigned int *status)
+{
+        uint8_t tx[2] = { ARCDVI_SPI_STATUS, 0 };
+        uint8_t rx[2];
+
+        int r = d->xfer(d->ctx, tx, rx, 2);
+        if (r)
+                return r;
+        *status = rx[1];
+        return 0;
+}
+
+int     arcdvi_spi_program_mode(struct arcdvi_spi *d, const struct video_regs *r,
+                                uint32_t fs, uint32_t phase, int commit)
+{
+        /* In register order, for ARCDVI_SPI_MODE_MASK: */
+        const uint32_t words[] = {
+                r->res_x, r->hs_fp, r->hs_width, r->hs_bp,
+                r->res_y, r->vs_fp, r->vs_width, r->vs_bp,
+                r->wplm1, r->ctrl,
+                fs,
+                r->pclk,
+                phase,
+                r->scaler, r->scaler_step, r->scaler_x, r->scaler_y, r->frame_lock,
+        };
+        uint32_t s;
+        int e;
+
+        e = arcdvi_spi_write_set(d, VIDO_BASE_ADDR, ARCDVI_SPI_MODE_MASK, words);
+        if (!e)
+                e = arcdvi_spi_read(d, VIDO_BASE_ADDR + 4 * VIDO_REG_SYNC, &s, 1);
+        if (e)
+                return e;
+
+        /* As video_program_mode(): */
+        if ((s & 1) != ((s >> 1) & 1))
+                return 0;
+        if (commit && ((s >> 5) & 1) == ((s >> 6) & 1))
+                s ^= 0x20;
+        else
+                s ^= 1;
+        return arcdvi_spi_write(d, VIDO_BASE_ADDR + 4 * VIDO_REG_SYNC, &s, 1);
+}
@@ -0,0 +1,91 @@
+/* ArcDVI SPI host library:  drives the SPI slave register interface
+ * (src/spi_slave.v) from an external MCU, or from the Verilator testbench.
+ *
+ * The caller supplies the SPI transfer function, so this has no idea what
+ * the SPI master is.  It must hold nCS low for the whole of one call, in
+ * SPI mode 0 with SCK at most the FPGA clock / 12, and return 0 on success.
+ *
+ * Plain C, so it can be built into MCU firmware, and compiles as C++.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ARCDVI_SPI_H
+#define ARCDVI_SPI_H
+
+#include <stdint.h>
+
+#include "../firmware/video_calc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Commands, see src/spi_slave.v */
+#define ARCDVI_SPI_WRITE        0x02
+#define ARCDVI_SPI_READ         0x03
+#define ARCDVI_SPI_STATUS       0x05
+#define ARCDVI_SPI_WRITE_SET    0x0b
+
+/* Most words in one call (the slave has no limit, but the buffers do): */
+#define ARCDVI_SPI_MAX_WORDS    64
+
+/* Registers video_program_mode() writes, for ARCDVI_SPI_WRITE_SET at
+ * VIDO_BASE_ADDR:  0-7, 9, 10, 16, 20, 30 and 32-36.
+ */
+#define ARCDVI_SPI_MODE_MASK    0x0000001f401106ffULL
+
+typedef int (*arcdvi_spi_xfer_fn)(void *ctx, const uint8_t *tx, uint8_t *rx,
+                                  unsigned int len);
+
+struct arcdvi_spi {
+        arcdvi_spi_xfer_fn      xfer;
+        void                    *ctx;
+};
+
+/* All return 0 on success, or the transfer function's error. */
+int     arcdvi_spi_write(struct arcdvi_spi *d, uint32_t addr,
+                         const uint32_t *words, unsigned int n);
+int     arcdvi_spi_read(struct arcdvi_spi *d, uint32_t addr,
+                        uint32_t *words, unsigned int n);
+/* Writes words[i] to the i-th set bit of mask, at base + 4*bit: */
+int     arcdvi_spi_write_set(struct arcdvi_spi *d, uint32_t base, uint64_t mask,
+                             const uint32_t *words);
+/* Bit 0 is the video interrupt (VIDO_REG_IRQ_STATUS & VIDO_REG_IRQ_MASK): */
+int     arcdvi_spi_status(struct arcdvi_spi *d, unsigned int *status);
+
+/* Programs a whole output mode in one transaction, as the firmware's
+ * video_program_mode() does, with the given frame store control and
+ * VIDO_REG_PHASE, then requests a sync (or a commit, if commit and one
+ * isn't outstanding).  If a sync is already outstanding, it picks up the
+ * new registers anyway.  The firmware's autoprobe should be turned off
+ * first (its "a" command), or it'll fight over the registers.
+ */
+int     arcdvi_spi_program_mode(struct arcdvi_spi *d, const struct video_regs *r,
+                                uint32_t fs, uint32_t phase, int commit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
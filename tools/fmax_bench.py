@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+#
+# ArcDVI: Fmax/utilisation benchmark
+#
+# Synthesises and places each build variant (using the Makefile's bitstream
+# rules), sweeping a few nextpnr placer seeds, and reads the achieved Fmax of
+# each clock and the resource usage from nextpnr's timing report.  Results
+# are appended to a history file (one JSON object per line, per variant) and
+# printed along with the change from the previous baseline, which is the
+# last successful run of that variant in the history (or of a given git
+# revision, with -b).
+#
+# Usage: tools/fmax_bench.py [-s SEEDS] [-v VARIANT,...] [-o HISTORY] [-b REV]
+#        tools/fmax_bench.py -l
+#
+# This is normally run by "make bench" (pass options in BENCH_ARGS).
+#
+# Copyright 2021 Matt Evans
+#
+# Permission is hereby granted, free of charge, to any person
+# obtaining a copy of this software and associated documentation files
+# (the "Software"), to deal in the Software without restriction,
+# including without limitation the rights to use, copy, modify, merge,
+# publish, distribute, sublicense, and/or sell copies of the Software,
+# and to permit persons to whom the Software is furnished to do so,
+# subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+# BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+# ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+# CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+import argparse
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+BOARD = "ulx3s"
+# As listed in platform/ulx3s/make.plat; the default size is the default variant:
+FPGA_SIZES = [12, 25, 45, 85]
+
+# Name, Makefile variables:
+VARIANTS = [
+    ("default",     {}),
+    ("hires",       {"HIRES_MODE": "1"}),
+    ("high_colour", {"HIGH_COLOUR": "1"}),
+    ("ppc2",        {"PIXELS_PER_CLK": "2"}),
+    ("xip",         {"FLASH_XIP": "1"}),
+]
+
+# Summary resource counts, from nextpnr's utilisation (older nextpnr packs
+# LUTs/FFs into TRELLIS_SLICE, which is then reported instead):
+RESOURCES = [
+    ("LUT",   ["TRELLIS_COMB"]),
+    ("FF",    ["TRELLIS_FF"]),
+    ("SLICE", ["TRELLIS_SLICE"]),
+    ("BRAM",  ["DP16KD"]),
+    ("DSP",   ["MULT18X18D", "ALU54B"]),
+]
+
+
+def default_fpga_size():
+    with open(os.path.join("platform", BOARD, "make.plat")) as f:
+        m = re.search(r"^FPGA_SIZE\s*\??=\s*(\d+)", f.read(), re.M)
+    return int(m.group(1))
+
+
+def all_variants():
+    v = list(VARIANTS)
+    for s in FPGA_SIZES:
+        if s != default_fpga_size():
+            v.append(("size%d" % s, {"FPGA_SIZE": str(s)}))
+    return v
+
+
+def git_rev():
+    try:
+        return subprocess.run(["git", "describe", "--always", "--dirty"],
+                              capture_output=True, text=True,
+                              check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def rm_f(path):
+    if os.path.exists(path):
+        os.remove(path)
+
+
+def clock_name(net):
+    # Global clock nets are renamed when promoted:
+    return net.replace("$glbnet$", "")
+
+
+def run_variant(name, mvars, seeds, make):
+    """Build one variant for each seed.  Returns the history record."""
+    project = "bench_" + name
+    size = int(mvars.get("FPGA_SIZE", default_fpga_size()))
+    json_file = project + ".json"
+    config = "%s_%df_%s.config" % (BOARD, size, project)
+
+    rec = {"date": time.strftime("%Y-%m-%d %H:%M:%S"),
+           "rev": git_rev(),
+           "variant": name,
+           "vars": mvars,
+           "seeds": seeds,
+           "status": "ok"}
+
+    # Always synthesise afresh, as the json doesn't depend on the options:
+    rm_f(json_file)
+
+    fmax = {}           # Clock: list of achieved MHz, per seed
+    constraint = {}
+    util = None
+    for seed in seeds:
+        report = "%s_s%d_timing.json" % (project, seed)
+        log = "%s_s%d.log" % (project, seed)
+        rm_f(config)
+        rm_f(report)
+
+        cmd = make + ["PROJECT=" + project, "NEXTPNR_SEED=%d" % seed,
+                      "TIMING_REPORT=" + report]
+        cmd += ["%s=%s" % kv for kv in sorted(mvars.items())]
+        cmd += [config]
+
+        print("%s: seed %d..." % (name, seed), flush=True)
+        with open(log, "w") as lf:
+            rc = subprocess.run(cmd, stdout=lf, stderr=subprocess.STDOUT).returncode
+        if rc != 0 or not os.path.exists(report):
+            print("%s: build failed (see %s)" % (name, log))
+            rec["status"] = "failed"
+            return rec
+
+        with open(report) as f:
+            r = json.load(f)
+        for net, t in r.get("fmax", {}).items():
+            c = clock_name(net)
+            fmax.setdefault(c, []).append(t["achieved"])
+            constraint[c] = t.get("constraint")
+        # Utilisation doesn't depend on placement; take the first:
+        if util is None:
+            util = r.get("utilization", {})
+
+    rec["fmax"] = {c: {"min": round(min(v), 2),
+                       "median": round(statistics.median(v), 2),
+                       "max": round(max(v), 2),
+                       "constraint": constraint[c]}
+                   for c, v in sorted(fmax.items())}
+    rec["util"] = {}
+    for res, bels in RESOURCES:
+        n = [util[b]["used"] for b in bels if b in util]
+        if n:
+            rec["util"][res] = sum(n)
+    rec["util_raw"] = {b: u["used"] for b, u in sorted(util.items())}
+    return rec
+
+
+def load_history(path):
+    hist = []
+    if os.path.exists(path):
+        with open(path) as f:
+            for line in f:
+                line = line.strip()
+                if line:
+                    hist.append(json.loads(line))
+    return hist
+
+
+def find_baseline(hist, variant, rev):
+    for rec in reversed(hist):
+        if rec["variant"] == variant and rec["status"] == "ok" and \
+           (rev is None or rec["rev"] == rev):
+            return rec
+    return None
+
+
+def delta(new, old, fmt):
+    if old is None:
+        return ""
+    d = new - old
+    return (" (" + fmt + ")") % d if d != 0 else " (=)"
+
+
+def print_record(rec, base):
+    print("\n%s @ %s: %s" % (rec["variant"], rec["rev"], rec["status"]))
+    if rec["status"] != "ok":
+        return
+    if base:
+        print("  vs %s (%s)" % (base["rev"], base["date"]))
+    else:
+        print("  (no baseline)")
+
+    for c, f in rec["fmax"].items():
+        old = base["fmax"].get(c) if base else None
+        print("  %-24s %7.2f %7.2f %7.2f MHz (min/median/max)%s, constraint %s" %
+              (c, f["min"], f["median"], f["max"],
+               delta(f["median"], old["median"] if old else None, "%+.2f"),
+               f["constraint"]))
+    u = []
+    for res, n in rec["util"].items():
+        old = base["util"].get(res) if base else None
+        u.append("%s %d%s" % (res, n, delta(n, old, "%+d")))
+    print("  " + ", ".join(u))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="ArcDVI Fmax/utilisation benchmark")
+    ap.add_argument("-s", "--seeds", type=int, default=3,
+                    help="placer seeds per variant (1..N, default 3)")
+    ap.add_argument("-v", "--variants",
+                    help="comma-separated variants to build (default all)")
+    ap.add_argument("-o", "--history", default="fmax_history.jsonl",
+                    help="history file to append to")
+    ap.add_argument("-b", "--baseline",
+                    help="compare against this git revision's runs, rather than the last")
+    ap.add_argument("-l", "--list", action="store_true",
+                    help="list the variants")
+    ap.add_argument("--make", default=os.environ.get("MAKE", "make"),
+                    help="make command")
+    args = ap.parse_args()
+
+    variants = all_variants()
+    if args.list:
+        for name, mvars in variants:
+            print("%-12s %s" % (name, " ".join("%s=%s" % kv for kv in sorted(mvars.items()))))
+        return 0
+
+    if args.variants:
+        names = args.variants.split(",")
+        unknown = [n for n in names if n not in dict(variants)]
+        if unknown:
+            print("Unknown variant(s): %s" % ", ".join(unknown))
+            return 2
+        variants = [v for v in variants if v[0] in names]
+
+    seeds = list(range(1, args.seeds + 1))
+    hist = load_history(args.history)
+
+    recs = []
+    for name, mvars in variants:
+        rec = run_variant(name, mvars, seeds, args.make.split())
+        recs.append((rec, find_baseline(hist, name, args.baseline)))
+        with open(args.history, "a") as f:
+            f.write(json.dumps(rec, sort_keys=True) + "\n")
+
+    for rec, base in recs:
+        print_record(rec, base)
+
+    return 1 if any(rec["status"] != "ok" for rec, base in recs) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
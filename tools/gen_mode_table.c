@@ -0,0 +1,154 @@
+/* Generates firmware/video_modes.h:  a table of output configurations for
+ * the standard RISC OS modes (tb/riscos_modes.h), keyed and sorted by VIDC
+ * timing signature, so that the firmware can switch to these modes with a
+ * lookup rather than running video_calc_mode().
+ *
+ * The calculation is firmware/video_calc.c, built for the host, so the
+ * table always matches what the firmware would otherwise calculate.  Each
+ * mode's registers are encoded from its VIDC list as the OS does it, and
+ * looked up in the finished table; if any misses, nothing is output and
+ * this fails.
+ *
+ * Usage: gen_mode_table > firmware/video_modes.h
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../firmware/vidc_regs.h"
+#include "../firmware/video_calc.h"
+#include "../tb/riscos_modes.h"
+
+struct gen_entry {
+        struct video_mode_entry e;
+        int                     mode;
+};
+
+/* The VIDC registers as the OS programs them (and as tb/vidc_bfm.cpp
+ * plays them):
+ */
+static void     mode_to_vidc(const struct riscos_mode *m, struct vidc_timing *t)
+{
+        struct riscos_vidc r;
+
+        riscos_mode_to_vidc(m, &r);
+        t->hcr = r.hcr;
+        t->hswr = r.hswr;
+        t->hdsr = r.hdsr;
+        t->hder = r.hder;
+        t->vcr = r.vcr;
+        t->vswr = r.vswr;
+        t->vdsr = r.vdsr;
+        t->vder = r.vder;
+        t->control = r.control;
+}
+
+static int      entry_cmp(const void *a, const void *b)
+{
+        return video_sig_cmp(&((const struct gen_entry *)a)->e.sig,
+                             &((const struct gen_entry *)b)->e.sig);
+}
+
+int     main(void)
+{
+        struct gen_entry table[NUM_RISCOS_MODES];
+        unsigned int n = 0;
+
+        for (unsigned int i = 0; i < NUM_RISCOS_MODES; i++) {
+                struct vidc_timing t;
+                struct video_mode m;
+
+                mode_to_vidc(&riscos_modes[i], &t);
+                /* For the hardware's pixel clocks; the firmware
+                 * recalculates if it lacks the one chosen (under SIM):
+                 */
+                video_calc_mode(&t, &m, VIDEO_PCLK_HW, &video_default_limits);
+                video_calc_sig(&t, &table[n].e.sig);
+                video_calc_regs(&m, &table[n].e.regs);
+                table[n].mode = riscos_modes[i].mode;
+                n++;
+        }
+
+        qsort(table, n, sizeof(table[0]), entry_cmp);
+
+        /* Check that every mode's writes find their entry, the way the
+         * firmware looks them up, so that a change to the encoding or the
+         * signature can't silently leave modes to be calculated:
+         */
+        int bad = 0;
+        for (unsigned int i = 0; i < NUM_RISCOS_MODES; i++) {
+                const struct riscos_mode *rm = &riscos_modes[i];
+                struct vidc_timing t;
+                struct video_mode m;
+                struct video_regs r;
+                struct gen_entry key;
+
+                mode_to_vidc(rm, &t);
+                video_calc_sig(&t, &key.e.sig);
+                const struct gen_entry *e = bsearch(&key, table, n, sizeof(table[0]),
+                                                    entry_cmp);
+                video_calc_mode(&t, &m, VIDEO_PCLK_HW, &video_default_limits);
+                video_calc_regs(&m, &r);
+                if (!e || memcmp(&e->e.regs, &r, sizeof(r)) != 0) {
+                        fprintf(stderr, "Mode %d: %s\n", rm->mode,
+                                e ? "table entry differs" : "not found in table");
+                        bad = 1;
+                }
+        }
+        if (bad)
+                return 1;
+
+        printf("/* Generated by tools/gen_mode_table.c, do not edit. */\n\n"
+               "#ifndef VIDEO_MODES_H\n"
+               "#define VIDEO_MODES_H\n\n"
+               "static const struct video_mode_entry video_mode_table[] = {\n");
+
+        unsigned int out = 0;
+        for (unsigned int i = 0; i < n; i++) {
+                const struct video_regs *r = &table[i].e.regs;
+
+                /* Modes with identical timing need only one entry: */
+                if (i > 0 && entry_cmp(&table[i - 1], &table[i]) == 0) {
+                        printf("        /* Mode %d: same as above */\n", table[i].mode);
+                        continue;
+                }
+                printf("        /* Mode %d: %ux%u */\n"
+                       "        { { { 0x%08x, 0x%08x, 0x%08x } },\n"
+                       "          { 0x%08x, %u, %u, %u, 0x%08x, %u, %u, %u, %u, 0x%08x, %u } },\n",
+                       table[i].mode, r->res_x & 0x7ff, r->res_y & 0x7ff,
+                       table[i].e.sig.w[0], table[i].e.sig.w[1], table[i].e.sig.w[2],
+                       r->res_x, r->hs_fp, r->hs_width, r->hs_bp,
+                       r->res_y, r->vs_fp, r->vs_width, r->vs_bp,
+                       r->wplm1, r->ctrl, r->pclk);
+                out++;
+        }
+
+        printf("};\n\n"
+               "#define VIDEO_MODE_TABLE_SIZE   %u\n\n"
+               "#endif\n", out);
+        return 0;
+}
@@ -0,0 +1,270 @@
+/* Benchmarks the output mode solver (firmware/video_calc.c, built for the
+ * host):  sweeps the standard RISC OS modes (tb/riscos_modes.h) and a batch
+ * of randomised custom VIDC timings, and reports how many solve exactly,
+ * inexactly or not at all, the line period error, and the time taken per
+ * mode.
+ *
+ * The firmware runs the solver on a picorv32 (RV32I, so multiply and divide
+ * are library calls) when a mode isn't in its table or cache, so host time
+ * isn't much of a guide; the candidates evaluated are counted instead, and
+ * scaled by an estimate of the cost of one to compare with a budget of one
+ * VIDC frame.
+ *
+ * Usage: solver_bench [-n <random modes>] [-s <seed>] [-a <pclk bitmap>]
+ *                     [-m <max scale>] [-v]
+ *
+ * -a is a bitmap of the pixel clocks available (see video_pclk_mhz), by
+ * default the hardware's (VIDEO_PCLK_HW).
+ *
+ * Exits with 2 if any RISC OS mode is unsolved or inexact.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../firmware/vidc_regs.h"
+#include "../firmware/video_calc.h"
+#include "../tb/riscos_modes.h"
+
+/* Rough picorv32 cost of one candidate (two multiplies and two divides in
+ * libgcc, plus the comparisons), and the budget:  a mode change already
+ * waits a few frames to settle, so one 50Hz frame at 50MHz goes unnoticed.
+ */
+#define RV32_CYCLES_PER_TRY     3000
+#define RV32_BUDGET_CYCLES      (50000000 / 50)
+
+#define REPEATS                 100     // Per mode, for a measurable time
+
+struct bench_stats {
+        unsigned int    modes, exact, inexact, unsolved;
+        unsigned int    err_max;
+        unsigned long   err_sum;        // Of inexact modes, ppm
+        unsigned int    tried_max;
+        unsigned long   tried_sum;
+        double          ns_sum, ns_max;
+};
+
+static int      verbose;
+
+/* As tools/gen_mode_table.c, the registers as the OS programs them: */
+static void     mode_to_vidc(const struct riscos_mode *m, struct vidc_timing *t)
+{
+        struct riscos_vidc r;
+
+        riscos_mode_to_vidc(m, &r);
+        t->hcr = r.hcr;
+        t->hswr = r.hswr;
+        t->hdsr = r.hdsr;
+        t->hder = r.hder;
+        t->vcr = r.vcr;
+        t->vswr = r.vswr;
+        t->vdsr = r.vdsr;
+        t->vder = r.vder;
+        t->control = r.control;
+}
+
+static unsigned int     rnd(unsigned int lo, unsigned int hi)
+{
+        return lo + (unsigned int)(rand() % (int)(hi - lo + 1));
+}
+
+/* A random custom mode that VIDC could be programmed with:  a display a
+ * whole number of DMA words wide, inside a line of up to 2048 pixels, and
+ * 128 lines or more with some blanking.  No borders.
+ */
+static void     random_mode(struct riscos_mode *m)
+{
+        static const int words_px[] = { 32, 16, 8, 4 };
+
+        m->mode = -1;
+        m->pixrate = rnd(0, 3);
+        m->bpp = rnd(0, 3);
+        m->hires = 0;
+
+        int word = words_px[m->bpp];
+        int off = vidc_bpp_to_hdsr_offset(m->bpp);
+
+        int h_total = 2 * rnd(128, 1024);
+        m->h_sync = 2 * rnd(4, 64);
+        m->h_bporch = 2 * rnd(4, 80) + off;
+        m->h_lborder = 0;
+        int h_start = m->h_sync + m->h_bporch;
+        if (h_start + 2 * word > h_total - 8)
+                h_total = h_start + 2 * word + 8 + (h_total & 0x3e);
+        int max_words = (h_total - 8 - h_start) / word;
+        m->h_disp = word * rnd(1, max_words);
+        m->h_rborder = 0;
+        m->h_fporch = h_total - h_start - m->h_disp;
+
+        int v_total = rnd(160, 1024);
+        m->v_sync = rnd(1, 8);
+        m->v_bporch = rnd(2, 40);
+        m->v_tborder = 0;
+        int v_start = m->v_sync + m->v_bporch;
+        if (v_start + 128 > v_total - 1)
+                v_total = v_start + 128 + 1;
+        m->v_disp = rnd(128, v_total - 1 - v_start);
+        m->v_bborder = 0;
+        m->v_fporch = v_total - v_start - m->v_disp;
+}
+
+static double   now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void     bench_mode(const struct riscos_mode *rm, unsigned int avail,
+                           const struct video_limits *l, struct bench_stats *st)
+{
+        struct vidc_timing t;
+        struct video_mode m;
+
+        mode_to_vidc(rm, &t);
+
+        double t0 = now_ns();
+        for (int i = 0; i < REPEATS; i++)
+                video_calc_mode(&t, &m, avail, l);
+        double ns = (now_ns() - t0) / REPEATS;
+
+        /* Solved means within the monitor limits, i.e. doubled or scaled if
+         * need be:
+         */
+        int solved = !(m.note == VM_NO_PCLK || m.note == VM_HIRES_NO_PCLK ||
+                       m.note == VM_NO_DOUBLE || m.note == VM_NO_DOUBLE_XY);
+
+        st->modes++;
+        if (!solved) {
+                st->unsolved++;
+        } else if (m.err_ppm) {
+                st->inexact++;
+                st->err_sum += m.err_ppm;
+                if (m.err_ppm > st->err_max)
+                        st->err_max = m.err_ppm;
+        } else {
+                st->exact++;
+        }
+        st->tried_sum += m.tried;
+        if (m.tried > st->tried_max)
+                st->tried_max = m.tried;
+        st->ns_sum += ns;
+        if (ns > st->ns_max)
+                st->ns_max = ns;
+
+        if (verbose)
+                printf("  mode %3d: %4dx%-4d %2dMHz %dbpp -> %4dx%-4d pclk %2dMHz, "
+                       "total %4d, %s %u ppm, %u tried, %.0fns\n",
+                       rm->mode, m.in_xres, m.in_yres, m.pix_rate, 1 << m.in_bpp,
+                       m.xres, m.yres, video_pclk_mhz[m.pclk],
+                       m.xres + m.xfp + m.xsw + m.xbp,
+                       !solved ? "unsolved" : m.err_ppm ? "inexact" : "exact",
+                       m.err_ppm, m.tried, ns);
+}
+
+static void     report(const char *name, const struct bench_stats *st)
+{
+        unsigned int cycles = st->tried_max * RV32_CYCLES_PER_TRY;
+
+        printf("%s: %u modes\n", name, st->modes);
+        printf("  solved:     %u exact (%.1f%%), %u inexact (%.1f%%), %u unsolved\n",
+               st->exact, 100.0 * st->exact / st->modes,
+               st->inexact, 100.0 * st->inexact / st->modes, st->unsolved);
+        if (st->inexact)
+                printf("  error:      mean %lu ppm, max %u ppm (inexact modes)\n",
+                       st->err_sum / st->inexact, st->err_max);
+        printf("  host time:  mean %.0fns, max %.0fns per mode\n",
+               st->ns_sum / st->modes, st->ns_max);
+        printf("  candidates: mean %.1f, max %u; RV32 est. max %u cycles "
+               "(%.1f%% of %u budget)%s\n",
+               (double)st->tried_sum / st->modes, st->tried_max, cycles,
+               100.0 * cycles / RV32_BUDGET_CYCLES, RV32_BUDGET_CYCLES,
+               cycles > RV32_BUDGET_CYCLES ? " *** OVER ***" : "");
+}
+
+int     main(int argc, char *argv[])
+{
+        unsigned int n = 10000;
+        unsigned int seed = 1;
+        unsigned int avail = VIDEO_PCLK_HW;
+        struct video_limits limits = video_default_limits;
+        struct bench_stats os, custom;
+        int opt;
+
+        while ((opt = getopt(argc, argv, "n:s:a:m:v")) != -1) {
+                switch (opt) {
+                case 'n':
+                        n = strtoul(optarg, 0, 0);
+                        break;
+                case 's':
+                        seed = strtoul(optarg, 0, 0);
+                        break;
+                case 'a':
+                        avail = strtoul(optarg, 0, 0) & VIDEO_PCLK_ALL;
+                        break;
+                case 'm':
+                        limits.max_scale = strtoul(optarg, 0, 0);
+                        if (limits.max_scale > VIDEO_MAX_SCALE)
+                                limits.max_scale = VIDEO_MAX_SCALE;
+                        break;
+                case 'v':
+                        verbose = 1;
+                        break;
+                default:
+                        fprintf(stderr, "Usage: %s [-n <random modes>] [-s <seed>] "
+                                "[-a <pclk bitmap>] [-m <max scale>] [-v]\n", argv[0]);
+                        return 1;
+                }
+        }
+
+        memset(&os, 0, sizeof(os));
+        memset(&custom, 0, sizeof(custom));
+
+        if (verbose)
+                printf("RISC OS modes:\n");
+        for (unsigned int i = 0; i < NUM_RISCOS_MODES; i++)
+                bench_mode(&riscos_modes[i], avail, &limits, &os);
+
+        srand(seed);
+        if (verbose)
+                printf("Random modes (seed %u):\n", seed);
+        for (unsigned int i = 0; i < n; i++) {
+                struct riscos_mode rm;
+
+                random_mode(&rm);
+                bench_mode(&rm, avail, &limits, &custom);
+        }
+
+        report("RISC OS modes", &os);
+        if (n)
+                report("Random modes", &custom);
+        return (os.unsolved || os.inexact) ? 2 : 0;
+}
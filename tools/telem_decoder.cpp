@@ -0,0 +1,213 @@
+/* ArcDVI telemetry decoder, see telem_decoder.h
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "telem_decoder.h"
+
+const unsigned int TelemDecoder::timing_regs[TELEM_TIMING_REGS] = { TELEM_TIMING_REG_LIST };
+
+static uint32_t get_le(const uint8_t *p, int bytes)
+{
+        uint32_t v = 0;
+
+        for (int i = bytes - 1; i >= 0; i--)
+                v = (v << 8) | p[i];
+        return v;
+}
+
+TelemDecoder::TelemDecoder()
+        : vidc_valid(0), records(0), crc_errors(0), bad_records(0), seq_lost(0),
+          dropped(0), text_bytes(0), in_rec(false), esc(false), bad(false),
+          have_seq(false), last_seq(0), have_time(false), last_time(0)
+{
+        memset(vidc, 0, sizeof(vidc));
+}
+
+void    TelemDecoder::feed(uint8_t c)
+{
+        if (c == TELEM_END) {
+                /* Records are sent as END, record, END; so an END ends a
+                 * record if there's one, and otherwise starts one.
+                 */
+                if (in_rec && !buf.empty()) {
+                        if (bad || esc)
+                                crc_errors++;
+                        else
+                                record();
+                        in_rec = false;
+                } else {
+                        in_rec = true;
+                }
+                buf.clear();
+                esc = false;
+                bad = false;
+                return;
+        }
+
+        if (!in_rec) {
+                text_bytes++;
+                if (text_fn)
+                        text_fn(c);
+                return;
+        }
+
+        if (esc) {
+                esc = false;
+                if (c == TELEM_ESC_END)
+                        c = TELEM_END;
+                else if (c == TELEM_ESC_ESC)
+                        c = TELEM_ESC;
+                else
+                        bad = true;
+        } else if (c == TELEM_ESC) {
+                esc = true;
+                return;
+        }
+
+        if (buf.size() >= TELEM_MAX_REC) {
+                /* Lost an END somewhere:  wait for the next */
+                bad = true;
+                return;
+        }
+        buf.push_back(c);
+}
+
+void    TelemDecoder::record()
+{
+        const uint8_t *p = buf.data();
+        unsigned int len = buf.size();
+
+        if (len < 4 || get_le(p + len - 2, 2) != telem_crc16(p, len - 2)) {
+                crc_errors++;
+                return;
+        }
+
+        TelemRecord r;
+        memset(&r, 0, sizeof(r));
+        r.type = p[0];
+        r.seq = p[1];
+
+        if (have_seq)
+                seq_lost += (r.seq - last_seq - 1) & 0xff;
+        have_seq = true;
+        last_seq = r.seq;
+
+        const uint8_t *b = p + 2;
+        unsigned int blen = len - 4;
+        bool ok = false;
+
+        switch (r.type) {
+        case TELEM_FRAME:
+                if (blen < TELEM_FRAME_BODY)
+                        break;
+                r.frame = get_le(b + 4, 4);
+                r.dmac_video = get_le(b + 8, 2);
+                r.dmac_cursor = get_le(b + 10, 2);
+                r.slack_min = (int16_t)get_le(b + 12, 2);
+                r.slack_max = (int16_t)get_le(b + 14, 2);
+                if (blen == TELEM_FRAME_BODY) {
+                        ok = true;
+                        break;
+                }
+                if (blen < TELEM_FRAME_BODY + 8)
+                        break;
+                r.has_vidc = true;
+                r.vidc_changed = get_le(b + 16, 4) |
+                        ((uint64_t)get_le(b + 20, 4) << 32);
+                if (blen != TELEM_FRAME_BODY + 8 +
+                    3 * (unsigned int)__builtin_popcountll(r.vidc_changed))
+                        break;
+                {
+                        const uint8_t *v = b + TELEM_FRAME_BODY + 8;
+
+                        for (int i = 0; i < TELEM_VIDC_REGS; i++) {
+                                if (!((r.vidc_changed >> i) & 1))
+                                        continue;
+                                vidc[i] = get_le(v, 3);
+                                v += 3;
+                        }
+                        vidc_valid |= r.vidc_changed;
+                }
+                ok = true;
+                break;
+
+        case TELEM_RECONF:
+                if (blen != TELEM_RECONF_BODY)
+                        break;
+                r.frame = get_le(b + 4, 4);
+                r.prog = get_le(b + 8, 4);
+                r.live = get_le(b + 12, 4);
+                r.writes = get_le(b + 16, 2);
+                r.frames = b[18];
+                r.source = b[19];
+                r.flags = get_le(b + 20, 2);
+                ok = true;
+                break;
+
+        case TELEM_TIMING:
+                if (blen != 8 + 4 * TELEM_TIMING_REGS)
+                        break;
+                r.frame = get_le(b + 4, 4);
+                for (int i = 0; i < TELEM_TIMING_REGS; i++)
+                        r.timing[i] = get_le(b + 8 + 4 * i, 4);
+                ok = true;
+                break;
+
+        case TELEM_DROP:
+                if (blen != 2)
+                        break;
+                r.dropped = get_le(b, 2);
+                dropped += r.dropped;
+                ok = true;
+                break;
+        }
+
+        if (!ok) {
+                bad_records++;
+                return;
+        }
+
+        /* The time is 32 bits of system clocks, so unwrap it (it's sent
+         * far more often than every 2^31; records can be slightly out of
+         * order, hence signed):
+         */
+        if (r.type != TELEM_DROP) {
+                uint32_t t = get_le(b, 4);
+
+                if (!have_time)
+                        last_time = t;
+                else
+                        last_time += (int32_t)(t - (uint32_t)last_time);
+                have_time = true;
+                r.time = last_time;
+        } else {
+                r.time = last_time;
+        }
+
+        records++;
+        if (record_fn)
+                record_fn(r);
+}
@@ -0,0 +1,117 @@
+/* ArcDVI telemetry decoder:  pulls the firmware's telemetry records
+ * (firmware/telem.h) out of its UART output, checking their CRCs and
+ * sequence numbers, and keeps an image of the VIDC registers from their
+ * deltas.  Everything else in the stream is console text, passed on as is.
+ *
+ * Used by tools/telem_dump.cpp, and by the Verilator testbench.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TELEM_DECODER_H
+#define TELEM_DECODER_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+#define TELEM_HOST
+#include "../firmware/telem.h"
+
+struct TelemRecord {
+        unsigned int    type;
+        unsigned int    seq;
+        uint64_t        time;           /* System clocks, unwrapped */
+        uint32_t        frame;
+
+        /* TELEM_FRAME: */
+        unsigned int    dmac_video;
+        unsigned int    dmac_cursor;
+        int             slack_min;
+        int             slack_max;
+        bool            has_vidc;
+        uint64_t        vidc_changed;   /* Bit n = VIDC register 4*n */
+
+        /* TELEM_RECONF: */
+        uint32_t        prog;
+        uint32_t        live;
+        unsigned int    writes;
+        unsigned int    frames;
+        unsigned int    source;
+        unsigned int    flags;
+
+        /* TELEM_TIMING, see TELEM_TIMING_REG_LIST: */
+        uint32_t        timing[TELEM_TIMING_REGS];
+
+        /* TELEM_DROP: */
+        unsigned int    dropped;
+};
+
+class TelemDecoder {
+public:
+        typedef std::function<void(const TelemRecord &)> record_fn_t;
+        typedef std::function<void(uint8_t)> text_fn_t;
+
+        TelemDecoder();
+
+        void            set_record_fn(record_fn_t fn)   { record_fn = fn; }
+        void            set_text_fn(text_fn_t fn)       { text_fn = fn; }
+
+        /* Feed the UART's bytes through: */
+        void            feed(uint8_t c);
+
+        /* The VIDC registers, from the deltas (by address/4), and which of
+         * them have been seen:
+         */
+        uint32_t        vidc[TELEM_VIDC_REGS];
+        uint64_t        vidc_valid;
+
+        /* The VIDO_REG_* numbers of TelemRecord::timing[]: */
+        static const unsigned int timing_regs[TELEM_TIMING_REGS];
+
+        /* Statistics */
+        uint64_t        records;
+        uint64_t        crc_errors;     /* Also framing errors */
+        uint64_t        bad_records;    /* Good CRC, but an unknown type or length */
+        uint64_t        seq_lost;       /* Records missing from the sequence */
+        uint64_t        dropped;        /* Records the firmware dropped */
+        uint64_t        text_bytes;
+
+private:
+        void            record();
+
+        record_fn_t     record_fn;
+        text_fn_t       text_fn;
+
+        bool            in_rec;
+        bool            esc;
+        bool            bad;
+        std::vector<uint8_t> buf;
+
+        bool            have_seq;
+        unsigned int    last_seq;
+        bool            have_time;
+        uint64_t        last_time;
+};
+
+#endif
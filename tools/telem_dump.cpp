@@ -0,0 +1,217 @@
+/* ArcDVI telemetry dump:  decodes the firmware's binary telemetry (see
+ * firmware/telem.h; turn it on with the "telem" command) from a capture of
+ * its UART output, or the serial port itself, into a time series.
+ *
+ * Usage: telem_dump [-j] [-t] [-c clock_hz] [file]
+ *
+ * Reads stdin if no file is given.  A serial port should be set up first,
+ * e.g. "stty -F /dev/ttyUSB0 115200 raw".  Writes CSV, one row per record
+ * (the columns that don't apply to a record type are empty), or with -j
+ * JSON, one object per line.  With -t, the console text in the stream goes
+ * to stderr.  At the end, a summary of what was decoded (and any CRC
+ * errors or lost records) goes to stderr.
+ *
+ * Copyright 2021 Matt Evans
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "telem_decoder.h"
+#include "../firmware/hw.h"
+
+static const char *type_names[] = { "?", "frame", "reconf", "timing", "drop" };
+static const char *source_names[] = { "table", "cache", "calculated" };
+static const char *flag_names[] = { "fs", "fixed", "line_lock", "commit",
+                                    "lb_full", "fs_busy" };
+static const char *timing_names[TELEM_TIMING_REGS] = {
+        "res_x", "hs_fp", "hs_width", "hs_bp", "res_y", "vs_fp", "vs_width", "vs_bp",
+        "wplm1", "ctrl", "pclk", "phase",
+        "scaler", "scaler_step", "scaler_x", "scaler_y",
+};
+
+static int      json;
+static double   clock_hz = CPU_CLK_RATE;
+
+static std::string      fmt(const char *f, ...) __attribute__((format(printf, 1, 2)));
+static std::string      fmt(const char *f, ...)
+{
+        char b[64];
+        va_list ap;
+
+        va_start(ap, f);
+        vsnprintf(b, sizeof(b), f, ap);
+        va_end(ap);
+        return b;
+}
+
+/* The record's details, as "name=value" pairs for CSV or members for JSON: */
+static std::string      details(const TelemDecoder &d, const TelemRecord &r)
+{
+        const char *sep = json ? ", " : " ";
+        const char *eq = json ? ": " : "=";
+        const char *q = json ? "\"" : "";
+        std::string s;
+
+        auto item = [&](const std::string &name, const std::string &val) {
+                if (!s.empty())
+                        s += sep;
+                s += q + name + q + eq + val;
+        };
+
+        switch (r.type) {
+        case TELEM_FRAME:
+                if (!r.has_vidc)
+                        break;
+                for (int i = 0; i < TELEM_VIDC_REGS; i++) {
+                        if ((r.vidc_changed >> i) & 1)
+                                item(fmt("vidc_%02x", i * 4), fmt("%s%06x%s", q, d.vidc[i], q));
+                }
+                break;
+
+        case TELEM_RECONF: {
+                std::string flags;
+
+                for (unsigned int i = 0; i < sizeof(flag_names) / sizeof(flag_names[0]); i++) {
+                        if (r.flags & (1 << i))
+                                flags += std::string(flags.empty() ? "" : "|") + flag_names[i];
+                }
+                item("prog_us", fmt("%.1f", r.prog * 1e6 / clock_hz));
+                item("live_us", fmt("%.1f", r.live * 1e6 / clock_hz));
+                item("writes", fmt("%u", r.writes));
+                item("frames", fmt("%u", r.frames));
+                item("source", fmt("%s%s%s", q, r.source < 3 ? source_names[r.source] : "?", q));
+                item("flags", q + flags + q);
+        } break;
+
+        case TELEM_TIMING:
+                for (int i = 0; i < TELEM_TIMING_REGS; i++)
+                        item(timing_names[i], fmt("%s%08x%s", q, r.timing[i], q));
+                break;
+
+        case TELEM_DROP:
+                item("dropped", fmt("%u", r.dropped));
+                break;
+        }
+        return s;
+}
+
+static void     print_record(const TelemDecoder &d, const TelemRecord &r)
+{
+        double t_us = r.time * 1e6 / clock_hz;
+        const char *type = r.type < 5 ? type_names[r.type] : "?";
+        std::string det = details(d, r);
+
+        if (json) {
+                printf("{\"t_us\": %.1f, \"type\": \"%s\", \"seq\": %u", t_us, type, r.seq);
+                if (r.type != TELEM_DROP)
+                        printf(", \"frame\": %u", r.frame);
+                if (r.type == TELEM_FRAME)
+                        printf(", \"dmac_video\": %u, \"dmac_cursor\": %u, "
+                               "\"slack_min\": %d, \"slack_max\": %d, \"vidc_changes\": %d",
+                               r.dmac_video, r.dmac_cursor, r.slack_min, r.slack_max,
+                               __builtin_popcountll(r.vidc_changed));
+                if (!det.empty())
+                        printf(", %s", det.c_str());
+                printf("}\n");
+        } else {
+                printf("%.1f,%s,%u,", t_us, type, r.seq);
+                if (r.type != TELEM_DROP)
+                        printf("%u", r.frame);
+                if (r.type == TELEM_FRAME)
+                        printf(",%u,%u,%d,%d,%d,", r.dmac_video, r.dmac_cursor,
+                               r.slack_min, r.slack_max,
+                               __builtin_popcountll(r.vidc_changed));
+                else
+                        printf(",,,,,,");
+                printf("%s\n", det.c_str());
+        }
+}
+
+static void     usage(const char *name)
+{
+        fprintf(stderr, "Usage: %s [-j] [-t] [-c clock_hz] [file]\n"
+                "\t-j\tWrite JSON lines (default CSV)\n"
+                "\t-t\tCopy console text to stderr\n"
+                "\t-c\tSystem clock, for times (default %d)\n", name, CPU_CLK_RATE);
+        exit(1);
+}
+
+int     main(int argc, char **argv)
+{
+        int text = 0;
+        int c;
+
+        while ((c = getopt(argc, argv, "jtc:h")) != -1) {
+                switch (c) {
+                case 'j':
+                        json = 1;
+                        break;
+                case 't':
+                        text = 1;
+                        break;
+                case 'c':
+                        clock_hz = strtod(optarg, 0);
+                        if (clock_hz <= 0)
+                                usage(argv[0]);
+                        break;
+                default:
+                        usage(argv[0]);
+                }
+        }
+
+        FILE *f = stdin;
+        if (optind < argc) {
+                f = fopen(argv[optind], "rb");
+                if (!f) {
+                        perror(argv[optind]);
+                        return 1;
+                }
+        }
+
+        TelemDecoder d;
+        d.set_record_fn([&d](const TelemRecord &r) {
+                print_record(d, r);
+                fflush(stdout);
+        });
+        if (text)
+                d.set_text_fn([](uint8_t ch) { fputc(ch, stderr); });
+
+        if (!json)
+                printf("t_us,type,seq,frame,dmac_video,dmac_cursor,slack_min,slack_max,"
+                       "vidc_changes,details\n");
+
+        while ((c = fgetc(f)) != EOF)
+                d.feed(c);
+
+        fprintf(stderr, "%llu records, %llu CRC errors, %llu bad, %llu lost, "
+                "%llu dropped by the firmware, %llu bytes of text\n",
+                (unsigned long long)d.records, (unsigned long long)d.crc_errors,
+                (unsigned long long)d.bad_records, (unsigned long long)d.seq_lost,
+                (unsigned long long)d.dropped, (unsigned long long)d.text_bytes);
+        return (d.crc_errors || d.bad_records) ? 2 : 0;
+}